@@ -0,0 +1,29 @@
+#ifndef __CRIT_CPU_H__
+#define __CRIT_CPU_H__
+
+#include "stm32f10x.h"
+
+/* With NVIC_PriorityGroup_4, preemption priorities 0 to 3 (motor control)
+ * stay enabled and 4 to 15 are masked. The USARTs, SysTick and PendSV, and
+ * any ISR calling uC/OS-II, must be at 4 or below. */
+#define __CRIT_CPU_BASEPRI (4 << (8 - __NVIC_PRIO_BITS))
+
+typedef u32_t crit_cpu_t;
+
+static inline crit_cpu_t crit_cpu_raise(void)
+{
+	crit_cpu_t old = __get_BASEPRI();
+
+	/* never lower a mask already raised, 0 being none */
+	if (old == 0 || old > __CRIT_CPU_BASEPRI)
+		__set_BASEPRI(__CRIT_CPU_BASEPRI);
+
+	return old;
+}
+
+static inline void crit_cpu_restore(crit_cpu_t old)
+{
+	__set_BASEPRI(old);
+}
+
+#endif /* __CRIT_CPU_H__ */
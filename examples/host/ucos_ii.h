@@ -0,0 +1,116 @@
+#ifndef __UCOS_II_H__
+#define __UCOS_II_H__
+
+/* As much of uC/OS-II as the port and the benchmarks run on a host use,
+ * each benchmark implementing the calls it makes. Put this directory on the
+ * include path ahead of the kernel's. */
+
+typedef unsigned char	BOOLEAN;
+typedef unsigned char	INT8U;
+typedef signed char	INT8S;
+typedef unsigned short	INT16U;
+typedef signed short	INT16S;
+typedef unsigned int	INT32U;
+typedef signed int	INT32S;
+typedef unsigned int	OS_STK;
+typedef unsigned int	OS_CPU_SR;
+typedef INT16U		OS_FLAGS;
+
+#define OS_CRITICAL_METHOD	3
+#define OS_TICKS_PER_SEC	1000
+#define OS_LOWEST_PRIO		63
+#define OS_PRIO_SELF		0xFF
+#define OS_STK_GROWTH		1
+
+#define OS_SEM_EN		1
+#define OS_SEM_SET_EN		1
+#define OS_Q_EN			1
+#define OS_MAX_QS		8
+#define OS_MEM_EN		1
+#define OS_MAX_MEM_PART		8
+#define OS_FLAG_EN		1
+#define OS_TMR_EN		0
+#define OS_TASK_CREATE_EXT_EN	1
+
+#define OS_ERR_NONE		0
+#define OS_ERR_TIMEOUT		10
+#define OS_ERR_PEND_ABORT	14
+#define OS_ERR_Q_FULL		30
+#define OS_ERR_Q_EMPTY		31
+#define OS_ERR_PRIO_EXIST	40
+#define OS_ERR_MEM_INVALID_PART	110
+#define OS_ERR_MEM_INVALID_BLKS	111
+#define OS_ERR_MEM_INVALID_SIZE	112
+#define OS_ERR_MEM_NO_FREE_BLKS	113
+#define OS_ERR_MEM_FULL		114
+#define OS_PEND_OPT_NONE	0
+#define OS_PEND_OPT_BROADCAST	1
+#define OS_DEL_NO_PEND		0
+#define OS_DEL_ALWAYS		1
+#define OS_TASK_OPT_STK_CHK	0x0001
+#define OS_TASK_OPT_STK_CLR	0x0002
+
+typedef struct os_event {
+	INT8U	OSEventType;
+	void	*OSEventPtr;
+	INT16U	OSEventCnt;
+} OS_EVENT;
+
+typedef struct os_mem {
+	void	*OSMemAddr;
+	void	*OSMemFreeList;
+	INT32U	OSMemBlkSize;
+	INT32U	OSMemNBlks;
+	INT32U	OSMemNFree;
+} OS_MEM;
+
+typedef struct os_tcb {
+	struct os_tcb	*OSTCBNext;
+	INT16U		OSTCBDly;
+	INT8U		OSTCBStat;
+	INT8U		OSTCBPrio;
+} OS_TCB;
+
+extern volatile INT32U	OSTime;
+extern INT8U		OSPrioCur;
+extern INT8U		OSIntNesting;
+
+#define OS_ENTER_CRITICAL() (cpu_sr = OS_CPU_SR_Save())
+#define OS_EXIT_CRITICAL() OS_CPU_SR_Restore(cpu_sr)
+
+OS_CPU_SR OS_CPU_SR_Save(void);
+void OS_CPU_SR_Restore(OS_CPU_SR cpu_sr);
+
+OS_EVENT *OSSemCreate(INT16U cnt);
+INT16U OSSemAccept(OS_EVENT *pevent);
+void OSSemPend(OS_EVENT *pevent, INT32U timeout, INT8U *perr);
+INT8U OSSemPendAbort(OS_EVENT *pevent, INT8U opt, INT8U *perr);
+INT8U OSSemPost(OS_EVENT *pevent);
+void OSSemSet(OS_EVENT *pevent, INT16U cnt, INT8U *perr);
+OS_EVENT *OSSemDel(OS_EVENT *pevent, INT8U opt, INT8U *perr);
+
+OS_EVENT *OSQCreate(void **start, INT16U size);
+OS_EVENT *OSQDel(OS_EVENT *pevent, INT8U opt, INT8U *perr);
+INT8U OSQFlush(OS_EVENT *pevent);
+INT8U OSQPost(OS_EVENT *pevent, void *pmsg);
+INT8U OSQPostFront(OS_EVENT *pevent, void *pmsg);
+void *OSQPend(OS_EVENT *pevent, INT32U timeout, INT8U *perr);
+void *OSQAccept(OS_EVENT *pevent, INT8U *perr);
+
+OS_MEM *OSMemCreate(void *addr, INT32U nblks, INT32U blksize, INT8U *perr);
+void *OSMemGet(OS_MEM *pmem, INT8U *perr);
+INT8U OSMemPut(OS_MEM *pmem, void *pblk);
+
+INT8U OSTaskCreate(void (*task)(void *p_arg), void *p_arg, OS_STK *ptos,
+		INT8U prio);
+INT8U OSTaskCreateExt(void (*task)(void *p_arg), void *p_arg, OS_STK *ptos,
+		INT8U prio, INT16U id, OS_STK *pbos, INT32U stk_size,
+		void *pext, INT16U opt);
+INT8U OSTaskDel(INT8U prio);
+void OSTaskNameSet(INT8U prio, INT8U *pname, INT8U *perr);
+
+void OSSchedLock(void);
+void OSSchedUnlock(void);
+INT32U OSTimeGet(void);
+
+#endif /* __UCOS_II_H__ */
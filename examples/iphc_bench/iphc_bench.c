@@ -0,0 +1,605 @@
+#include "iphc_bench.h"
+
+#include "lwip/opt.h"
+#include "arch/ppp_iphc.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if !PPP_IPHC || !PPP_IPHC_RX
+# error "The benchmark needs PPP_IPHC, and LWIP_TCP 0 for PPP_IPHC_RX"
+#endif
+
+#define __BENCH_FLAG	0x7e
+#define __BENCH_ESC	0x7d
+#define __BENCH_TRANS	0x20
+#define __BENCH_FCS_GOOD 0xf0b8
+
+#define __BENCH_IP	0x0021
+#define __BENCH_FULL	0x0061
+#define __BENCH_NON_TCP	0x0065
+#define __BENCH_IPCP	0x8021
+#define __BENCH_LCP	0xc021
+
+/* One direction of the simulated link */
+struct __bench_wire {
+	u8_t	buf[512];
+	u16_t	rd, wr;
+	u32_t	bytes;	/* written since last cleared */
+};
+
+/* One end: as much of lwIP's PPP as the benchmark needs, over the filter or
+ * straight on the link */
+struct __bench_end {
+	struct ppp_iphc		iphc;
+	u8_t			filter;
+	struct __bench_wire	*tx, *rx;
+	u32_t			accm;
+	u8_t			idle;	/* the next frame starts with a flag */
+	u8_t			req_id;
+	u8_t			up;	/* our IPCP request was acked */
+	u8_t			rfc2507; /* speaks IPHC itself, see below */
+	/* the frame being received */
+	u8_t			frame[256];
+	u16_t			n;
+	u8_t			esc;
+	/* the IP packet the other end sent, and what came */
+	u8_t			expect[20 + 8 + 64];
+	u16_t			expect_len;
+	u32_t			ok, bad;
+	/* the last IPHC frame which came, from its protocol field */
+	u8_t			got[1 + 20 + 8 + 64];
+	u16_t			got_len;
+};
+
+static const struct {
+	const char	*name;
+	u16_t		port;
+	u8_t		len;	/* UDP payload */
+} __bench_flows[] = {
+	{ "stun", 3478, 20 },		/* a binding request */
+	{ "dns", 53, 33 },		/* a query for a short name */
+	{ "telemetry", 5683, 48 },	/* a CoAP report */
+};
+
+static struct __bench_wire __bench_ab, __bench_ba;
+static struct __bench_end __bench_a, __bench_b;
+
+static u16_t __bench_fcs(u16_t fcs, u8_t c)
+{
+	u8_t i;
+
+	fcs ^= c;
+	for (i = 0; i < 8; i++)
+		fcs = fcs & 1 ? (fcs >> 1) ^ 0x8408 : fcs >> 1;
+
+	return fcs;
+}
+
+static u32_t __bench_sum(u32_t sum, const u8_t *b, u16_t len)
+{
+	u16_t i;
+
+	for (i = 0; i + 1 < len; i += 2)
+		sum += (u32_t)b[i] << 8 | b[i + 1];
+	if (len & 1)
+		sum += (u32_t)b[len - 1] << 8;
+
+	return sum;
+}
+
+static u16_t __bench_fold(u32_t sum)
+{
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return (u16_t)~sum;
+}
+
+static void __bench_wire_write(void *arg, const u8_t *data, u32_t len)
+{
+	struct __bench_wire *w = arg;
+
+	LWIP_ASSERT("wire full", w->wr + len <= sizeof(w->buf));
+	memcpy(w->buf + w->wr, data, len);
+	w->wr += len;
+	w->bytes += len;
+}
+
+static u32_t __bench_wire_read(void *arg, u8_t *data, u32_t len)
+{
+	struct __bench_wire *w = arg;
+
+	if (len > (u32_t)(w->wr - w->rd))
+		len = w->wr - w->rd;
+	memcpy(data, w->buf + w->rd, len);
+	w->rd += len;
+	if (w->rd == w->wr) {
+		w->rd = 0;
+		w->wr = 0;
+	}
+
+	return len;
+}
+
+static void __bench_put(u8_t *b, u16_t *n, u8_t c, u32_t accm)
+{
+	if (c == __BENCH_FLAG || c == __BENCH_ESC ||
+	    (c < 0x20 && (accm & (1UL << c)))) {
+		b[(*n)++] = __BENCH_ESC;
+		c ^= __BENCH_TRANS;
+	}
+	b[(*n)++] = c;
+}
+
+/* Send a frame with the given link header */
+static void __bench_frame(struct __bench_end *e, const u8_t *head, u16_t hlen,
+		const u8_t *data, u16_t len, u32_t accm)
+{
+	u8_t b[2 * (4 + sizeof(e->expect) + 2) + 2];
+	u16_t fcs = 0xffff, n = 0, i;
+
+	if (e->idle)
+		b[n++] = __BENCH_FLAG;
+	e->idle = 0;
+	for (i = 0; i < hlen; i++) {
+		fcs = __bench_fcs(fcs, head[i]);
+		__bench_put(b, &n, head[i], accm);
+	}
+	for (i = 0; i < len; i++) {
+		fcs = __bench_fcs(fcs, data[i]);
+		__bench_put(b, &n, data[i], accm);
+	}
+	fcs ^= 0xffff;
+	__bench_put(b, &n, (u8_t)fcs, accm);
+	__bench_put(b, &n, (u8_t)(fcs >> 8), accm);
+	b[n++] = __BENCH_FLAG;
+
+	if (e->filter)
+		ppp_iphc_write(&e->iphc, b, n, __bench_wire_write, e->tx);
+	else
+		__bench_wire_write(e->tx, b, n);
+}
+
+/* Send a frame as lwIP does, with address, control and protocol field
+ * compression on IP */
+static void __bench_send(struct __bench_end *e, u16_t proto,
+		const u8_t *data, u16_t len)
+{
+	u8_t head[4];
+	u16_t hlen = 0;
+
+	if (proto != __BENCH_IP) {
+		head[hlen++] = 0xff;
+		head[hlen++] = 0x03;
+		head[hlen++] = (u8_t)(proto >> 8);
+	}
+	head[hlen++] = (u8_t)proto;
+	__bench_frame(e, head, hlen, data, len,
+			proto == __BENCH_LCP ? 0xffffffffUL : e->accm);
+}
+
+static void __bench_ipcp_req(struct __bench_end *e, u8_t addr)
+{
+	/* an RFC 2507 peer asks for IPHC with the defaults of RFC 2509:
+	 * TCP_SPACE 15, NON_TCP_SPACE 15, F_MAX_PERIOD 256, F_MAX_TIME 5 and
+	 * MAX_HEADER 168 */
+	u8_t req[] = { 1, 0, 0, 10, 3, 6, 10, 64, 64, 0,
+		2, 14, 0x00, 0x61, 0, 15, 0, 15, 1, 0, 0, 5, 0, 168 };
+
+	req[1] = ++e->req_id;
+	req[9] = addr;
+	if (e->rfc2507)
+		req[3] = sizeof(req);
+	__bench_send(e, __BENCH_IPCP, req, req[3]);
+}
+
+/* IPCP as lwIP answers it, which rejects any IP-Compression-Protocol since
+ * VJ_SUPPORT is 0, or as an RFC 2507 peer does, which takes it */
+static void __bench_ipcp(struct __bench_end *e, u8_t *pkt, u16_t len)
+{
+	u8_t rej[64];
+	u16_t i, n = 4;
+
+	if (len < 4 || ((u16_t)pkt[2] << 8 | pkt[3]) != len)
+		return;
+	switch (pkt[0]) {
+	case 1:
+		for (i = 4; i + 2 <= len && pkt[i + 1] >= 2; i += pkt[i + 1]) {
+			if (pkt[i] == 2 && n + pkt[i + 1] <= sizeof(rej)) {
+				memcpy(rej + n, pkt + i, pkt[i + 1]);
+				n += pkt[i + 1];
+			}
+		}
+		if (n > 4 && !e->rfc2507) {
+			rej[0] = 4;
+			rej[1] = pkt[1];
+			rej[2] = 0;
+			rej[3] = (u8_t)n;
+			__bench_send(e, __BENCH_IPCP, rej, n);
+		} else {
+			pkt[0] = 2;
+			__bench_send(e, __BENCH_IPCP, pkt, len);
+		}
+		break;
+	case 2:
+		if (pkt[1] == e->req_id)
+			e->up = 1;
+		break;
+	case 3:
+	case 4:
+		if (pkt[1] == e->req_id)
+			__bench_ipcp_req(e, e == &__bench_a ? 1 : 2);
+		break;
+	}
+}
+
+static void __bench_input(struct __bench_end *e)
+{
+	u8_t *b = e->frame;
+	u16_t fcs = 0xffff, i, proto, hlen = 0;
+
+	for (i = 0; i < e->n; i++)
+		fcs = __bench_fcs(fcs, b[i]);
+	if (e->n < 4 || fcs != __BENCH_FCS_GOOD) {
+		if (e->n > 0)
+			e->bad++;
+		return;
+	}
+	if (b[0] == 0xff && b[1] == 0x03)
+		hlen = 2;
+	proto = b[hlen++];
+	if (!(proto & 1))
+		proto = proto << 8 | b[hlen++];
+	switch (proto) {
+	case __BENCH_IPCP:
+		__bench_ipcp(e, b + hlen, e->n - 2 - hlen);
+		break;
+	case __BENCH_IP:
+		if (e->n - 2 - hlen == e->expect_len &&
+		    memcmp(b + hlen, e->expect, e->expect_len) == 0)
+			e->ok++;
+		else
+			e->bad++;
+		break;
+	case __BENCH_FULL:
+	case __BENCH_NON_TCP:
+		e->got[0] = (u8_t)proto;
+		e->got_len = e->n - 2 - hlen + 1;
+		if (e->got_len > sizeof(e->got))
+			e->got_len = sizeof(e->got);
+		memcpy(e->got + 1, b + hlen, e->got_len - 1);
+		break;
+	}
+}
+
+/* Receive what the other end sent, as far as it goes */
+static void __bench_poll(struct __bench_end *e)
+{
+	u8_t buf[64];
+	u32_t n, i;
+	u8_t c;
+
+	while (1) {
+		if (e->filter)
+			n = ppp_iphc_read(&e->iphc, buf, sizeof(buf),
+					__bench_wire_read, e->rx);
+		else
+			n = __bench_wire_read(e->rx, buf, sizeof(buf));
+		if (n == 0)
+			return;
+		for (i = 0; i < n; i++) {
+			c = buf[i];
+			if (c == __BENCH_FLAG) {
+				__bench_input(e);
+				e->n = 0;
+				e->esc = 0;
+			} else if (c == __BENCH_ESC) {
+				e->esc = 1;
+			} else if (e->n < sizeof(e->frame)) {
+				e->frame[e->n++] = e->esc ? c ^ __BENCH_TRANS : c;
+				e->esc = 0;
+			}
+		}
+	}
+}
+
+static void __bench_pump(void)
+{
+	while (__bench_ab.wr > 0 || __bench_ba.wr > 0) {
+		__bench_poll(&__bench_b);
+		__bench_poll(&__bench_a);
+	}
+}
+
+static void __bench_end_init(struct __bench_end *e, u8_t filter,
+		struct __bench_wire *tx, struct __bench_wire *rx)
+{
+	memset(e, 0, sizeof(*e));
+	e->filter = filter;
+	e->tx = tx;
+	e->rx = rx;
+	e->accm = 0xffffffffUL;
+	e->idle = 1;
+	if (filter)
+		ppp_iphc_init(&e->iphc);
+}
+
+/* LCP settles on an ACCM of 0, then IPCP */
+static void __bench_open(void)
+{
+	static const u8_t ack[] = { 2, 1, 0, 10, 2, 6, 0, 0, 0, 0 };
+	u8_t i;
+
+	__bench_send(&__bench_a, __BENCH_LCP, ack, sizeof(ack));
+	__bench_send(&__bench_b, __BENCH_LCP, ack, sizeof(ack));
+	__bench_a.accm = 0;
+	__bench_b.accm = 0;
+	__bench_pump();
+	__bench_ipcp_req(&__bench_a, 1);
+	__bench_ipcp_req(&__bench_b, 2);
+	for (i = 0; i < 4 && !(__bench_a.up && __bench_b.up); i++)
+		__bench_pump();
+	LWIP_ASSERT("IPCP", __bench_a.up && __bench_b.up);
+}
+
+/* An IPv4/UDP datagram of the flow, from A to B */
+static u16_t __bench_packet(u8_t *p, u8_t flow, u16_t k)
+{
+	u16_t ulen = 8 + __bench_flows[flow].len;
+	u16_t len = 20 + ulen, sum, i;
+
+	memset(p, 0, 20 + 8);
+	p[0] = 0x45;
+	p[2] = (u8_t)(len >> 8);
+	p[3] = (u8_t)len;
+	p[4] = (u8_t)(k >> 8);
+	p[5] = (u8_t)k;
+	p[8] = 64;
+	p[9] = 17;
+	p[12] = 10; p[13] = 64; p[14] = 64; p[15] = 1;
+	p[16] = 192; p[17] = 0; p[18] = 2; p[19] = 10;
+	p[20] = 0xc0;
+	p[21] = flow;
+	p[22] = (u8_t)(__bench_flows[flow].port >> 8);
+	p[23] = (u8_t)__bench_flows[flow].port;
+	p[24] = (u8_t)(ulen >> 8);
+	p[25] = (u8_t)ulen;
+	for (i = 0; i < __bench_flows[flow].len; i++)
+		p[28 + i] = (u8_t)(k * 7 + i * 13);
+	sum = __bench_fold(__bench_sum(0, p, 20));
+	p[10] = (u8_t)(sum >> 8);
+	p[11] = (u8_t)sum;
+	/* pseudo header */
+	sum = __bench_fold(__bench_sum(__bench_sum(17 + ulen, p + 12, 8),
+				p + 20, ulen));
+	if (sum == 0)
+		sum = 0xffff;
+	p[26] = (u8_t)(sum >> 8);
+	p[27] = (u8_t)sum;
+
+	return len;
+}
+
+/* Bytes on the wire to send the datagrams of a flow */
+static u32_t __bench_run(u8_t flow, u8_t filter_a, u8_t filter_b)
+{
+	struct __bench_end *a = &__bench_a, *b = &__bench_b;
+	u16_t k;
+
+	memset(&__bench_ab, 0, sizeof(__bench_ab));
+	memset(&__bench_ba, 0, sizeof(__bench_ba));
+	__bench_end_init(a, filter_a, &__bench_ab, &__bench_ba);
+	__bench_end_init(b, filter_b, &__bench_ba, &__bench_ab);
+	__bench_open();
+
+	__bench_ab.bytes = 0;
+	for (k = 0; k < IPHC_BENCH_PACKETS; k++) {
+		b->expect_len = __bench_packet(b->expect, flow, k);
+		__bench_send(a, __BENCH_IP, b->expect, b->expect_len);
+		__bench_pump();
+	}
+	if (b->ok != IPHC_BENCH_PACKETS || b->bad > 0)
+		printf("iphc: %s: %lu datagrams of %u came through, %lu bad\r\n",
+				__bench_flows[flow].name, (unsigned long)b->ok,
+				IPHC_BENCH_PACKETS, (unsigned long)b->bad);
+
+	return __bench_ab.bytes;
+}
+
+/* Frames as RFC 2507 lays them out (sections 5.3 and 6), written here byte
+ * by byte rather than by the filter, each with the IPv4/UDP datagram it
+ * carries. A FULL_HEADER frame is the datagram with its IPv4 Total Length
+ * holding 1, 0 and the generation, then the 8-bit CID; a COMPRESSED_NON_TCP
+ * frame starts with the CID, 0, 0 and the generation, then the IPv4
+ * Identification and the UDP checksum if the flow has one. */
+struct __bench_vector {
+	const char	*name;
+	const u8_t	*ip;
+	u8_t		ip_len;
+	u8_t		gen, cid;	/* of a full header */
+	const u8_t	*compressed;	/* or this frame */
+	u8_t		compressed_len;
+};
+
+/* A STUN binding request of the node, 10.64.64.1:49152 to 192.0.2.10:3478,
+ * in a full header then compressed, as the filter must send them */
+static const u8_t __bench_tx1[] = {
+	0x45, 0x00, 0x00, 0x24, 0x00, 0x01, 0x00, 0x00, 0x40, 0x11, 0x6e, 0x7d,
+	0x0a, 0x40, 0x40, 0x01, 0xc0, 0x00, 0x02, 0x0a, 0xc0, 0x00, 0x0d, 0x96,
+	0x00, 0x10, 0x60, 0x96, 0x00, 0x01, 0x00, 0x00, 0x21, 0x12, 0xa4, 0x42
+};
+static const u8_t __bench_tx2[] = {
+	0x45, 0x00, 0x00, 0x24, 0x00, 0x02, 0x00, 0x00, 0x40, 0x11, 0x6e, 0x7c,
+	0x0a, 0x40, 0x40, 0x01, 0xc0, 0x00, 0x02, 0x0a, 0xc0, 0x00, 0x0d, 0x96,
+	0x00, 0x10, 0x60, 0x96, 0x00, 0x01, 0x00, 0x00, 0x21, 0x12, 0xa4, 0x42
+};
+static const u8_t __bench_tx2c[] = {
+	0x00, 0x01, 0x00, 0x02, 0x60, 0x96,
+	0x00, 0x01, 0x00, 0x00, 0x21, 0x12, 0xa4, 0x42
+};
+
+/* What the peer sends: the STUN response, CID 0 of generation 1, and a
+ * DNS answer without a UDP checksum, CID 1 of generation 5 */
+static const u8_t __bench_rx1[] = {
+	0x45, 0x00, 0x00, 0x24, 0x1a, 0x2b, 0x00, 0x00, 0x40, 0x11, 0x54, 0x53,
+	0xc0, 0x00, 0x02, 0x0a, 0x0a, 0x40, 0x40, 0x01, 0x0d, 0x96, 0xc0, 0x00,
+	0x00, 0x10, 0x5f, 0x96, 0x01, 0x01, 0x00, 0x00, 0x21, 0x12, 0xa4, 0x42
+};
+static const u8_t __bench_rx2[] = {
+	0x45, 0x00, 0x00, 0x24, 0x1a, 0x2c, 0x00, 0x00, 0x40, 0x11, 0x54, 0x52,
+	0xc0, 0x00, 0x02, 0x0a, 0x0a, 0x40, 0x40, 0x01, 0x0d, 0x96, 0xc0, 0x00,
+	0x00, 0x10, 0x5f, 0x96, 0x01, 0x01, 0x00, 0x00, 0x21, 0x12, 0xa4, 0x42
+};
+static const u8_t __bench_rx2c[] = {
+	0x00, 0x01, 0x1a, 0x2c, 0x5f, 0x96,
+	0x01, 0x01, 0x00, 0x00, 0x21, 0x12, 0xa4, 0x42
+};
+static const u8_t __bench_rx3[] = {
+	0x45, 0x00, 0x00, 0x24, 0x01, 0x00, 0x00, 0x00, 0x40, 0x11, 0x6d, 0x53,
+	0xc0, 0x00, 0x02, 0x35, 0x0a, 0x40, 0x40, 0x01, 0x00, 0x35, 0xc0, 0x01,
+	0x00, 0x10, 0x00, 0x00, 0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x01
+};
+static const u8_t __bench_rx4[] = {
+	0x45, 0x00, 0x00, 0x24, 0x01, 0x01, 0x00, 0x00, 0x40, 0x11, 0x6d, 0x52,
+	0xc0, 0x00, 0x02, 0x35, 0x0a, 0x40, 0x40, 0x01, 0x00, 0x35, 0xc0, 0x01,
+	0x00, 0x10, 0x00, 0x00, 0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x01
+};
+static const u8_t __bench_rx4c[] = {
+	0x01, 0x05, 0x01, 0x01,
+	0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x01
+};
+
+#define __BENCH_VECTOR(name, ip, gen, cid) \
+	{ name, ip, sizeof(ip), gen, cid, NULL, 0 }
+#define __BENCH_VECTOR_C(name, ip, c) \
+	{ name, ip, sizeof(ip), 0, 0, c, sizeof(c) }
+
+static const struct __bench_vector __bench_tx_vectors[] = {
+	__BENCH_VECTOR("stun full", __bench_tx1, 1, 0),
+	__BENCH_VECTOR_C("stun compressed", __bench_tx2, __bench_tx2c),
+};
+
+static const struct __bench_vector __bench_rx_vectors[] = {
+	__BENCH_VECTOR("stun full", __bench_rx1, 1, 0),
+	__BENCH_VECTOR_C("stun compressed", __bench_rx2, __bench_rx2c),
+	__BENCH_VECTOR("dns full", __bench_rx3, 5, 1),
+	__BENCH_VECTOR_C("dns compressed", __bench_rx4, __bench_rx4c),
+};
+
+/* The frame of a vector from its protocol field on, in 'b' */
+static u16_t __bench_vector_frame(const struct __bench_vector *v, u8_t *b)
+{
+	if (v->compressed) {
+		b[0] = (u8_t)__BENCH_NON_TCP;
+		memcpy(b + 1, v->compressed, v->compressed_len);
+		return 1 + v->compressed_len;
+	}
+	b[0] = (u8_t)__BENCH_FULL;
+	memcpy(b + 1, v->ip, v->ip_len);
+	b[1 + 2] = 0x80 | v->gen;
+	b[1 + 3] = v->cid;
+	return 1 + v->ip_len;
+}
+
+/* Against a peer which speaks IPHC itself: the frames the filter sends must
+ * be those of RFC 2507, and the peer's must come out as the datagrams they
+ * carry. The peer sends a full header with its address, control and
+ * protocol fields whole, a compressed one with them compressed. */
+static void __bench_rfc2507(void)
+{
+	static const u8_t head_full[] = { 0xff, 0x03, 0x00, 0x61 };
+	struct __bench_end *a = &__bench_a, *b = &__bench_b;
+	const struct __bench_vector *v;
+	struct ppp_iphc_stats st;
+	u8_t frame[sizeof(b->got)];
+	u16_t len;
+	u8_t i, tx_ok = 0, rx_ok = 0;
+
+	memset(&__bench_ab, 0, sizeof(__bench_ab));
+	memset(&__bench_ba, 0, sizeof(__bench_ba));
+	__bench_end_init(a, 1, &__bench_ab, &__bench_ba);
+	__bench_end_init(b, 0, &__bench_ba, &__bench_ab);
+	b->rfc2507 = 1;
+	__bench_open();
+	ppp_iphc_get_stats(&a->iphc, &st);
+	LWIP_ASSERT("IPHC both ways", st.tx_on && st.rx_on);
+
+	for (i = 0; i < sizeof(__bench_tx_vectors) /
+			sizeof(__bench_tx_vectors[0]); i++) {
+		v = &__bench_tx_vectors[i];
+		b->got_len = 0;
+		__bench_send(a, __BENCH_IP, v->ip, v->ip_len);
+		__bench_pump();
+		len = __bench_vector_frame(v, frame);
+		if (b->got_len == len && memcmp(b->got, frame, len) == 0)
+			tx_ok++;
+		else
+			printf("iphc: rfc2507: sent %s differs\r\n", v->name);
+	}
+	for (i = 0; i < sizeof(__bench_rx_vectors) /
+			sizeof(__bench_rx_vectors[0]); i++) {
+		v = &__bench_rx_vectors[i];
+		memcpy(a->expect, v->ip, v->ip_len);
+		a->expect_len = v->ip_len;
+		a->ok = 0;
+		len = __bench_vector_frame(v, frame);
+		if (v->compressed)
+			__bench_frame(b, frame, 1, frame + 1, len - 1, b->accm);
+		else
+			__bench_frame(b, head_full, sizeof(head_full),
+					frame + 1, len - 1, b->accm);
+		__bench_pump();
+		if (a->ok == 1)
+			rx_ok++;
+		else
+			printf("iphc: rfc2507: received %s differs\r\n",
+					v->name);
+	}
+	printf("rfc2507 peer: %u/%u frames sent as the RFC has them, %u/%u "
+			"received as the datagrams they carry\r\n", tx_ok,
+			(unsigned)(sizeof(__bench_tx_vectors) /
+				sizeof(__bench_tx_vectors[0])), rx_ok,
+			(unsigned)(sizeof(__bench_rx_vectors) /
+				sizeof(__bench_rx_vectors[0])));
+}
+
+static void __bench_print(u32_t bytes)
+{
+	/* per datagram, to a tenth, and datagrams a second */
+	printf("  %3lu.%lu %5lu", (unsigned long)(bytes / IPHC_BENCH_PACKETS),
+			(unsigned long)(bytes * 10 / IPHC_BENCH_PACKETS % 10),
+			(unsigned long)(IPHC_BENCH_BPS / 10UL *
+				IPHC_BENCH_PACKETS / bytes));
+}
+
+void iphc_bench(void)
+{
+	struct ppp_iphc_stats st;
+	u32_t plain, iphc, refused;
+	u8_t flow;
+
+	printf("iphc: %u datagrams a flow, %lu bit/s 8N1\r\n",
+			IPHC_BENCH_PACKETS, (unsigned long)IPHC_BENCH_BPS);
+	printf("                  plain        iphc        refused\r\n");
+	printf("flow    payload  B/pkt pkt/s  B/pkt pkt/s  B/pkt pkt/s"
+			"  full/compressed\r\n");
+	for (flow = 0; flow < sizeof(__bench_flows) / sizeof(__bench_flows[0]);
+			flow++) {
+		plain = __bench_run(flow, 0, 0);
+		refused = __bench_run(flow, 1, 0);
+		ppp_iphc_get_stats(&__bench_a.iphc, &st);
+		LWIP_ASSERT("compressing for a peer which refused", !st.tx_on);
+		iphc = __bench_run(flow, 1, 1);
+		ppp_iphc_get_stats(&__bench_a.iphc, &st);
+
+		printf("%-9s %5u", __bench_flows[flow].name,
+				__bench_flows[flow].len);
+		__bench_print(plain);
+		__bench_print(iphc);
+		__bench_print(refused);
+		printf("  %lu/%lu\r\n", (unsigned long)st.tx_full,
+				(unsigned long)st.tx_compressed);
+	}
+	__bench_rfc2507();
+}
@@ -0,0 +1,18 @@
+#ifndef __IPHC_BENCH_H__
+#define __IPHC_BENCH_H__
+
+/** Datagrams sent per flow and run */
+#ifndef IPHC_BENCH_PACKETS
+# define IPHC_BENCH_PACKETS 64
+#endif
+
+/** Bit rate of the simulated link, 8N1 taking 10 bits a byte */
+#ifndef IPHC_BENCH_BPS
+# define IPHC_BENCH_BPS 115200
+#endif
+
+/** Run the benchmark and print the results, from a task, once lwIP is
+ * initialized */
+void iphc_bench(void);
+
+#endif /* __IPHC_BENCH_H__ */
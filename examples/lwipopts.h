@@ -6,25 +6,120 @@
 #define TCPIP_THREAD_PRIO	12
 #define TCPIP_THREAD_STACKSIZE	128
 #define TCPIP_MBOX_SIZE		64
+#define SYS_MBOX_URGENT_SIZE	4
+#define SYS_MBOX_CACHE		4
+#define SYS_MBOX_CACHE_WARM	2
+#define SYS_SEM_CACHE		4
+#define SYS_BACKPRESSURE	1
+
+/* The diagnostics cost RAM and cycles, so they are off unless the build
+ * asks for them: a debug build defines DEBUG_BUILD 1 for all of them, e.g.
+ * with -DDEBUG_BUILD=1, or one of them alone, e.g. -DTASK_PROF=1. */
+#ifndef DEBUG_BUILD
+# define DEBUG_BUILD		0
+#endif
+
+/* Cortex-M3 DWT_CYCCNT, enabled by DEMCR.TRCENA and DWT_CTRL.CYCCNTENA */
+#ifndef TASK_PROF
+# define TASK_PROF		DEBUG_BUILD
+#endif
+#define TASK_PROF_CYCLES()	(*(volatile u32_t *)0xE0001004)
+#define TASK_PROF_CYCLES_INIT() \
+do { \
+	*(volatile u32_t *)0xE000EDFC |= 0x01000000; \
+	*(volatile u32_t *)0xE0001000 |= 1; \
+} while (0)
+
+/* Motor control ISRs above the threshold of crit_cpu.h stay enabled in the
+ * critical sections, which the serial rings skip altogether. Set
+ * SYS_CRIT_MEASURE in debug builds to find the longest ones. */
+#define SYS_CRIT		SYS_CRIT_THRESHOLD
+#define SYS_CRIT_MEASURE	0
+#define SIO_LOCKFREE		1
+
+/* SysTick stops while every task is blocked, see tickless_cpu.h */
+#define TICKLESS		1
+
+/* Timers for the modem retries and the STUN queries, run from
+ * OSTimeTickHook(). Both run in the tcpip thread, so there is no worker. */
+#define TIMER_WHEEL			1
 
 #define PPP_SUPPORT		1
 #define PPPOS_SUPPORT		1
 #define PPP_INPROC_OWNTHREAD	1
 #define PAP_SUPPORT		1
 #define CHAP_SUPPORT		1
-#define PPP_THREAD_PRIO		11
+#define PPP_THREAD_PRIO		10	/* 10 and 11 */
 #define PPP_THREAD_STACKSIZE	128
-
+#define NUM_PPP			2
+
+/* PPP_IPHC compresses the headers of the small UDP datagrams, STUN and DNS,
+ * that the node sends on the modem links, see arch/ppp_iphc.h. It can't
+ * decompress TCP, so with LWIP_TCP it doesn't offer the option
+ * (PPP_IPHC_RX 0) and the peer sends uncompressed. It takes the IPCP
+ * option VJ would use. */
+#define PPP_IPHC		1
+#define VJ_SUPPORT		0
+
+/* The receive thread of netif/sioslip.h, see examples/slip_link */
+#define SLIPIF_THREAD_PRIO	9
+#define SLIPIF_THREAD_STACKSIZE	128
+
+/* Two modems, each on its own USART, sharing the outbound traffic */
+#define SIO_NUM_DEVS		2
+#define MODEM_NUM		2
+#define MODEM_BALANCE		MODEM_BALANCE_WRR
+#define MODEM_WEIGHTS		{ 1, 1 }
+
+struct ip_addr;
+struct netif *modem_route(struct ip_addr *dest);
+#define LWIP_HOOK_IP4_ROUTE(dest) modem_route(dest)
+
+#define SIO_STATS		1
+#define SIO_FRAME_READ		1
+#ifndef CAPTURE
+# define CAPTURE		DEBUG_BUILD
+#endif
+#ifndef SIO_TRACE
+# define SIO_TRACE		DEBUG_BUILD
+#endif
+/* DWT_CYCCNT only runs once TASK_PROF started it, without it the trace
+ * falls back to OSTimeGet(), which times replays to the tick */
+#if TASK_PROF
+# define SIO_TRACE_CLOCK()	TASK_PROF_CYCLES()
+# define SIO_TRACE_CLOCK_HZ	72000000
+#endif
+
+/* The classes tools/mem_classes.py derived from the trace of
+ * examples/mem_bench, an upload, the echo server, STUN and DNS: 8464 bytes
+ * where the 16 KB heap they replace took 16404. Each queued TCP segment
+ * takes a 496-byte block, so the last class holds a send buffer and a
+ * quarter; a second upload at once needs as many blocks again. */
 #define MEM_ALIGNMENT		4
-#define MEM_SIZE		(16*1024)
+#define MEM_ARCH		1
+#define MEM_ARCH_CLASSES \
+	MEM_ARCH_CLASS(80, 3) \
+	MEM_ARCH_CLASS(352, 2) \
+	MEM_ARCH_CLASS(496, (TCP_PPP_SEGS * 5 + 3) / 4)
 #define MEMP_NUM_PBUF		10
 
-#define PBUF_POOL_SIZE		10
-#define PBUF_POOL_BUFSIZE	1500
+/* PPPoS chains pool pbufs, so small buffers serve the small frames which
+ * dominate the serial link without pinning 1500 bytes each. The rx_frames
+ * and rx_pool_empty counters of sio_get_stats() give the frames of each
+ * size and those the pool ran short for. */
+#define PBUF_POOL_SIZE		32
+#define PBUF_POOL_BUFSIZE	128
 
 #define LWIP_IPV6	0
 
-#define LWIP_TCP	0
+/* The segment sizes, buffers and window follow from the link, see
+ * arch/tcp_ppp.h. A full send buffer is TCP_PPP_SEGS segments of 420 bytes,
+ * each in a 496-byte MEM_ARCH block. */
+#define LWIP_TCP		1
+#define TCP_PPP_LINK_BPS	115200
+#define TCP_PPP_RTT_MS		400
+#define MEMP_NUM_TCP_PCB	4
+#define MEMP_NUM_TCP_PCB_LISTEN	2
 
 #define LWIP_ICMP	1
 
@@ -40,14 +135,30 @@
 #define DEFAULT_RAW_RECVMBOX_SIZE	64
 #define DEFAULT_ACCEPTMBOX_SIZE		64
 
-#define LWIP_STATS	0
+/* Only the memp counters, which SYS_BACKPRESSURE reads for the pbuf pool */
+#define LWIP_STATS	1
+#define LINK_STATS	0
+#define IP_STATS	0
+#define IPFRAG_STATS	0
+#define ICMP_STATS	0
+#define UDP_STATS	0
+#define TCP_STATS	0
+#define MEM_STATS	0
+#define SYS_STATS	0
+#define MEMP_STATS	1
+#ifndef RAM_REPORT
+# define RAM_REPORT	DEBUG_BUILD
+#endif
 
 #define LWIP_NETCONN		1
 #define LWIP_SOCKET		1
+#define NETCONN_WAIT		1
 #define LWIP_SO_RCVTIMEO	1
 
 #define LWIP_DEBUG		1
 #define PPP_DEBUG		0x80U
 #define DNS_DEBUG		0x80U
 
+#include "arch/tcp_ppp.h"
+
 #endif /* __LWIPOPTS_H__ */
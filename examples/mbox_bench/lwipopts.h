@@ -0,0 +1,19 @@
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/* The tcpip mbox options of examples/lwipopts.h, for mbox_bench on a host.
+ * Build with this directory first on the include path, once with
+ * -DSYS_MBOX_URGENT_SIZE=0 for the mbox without urgent slots. */
+
+#define NO_SYS			0
+
+#define TCPIP_THREAD_PRIO	12
+#define TCPIP_MBOX_SIZE		64
+#ifndef SYS_MBOX_URGENT_SIZE
+# define SYS_MBOX_URGENT_SIZE	4
+#endif
+#define SYS_MBOX_CACHE		0
+#define SYS_SEM_CACHE		0
+#define SYS_BACKPRESSURE	0
+
+#endif /* __LWIPOPTS_H__ */
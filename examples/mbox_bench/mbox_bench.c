@@ -0,0 +1,482 @@
+#include "mbox_bench.h"
+
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "ucos_ii.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define __BENCH_END	(MBOX_BENCH_SECONDS * 1000000UL)	/* us */
+#define __BENCH_PERIOD	(MBOX_BENCH_CONTROL_MS * 1000UL)
+#define __BENCH_EVENTS	(2 * OS_MAX_QS)
+#define __BENCH_LAT	(1UL << 16)
+#define __BENCH_PRIO	20	/* of the tasks posting */
+
+/* A task posting control messages: the message is the task, live until the
+ * tcpip thread handled it, as the message of an API call is */
+struct __bench_task {
+	u32_t	post_at;
+	u32_t	posted;
+	u8_t	pending;	/* posted and not handled yet */
+};
+
+/* The packets are all the same message, told apart from the tasks */
+static u8_t __bench_packet;
+
+static struct {
+	u32_t			now;		/* us */
+	sys_mbox_t		mbox;		/* the tcpip mbox */
+	OS_EVENT		*q;		/* and its OS queue */
+	u32_t			rx_at;		/* next packet lands */
+	u32_t			busy;		/* tcpip thread until */
+	struct __bench_task	task[MBOX_BENCH_TASKS];
+	u8_t			tasks;
+	u32_t			packets, dropped, handled;
+	u32_t			lat[__BENCH_LAT];	/* us, each control */
+	u32_t			n;
+	u32_t			random;
+} __bench;
+
+static void __bench_step(void);
+
+/* xorshift32 */
+static u32_t __bench_random(void)
+{
+	u32_t x = __bench.random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return __bench.random = x;
+}
+
+/* The kernel, as much of it as sys_arch.c uses for mboxes. The tasks run
+ * in __bench_step(), a microsecond at a time: a task pending on a
+ * semaphore runs the others until it is given a count, which a post hands
+ * to the waiting task before anybody else can take it. */
+volatile INT32U OSTime;
+INT8U OSPrioCur = __BENCH_PRIO;
+
+struct __bench_q {
+	void	**start;
+	INT16U	size;
+	INT16U	out;
+	INT16U	n;
+};
+
+static OS_EVENT __bench_event[__BENCH_EVENTS];
+static struct __bench_q __bench_q[__BENCH_EVENTS];
+static u8_t __bench_used[__BENCH_EVENTS];
+static u16_t __bench_waiting[__BENCH_EVENTS];	/* on a semaphore */
+static u16_t __bench_given[__BENCH_EVENTS];
+
+OS_CPU_SR OS_CPU_SR_Save(void)
+{
+	return 0;
+}
+
+void OS_CPU_SR_Restore(OS_CPU_SR cpu_sr)
+{
+	LWIP_UNUSED_ARG(cpu_sr);
+}
+
+INT32U OSTimeGet(void)
+{
+	return __bench.now / (1000000 / OS_TICKS_PER_SEC);
+}
+
+static OS_EVENT *__bench_event_new(void)
+{
+	u8_t i;
+
+	for (i = 0; i < __BENCH_EVENTS; i++) {
+		if (!__bench_used[i]) {
+			__bench_used[i] = 1;
+			__bench_waiting[i] = 0;
+			__bench_given[i] = 0;
+			__bench_event[i].OSEventCnt = 0;
+			__bench_event[i].OSEventPtr = &__bench_q[i];
+			return &__bench_event[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void __bench_event_del(OS_EVENT *e, INT8U *perr)
+{
+	__bench_used[e - __bench_event] = 0;
+	*perr = OS_ERR_NONE;
+}
+
+OS_EVENT *OSSemCreate(INT16U cnt)
+{
+	OS_EVENT *e = __bench_event_new();
+
+	if (e)
+		e->OSEventCnt = cnt;
+	return e;
+}
+
+OS_EVENT *OSSemDel(OS_EVENT *e, INT8U opt, INT8U *perr)
+{
+	LWIP_UNUSED_ARG(opt);
+	__bench_event_del(e, perr);
+	return NULL;
+}
+
+INT16U OSSemAccept(OS_EVENT *e)
+{
+	if (!e->OSEventCnt)
+		return 0;
+	return e->OSEventCnt--;
+}
+
+void OSSemPend(OS_EVENT *e, INT32U timeout, INT8U *perr)
+{
+	u8_t i = e - __bench_event;
+
+	LWIP_UNUSED_ARG(timeout);
+	*perr = OS_ERR_NONE;
+	if (e->OSEventCnt) {
+		e->OSEventCnt--;
+		return;
+	}
+	__bench_waiting[i]++;
+	while (!__bench_given[i])
+		__bench_step();
+	__bench_given[i]--;
+	__bench_waiting[i]--;
+}
+
+INT8U OSSemPost(OS_EVENT *e)
+{
+	u8_t i = e - __bench_event;
+
+	if (__bench_waiting[i] > __bench_given[i])
+		__bench_given[i]++;
+	else
+		e->OSEventCnt++;
+	return OS_ERR_NONE;
+}
+
+void OSSemSet(OS_EVENT *e, INT16U cnt, INT8U *perr)
+{
+	e->OSEventCnt = cnt;
+	*perr = OS_ERR_NONE;
+}
+
+OS_EVENT *OSQCreate(void **start, INT16U size)
+{
+	OS_EVENT *e = __bench_event_new();
+	struct __bench_q *q;
+
+	if (e) {
+		q = e->OSEventPtr;
+		q->start = start;
+		q->size = size;
+		q->out = 0;
+		q->n = 0;
+		/* the first one is the tcpip mbox's */
+		if (!__bench.q)
+			__bench.q = e;
+	}
+	return e;
+}
+
+OS_EVENT *OSQDel(OS_EVENT *e, INT8U opt, INT8U *perr)
+{
+	LWIP_UNUSED_ARG(opt);
+	__bench_event_del(e, perr);
+	return NULL;
+}
+
+INT8U OSQFlush(OS_EVENT *e)
+{
+	struct __bench_q *q = e->OSEventPtr;
+
+	q->n = 0;
+	return OS_ERR_NONE;
+}
+
+INT8U OSQPost(OS_EVENT *e, void *msg)
+{
+	struct __bench_q *q = e->OSEventPtr;
+
+	if (q->n == q->size)
+		return OS_ERR_Q_FULL;
+	q->start[(q->out + q->n++) % q->size] = msg;
+	return OS_ERR_NONE;
+}
+
+INT8U OSQPostFront(OS_EVENT *e, void *msg)
+{
+	struct __bench_q *q = e->OSEventPtr;
+
+	if (q->n == q->size)
+		return OS_ERR_Q_FULL;
+	q->out = q->out ? q->out - 1 : q->size - 1;
+	q->start[q->out] = msg;
+	q->n++;
+	return OS_ERR_NONE;
+}
+
+void *OSQAccept(OS_EVENT *e, INT8U *perr)
+{
+	struct __bench_q *q = e->OSEventPtr;
+	void *msg;
+
+	if (!q->n) {
+		*perr = OS_ERR_Q_EMPTY;
+		return NULL;
+	}
+	msg = q->start[q->out];
+	q->out = (q->out + 1) % q->size;
+	q->n--;
+	*perr = OS_ERR_NONE;
+	return msg;
+}
+
+/* The tcpip thread only fetches once a message is queued */
+void *OSQPend(OS_EVENT *e, INT32U timeout, INT8U *perr)
+{
+	LWIP_UNUSED_ARG(timeout);
+	return OSQAccept(e, perr);
+}
+
+/* OSMem as uC/OS-II has it: the free blocks linked through their first
+ * word, taken from and put back at the head of the list */
+static OS_MEM __bench_part;
+
+OS_MEM *OSMemCreate(void *addr, INT32U nblks, INT32U blksize, INT8U *perr)
+{
+	void **link;
+	INT32U i;
+
+	if (nblks < 2) {
+		*perr = OS_ERR_MEM_INVALID_BLKS;
+		return NULL;
+	}
+	for (i = 0; i < nblks - 1; i++) {
+		link = (void **)((u8_t *)addr + i * blksize);
+		*link = (u8_t *)addr + (i + 1) * blksize;
+	}
+	*(void **)((u8_t *)addr + i * blksize) = NULL;
+	__bench_part.OSMemAddr = addr;
+	__bench_part.OSMemFreeList = addr;
+	__bench_part.OSMemBlkSize = blksize;
+	__bench_part.OSMemNBlks = nblks;
+	__bench_part.OSMemNFree = nblks;
+	*perr = OS_ERR_NONE;
+	return &__bench_part;
+}
+
+void *OSMemGet(OS_MEM *pmem, INT8U *perr)
+{
+	void *blk = pmem->OSMemFreeList;
+
+	if (!blk) {
+		*perr = OS_ERR_MEM_NO_FREE_BLKS;
+		return NULL;
+	}
+	pmem->OSMemFreeList = *(void **)blk;
+	pmem->OSMemNFree--;
+	*perr = OS_ERR_NONE;
+	return blk;
+}
+
+INT8U OSMemPut(OS_MEM *pmem, void *blk)
+{
+	*(void **)blk = pmem->OSMemFreeList;
+	pmem->OSMemFreeList = blk;
+	pmem->OSMemNFree++;
+	return OS_ERR_NONE;
+}
+
+/* No threads are made, and nothing is deferred to the tcpip thread */
+INT8U OSTaskCreateExt(void (*task)(void *p_arg), void *p_arg, OS_STK *ptos,
+		INT8U prio, INT16U id, OS_STK *pbos, INT32U stk_size,
+		void *pext, INT16U opt)
+{
+	LWIP_UNUSED_ARG(task);
+	LWIP_UNUSED_ARG(p_arg);
+	LWIP_UNUSED_ARG(ptos);
+	LWIP_UNUSED_ARG(prio);
+	LWIP_UNUSED_ARG(id);
+	LWIP_UNUSED_ARG(pbos);
+	LWIP_UNUSED_ARG(stk_size);
+	LWIP_UNUSED_ARG(pext);
+	LWIP_UNUSED_ARG(opt);
+	return OS_ERR_PRIO_EXIST;
+}
+
+INT8U OSTaskDel(INT8U prio)
+{
+	LWIP_UNUSED_ARG(prio);
+	return OS_ERR_NONE;
+}
+
+void OSTaskNameSet(INT8U prio, INT8U *pname, INT8U *perr)
+{
+	LWIP_UNUSED_ARG(prio);
+	LWIP_UNUSED_ARG(pname);
+	*perr = OS_ERR_NONE;
+}
+
+void tcpip_defer_poll(void)
+{
+}
+
+/* Control messages of a task are spread over every phase of the packets */
+static void __bench_schedule(struct __bench_task *t, u32_t from)
+{
+	t->post_at = from + __BENCH_PERIOD / 2 + __bench_random() %
+		__BENCH_PERIOD;
+}
+
+/* A microsecond of the node: a packet lands, the tcpip thread takes the
+ * next message once done with the last, and the tasks post theirs */
+static void __bench_step(void)
+{
+	struct __bench_task *t;
+	struct __bench_q *q = __bench.q->OSEventPtr;
+	void *msg;
+	u8_t i;
+
+	__bench.now++;
+	if (__bench.now >= __bench.rx_at) {
+		__bench.rx_at += MBOX_BENCH_RX_US;
+		__bench.packets++;
+		if (sys_mbox_trypost(&__bench.mbox, &__bench_packet) != ERR_OK)
+			__bench.dropped++;
+	}
+	if (__bench.now >= __bench.busy && q->n) {
+		OSPrioCur = TCPIP_THREAD_PRIO;
+		sys_arch_mbox_fetch(&__bench.mbox, &msg, 0);
+		OSPrioCur = __BENCH_PRIO;
+		if (msg == &__bench_packet) {
+			__bench.busy = __bench.now + MBOX_BENCH_PACKET_US;
+			__bench.handled++;
+		} else {
+			t = msg;
+			if (__bench.n < __BENCH_LAT)
+				__bench.lat[__bench.n++] =
+					__bench.now - t->posted;
+			__bench.busy = __bench.now + MBOX_BENCH_CONTROL_US;
+			t->pending = 0;
+			__bench_schedule(t, __bench.busy);
+		}
+	}
+	for (i = 0; i < __bench.tasks; i++) {
+		t = &__bench.task[i];
+		if (!t->pending && __bench.now >= t->post_at) {
+			t->pending = 1;
+			t->posted = __bench.now;
+			/* may run the others until it is posted */
+			sys_mbox_post(&__bench.mbox, t);
+		}
+	}
+}
+
+static int __bench_cmp(const void *a, const void *b)
+{
+	u32_t x = *(const u32_t *)a, y = *(const u32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void __bench_row(u8_t tasks)
+{
+	unsigned long long sum = 0;
+	u32_t i;
+
+	__bench.now = 0;
+	__bench.rx_at = 0;
+	__bench.busy = 0;
+	__bench.packets = __bench.dropped = __bench.handled = 0;
+	__bench.n = 0;
+	__bench.random = 0x12345678;
+	__bench.tasks = tasks;
+	for (i = 0; i < tasks; i++) {
+		__bench.task[i].pending = 0;
+		__bench_schedule(&__bench.task[i], 0);
+	}
+
+	sys_init();
+	if (sys_mbox_new(&__bench.mbox, TCPIP_MBOX_SIZE) != ERR_OK) {
+		printf("sys_mbox_new failed\r\n");
+		exit(1);
+	}
+	while (__bench.now < __BENCH_END)
+		__bench_step();
+	sys_mbox_free(&__bench.mbox);
+	__bench.q = NULL;
+
+	qsort(__bench.lat, __bench.n, sizeof(__bench.lat[0]), __bench_cmp);
+	for (i = 0; i < __bench.n; i++)
+		sum += __bench.lat[i];
+	printf("%5u %8lu %7lu %7lu %7lu %8lu %7lu%%\r\n", tasks,
+			(unsigned long)__bench.n,
+			(unsigned long)(__bench.n ? sum / __bench.n : 0),
+			(unsigned long)(__bench.n ?
+				__bench.lat[__bench.n * 99 / 100] : 0),
+			(unsigned long)(__bench.n ?
+				__bench.lat[__bench.n - 1] : 0),
+			(unsigned long)(__bench.handled / MBOX_BENCH_SECONDS),
+			(unsigned long)(__bench.packets ? __bench.dropped *
+				100 / __bench.packets : 0));
+}
+
+/* Blocking and non-blocking posts to another mbox than the tcpip one, a
+ * netconn's, come out in the order they went in */
+static void __bench_order(void)
+{
+	sys_mbox_t tcpip, other;
+	u8_t msgs[3];
+	void *msg;
+	u8_t i;
+
+	sys_init();
+	if (sys_mbox_new(&tcpip, TCPIP_MBOX_SIZE) != ERR_OK ||
+			sys_mbox_new(&other, TCPIP_MBOX_SIZE) != ERR_OK) {
+		printf("sys_mbox_new failed\r\n");
+		exit(1);
+	}
+	sys_mbox_post(&other, &msgs[0]);
+	sys_mbox_trypost(&other, &msgs[1]);
+	sys_mbox_post(&other, &msgs[2]);
+	printf("another mbox, posted 1 2 3 (blocking, trypost, blocking), "
+			"fetched");
+	for (i = 0; i < 3; i++) {
+		sys_arch_mbox_tryfetch(&other, &msg);
+		printf(" %d", msg ? (int)((u8_t *)msg - msgs) + 1 : 0);
+	}
+	printf("\r\n");
+	sys_mbox_free(&other);
+	sys_mbox_free(&tcpip);
+	__bench.q = NULL;
+}
+
+void mbox_bench(void)
+{
+	u8_t tasks;
+
+	printf("mbox: SYS_MBOX_URGENT_SIZE %u, TCPIP_MBOX_SIZE %u, a packet "
+			"every %u us taking %u us, a control message every %u "
+			"ms a task taking %u us\r\n", SYS_MBOX_URGENT_SIZE,
+			TCPIP_MBOX_SIZE, MBOX_BENCH_RX_US, MBOX_BENCH_PACKET_US,
+			MBOX_BENCH_CONTROL_MS, MBOX_BENCH_CONTROL_US);
+	printf("               control latency us     packets\r\n");
+	printf("tasks controls    mean     p99     max       /s "
+			"dropped\r\n");
+	for (tasks = 1; tasks <= MBOX_BENCH_TASKS; tasks *= 2)
+		__bench_row(tasks);
+	__bench_order();
+}
+
+int main(void)
+{
+	mbox_bench();
+	return 0;
+}
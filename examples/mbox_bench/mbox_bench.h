@@ -0,0 +1,39 @@
+#ifndef __MBOX_BENCH_H__
+#define __MBOX_BENCH_H__
+
+#include "lwip/opt.h"
+
+/** Simulated seconds of a row */
+#ifndef MBOX_BENCH_SECONDS
+# define MBOX_BENCH_SECONDS 60
+#endif
+
+/** A packet is posted to the tcpip mbox with sys_mbox_trypost() this often,
+ * faster than the tcpip thread takes to handle one, so that the mbox stays
+ * full and drops what doesn't fit */
+#ifndef MBOX_BENCH_RX_US
+# define MBOX_BENCH_RX_US 100
+#endif
+#ifndef MBOX_BENCH_PACKET_US
+# define MBOX_BENCH_PACKET_US 150
+#endif
+
+/** Each task posts a control message with sys_mbox_post() every
+ * MBOX_BENCH_CONTROL_MS on average, and waits until the tcpip thread handled
+ * it, as an API call does. Handling it takes MBOX_BENCH_CONTROL_US. */
+#ifndef MBOX_BENCH_CONTROL_MS
+# define MBOX_BENCH_CONTROL_MS 10
+#endif
+#ifndef MBOX_BENCH_CONTROL_US
+# define MBOX_BENCH_CONTROL_US 20
+#endif
+
+/** Most tasks posting control messages, the rows doubling up to it */
+#ifndef MBOX_BENCH_TASKS
+# define MBOX_BENCH_TASKS 8
+#endif
+
+/** Run the benchmark and print the results, on a host */
+void mbox_bench(void);
+
+#endif /* __MBOX_BENCH_H__ */
@@ -0,0 +1,27 @@
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/* The heap and TCP options of examples/lwipopts.h, for mem_bench on a host.
+ * Build with this directory first on the include path. */
+
+#define NO_SYS			0
+
+#define MEM_ALIGNMENT		4
+#define MEM_ARCH		1
+#define MEM_ARCH_CLASSES \
+	MEM_ARCH_CLASS(80, 3) \
+	MEM_ARCH_CLASS(352, 2) \
+	MEM_ARCH_CLASS(496, (TCP_PPP_SEGS * 5 + 3) / 4)
+#define PBUF_POOL_SIZE		32
+#define PBUF_POOL_BUFSIZE	128
+
+#define LWIP_TCP		1
+#define TCP_PPP_LINK_BPS	115200
+#define TCP_PPP_RTT_MS		400
+#define MEMP_NUM_TCP_PCB	4
+
+#define LWIP_DNS		1
+
+#include "arch/tcp_ppp.h"
+
+#endif /* __LWIPOPTS_H__ */
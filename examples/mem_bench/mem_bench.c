@@ -0,0 +1,636 @@
+#include "mem_bench.h"
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/sys.h"
+#include "arch/mem_arch.h"
+#include "ucos_ii.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if !MEM_ARCH
+# error "The benchmark compares MEM_ARCH with the heap, MEM_ARCH must be 1"
+#endif
+
+#define __BENCH_HZ	TCP_PPP_BYTES_PER_SEC	/* bytes a second on a link */
+#define __BENCH_LINKS	2	/* the modems of examples/lwipopts.h */
+#define __BENCH_PPP	4	/* flag, protocol field and FCS of a frame */
+#define __BENCH_RTT	(TCP_PPP_RTT_MS * 1000UL)	/* us */
+#define __BENCH_END	(MEM_BENCH_SECONDS * 1000000UL)
+#define __BENCH_RETRY	500000UL	/* us, lwIP's slow timer */
+#define __BENCH_CALLS	(1UL << 17)
+/* The RAM of the classes on the board, where the class pointer in front
+ * of each block takes 4 bytes */
+#define MEM_ARCH_CLASS(size, nblks) \
+	+ (nblks) * (LWIP_MEM_ALIGN_SIZE(size) + 4)
+enum { __BENCH_ARCH_RAM = 0 MEM_ARCH_CLASSES };
+#undef MEM_ARCH_CLASS
+
+/* What pbuf_alloc() asks mem_malloc() for, for a PBUF_RAM pbuf of 'len'
+ * bytes with 'hlen' bytes of headers in front: struct pbuf, the headers and
+ * the data, each aligned */
+#define __BENCH_PBUF(hlen, len) \
+	(LWIP_MEM_ALIGN_SIZE(16 + (hlen)) + LWIP_MEM_ALIGN_SIZE(len))
+#define __BENCH_TRANSPORT	(PBUF_LINK_HLEN + 20 + 20)
+#define __BENCH_IP		(PBUF_LINK_HLEN + 20)
+
+/* tcp_write() of a segment, and the SYN, with its MSS option, and FIN of
+ * tcp_enqueue_flags() */
+#define __BENCH_SEG	__BENCH_PBUF(__BENCH_TRANSPORT, TCP_MSS)
+#define __BENCH_SYN	__BENCH_PBUF(__BENCH_TRANSPORT, 4)
+#define __BENCH_FIN	__BENCH_PBUF(__BENCH_TRANSPORT, 0)
+/* The UDP header udp_sendto() puts in front of the data of sendto(), which
+ * the netbuf references */
+#define __BENCH_ECHO	__BENCH_PBUF(__BENCH_IP, 8)
+/* A STUN Binding Request, and dns_send(), which asks for the longest name */
+#define __BENCH_STUN	__BENCH_PBUF(__BENCH_TRANSPORT, 20)
+#define __BENCH_DNS \
+	__BENCH_PBUF(__BENCH_TRANSPORT, 12 + DNS_MAX_NAME_LENGTH + 4)
+
+#define __BENCH_CLOSED	0
+#define __BENCH_SYN_SENT 1
+#define __BENCH_EST	2
+#define __BENCH_FIN_SENT 3
+
+/* An upload as lwIP's TCP allocates for it: a pbuf for each segment, freed
+ * once acked, one round trip after the segment left the link. It connects,
+ * keeps TCP_SND_BUF in flight, closes once everything is acked and connects
+ * again. */
+struct __bench_upload {
+	u8_t	state;
+	u8_t	link;
+	u32_t	left;	/* bytes not written yet */
+	void	*seg[TCP_PPP_SEGS];	/* waiting for their ACK, oldest first */
+	u32_t	ack_at[TCP_PPP_SEGS];
+	u8_t	rd, n;
+	void	*ctl;	/* the SYN or FIN waiting for its ACK */
+	u32_t	ctl_at;
+	u32_t	retry_at;	/* after a failed allocation */
+};
+
+static const struct __bench_allocator {
+	const char	*name;
+	void		*(*malloc)(size_t size);
+	void		(*free)(void *mem);
+} *__bench_a;
+
+static struct {
+	u32_t			now;		/* us */
+	u32_t			link[__BENCH_LINKS];	/* busy until */
+	struct __bench_upload	up[MEMP_NUM_TCP_PCB];
+	u8_t			uploads;
+	u32_t			random;
+	u8_t			repeat;
+	u32_t			calls;
+	u32_t			allocs, fails, frag;
+	u32_t			walk, walk_max;	/* heap blocks looked at */
+} __bench;
+
+static u32_t __bench_ns[__BENCH_CALLS];	/* least time of each call */
+static u8_t __bench_op[__BENCH_CALLS];	/* 0 for mem_malloc(), 1 for free */
+static u32_t __bench_overhead;		/* of reading the clock */
+
+/* The kernel, as much of it as mem_arch.c uses */
+OS_CPU_SR OS_CPU_SR_Save(void)
+{
+	return 0;
+}
+
+void OS_CPU_SR_Restore(OS_CPU_SR cpu_sr)
+{
+	LWIP_UNUSED_ARG(cpu_sr);
+}
+
+/* OSMem as uC/OS-II has it: the free blocks linked through their first
+ * word, taken from and put back at the head of the list */
+static OS_MEM __bench_part[OS_MAX_MEM_PART];
+static u8_t __bench_parts;
+
+OS_MEM *OSMemCreate(void *addr, INT32U nblks, INT32U blksize, INT8U *perr)
+{
+	OS_MEM *pmem;
+	void **link;
+	INT32U i;
+
+	if (nblks < 2) {
+		*perr = OS_ERR_MEM_INVALID_BLKS;
+		return NULL;
+	}
+	if (blksize < sizeof(void *)) {
+		*perr = OS_ERR_MEM_INVALID_SIZE;
+		return NULL;
+	}
+	if (__bench_parts == OS_MAX_MEM_PART) {
+		*perr = OS_ERR_MEM_INVALID_PART;
+		return NULL;
+	}
+	pmem = &__bench_part[__bench_parts++];
+	link = addr;
+	for (i = 0; i < nblks - 1; i++) {
+		*link = (u8_t *)link + blksize;
+		link = *link;
+	}
+	*link = NULL;
+	pmem->OSMemAddr = addr;
+	pmem->OSMemFreeList = addr;
+	pmem->OSMemBlkSize = blksize;
+	pmem->OSMemNBlks = nblks;
+	pmem->OSMemNFree = nblks;
+	*perr = OS_ERR_NONE;
+
+	return pmem;
+}
+
+void *OSMemGet(OS_MEM *pmem, INT8U *perr)
+{
+	void *pblk;
+	OS_CPU_SR cpu_sr;
+
+	OS_ENTER_CRITICAL();
+	if (pmem->OSMemNFree > 0) {
+		pblk = pmem->OSMemFreeList;
+		pmem->OSMemFreeList = *(void **)pblk;
+		pmem->OSMemNFree--;
+		OS_EXIT_CRITICAL();
+		*perr = OS_ERR_NONE;
+		return pblk;
+	}
+	OS_EXIT_CRITICAL();
+	*perr = OS_ERR_MEM_NO_FREE_BLKS;
+
+	return NULL;
+}
+
+INT8U OSMemPut(OS_MEM *pmem, void *pblk)
+{
+	OS_CPU_SR cpu_sr;
+
+	OS_ENTER_CRITICAL();
+	if (pmem->OSMemNFree >= pmem->OSMemNBlks) {
+		OS_EXIT_CRITICAL();
+		return OS_ERR_MEM_FULL;
+	}
+	*(void **)pblk = pmem->OSMemFreeList;
+	pmem->OSMemFreeList = pblk;
+	pmem->OSMemNFree++;
+	OS_EXIT_CRITICAL();
+
+	return OS_ERR_NONE;
+}
+
+/* lwIP 1.4's heap, mem.c without mem_trim() and the statistics: a MEM_ARCH
+ * build has MEM_LIBC_MALLOC, which compiles mem.c to nothing, so the
+ * benchmark carries it. First fit from the lowest free block, the blocks
+ * linked by offset and merged with their free neighbours when freed.
+ * mem.c takes its mem_mutex around each call, a semaphore on the board,
+ * which this leaves out as the host times no kernel call. */
+struct __bench_mem {
+	u16_t	next, prev;
+	u8_t	used;
+};
+
+#define __BENCH_MIN	LWIP_MEM_ALIGN_SIZE(12)
+#define __BENCH_HDR	LWIP_MEM_ALIGN_SIZE(sizeof(struct __bench_mem))
+
+static struct {
+	u8_t			*ram;
+	struct __bench_mem	*end, *lfree;
+	u16_t			size;
+} __bench_heap;
+
+#define __bench_mem(off)	((struct __bench_mem *)&__bench_heap.ram[off])
+#define __bench_off(mem)	((u16_t)((u8_t *)(mem) - __bench_heap.ram))
+
+#if !MEM_ARCH_TRACE
+/* Room for either heap of the benchmark */
+#define __BENCH_HEAP_MAX	LWIP_MAX(MEM_BENCH_HEAP, __BENCH_ARCH_RAM)
+
+static u8_t __bench_ram[LWIP_MEM_ALIGN_SIZE(__BENCH_HEAP_MAX) +
+	2 * __BENCH_HDR + MEM_ALIGNMENT];
+
+static void __bench_heap_init(u16_t size)
+{
+	struct __bench_mem *mem;
+
+	LWIP_ASSERT("__BENCH_HEAP_MAX", size <= __BENCH_HEAP_MAX);
+	__bench_heap.ram = LWIP_MEM_ALIGN(__bench_ram);
+	__bench_heap.size = LWIP_MEM_ALIGN_SIZE(size);
+	mem = __bench_mem(0);
+	mem->next = __bench_heap.size;
+	mem->prev = 0;
+	mem->used = 0;
+	__bench_heap.end = __bench_mem(__bench_heap.size);
+	__bench_heap.end->used = 1;
+	__bench_heap.end->next = __bench_heap.size;
+	__bench_heap.end->prev = __bench_heap.size;
+	__bench_heap.lfree = mem;
+}
+#endif
+
+static void __bench_plug_holes(struct __bench_mem *mem)
+{
+	struct __bench_mem *nmem, *pmem;
+
+	nmem = __bench_mem(mem->next);
+	if (mem != nmem && !nmem->used && nmem != __bench_heap.end) {
+		if (__bench_heap.lfree == nmem)
+			__bench_heap.lfree = mem;
+		mem->next = nmem->next;
+		__bench_mem(nmem->next)->prev = __bench_off(mem);
+	}
+
+	pmem = __bench_mem(mem->prev);
+	if (pmem != mem && !pmem->used) {
+		if (__bench_heap.lfree == mem)
+			__bench_heap.lfree = pmem;
+		pmem->next = mem->next;
+		__bench_mem(mem->next)->prev = __bench_off(pmem);
+	}
+}
+
+static void *__bench_heap_malloc(size_t size)
+{
+	struct __bench_mem *mem, *mem2;
+	u16_t ptr, ptr2;
+
+	if (size == 0)
+		return NULL;
+	size = LWIP_MEM_ALIGN_SIZE(size);
+	if (size < __BENCH_MIN)
+		size = __BENCH_MIN;
+	if (size > __bench_heap.size)
+		return NULL;
+
+	for (ptr = __bench_off(__bench_heap.lfree);
+	     ptr < __bench_heap.size - size;
+	     ptr = __bench_mem(ptr)->next) {
+		mem = __bench_mem(ptr);
+		__bench.walk++;
+		if (mem->used || mem->next - (ptr + __BENCH_HDR) < size)
+			continue;
+		/* split off the rest if it holds a block */
+		if (mem->next - (ptr + __BENCH_HDR) >=
+				size + __BENCH_HDR + __BENCH_MIN) {
+			ptr2 = ptr + __BENCH_HDR + size;
+			mem2 = __bench_mem(ptr2);
+			mem2->used = 0;
+			mem2->next = mem->next;
+			mem2->prev = ptr;
+			mem->next = ptr2;
+			if (mem2->next != __bench_heap.size)
+				__bench_mem(mem2->next)->prev = ptr2;
+		}
+		mem->used = 1;
+		if (mem == __bench_heap.lfree) {
+			while (__bench_heap.lfree->used &&
+			       __bench_heap.lfree != __bench_heap.end) {
+				__bench.walk++;
+				__bench_heap.lfree =
+					__bench_mem(__bench_heap.lfree->next);
+			}
+		}
+		return (u8_t *)mem + __BENCH_HDR;
+	}
+
+	return NULL;
+}
+
+static void __bench_heap_free(void *rmem)
+{
+	struct __bench_mem *mem;
+
+	if (!rmem)
+		return;
+	mem = (struct __bench_mem *)((u8_t *)rmem - __BENCH_HDR);
+	mem->used = 0;
+	if (mem < __bench_heap.lfree)
+		__bench_heap.lfree = mem;
+	__bench_plug_holes(mem);
+}
+
+/* Whether the free blocks of the heap held 'size' between them, a failure
+ * then being one of fragmentation */
+static int __bench_heap_room(size_t size)
+{
+	struct __bench_mem *mem;
+	u32_t room = 0;
+	u16_t ptr;
+
+	for (ptr = 0; ptr < __bench_heap.size; ptr = mem->next) {
+		mem = __bench_mem(ptr);
+		if (!mem->used)
+			room += mem->next - ptr - __BENCH_HDR;
+	}
+
+	return room >= LWIP_MEM_ALIGN_SIZE(size);
+}
+
+static const struct __bench_allocator __bench_mem_arch = {
+	"mem_arch", mem_arch_malloc, mem_arch_free
+};
+static const struct __bench_allocator __bench_heap_allocator = {
+	"heap", __bench_heap_malloc, __bench_heap_free
+};
+
+static u32_t __bench_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/* Keep the least time of the call across the runs of a row, which replay
+ * the same calls */
+static void __bench_time(u32_t ns, u8_t op)
+{
+	u32_t i = __bench.calls++;
+
+	ns = ns > __bench_overhead ? ns - __bench_overhead : 0;
+	if (i >= __BENCH_CALLS)
+		return;
+	if (__bench.repeat == 0 || ns < __bench_ns[i])
+		__bench_ns[i] = ns;
+	__bench_op[i] = op;
+}
+
+static void *__bench_malloc(size_t size)
+{
+	void *mem;
+	u32_t t;
+
+	__bench.walk = 0;
+	t = __bench_clock();
+	mem = __bench_a->malloc(size);
+	t = __bench_clock() - t;
+	__bench_time(t, 0);
+	__bench.allocs++;
+	if (__bench.walk > __bench.walk_max)
+		__bench.walk_max = __bench.walk;
+	if (!mem) {
+		__bench.fails++;
+		if (__bench_a == &__bench_heap_allocator &&
+		    __bench_heap_room(size))
+			__bench.frag++;
+	}
+
+	return mem;
+}
+
+static void __bench_free(void *mem)
+{
+	u32_t t;
+
+	t = __bench_clock();
+	__bench_a->free(mem);
+	t = __bench_clock() - t;
+	__bench_time(t, 1);
+}
+
+/* xorshift32 */
+static u32_t __bench_random(void)
+{
+	u32_t x = __bench.random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return __bench.random = x;
+}
+
+/* Queue 'len' bytes of IP on a link, returning when they have left */
+static u32_t __bench_send(u8_t link, u32_t len)
+{
+	u32_t *t = &__bench.link[link];
+
+	if (*t < __bench.now)
+		*t = __bench.now;
+	*t += (u32_t)((len + __BENCH_PPP) * 1000000ULL / __BENCH_HZ);
+
+	return *t;
+}
+
+/* Send or free what the upload allows at this millisecond. tcp_upload
+ * writes again on the next ACK once tcp_write() failed, and connects again
+ * on its next try once tcp_connect() or tcp_close() did, taken to be one
+ * slow timer later. */
+static void __bench_upload(struct __bench_upload *u)
+{
+	u8_t i, acked = 0;
+	void *p;
+
+	if (u->ctl && __bench.now >= u->ctl_at) {
+		__bench_free(u->ctl);
+		u->ctl = NULL;
+		if (u->state == __BENCH_SYN_SENT) {
+			u->state = __BENCH_EST;
+			u->left = MEM_BENCH_UPLOAD_BYTES;
+		} else {
+			u->state = __BENCH_CLOSED;
+		}
+	}
+	while (u->n > 0 && u->ack_at[u->rd] <= __bench.now) {
+		__bench_free(u->seg[u->rd]);
+		u->rd = (u->rd + 1) % TCP_PPP_SEGS;
+		u->n--;
+		acked = 1;
+	}
+	if (!acked && __bench.now < u->retry_at)
+		return;
+
+	switch (u->state) {
+	case __BENCH_CLOSED:
+		u->ctl = __bench_malloc(__BENCH_SYN);
+		if (!u->ctl) {
+			u->retry_at = __bench.now + __BENCH_RETRY;
+			return;
+		}
+		u->state = __BENCH_SYN_SENT;
+		u->ctl_at = __bench_send(u->link, 40 + 4) + __BENCH_RTT;
+		return;
+	case __BENCH_EST:
+		break;
+	default:
+		return;
+	}
+
+	while (u->n < TCP_PPP_SEGS && u->left > 0) {
+		p = __bench_malloc(__BENCH_SEG);
+		if (!p) {
+			u->retry_at = __bench.now + __BENCH_RETRY;
+			return;
+		}
+		i = (u->rd + u->n) % TCP_PPP_SEGS;
+		u->seg[i] = p;
+		u->ack_at[i] = __bench_send(u->link, 40 + TCP_MSS) +
+			__BENCH_RTT;
+		u->n++;
+		u->left -= LWIP_MIN(u->left, TCP_MSS);
+	}
+	if (u->left == 0 && u->n == 0) {
+		u->ctl = __bench_malloc(__BENCH_FIN);
+		if (!u->ctl) {
+			u->retry_at = __bench.now + __BENCH_RETRY;
+			return;
+		}
+		u->state = __BENCH_FIN_SENT;
+		u->ctl_at = __bench_send(u->link, 40) + __BENCH_RTT;
+	}
+}
+
+/* A datagram, freed once PPP copied it into pool pbufs */
+static void __bench_datagram(size_t size, u32_t len)
+{
+	void *p = __bench_malloc(size);
+
+	if (!p)
+		return;
+	__bench_send(0, len);
+	__bench_free(p);
+}
+
+static void __bench_run(u8_t uploads)
+{
+	struct __bench_upload *u;
+	u8_t i;
+
+	memset(__bench.up, 0, sizeof(__bench.up));
+	memset(__bench.link, 0, sizeof(__bench.link));
+	__bench.random = 1;
+	__bench.calls = __bench.allocs = __bench.fails = __bench.frag = 0;
+	__bench.walk_max = 0;
+	for (i = 0; i < uploads; i++)
+		__bench.up[i].link = i % __BENCH_LINKS;
+
+	for (__bench.now = 0; __bench.now < __BENCH_END;
+			__bench.now += 1000) {
+		for (i = 0; i < uploads; i++)
+			__bench_upload(&__bench.up[i]);
+		if (__bench.now % (MEM_BENCH_ECHO_MS * 1000UL) == 0)
+			__bench_datagram(__BENCH_ECHO, 28 + 1 +
+					__bench_random() % MEM_BENCH_ECHO_MAX);
+		if (__bench.now % (MEM_BENCH_DNS_S * 1000000UL) == 0)
+			__bench_datagram(__BENCH_DNS, 28 + 12 + 23 + 4);
+		if (__bench.now % (MEM_BENCH_STUN_S * 1000000UL) == 0)
+			__bench_datagram(__BENCH_STUN, 28 + 20);
+	}
+
+	for (i = 0; i < uploads; i++) {
+		u = &__bench.up[i];
+		if (u->ctl)
+			__bench_free(u->ctl);
+		for (; u->n > 0; u->n--) {
+			__bench_free(u->seg[u->rd]);
+			u->rd = (u->rd + 1) % TCP_PPP_SEGS;
+		}
+	}
+}
+
+#if !MEM_ARCH_TRACE
+/* The least time of reading the clock twice */
+static void __bench_calibrate(void)
+{
+	u32_t t, i;
+
+	__bench_overhead = 0xffffffffUL;
+	for (i = 0; i < 100000; i++) {
+		t = __bench_clock();
+		t = __bench_clock() - t;
+		if (t < __bench_overhead)
+			__bench_overhead = t;
+	}
+}
+
+static u32_t __bench_spills(void)
+{
+	struct mem_arch_stats st;
+	u32_t spills = 0;
+	u8_t i;
+
+	for (i = 0; mem_arch_get_stats(i, &st) == 0; i++)
+		spills += st.spills;
+
+	return spills;
+}
+
+static void __bench_row(const struct __bench_allocator *a, u32_t size,
+		u8_t uploads)
+{
+	u32_t sum[2] = { 0, 0 }, max[2] = { 0, 0 }, n[2] = { 0, 0 };
+	u32_t spills = __bench_spills(), i;
+	u8_t op;
+
+	__bench_a = a;
+	for (__bench.repeat = 0; __bench.repeat < MEM_BENCH_REPEAT;
+			__bench.repeat++) {
+		if (a == &__bench_mem_arch) {
+			__bench_parts = 0;
+			mem_arch_init();
+		} else {
+			__bench_heap_init(size);
+		}
+		__bench_run(uploads);
+	}
+	LWIP_ASSERT("__BENCH_CALLS", __bench.calls <= __BENCH_CALLS);
+	for (i = 0; i < __bench.calls; i++) {
+		op = __bench_op[i];
+		sum[op] += __bench_ns[i];
+		if (__bench_ns[i] > max[op])
+			max[op] = __bench_ns[i];
+		n[op]++;
+	}
+
+	printf("%-8s %6lu %3u %7lu %5lu", a->name, (unsigned long)size,
+			uploads, (unsigned long)__bench.allocs,
+			(unsigned long)__bench.fails);
+	if (a == &__bench_mem_arch)
+		printf(" %5s %5lu %5s", "-", (unsigned long)((__bench_spills() -
+					spills) / MEM_BENCH_REPEAT), "-");
+	else
+		printf(" %5lu %5s %5lu", (unsigned long)__bench.frag, "-",
+				(unsigned long)__bench.walk_max);
+	printf(" %5lu %5lu %5lu %5lu\r\n",
+			(unsigned long)(n[0] ? sum[0] / n[0] : 0),
+			(unsigned long)max[0],
+			(unsigned long)(n[1] ? sum[1] / n[1] : 0),
+			(unsigned long)max[1]);
+}
+#endif /* !MEM_ARCH_TRACE */
+
+void mem_bench(void)
+{
+#if MEM_ARCH_TRACE
+	__bench_a = &__bench_mem_arch;
+	mem_arch_init();
+	__bench_run(MEM_BENCH_UPLOADS);
+#else
+	u8_t uploads;
+
+	__bench_calibrate();
+
+	printf("mem: %u s over %u links of %lu bit/s 8N1, TCP_SND_BUF %u an "
+			"upload of %lu bytes, an echo every %u ms, STUN every "
+			"%u s, DNS every %u s\r\n", MEM_BENCH_SECONDS,
+			__BENCH_LINKS, (unsigned long)TCP_PPP_LINK_BPS,
+			TCP_SND_BUF, (unsigned long)MEM_BENCH_UPLOAD_BYTES,
+			MEM_BENCH_ECHO_MS, MEM_BENCH_STUN_S, MEM_BENCH_DNS_S);
+	printf("                                             "
+			"malloc ns    free ns\r\n");
+	printf("alloc       RAM upl  allocs fails  frag spill  walk"
+			"  mean   max  mean   max\r\n");
+	for (uploads = 1; uploads <= MEMP_NUM_TCP_PCB; uploads *= 2) {
+		__bench_row(&__bench_mem_arch, __BENCH_ARCH_RAM, uploads);
+		__bench_row(&__bench_heap_allocator, MEM_BENCH_HEAP, uploads);
+		__bench_row(&__bench_heap_allocator, __BENCH_ARCH_RAM,
+				uploads);
+	}
+#endif
+}
+
+int main(void)
+{
+	mem_bench();
+	return 0;
+}
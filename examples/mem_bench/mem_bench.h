@@ -0,0 +1,52 @@
+#ifndef __MEM_BENCH_H__
+#define __MEM_BENCH_H__
+
+#include "lwip/opt.h"
+
+/** Simulated seconds of a run */
+#ifndef MEM_BENCH_SECONDS
+# define MEM_BENCH_SECONDS 300
+#endif
+
+/** Runs of each row, the time of every call being the least of them */
+#ifndef MEM_BENCH_REPEAT
+# define MEM_BENCH_REPEAT 5
+#endif
+
+/** MEM_SIZE of the heap MEM_ARCH replaced in examples/lwipopts.h */
+#ifndef MEM_BENCH_HEAP
+# define MEM_BENCH_HEAP 16384
+#endif
+
+/** Uploads running at once in the trace, as examples/tcp_upload runs one */
+#ifndef MEM_BENCH_UPLOADS
+# define MEM_BENCH_UPLOADS 1
+#endif
+
+/** Bytes of an upload, which connects again once they are acked */
+#ifndef MEM_BENCH_UPLOAD_BYTES
+# define MEM_BENCH_UPLOAD_BYTES 65536
+#endif
+
+/** A datagram is echoed this often, of up to MEM_BENCH_ECHO_MAX bytes */
+#ifndef MEM_BENCH_ECHO_MS
+# define MEM_BENCH_ECHO_MS 200
+#endif
+#ifndef MEM_BENCH_ECHO_MAX
+# define MEM_BENCH_ECHO_MAX 1000
+#endif
+
+/** examples/stun queries every 10 s, resolving the server again once the
+ * TTL of its address ran out */
+#ifndef MEM_BENCH_STUN_S
+# define MEM_BENCH_STUN_S 10
+#endif
+#ifndef MEM_BENCH_DNS_S
+# define MEM_BENCH_DNS_S 60
+#endif
+
+/** Run the benchmark and print the results, on a host. Built with
+ * MEM_ARCH_TRACE, it prints the trace of MEM_BENCH_UPLOADS instead. */
+void mem_bench(void);
+
+#endif /* __MEM_BENCH_H__ */
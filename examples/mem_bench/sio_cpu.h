@@ -0,0 +1,8 @@
+#ifndef __SIO_CPU_H__
+#define __SIO_CPU_H__
+
+/* mem_bench has no UART: arch/cc.h includes this in place of the board's
+ * examples/sio_cpu.h. Put this directory ahead of examples/ on the include
+ * path. */
+
+#endif /* __SIO_CPU_H__ */
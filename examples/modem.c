@@ -4,73 +4,120 @@
 #include "misc.h"
 #include "ucos_ii.h"
 #include "ppp.h"
+#include "modem.h"
 
 #include "lwip/tcpip.h"
 #include "lwip/err.h"
 #include "lwip/dns.h"
-
-/* Port A */
-#define MODEM_CTS	GPIO_Pin_0
-#define MODEM_RTS	GPIO_Pin_1
-#define MODEM_TxD	GPIO_Pin_2
-#define MODEM_RxD	GPIO_Pin_3
-
-/* Port C */
-#define MODEM_RI	GPIO_Pin_0
-#define MODEM_DCD	GPIO_Pin_1
-#define MODEM_DSR	GPIO_Pin_2
-#define MODEM_DTR	GPIO_Pin_3
+#include "arch/sio_arch.h"
+#include "arch/sio_trace.h"
+#include "arch/timer_wheel.h"
+
+/* The pins of each modem, the second one on USART3 */
+static const struct modem_hw {
+	USART_TypeDef	*usart;
+	INT32U		usart_clk;	/* on APB1 */
+	INT8U		irq;
+	GPIO_TypeDef	*port;		/* TxD, RxD, CTS and RTS */
+	INT32U		port_clk;	/* on APB2 */
+	INT16U		txd, rxd, cts, rts;
+	INT16U		ri, dcd, dsr, dtr;	/* on port C */
+} __modem_hw[MODEM_NUM] = {
+	{ USART2, RCC_APB1Periph_USART2, USART2_IRQn,
+	  GPIOA, RCC_APB2Periph_GPIOA,
+	  GPIO_Pin_2, GPIO_Pin_3, GPIO_Pin_0, GPIO_Pin_1,
+	  GPIO_Pin_0, GPIO_Pin_1, GPIO_Pin_2, GPIO_Pin_3 },
+#if MODEM_NUM > 1
+	{ USART3, RCC_APB1Periph_USART3, USART3_IRQn,
+	  GPIOB, RCC_APB2Periph_GPIOB,
+	  GPIO_Pin_10, GPIO_Pin_11, GPIO_Pin_13, GPIO_Pin_14,
+	  GPIO_Pin_4, GPIO_Pin_5, GPIO_Pin_6, GPIO_Pin_7 },
+#endif
+};
+
+static struct modem {
+	const struct modem_hw	*hw;
+	sio_fd_t		fd;
+	OS_EVENT		*sem;	/* posted to (re)dial */
+	int			pd;
+	sys_thread_t		ppp_thread;	/* OS_PRIO_SELF if none */
+	INT8U			buf[80];
+#if TIMER_WHEEL
+	struct timer_wheel_entry retry;	/* posts 'sem' */
+#endif
+#if PPP_IPHC
+	struct ppp_iphc		iphc;
+#endif
+} __modem[MODEM_NUM];
 
 static OS_EVENT *__sem;
-static INT8U __buf[80];
 
 static void tcpip_init_done(void *arg)
 {
 	OSSemPost(__sem);
 }
 
-void modem_init(void)
+#if SYS_BACKPRESSURE
+/* All the links feed the tcpip thread, so all of them are throttled */
+static void modem_rx_throttle(void *arg, u8_t on)
 {
-	GPIO_InitTypeDef GPIO_InitStruct;
-	USART_InitTypeDef USART_InitStruct;
-	NVIC_InitTypeDef NVIC_InitStruct;
-	INT8U err;
+	INT8U i;
 
-	__sem = OSSemCreate(0);
-	LWIP_ASSERT("OSSemCreate", __sem);
+	for (i = 0; i < MODEM_NUM; i++)
+		sio_rx_throttle(__modem[i].fd, on);
+}
+#endif
 
-	tcpip_init(tcpip_init_done, NULL);
-	OSSemPend(__sem, 0, &err);
-	OSSemPost(__sem);
+#if TIMER_WHEEL
+/* Called in the tcpip thread */
+static void modem_redial(void *arg)
+{
+	struct modem *m = arg;
 
-	pppInit();
-	pppSetAuth(PPPAUTHTYPE_ANY, "cmnet", "cmnet");
+	OSSemPost(m->sem);
+}
+#endif
 
-	sio_open(0);
+/* Dial again in 3 s, the modem task waits on 'sem' meanwhile */
+static void modem_retry(struct modem *m)
+{
+#if TIMER_WHEEL
+	timer_wheel_start(&m->retry, 3000, 0);
+#else
+	OSSemPost(m->sem);
+	OSTimeDly(OS_TICKS_PER_SEC * 3);
+#endif
+}
 
-	RCC_APB1PeriphClockCmd(RCC_APB1Periph_USART2, ENABLE);
-	RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA, ENABLE);
+static void modem_hw_init(const struct modem_hw *hw)
+{
+	GPIO_InitTypeDef GPIO_InitStruct;
+	USART_InitTypeDef USART_InitStruct;
+	NVIC_InitTypeDef NVIC_InitStruct;
+
+	RCC_APB1PeriphClockCmd(hw->usart_clk, ENABLE);
+	RCC_APB2PeriphClockCmd(hw->port_clk, ENABLE);
 	RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOC, ENABLE);
 
-	GPIO_InitStruct.GPIO_Pin = MODEM_TxD | MODEM_RTS;
+	GPIO_InitStruct.GPIO_Pin = hw->txd | hw->rts;
 	GPIO_InitStruct.GPIO_Speed = GPIO_Speed_50MHz;
 	GPIO_InitStruct.GPIO_Mode = GPIO_Mode_AF_PP;
-	GPIO_Init(GPIOA, &GPIO_InitStruct);
+	GPIO_Init(hw->port, &GPIO_InitStruct);
 
-	GPIO_InitStruct.GPIO_Pin = MODEM_RxD | MODEM_CTS;
+	GPIO_InitStruct.GPIO_Pin = hw->rxd | hw->cts;
 	GPIO_InitStruct.GPIO_Mode = GPIO_Mode_IN_FLOATING;
-	GPIO_Init(GPIOA, &GPIO_InitStruct); 
+	GPIO_Init(hw->port, &GPIO_InitStruct);
 
-	GPIO_InitStruct.GPIO_Pin = MODEM_DTR;
+	GPIO_InitStruct.GPIO_Pin = hw->dtr;
 	GPIO_InitStruct.GPIO_Mode = GPIO_Mode_AF_PP;
 	GPIO_Init(GPIOC, &GPIO_InitStruct);
-	GPIO_SetBits(GPIOC, MODEM_DTR);
+	GPIO_SetBits(GPIOC, hw->dtr);
 
-	GPIO_InitStruct.GPIO_Pin = MODEM_DCD | MODEM_RI | MODEM_DSR;
+	GPIO_InitStruct.GPIO_Pin = hw->dcd | hw->ri | hw->dsr;
 	GPIO_InitStruct.GPIO_Mode = GPIO_Mode_IN_FLOATING;
 	GPIO_Init(GPIOC, &GPIO_InitStruct);
 
-	NVIC_InitStruct.NVIC_IRQChannel = USART2_IRQn;
+	NVIC_InitStruct.NVIC_IRQChannel = hw->irq;
 	NVIC_InitStruct.NVIC_IRQChannelPreemptionPriority = 5;
 	NVIC_InitStruct.NVIC_IRQChannelSubPriority = 5;
 	NVIC_InitStruct.NVIC_IRQChannelCmd = ENABLE;
@@ -79,29 +126,81 @@ void modem_init(void)
 	USART_StructInit(&USART_InitStruct);
 	USART_InitStruct.USART_BaudRate = 115200;
 	USART_InitStruct.USART_HardwareFlowControl = USART_HardwareFlowControl_RTS_CTS;
-	USART_Init(USART2, &USART_InitStruct);
+	USART_Init(hw->usart, &USART_InitStruct);
+
+	USART_ITConfig(hw->usart, USART_IT_RXNE, ENABLE);
+	USART_ITConfig(hw->usart, USART_IT_TC, ENABLE);
+
+	USART_Cmd(hw->usart, ENABLE);
+}
 
-	USART_ITConfig(USART2, USART_IT_RXNE, ENABLE);
-	USART_ITConfig(USART2, USART_IT_TC, ENABLE);
+void modem_init(void)
+{
+	struct modem *m;
+	INT8U err, i;
+#if TIMER_WHEEL
+	err_t e;
+#endif
 
-	USART_Cmd(USART2, ENABLE);
+	__sem = OSSemCreate(0);
+	LWIP_ASSERT("OSSemCreate", __sem);
+
+	tcpip_init(tcpip_init_done, NULL);
+	OSSemPend(__sem, 0, &err);
+#if TIMER_WHEEL
+	e = timer_wheel_init();
+	LWIP_ASSERT("timer_wheel_init", e == ERR_OK);
+#endif
+
+	pppInit();
+	pppSetAuth(PPPAUTHTYPE_ANY, "cmnet", "cmnet");
+
+	for (i = 0; i < MODEM_NUM; i++) {
+		m = &__modem[i];
+		m->hw = &__modem_hw[i];
+		m->pd = -1;
+		m->ppp_thread = OS_PRIO_SELF;
+		m->sem = OSSemCreate(1); /* dial right away */
+		LWIP_ASSERT("OSSemCreate", m->sem);
+#if TIMER_WHEEL
+		timer_wheel_setup(&m->retry, modem_redial, m,
+				TIMER_WHEEL_TCPIP);
+#endif
+		m->fd = sio_open(i);
+		LWIP_ASSERT("sio_open", m->fd);
+		modem_hw_init(m->hw);
+	}
+	modem_route_init();
+#if SYS_BACKPRESSURE
+	sys_backpressure_set(modem_rx_throttle, NULL);
+#endif
 }
 
 void USART2_IRQHandler(void)
 {
 	OSIntEnter();
-	sio_tx_complete(NULL);
-	sio_rx_complete(NULL);
+	sio_tx_complete(__modem[0].fd);
+	sio_rx_complete(__modem[0].fd);
 	OSIntExit();
 }
 
-static INT32U read_line(INT8U *buf, INT32U size)
+#if MODEM_NUM > 1
+void USART3_IRQHandler(void)
+{
+	OSIntEnter();
+	sio_tx_complete(__modem[1].fd);
+	sio_rx_complete(__modem[1].fd);
+	OSIntExit();
+}
+#endif
+
+static INT32U read_line(struct modem *m, INT8U *buf, INT32U size)
 {
 	INT8U c;
 	INT32U len = 0;
 
 	while (size-- > 0) {
-		c = sio_recv(NULL);
+		c = sio_recv(m->fd);
 		*buf++ = c;
 		len++;
 		if (c == '\n')
@@ -111,39 +210,69 @@ static INT32U read_line(INT8U *buf, INT32U size)
 	return len;
 }
 
-static void write_str(const char *str)
+static void write_str(struct modem *m, const char *str)
 {
-	sio_write(NULL, (u8_t *)str, strlen((const char *)str));
+	sio_write(m->fd, (u8_t *)str, strlen((const char *)str));
+}
+
+static struct netif *netif_find_addr(ip_addr_t *addr)
+{
+	struct netif *netif;
+
+	for (netif = netif_list; netif; netif = netif->next) {
+		if (ip_addr_cmp(&netif->ip_addr, addr))
+			return netif;
+	}
+
+	return NULL;
 }
 
 static void link_status_cb(void *ctx, int errCode, void *arg)
 {
+	struct modem *m = ctx;
+	sys_thread_t thread;
+	SYS_ARCH_DECL_PROTECT(sr);
+
 	if (errCode == PPPERR_NONE) {
 		struct ppp_addrs *addrs = arg;
+		struct netif *netif = netif_find_addr(&addrs->our_ipaddr);
 
 		if (addrs->dns1.addr)
 			dns_setserver(0, &addrs->dns1);
 		if (addrs->dns2.addr)
 			dns_setserver(1, &addrs->dns2);
+#if SIO_TRACE
+		if (netif && sio_devnum(m->fd) == 0)
+			sio_trace_attach(netif);
+#endif
+		if (netif)
+			modem_link(m - __modem, netif);
 	} else {
-		OSSemPost(__sem);
-		sys_thread_free(PPP_THREAD_PRIO);
+		modem_link(m - __modem, NULL);
+		SYS_ARCH_PROTECT(sr);
+		thread = m->ppp_thread;
+		m->ppp_thread = OS_PRIO_SELF;
+		SYS_ARCH_UNPROTECT(sr);
+		/* the PPP thread would return now that the link is dead */
+		if (thread != OS_PRIO_SELF)
+			sys_thread_free(thread);
+		OSSemPost(m->sem);
 	}
 }
 
-static INT8U at_cmd(const char *cmd)
+static INT8U at_cmd(struct modem *m, const char *cmd)
 {
 	INT32U len;
 
-	write_str("AT");
-	write_str(cmd);
-	write_str("\r\n");
+	write_str(m, "AT");
+	write_str(m, cmd);
+	write_str(m, "\r\n");
 	while (1) {
-		len = read_line(__buf, sizeof(__buf));
-		LWIP_ASSERT("read_line", len < sizeof(__buf));
-		if (len > 2 && memcmp(__buf, "OK", 2) == 0)
+		len = read_line(m, m->buf, sizeof(m->buf));
+		LWIP_ASSERT("read_line", len < sizeof(m->buf));
+		if (len > 2 && memcmp(m->buf, "OK", 2) == 0)
 			return 0;
-		else if (len > 5 && memcmp(__buf, "ERROR", 5) == 0)
+		else if (len > 5 && memcmp(m->buf, "ERROR", 5) == 0)
 			return 1;
 		else
 			continue;
@@ -152,66 +281,86 @@ static INT8U at_cmd(const char *cmd)
 
 void modem_task(void *p_arg)
 {
+	struct modem *m;
 	INT8U err;
-	int pd = -1;
 	INT32U len;
+	sys_thread_t thread;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	LWIP_ASSERT("Invalid modem", (mem_ptr_t)p_arg < MODEM_NUM);
+	m = &__modem[(mem_ptr_t)p_arg];
 
-	GPIO_ResetBits(GPIOC, MODEM_DTR);
-	err = at_cmd("E0");
+	GPIO_ResetBits(GPIOC, m->hw->dtr);
+	err = at_cmd(m, "E0");
 	LWIP_ASSERT("at_cmd", !err);
-	err = at_cmd("+IPR=115200");
+	err = at_cmd(m, "+IPR=115200");
 	LWIP_ASSERT("at_cmd", !err);
-	err = at_cmd("\\Q3");
+	err = at_cmd(m, "\\Q3");
 	LWIP_ASSERT("at_cmd", !err);
-	err = at_cmd("&C1");
+	err = at_cmd(m, "&C1");
 	LWIP_ASSERT("at_cmd", !err);
-	err = at_cmd("&D2");
+	err = at_cmd(m, "&D2");
 	LWIP_ASSERT("at_cmd", !err);
-	err = at_cmd("&S0");
+	err = at_cmd(m, "&S0");
 	LWIP_ASSERT("at_cmd", !err);
 
 	while (1) {
 again:
-		OSSemPend(__sem, 0, &err);
+		OSSemPend(m->sem, 0, &err);
 		LWIP_ASSERT("OSSemPend", err == OS_ERR_NONE);
-		if (pd >= 0) {
-			pppClose(pd);
-			pd = -1;
+		if (m->pd >= 0) {
+			pppClose(m->pd);
+			m->pd = -1;
+#if SIO_FRAME_READ
+			sio_frame_mode(m->fd, 0, 0);
+#endif
+#if PPP_IPHC
+			sio_iphc(m->fd, NULL);
+#endif
 		}
 
-		err = at_cmd("+CGDCONT=1,\"IP\",\"CMNET\"");
+		err = at_cmd(m, "+CGDCONT=1,\"IP\",\"CMNET\"");
 		if (err) {
-			err = OSSemPost(__sem);
-			OSTimeDly(OS_TICKS_PER_SEC * 3);
+			modem_retry(m);
 			goto again;
 		}
 
-		write_str("ATD*99***1#\r\n");
+		write_str(m, "ATD*99***1#\r\n");
 		while (1) {
-			len = read_line(__buf, sizeof(__buf));
-			LWIP_ASSERT("read_line", len < sizeof(__buf));
-			if (len > 7 && memcmp(__buf, "CONNECT", 7) == 0) {
+			len = read_line(m, m->buf, sizeof(m->buf));
+			LWIP_ASSERT("read_line", len < sizeof(m->buf));
+			if (len > 7 && memcmp(m->buf, "CONNECT", 7) == 0) {
 				break;
 			} else if ((len > 10 &&
-				    memcmp(__buf, "NO CARRIER", 10) == 0) ||
-				   (len > 4 && memcmp(__buf, "BUSY", 4) == 0) ||
+				    memcmp(m->buf, "NO CARRIER", 10) == 0) ||
+				   (len > 4 && memcmp(m->buf, "BUSY", 4) == 0) ||
 				   (len > 7 &&
-				    memcmp(__buf, "DELAYED", 7) == 0) ||
+				    memcmp(m->buf, "DELAYED", 7) == 0) ||
 				   (len > 5
-				    && memcmp(__buf, "ERROR", 5) == 0) ||
+				    && memcmp(m->buf, "ERROR", 5) == 0) ||
 				   (len > 11 &&
-				    memcmp(__buf, "NO DIALTONE", 11) == 0) ||
+				    memcmp(m->buf, "NO DIALTONE", 11) == 0) ||
 				   (len > 9 &&
-				    memcmp(__buf, "NO ANSWER", 9) == 0)) {
-				err = OSSemPost(__sem);
-				OSTimeDly(OS_TICKS_PER_SEC * 3);
+				    memcmp(m->buf, "NO ANSWER", 9) == 0)) {
+				modem_retry(m);
 				goto again;
 			} else {
 				continue;
 			}
 		}
 
-		pd = pppOverSerialOpen(NULL, link_status_cb, NULL);
-		LWIP_ASSERT("pppOverSerialOpen", pd >= 0);
+#if SIO_FRAME_READ
+		sio_frame_mode(m->fd, 1, 0x7e);
+#endif
+#if PPP_IPHC
+		/* AT commands went around it, the link starts afresh */
+		sio_iphc(m->fd, &m->iphc);
+#endif
+		m->pd = pppOverSerialOpen(m->fd, link_status_cb, m);
+		LWIP_ASSERT("pppOverSerialOpen", m->pd >= 0);
+		thread = sys_thread_ppp();
+		SYS_ARCH_PROTECT(sr);
+		m->ppp_thread = thread;
+		SYS_ARCH_UNPROTECT(sr);
 	}
 }
@@ -1,7 +1,72 @@
 #ifndef __MODEM_H__
 #define __MODEM_H__
 
+#include "lwip/netif.h"
+
+/** Number of modems, modem i on serial device i */
+#ifndef MODEM_NUM
+# define MODEM_NUM 1
+#endif
+
+/** How modem_route() spreads destinations over the links which are up:
+ * MODEM_BALANCE_HASH picks the link by a rendezvous hash of the destination
+ * address, with no state: a link going down or up only moves the
+ * destinations it loses or wins.
+ * MODEM_BALANCE_WRR hands new destinations out by smooth weighted round
+ * robin and remembers the last MODEM_FLOWS of them, which stay on their link
+ * until it goes down. */
+#define MODEM_BALANCE_HASH	0
+#define MODEM_BALANCE_WRR	1
+
+#ifndef MODEM_BALANCE
+# define MODEM_BALANCE MODEM_BALANCE_HASH
+#endif
+
+#ifndef MODEM_FLOWS
+# define MODEM_FLOWS 16
+#endif
+
+/** Share of the traffic of each modem, missing ones count as 1 */
+#ifndef MODEM_WEIGHTS
+# define MODEM_WEIGHTS { 1 }
+#endif
+
+struct modem_stats {
+	u8_t	up;		/* the PPP link is up */
+	u32_t	routed;		/* packets routed over the link */
+	u32_t	flows;		/* destinations given the link */
+	u32_t	failovers;	/* destinations moved off the link, WRR only */
+	u32_t	sourced;	/* packets moved onto the link by their source */
+	u32_t	downs;		/* times the link went down */
+	u32_t	aborts;		/* TCP connections it took down with it */
+	u32_t	abort_fails;	/* downs whose connections were left */
+};
+
 void modem_init(void);
+
+/** The dial loop of a modem, one task per modem
+ * @param p_arg index of the modem cast to a pointer, NULL for modem 0 */
 void modem_task(void *p_arg);
 
+/** Prepare modem_route(), called by modem_init() */
+void modem_route_init(void);
+
+/** Hand the link of a modem to modem_route(), from its link status callback
+ * A packet whose source address is that of a link which is up leaves over
+ * that link, wherever modem_route() sent it. The TCP connections bound to
+ * the address of a link going down are aborted.
+ * @param idx index of the modem
+ * @param netif the PPP netif once the link is up, NULL when it went down */
+void modem_link(u8_t idx, struct netif *netif);
+
+/** Pick the link for a destination, LWIP_HOOK_IP4_ROUTE of lwipopts.h
+ * Destinations on the subnet of another netif which is up are left to lwIP.
+ * @return the netif, NULL if no link is up or the destination isn't for the
+ * modems */
+struct netif *modem_route(ip_addr_t *dest);
+
+/** Get the counters of a modem
+ * @return 0 if successful, -1 if idx is out of range */
+int modem_get_stats(u8_t idx, struct modem_stats *st);
+
 #endif /* __MODEM_H__ */
@@ -0,0 +1,26 @@
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/* The modem and TCP options of examples/lwipopts.h, for modem_bench on a
+ * host. Build with this directory first on the include path. */
+
+#define NO_SYS			0
+
+#define MODEM_NUM		2
+#ifndef MODEM_BALANCE
+# define MODEM_BALANCE		MODEM_BALANCE_WRR
+#endif
+#define MODEM_WEIGHTS		{ 1, 1 }
+
+#define MEM_ALIGNMENT		4
+#define PBUF_POOL_SIZE		32
+#define PBUF_POOL_BUFSIZE	128
+
+#define LWIP_TCP		1
+#define TCP_PPP_LINK_BPS	115200
+#define TCP_PPP_RTT_MS		400
+#define MEMP_NUM_TCP_PCB	4
+
+#include "arch/tcp_ppp.h"
+
+#endif /* __LWIPOPTS_H__ */
@@ -0,0 +1,593 @@
+#include "modem_bench.h"
+
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "lwip/ip.h"
+#include "lwip/tcp_impl.h"
+#include "lwip/tcpip.h"
+#include "modem.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if MODEM_NUM != 2
+# error "The benchmark runs two modems, MODEM_NUM must be 2"
+#endif
+
+#define __BENCH_HZ	(MODEM_BENCH_BPS / 10)	/* byte times a second */
+#define __bench_ms(ms)	((u32_t)((unsigned long long)(ms) * __BENCH_HZ / 1000))
+#define __BENCH_NEVER	0xffffffffUL
+#define __BENCH_Q	256	/* frames queued on a link */
+#define __BENCH_ACKS	512	/* ACKs on their way back */
+#define __BENCH_PPP	4	/* flag, protocol field and FCS of a frame */
+#define __BENCH_UDP	0xff	/* the flow of the scattered datagrams */
+#define __BENCH_SLOW	500	/* ms, lwIP's slow TCP timer */
+
+#define __BENCH_CLOSED	0
+#define __BENCH_SYN	1
+#define __BENCH_EST	2
+
+/* A packet on a link: a segment of a flow, or a datagram */
+struct __bench_frame {
+	u8_t		flow;
+	u8_t		gen;	/* of the flow's connection */
+	u8_t		syn;
+	u16_t		len;	/* of the payload */
+	u32_t		end;	/* sequence number after it */
+	ip_addr_t	src;
+};
+
+/* One modem: its PPP netif and serial link, and the carrier behind it,
+ * which drops what doesn't come from the address it gave the link */
+static struct __bench_link {
+	struct netif		netif;
+	u8_t			up;
+	struct __bench_frame	q[__BENCH_Q];
+	u16_t			rd, len;
+	u32_t			left;	/* byte times of the frame being sent */
+	u32_t			wire;	/* bytes sent */
+	u32_t			dropped;/* by the carrier, for their source */
+	u32_t			lost;	/* when the link was down or full */
+} __bench_link[MODEM_NUM];
+
+/* A TCP upload, as much of lwIP's sender as the routing needs: it connects
+ * over the link modem_route() picks, which binds it to that link's address
+ * as tcp_connect() does, then keeps TCP_SND_BUF bytes in flight in TCP_MSS
+ * segments. A timeout resends from the first byte not acked, with lwIP
+ * 1.4's RTO and backoff; TCP_MAXRTX of them abort the connection. An
+ * aborted connection opens again at once. */
+static struct __bench_flow {
+	struct tcp_pcb	pcb;	/* in tcp_active_pcbs while open */
+	ip_addr_t	dest;
+	u8_t		gen;
+	u8_t		state;
+	u32_t		nxt, acked;
+	u32_t		rto_at;
+	u8_t		nrtx;
+	s16_t		sa, sv;	/* RTT estimate, in slow timer ticks */
+	u32_t		rtseq;	/* segment being timed */
+	u32_t		rttest;	/* when it was sent, 0 if none */
+	u8_t		failing;/* its link went down */
+	u32_t		bytes;	/* acked in this phase */
+} __bench_flow[MEMP_NUM_TCP_PCB];
+
+static const u8_t __bench_backoff[13] = {
+	1, 2, 3, 4, 5, 6, 7, 7, 7, 7, 7, 7, 7
+};
+
+static struct {
+	u32_t		at;
+	u8_t		flow, gen, syn;
+	u32_t		end;
+	ip_addr_t	dst;	/* the address the ACK comes back to */
+} __bench_ack[__BENCH_ACKS];
+static u16_t __bench_ack_rd, __bench_ack_len;
+
+/* The tcpip thread's callbacks, run at the start of the next byte time */
+static struct {
+	tcpip_callback_fn	fn;
+	void			*arg;
+} __bench_cb[4];
+static u8_t __bench_cbs;
+
+static u32_t __bench_now;	/* in byte times */
+static u8_t __bench_flows;
+static u8_t __bench_dest_only;	/* route as before, by destination only */
+static struct __bench_frame __bench_tx;	/* what is being output */
+static u32_t __bench_scatter;	/* datagrams to new destinations */
+static u32_t __bench_timeouts;
+static u32_t __bench_fo_sum, __bench_fo_max, __bench_fo_n;
+static u32_t __bench_down_at;
+
+struct netif *netif_list;
+struct tcp_pcb *tcp_active_pcbs;
+
+OS_CPU_SR OS_CPU_SR_Save(void)
+{
+	return 0;
+}
+
+void OS_CPU_SR_Restore(OS_CPU_SR cpu_sr)
+{
+	LWIP_UNUSED_ARG(cpu_sr);
+}
+
+err_t tcpip_callback_with_block(tcpip_callback_fn fn, void *ctx, u8_t block)
+{
+	LWIP_UNUSED_ARG(block);
+	/* the previous modem_route() aborted nothing */
+	if (__bench_dest_only)
+		return ERR_OK;
+	if (__bench_cbs == sizeof(__bench_cb) / sizeof(__bench_cb[0]))
+		return ERR_MEM;
+	__bench_cb[__bench_cbs].fn = fn;
+	__bench_cb[__bench_cbs].arg = ctx;
+	__bench_cbs++;
+
+	return ERR_OK;
+}
+
+static void __bench_unlink(struct tcp_pcb *pcb)
+{
+	struct tcp_pcb **pp;
+
+	for (pp = &tcp_active_pcbs; *pp; pp = &(*pp)->next) {
+		if (*pp == pcb) {
+			*pp = pcb->next;
+			break;
+		}
+	}
+}
+
+/* lwIP's, as far as the flows go: the connection is gone and the
+ * application, told by its err callback, connects again */
+void tcp_abort(struct tcp_pcb *pcb)
+{
+	struct __bench_flow *f = pcb->callback_arg;
+
+	__bench_unlink(pcb);
+	f->state = __BENCH_CLOSED;
+}
+
+/* PPP's output: queue the frame on the link */
+static err_t __bench_ppp_output(struct netif *netif, struct pbuf *p,
+		ip_addr_t *ipaddr)
+{
+	struct __bench_link *l = &__bench_link[netif->num];
+	struct ip_hdr *iphdr = p->payload;
+	struct __bench_frame *fr;
+
+	LWIP_UNUSED_ARG(ipaddr);
+	if (!l->up || l->len == __BENCH_Q) {
+		l->lost++;
+		return ERR_IF;
+	}
+	fr = &l->q[(l->rd + l->len++) % __BENCH_Q];
+	*fr = __bench_tx;
+	ip_addr_copy(fr->src, iphdr->src);
+
+	return ERR_OK;
+}
+
+/* ip_output(): route the packet, by LWIP_HOOK_IP4_ROUTE, and hand it to the
+ * netif with 'src', or the netif's address for an unbound pcb */
+static void __bench_ip_output(ip_addr_t *src, ip_addr_t *dest)
+{
+	struct netif *netif = modem_route(dest);
+	struct ip_hdr iphdr;
+	struct pbuf p;
+
+	if (netif == NULL)
+		return;
+	memset(&iphdr, 0, sizeof(iphdr));
+	if (ip_addr_isany(src))
+		src = &netif->ip_addr;
+	ip_addr_copy(iphdr.src, *src);
+	ip_addr_copy(iphdr.dest, *dest);
+	memset(&p, 0, sizeof(p));
+	p.payload = &iphdr;
+	p.len = p.tot_len = sizeof(iphdr);
+	netif->output(netif, &p, dest);
+}
+
+/* Give the link, at 100.64.i.host, to modem_route(), as link_status_cb()
+ * does once PPP added its netif */
+static void __bench_link_up(u8_t i, u8_t host)
+{
+	struct __bench_link *l = &__bench_link[i];
+
+	l->up = 1;
+	l->rd = l->len = 0;
+	l->left = 0;
+	IP4_ADDR(&l->netif.ip_addr, 100, 64, i, host);
+	l->netif.flags |= NETIF_FLAG_UP;
+	l->netif.output = __bench_ppp_output;
+	modem_link(i, &l->netif);
+	if (__bench_dest_only)
+		l->netif.output = __bench_ppp_output;
+}
+
+/* The modem hung up: what was queued is lost */
+static void __bench_link_down(u8_t i)
+{
+	struct __bench_link *l = &__bench_link[i];
+
+	l->up = 0;
+	l->lost += l->len;
+	l->len = 0;
+	l->left = 0;
+	l->netif.flags &= ~NETIF_FLAG_UP;
+	modem_link(i, NULL);
+}
+
+static void __bench_send(struct __bench_flow *f, u8_t syn, u16_t len)
+{
+	__bench_tx.flow = (u8_t)(f - __bench_flow);
+	__bench_tx.gen = f->gen;
+	__bench_tx.syn = syn;
+	__bench_tx.len = len;
+	__bench_tx.end = f->nxt + len;
+	__bench_ip_output(&f->pcb.local_ip, &f->dest);
+}
+
+/* The RTO of tcp_receive(), or of tcp_slowtmr() after 'shift' doublings */
+static u32_t __bench_rto(struct __bench_flow *f, u8_t shift)
+{
+	return __bench_ms((u32_t)((f->sa >> 3) + f->sv) * __BENCH_SLOW <<
+			shift);
+}
+
+static void __bench_connect(struct __bench_flow *f)
+{
+	struct netif *netif = modem_route(&f->dest);
+
+	if (netif == NULL)
+		return;
+	f->gen++;
+	f->state = __BENCH_SYN;
+	f->nxt = f->acked = 0;
+	f->nrtx = 0;
+	f->sa = 0;
+	f->sv = 3000 / __BENCH_SLOW;
+	f->rttest = 0;
+	ip_addr_copy(f->pcb.local_ip, netif->ip_addr);
+	f->pcb.callback_arg = f;
+	f->pcb.next = tcp_active_pcbs;
+	tcp_active_pcbs = &f->pcb;
+	__bench_send(f, 1, 0);
+	f->rto_at = __bench_now + __bench_rto(f, 0);
+}
+
+static void __bench_flow_step(struct __bench_flow *f)
+{
+	if (f->state == __BENCH_CLOSED) {
+		__bench_connect(f);
+		return;
+	}
+	if (__bench_now >= f->rto_at) {
+		__bench_timeouts++;
+		if (f->nrtx == (f->state == __BENCH_SYN ? TCP_SYNMAXRTX :
+					TCP_MAXRTX)) {
+			tcp_abort(&f->pcb);
+			return;
+		}
+		/* a SYN is resent without backing off */
+		f->rto_at = __bench_now + __bench_rto(f,
+				f->state == __BENCH_SYN ? 0 :
+				__bench_backoff[f->nrtx]);
+		f->nrtx++;
+		f->rttest = 0;
+		if (f->state == __BENCH_SYN) {
+			__bench_send(f, 1, 0);
+			return;
+		}
+		f->nxt = f->acked;
+	}
+	if (f->state != __BENCH_EST ||
+	    f->nxt + TCP_MSS - f->acked > TCP_SND_BUF)
+		return;
+	if (f->rttest == 0) {
+		f->rttest = __bench_now;
+		f->rtseq = f->nxt;
+	}
+	__bench_send(f, 0, TCP_MSS);
+	f->nxt += TCP_MSS;
+	if (f->rto_at == __BENCH_NEVER)
+		f->rto_at = __bench_now + __bench_rto(f, 0);
+}
+
+/* An ACK came back, over whichever link holds the address it is for */
+static void __bench_acked(u8_t flow, u8_t gen, u8_t syn, u32_t end)
+{
+	struct __bench_flow *f = &__bench_flow[flow];
+	s16_t m;
+
+	if (gen != f->gen || f->state == __BENCH_CLOSED)
+		return;
+	if (syn) {
+		if (f->state == __BENCH_SYN) {
+			f->state = __BENCH_EST;
+			f->nrtx = 0;
+			f->rto_at = __BENCH_NEVER;
+		}
+		return;
+	}
+	if (end <= f->acked)
+		return;
+	/* the RTT estimate of tcp_receive() */
+	if (f->rttest && f->rtseq < end) {
+		m = (s16_t)((__bench_now - f->rttest) * 1000 / __BENCH_HZ /
+				__BENCH_SLOW);
+		m = m - (f->sa >> 3);
+		f->sa += m;
+		if (m < 0)
+			m = -m;
+		m = m - (f->sv >> 2);
+		f->sv += m;
+		f->rttest = 0;
+	}
+	f->bytes += end - f->acked;
+	f->acked = end;
+	f->nrtx = 0;
+	f->rto_at = f->nxt > f->acked ? __bench_now + __bench_rto(f, 0) :
+		__BENCH_NEVER;
+	if (f->failing) {
+		f->failing = 0;
+		end = __bench_now - __bench_down_at;
+		__bench_fo_sum += end;
+		if (end > __bench_fo_max)
+			__bench_fo_max = end;
+		__bench_fo_n++;
+	}
+}
+
+/* One byte time on a link. A frame whose source isn't the link's address
+ * is dropped by the carrier, the others reach their peer, whose ACK comes
+ * back TCP_PPP_RTT_MS later. */
+static void __bench_link_step(struct __bench_link *l)
+{
+	struct __bench_frame *fr;
+	u16_t i;
+
+	if (!l->up)
+		return;
+	if (l->left == 0 && l->len > 0) {
+		fr = &l->q[l->rd];
+		l->left = 20 + (fr->flow == __BENCH_UDP ? 8 : 20) + fr->len +
+			__BENCH_PPP;
+	}
+	if (l->left == 0)
+		return;
+	l->wire++;
+	if (--l->left > 0)
+		return;
+	fr = &l->q[l->rd];
+	l->rd = (l->rd + 1) % __BENCH_Q;
+	l->len--;
+	if (!ip_addr_cmp(&fr->src, &l->netif.ip_addr)) {
+		l->dropped++;
+		return;
+	}
+	if (fr->flow == __BENCH_UDP)
+		return;
+	LWIP_ASSERT("ACKs full", __bench_ack_len < __BENCH_ACKS);
+	i = (__bench_ack_rd + __bench_ack_len++) % __BENCH_ACKS;
+	__bench_ack[i].at = __bench_now + __bench_ms(TCP_PPP_RTT_MS);
+	__bench_ack[i].flow = fr->flow;
+	__bench_ack[i].gen = fr->gen;
+	__bench_ack[i].syn = fr->syn;
+	__bench_ack[i].end = fr->end;
+	ip_addr_copy(__bench_ack[i].dst, fr->src);
+}
+
+static void __bench_step(void)
+{
+	u8_t i, n;
+	u16_t k;
+
+	n = __bench_cbs;
+	__bench_cbs = 0;
+	for (i = 0; i < n; i++)
+		__bench_cb[i].fn(__bench_cb[i].arg);
+
+	while (__bench_ack_len > 0 &&
+	       __bench_ack[__bench_ack_rd].at <= __bench_now) {
+		k = __bench_ack_rd;
+		__bench_ack_rd = (__bench_ack_rd + 1) % __BENCH_ACKS;
+		__bench_ack_len--;
+		for (i = 0; i < MODEM_NUM; i++) {
+			if (__bench_link[i].up &&
+			    ip_addr_cmp(&__bench_ack[k].dst,
+				    &__bench_link[i].netif.ip_addr))
+				break;
+		}
+		if (i < MODEM_NUM)
+			__bench_acked(__bench_ack[k].flow, __bench_ack[k].gen,
+					__bench_ack[k].syn, __bench_ack[k].end);
+	}
+
+#if MODEM_BENCH_SCATTER_MS > 0
+	if (__bench_now % __bench_ms(MODEM_BENCH_SCATTER_MS) == 0) {
+		ip_addr_t src, dest;
+
+		ip_addr_set_zero(&src);
+		/* 198.18.0.0/15, a new address each time */
+		__bench_scatter++;
+		IP4_ADDR(&dest, 198, 18 + (__bench_scatter >> 16 & 1),
+				__bench_scatter >> 8, __bench_scatter);
+		memset(&__bench_tx, 0, sizeof(__bench_tx));
+		__bench_tx.flow = __BENCH_UDP;
+		__bench_tx.len = 20;
+		__bench_ip_output(&src, &dest);
+	}
+#endif
+
+	for (i = 0; i < __bench_flows; i++)
+		__bench_flow_step(&__bench_flow[i]);
+	for (i = 0; i < MODEM_NUM; i++)
+		__bench_link_step(&__bench_link[i]);
+	__bench_now++;
+}
+
+static void __bench_start(u8_t flows, u8_t dest_only)
+{
+	u8_t i;
+
+	memset(__bench_link, 0, sizeof(__bench_link));
+	memset(__bench_flow, 0, sizeof(__bench_flow));
+	__bench_ack_rd = __bench_ack_len = 0;
+	__bench_cbs = 0;
+	__bench_now = 0;
+	__bench_flows = flows;
+	__bench_dest_only = dest_only;
+	__bench_timeouts = 0;
+	__bench_fo_sum = __bench_fo_max = __bench_fo_n = 0;
+	tcp_active_pcbs = NULL;
+	netif_list = NULL;
+	modem_route_init();
+	for (i = 0; i < MODEM_NUM; i++) {
+		__bench_link[i].netif.num = i;
+		IP4_ADDR(&__bench_link[i].netif.netmask, 255, 0, 0, 0);
+		IP4_ADDR(&__bench_link[i].netif.gw, 10, 64, 64, 64);
+		__bench_link[i].netif.next = netif_list;
+		netif_list = &__bench_link[i].netif;
+		__bench_link_up(i, 1);
+	}
+	for (i = 0; i < flows; i++) {
+		IP4_ADDR(&__bench_flow[i].dest, 203, 0, 113, i + 1);
+		__bench_flow[i].rto_at = __BENCH_NEVER;
+	}
+}
+
+static u32_t __bench_goodput(u32_t t)
+{
+	u32_t bytes = 0;
+	u8_t i;
+
+	for (i = 0; i < __bench_flows; i++) {
+		bytes += __bench_flow[i].bytes;
+		__bench_flow[i].bytes = 0;
+	}
+
+	return (u32_t)((unsigned long long)bytes * __BENCH_HZ / t);
+}
+
+static u32_t __bench_sourced(void)
+{
+	struct modem_stats st;
+	u32_t n = 0;
+	u8_t i;
+
+	for (i = 0; i < MODEM_NUM; i++) {
+		modem_get_stats(i, &st);
+		n += st.sourced;
+	}
+
+	return n;
+}
+
+static void __bench_row(u8_t flows, u8_t dest_only)
+{
+	u32_t t = __bench_ms(MODEM_BENCH_SECONDS * 1000), sourced, wire, g;
+
+	__bench_start(flows, dest_only);
+	sourced = __bench_sourced();
+	while (__bench_now < t)
+		__bench_step();
+	wire = __bench_link[0].wire + __bench_link[1].wire;
+	g = __bench_goodput(t);
+
+	printf("%5u %-6s %6lu %3lu%% %3lu%% %3lu%% %7lu %7lu %5lu\r\n", flows,
+			dest_only ? "dest" : "source", (unsigned long)g,
+			(unsigned long)(g * 100 / (2 * __BENCH_HZ)),
+			(unsigned long)(wire ? __bench_link[0].wire * 100 /
+				wire : 0),
+			(unsigned long)(wire ? __bench_link[1].wire * 100 /
+				wire : 0),
+			(unsigned long)(__bench_sourced() - sourced),
+			(unsigned long)(__bench_link[0].dropped +
+				__bench_link[1].dropped),
+			(unsigned long)__bench_timeouts);
+}
+
+/* Modem 0 goes down with the flows on it, and comes back with a new
+ * address */
+static void __bench_failover(u8_t dest_only)
+{
+	u32_t t = __bench_ms(MODEM_BENCH_FAILOVER_S * 1000UL);
+	u32_t g[3];
+	u8_t i, hit = 0;
+
+	__bench_start(MEMP_NUM_TCP_PCB, dest_only);
+	while (__bench_now < t)
+		__bench_step();
+	g[0] = __bench_goodput(t);
+
+	for (i = 0; i < __bench_flows; i++) {
+		if (__bench_flow[i].state != __BENCH_CLOSED &&
+		    ip_addr_cmp(&__bench_flow[i].pcb.local_ip,
+			    &__bench_link[0].netif.ip_addr)) {
+			__bench_flow[i].failing = 1;
+			hit++;
+		}
+	}
+	__bench_down_at = __bench_now;
+	__bench_link_down(0);
+	while (__bench_now < 2 * t)
+		__bench_step();
+	g[1] = __bench_goodput(t);
+
+	__bench_link_up(0, 2);
+	while (__bench_now < 3 * t)
+		__bench_step();
+	g[2] = __bench_goodput(t);
+
+	printf("%-6s %4u %4lu", dest_only ? "dest" : "source", hit,
+			(unsigned long)__bench_fo_n);
+	if (__bench_fo_n > 0)
+		printf(" %7lu %7lu", (unsigned long)(__bench_fo_sum /
+					__bench_fo_n * 1000 / __BENCH_HZ),
+				(unsigned long)(__bench_fo_max * 1000 /
+					__BENCH_HZ));
+	else
+		printf(" %7s %7s", "-", "-");
+	printf(" %6lu %6lu %6lu %7lu\r\n", (unsigned long)g[0],
+			(unsigned long)g[1], (unsigned long)g[2],
+			(unsigned long)(__bench_link[0].dropped +
+				__bench_link[1].dropped));
+}
+
+void modem_bench(void)
+{
+	u8_t flows;
+
+	printf("modem: %s, %u ms round trip beyond the modems, %lu bit/s 8N1"
+			", MSS %u, TCP_SND_BUF %u", MODEM_BALANCE ==
+			MODEM_BALANCE_WRR ? "MODEM_BALANCE_WRR" :
+			"MODEM_BALANCE_HASH", TCP_PPP_RTT_MS,
+			(unsigned long)MODEM_BENCH_BPS, TCP_MSS, TCP_SND_BUF);
+#if MODEM_BENCH_SCATTER_MS > 0
+	printf(", a datagram to a new address every %u ms",
+			MODEM_BENCH_SCATTER_MS);
+#endif
+	printf("\r\n");
+	printf("flows route     B/s  use link0 link1   moved dropped  rtos\r\n");
+	for (flows = 1; flows <= MEMP_NUM_TCP_PCB; flows *= 2) {
+		__bench_row(flows, 0);
+		__bench_row(flows, 1);
+	}
+
+	printf("\r\nfailover: modem 0 down after %u s, back after %u s\r\n",
+			MODEM_BENCH_FAILOVER_S, 2 * MODEM_BENCH_FAILOVER_S);
+	printf("               failover ms         B/s\r\n");
+	printf("route  hit back    mean     max   both    one   both dropped"
+			"\r\n");
+	__bench_failover(0);
+	__bench_failover(1);
+}
+
+int main(void)
+{
+	modem_bench();
+	return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef __MODEM_BENCH_H__
+#define __MODEM_BENCH_H__
+
+#include "lwip/opt.h"
+
+/** Bit rate of each modem's serial link, 8N1 taking 10 bits a byte */
+#ifndef MODEM_BENCH_BPS
+# define MODEM_BENCH_BPS 115200
+#endif
+
+/** Simulated seconds of a throughput run */
+#ifndef MODEM_BENCH_SECONDS
+# define MODEM_BENCH_SECONDS 60
+#endif
+
+/** A datagram goes to a new destination this often, as DNS and STUN
+ * queries do, 0 for none */
+#ifndef MODEM_BENCH_SCATTER_MS
+# define MODEM_BENCH_SCATTER_MS 100
+#endif
+
+/** In the failover run, modem 0 goes down after this many seconds, comes
+ * back after as many again, and the run lasts as long once more */
+#ifndef MODEM_BENCH_FAILOVER_S
+# define MODEM_BENCH_FAILOVER_S 200
+#endif
+
+/** Run the benchmark and print the results, on a host */
+void modem_bench(void);
+
+#endif /* __MODEM_BENCH_H__ */
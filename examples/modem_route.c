@@ -0,0 +1,287 @@
+#include "modem.h"
+
+#include "lwip/sys.h"
+#include "lwip/ip.h"
+#include "lwip/tcpip.h"
+#if LWIP_TCP
+# include "lwip/tcp_impl.h"
+#endif
+
+static const INT8U __modem_weight[MODEM_NUM] = MODEM_WEIGHTS;
+
+/* The link of each modem as modem_route() sees it */
+static struct modem_link {
+	struct netif		*netif;	/* while the link is up */
+	struct netif		*ppp;	/* the PPP netif it last came up on */
+	netif_output_fn		output;	/* and the output PPP gave it */
+	ip_addr_t		addr;	/* our address on the link */
+	INT8U			weight;
+#if MODEM_BALANCE == MODEM_BALANCE_WRR
+	int			current;
+#endif
+	struct modem_stats	stats;
+} __modem_link[MODEM_NUM];
+
+#if MODEM_BALANCE == MODEM_BALANCE_WRR
+static struct {
+	ip_addr_t	dest;
+	INT8U		link;	/* MODEM_NUM if the entry is free */
+} __modem_flow[MODEM_FLOWS];
+static INT8U __modem_flow_next;	/* entry replaced next */
+#endif
+
+void modem_route_init(void)
+{
+	INT8U i;
+
+	for (i = 0; i < MODEM_NUM; i++)
+		__modem_link[i].weight = __modem_weight[i] ?
+			__modem_weight[i] : 1;
+#if MODEM_BALANCE == MODEM_BALANCE_WRR
+	for (i = 0; i < MODEM_FLOWS; i++)
+		__modem_flow[i].link = MODEM_NUM;
+#endif
+}
+
+/* Every packet of the modem netifs. lwIP 1.4's tcp_connect() binds a pcb
+ * to the address of the link its first segment took, and the carrier drops
+ * what leaves another link with it. A packet whose source is the address
+ * of another link which is up goes out over that link, whatever link
+ * modem_route() picked for its destination. */
+static err_t modem_output(struct netif *netif, struct pbuf *p,
+		ip_addr_t *ipaddr)
+{
+	struct ip_hdr *iphdr = p->payload;
+	struct modem_link *own = NULL, *src = NULL;
+	INT8U i;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	for (i = 0; i < MODEM_NUM; i++) {
+		if (__modem_link[i].ppp == netif)
+			own = &__modem_link[i];
+		if (__modem_link[i].netif &&
+		    ip_addr_cmp(&iphdr->src, &__modem_link[i].addr))
+			src = &__modem_link[i];
+	}
+	if (src && src != own) {
+		src->stats.sourced++;
+		own = src;
+		netif = src->netif;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+	LWIP_ASSERT("modem_output: not a modem netif", own != NULL);
+
+	return own->output(netif, p, ipaddr);
+}
+
+#if LWIP_TCP
+/* Called in the tcpip thread once a link went down: the connections bound
+ * to its address can't send anywhere, so their applications get ERR_ABRT
+ * and can connect again over the links which are left */
+static void modem_abort(void *arg)
+{
+	struct modem_link *l = arg;
+	struct tcp_pcb *pcb, *next;
+
+	for (pcb = tcp_active_pcbs; pcb; pcb = next) {
+		next = pcb->next;
+		if (ip_addr_cmp(&pcb->local_ip, &l->addr)) {
+			l->stats.aborts++;
+			tcp_abort(pcb);
+		}
+	}
+}
+#endif
+
+void modem_link(u8_t idx, struct netif *netif)
+{
+	struct modem_link *l = &__modem_link[idx];
+	struct netif *was;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (netif) {
+		SYS_ARCH_PROTECT(sr);
+		/* PPP sets the output each time it adds the netif */
+		if (netif->output != modem_output) {
+			l->output = netif->output;
+			netif->output = modem_output;
+		}
+		l->ppp = netif;
+		ip_addr_copy(l->addr, netif->ip_addr);
+		l->netif = netif;
+		SYS_ARCH_UNPROTECT(sr);
+		return;
+	}
+
+	/* modem_route() moves the traffic off the link right away */
+	SYS_ARCH_PROTECT(sr);
+	was = l->netif;
+	if (was)
+		l->stats.downs++;
+	l->netif = NULL;
+	SYS_ARCH_UNPROTECT(sr);
+#if LWIP_TCP
+	/* without blocking, as PPP may call this in the tcpip thread */
+	if (was && tcpip_callback_with_block(modem_abort, l, 0) != ERR_OK)
+		l->stats.abort_fails++;
+#else
+	LWIP_UNUSED_ARG(was);
+#endif
+}
+
+#if MODEM_BALANCE == MODEM_BALANCE_WRR
+/* Smooth weighted round robin over the links which are up, called with at
+ * least one up and interrupts disabled */
+static INT8U modem_wrr_next(void)
+{
+	INT8U i, best = MODEM_NUM;
+	int total = 0;
+
+	for (i = 0; i < MODEM_NUM; i++) {
+		if (!__modem_link[i].netif)
+			continue;
+		__modem_link[i].current += __modem_link[i].weight;
+		total += __modem_link[i].weight;
+		if (best == MODEM_NUM ||
+		    __modem_link[i].current > __modem_link[best].current)
+			best = i;
+	}
+	__modem_link[best].current -= total;
+
+	return best;
+}
+
+static INT8U modem_balance(ip_addr_t *dest)
+{
+	INT8U i, link;
+
+	for (i = 0; i < MODEM_FLOWS; i++) {
+		if (__modem_flow[i].link < MODEM_NUM &&
+		    ip_addr_cmp(&__modem_flow[i].dest, dest))
+			break;
+	}
+	if (i < MODEM_FLOWS) {
+		link = __modem_flow[i].link;
+		if (__modem_link[link].netif)
+			return link;
+		__modem_link[link].stats.failovers++;
+	} else {
+		i = __modem_flow_next;
+		if (++__modem_flow_next == MODEM_FLOWS)
+			__modem_flow_next = 0;
+		ip_addr_copy(__modem_flow[i].dest, *dest);
+	}
+	link = modem_wrr_next();
+	__modem_flow[i].link = link;
+	__modem_link[link].stats.flows++;
+
+	return link;
+}
+#else
+static u32_t modem_hash(u32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/* Rendezvous hash of the destination over the links which are up, called
+ * with at least one up and interrupts disabled. Each link draws 'weight'
+ * scores for the destination and the highest score of all wins, so a link
+ * going down only moves the destinations it held and one coming up only
+ * takes those it wins, the others stay put. */
+static INT8U modem_balance(ip_addr_t *dest)
+{
+	u32_t addr = ip4_addr_get_u32(dest), score, best_score = 0;
+	INT8U i, j, best = MODEM_NUM;
+
+	for (i = 0; i < MODEM_NUM; i++) {
+		if (!__modem_link[i].netif)
+			continue;
+		for (j = 0; j < __modem_link[i].weight; j++) {
+			score = modem_hash(addr ^ modem_hash(i << 8 | j));
+			if (best == MODEM_NUM || score > best_score) {
+				best = i;
+				best_score = score;
+			}
+		}
+	}
+
+	return best;
+}
+#endif
+
+/* Whether the destination is on the subnet of a netif other than the
+ * modems', which lwIP routes itself */
+static int modem_on_link(ip_addr_t *dest)
+{
+	struct netif *netif;
+	INT8U i;
+
+	for (netif = netif_list; netif; netif = netif->next) {
+		if (!netif_is_up(netif) ||
+		    !ip_addr_netcmp(dest, &netif->ip_addr, &netif->netmask))
+			continue;
+		/* PPP gives its netif a classful mask, which says nothing
+		 * about what is behind the link */
+		for (i = 0; i < MODEM_NUM; i++) {
+			if (__modem_link[i].netif == netif)
+				break;
+		}
+		if (i == MODEM_NUM)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Called in the tcpip thread, which alone changes the netif list */
+struct netif *modem_route(ip_addr_t *dest)
+{
+	struct netif *netif = NULL;
+	INT8U i, up = 0;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	/* only what would take the default route is balanced, e.g. the SLIP
+	 * peer and the shmif subnet keep their netif */
+	if (modem_on_link(dest))
+		return NULL;
+
+	SYS_ARCH_PROTECT(sr);
+	for (i = 0; i < MODEM_NUM; i++) {
+		if (!__modem_link[i].netif)
+			continue;
+		up++;
+		/* a peer is only reachable over its own link */
+		if (ip_addr_cmp(dest, &__modem_link[i].netif->gw))
+			break;
+	}
+	if (i == MODEM_NUM && up > 0)
+		i = modem_balance(dest);
+	if (i < MODEM_NUM) {
+		__modem_link[i].stats.routed++;
+		netif = __modem_link[i].netif;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+
+	return netif;
+}
+
+int modem_get_stats(u8_t idx, struct modem_stats *st)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (idx >= MODEM_NUM)
+		return -1;
+	SYS_ARCH_PROTECT(sr);
+	*st = __modem_link[idx].stats;
+	st->up = __modem_link[idx].netif != NULL;
+	SYS_ARCH_UNPROTECT(sr);
+
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include "netconn_wait_bench.h"
+#include "ucos_ii.h"
+
+#include "lwip/api.h"
+#include "arch/netconn_wait.h"
+#include "arch/task_prof.h"
+
+#if !NETCONN_WAIT || !TASK_PROF
+# error "The benchmark needs NETCONN_WAIT and TASK_PROF"
+#endif
+
+static OS_STK __bench_stk[128];
+
+static struct {
+	struct netconn_wait	set;
+	struct netconn		*conn[NETCONN_WAIT_CONNS];
+	u8_t			n;
+	volatile u8_t		stop;
+	u32_t			t0;	/* when the event was reported */
+	u32_t			latency;
+} __bench;
+
+/* Waits on every netconn, consumes the event and records when it woke */
+static void __bench_waiter(void *p_arg)
+{
+	OS_FLAGS mask = 0, ready;
+	u32_t t;
+	u8_t i;
+
+	for (i = 0; i < __bench.n; i++)
+		mask |= NETCONN_WAIT_RD(i);
+	while (1) {
+		ready = netconn_wait(&__bench.set, mask, 0);
+		t = TASK_PROF_CYCLES();
+		if (__bench.stop)
+			break;
+		__bench.latency = t - __bench.t0;
+		for (i = 0; !(ready & NETCONN_WAIT_RD(i)); i++)
+			;
+		netconn_wait_callback(__bench.conn[i], NETCONN_EVT_RCVMINUS, 0);
+	}
+	OSTaskDel(OS_PRIO_SELF);
+}
+
+static void __bench_run(u8_t n)
+{
+	u32_t t, lat_min = 0xffffffff, lat_max = 0, rt;
+	unsigned long long lat_sum = 0, rt_sum = 0;
+	INT8U err;
+	err_t e;
+	u16_t k;
+	u8_t i;
+
+	e = netconn_wait_init(&__bench.set);
+	LWIP_ASSERT("netconn_wait_init", e == ERR_OK);
+	for (i = 0; i < n; i++) {
+		__bench.conn[i] = netconn_new_with_callback(NETCONN_UDP,
+				netconn_wait_callback);
+		LWIP_ASSERT("netconn_new", __bench.conn[i]);
+		netconn_wait_add(&__bench.set, __bench.conn[i]);
+	}
+	__bench.n = n;
+	__bench.stop = 0;
+	err = OSTaskCreate(__bench_waiter, NULL,
+			&__bench_stk[sizeof(__bench_stk) /
+				sizeof(__bench_stk[0]) - 1],
+			NETCONN_WAIT_BENCH_PRIO);
+	LWIP_ASSERT("OSTaskCreate", err == OS_ERR_NONE);
+
+	for (k = 0; k < NETCONN_WAIT_BENCH_EVENTS; k++) {
+		/* the waiter preempts us and blocks again before we go on */
+		__bench.t0 = TASK_PROF_CYCLES();
+		netconn_wait_callback(__bench.conn[k % n],
+				NETCONN_EVT_RCVPLUS, 0);
+		t = TASK_PROF_CYCLES();
+		rt = t - __bench.t0;
+		rt_sum += rt;
+		lat_sum += __bench.latency;
+		if (__bench.latency < lat_min)
+			lat_min = __bench.latency;
+		if (__bench.latency > lat_max)
+			lat_max = __bench.latency;
+	}
+
+	__bench.stop = 1;
+	netconn_wait_callback(__bench.conn[0], NETCONN_EVT_RCVPLUS, 0);
+	for (i = 0; i < n; i++) {
+		netconn_wait_remove(&__bench.set, __bench.conn[i]);
+		netconn_delete(__bench.conn[i]);
+	}
+	netconn_wait_deinit(&__bench.set);
+
+	printf("%5u  %8lu/%lu/%lu  %8lu\r\n", n,
+			(unsigned long)lat_min,
+			(unsigned long)(lat_sum / NETCONN_WAIT_BENCH_EVENTS),
+			(unsigned long)lat_max,
+			(unsigned long)(rt_sum / NETCONN_WAIT_BENCH_EVENTS));
+}
+
+void netconn_wait_bench_task(void *p_arg)
+{
+	u8_t n;
+
+	LWIP_ASSERT("The waiter must preempt the benchmark",
+			OSPrioCur > NETCONN_WAIT_BENCH_PRIO);
+	printf("conns  latency min/avg/max  round trip (cycles)\r\n");
+	for (n = 1; n <= NETCONN_WAIT_CONNS; n *= 2)
+		__bench_run(n);
+	OSTaskDel(OS_PRIO_SELF);
+}
@@ -0,0 +1,16 @@
+#ifndef __NETCONN_WAIT_BENCH_H__
+#define __NETCONN_WAIT_BENCH_H__
+
+/** Priority of the waiting task, higher than the one of the benchmark */
+#ifndef NETCONN_WAIT_BENCH_PRIO
+# define NETCONN_WAIT_BENCH_PRIO 4
+#endif
+
+/** Events per number of netconns */
+#ifndef NETCONN_WAIT_BENCH_EVENTS
+# define NETCONN_WAIT_BENCH_EVENTS 1000
+#endif
+
+void netconn_wait_bench_task(void *p_arg);
+
+#endif /* __NETCONN_WAIT_BENCH_H__ */
@@ -0,0 +1,16 @@
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/* The shmif options of examples/lwipopts.h, for shmif_bench between two
+ * processes of a Linux host, in a NO_SYS main loop. Build with this
+ * directory first on the include path. */
+
+#define NO_SYS			1
+#define LWIP_STATS		0
+
+#define LWIP_SUPPORT_CUSTOM_PBUF	1
+
+#define SHMIF_RING_SIZE		8
+#define SHMIF_MTU		1500
+
+#endif /* __LWIPOPTS_H__ */
@@ -0,0 +1,270 @@
+#include "shmif_bench.h"
+#include "shmif_host.h"
+
+#include "lwip/opt.h"
+#include "lwip/ip.h"
+#include "lwip/pbuf.h"
+#include "netif/shmif.h"
+#include "ucos_ii.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Each packet starts with its sequence number and kind */
+enum {
+	__BENCH_BULK,	/* to the peer, which counts it */
+	__BENCH_DONE,	/* from the peer, the bulk counted */
+	__BENCH_PING,	/* to the peer, which sends it back */
+	__BENCH_QUIT
+};
+
+static struct {
+	struct shmif_host	host;
+	struct netif		netif;
+	u8_t			spin;	/* poll, without the doorbell */
+	u8_t			done;
+
+	/* the bulk, in order at the peer */
+	u32_t			rx, rx_bad;
+
+	u32_t			buf[(SHMIF_MTU + 3) / 4];
+} __bench;
+
+/* The kernel shmif.c calls into: a process is one thread, which the
+ * doorbell doesn't interrupt */
+OS_CPU_SR OS_CPU_SR_Save(void)
+{
+	return 0;
+}
+
+void OS_CPU_SR_Restore(OS_CPU_SR cpu_sr)
+{
+	LWIP_UNUSED_ARG(cpu_sr);
+}
+
+/* lwIP, played as far as shmif.c needs: one pbuf a packet, handed to the
+ * benchmark in place of ip_input() */
+struct pbuf *pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type,
+		struct pbuf_custom *p, void *payload_mem, u16_t payload_mem_len)
+{
+	LWIP_UNUSED_ARG(l);
+	if (length > payload_mem_len)
+		return NULL;
+	p->pbuf.next = NULL;
+	p->pbuf.payload = payload_mem;
+	p->pbuf.flags = PBUF_FLAG_IS_CUSTOM;
+	p->pbuf.len = p->pbuf.tot_len = length;
+	p->pbuf.type = type;
+	p->pbuf.ref = 1;
+	return &p->pbuf;
+}
+
+u8_t pbuf_free(struct pbuf *p)
+{
+	if (--p->ref > 0)
+		return 0;
+	if (p->flags & PBUF_FLAG_IS_CUSTOM)
+		((struct pbuf_custom *)p)->custom_free_function(p);
+	return 1;
+}
+
+u16_t pbuf_copy_partial(struct pbuf *p, void *dataptr, u16_t len,
+		u16_t offset)
+{
+	u16_t n, copied = 0;
+
+	for (; p && copied < len; p = p->next) {
+		if (offset >= p->len) {
+			offset -= p->len;
+			continue;
+		}
+		n = LWIP_MIN(p->len - offset, len - copied);
+		memcpy((u8_t *)dataptr + copied, (u8_t *)p->payload + offset,
+				n);
+		copied += n;
+		offset = 0;
+	}
+	return copied;
+}
+
+/* Send a packet, waiting for room: the driver drops what finds the ring
+ * full, as lwIP would, and the benchmark sends it again */
+static void __bench_output(struct pbuf *p)
+{
+	while (__bench.netif.output(&__bench.netif, p, NULL) == ERR_MEM)
+		sched_yield();
+}
+
+static void __bench_send(u32_t seq, u32_t kind, u16_t len)
+{
+	struct pbuf p;
+
+	memset(&p, 0, sizeof(p));
+	__bench.buf[0] = seq;
+	__bench.buf[1] = kind;
+	p.payload = __bench.buf;
+	p.len = p.tot_len = len;
+	p.type = PBUF_REF;
+	p.ref = 1;
+	__bench_output(&p);
+}
+
+err_t ip_input(struct pbuf *p, struct netif *inp)
+{
+	u32_t *w = p->payload;
+
+	LWIP_UNUSED_ARG(inp);
+	switch (w[1]) {
+	case __BENCH_BULK:
+		if (w[0] != __bench.rx)
+			__bench.rx_bad++;
+		__bench.rx++;
+		if (w[0] == SHMIF_BENCH_PACKETS - 1)
+			__bench_send(__bench.rx - __bench.rx_bad,
+					__BENCH_DONE, 8);
+		break;
+	case __BENCH_DONE:
+		__bench.rx = w[0];
+		__bench.done = 1;
+		break;
+	case __BENCH_PING:
+		if (__bench.host.shmif.side == 1)
+			/* back from the slot it came in, as lwIP forwards */
+			__bench_output(p);
+		else
+			__bench.done = 1;
+		break;
+	case __BENCH_QUIT:
+		__bench.done = 1;
+		break;
+	}
+	pbuf_free(p);
+	return ERR_OK;
+}
+
+/* The main loop, until the flag is set */
+static void __bench_run(u8_t *done)
+{
+	for (;;) {
+		shmif_poll(&__bench.host.shmif);
+		if (*done)
+			return;
+		if (__bench.spin)
+			sched_yield();
+		else if (shmif_host_wait(&__bench.host, -1) < 0) {
+			perror("shmif_bench: doorbell");
+			exit(1);
+		}
+	}
+}
+
+static void __bench_nokick(struct shmif *shmif)
+{
+	LWIP_UNUSED_ARG(shmif);
+}
+
+/* Map the region as a process of its own would, and bring up the netif as
+ * netif_add() would */
+static void __bench_open(u8_t side)
+{
+	if (shmif_host_open(&__bench.host, SHMIF_BENCH_PATH, side) < 0) {
+		perror("shmif_bench: " SHMIF_BENCH_PATH);
+		exit(1);
+	}
+	if (__bench.spin)
+		__bench.host.shmif.kick = __bench_nokick;
+	__bench.netif.state = &__bench.host.shmif;
+	if (shmif_init(&__bench.netif) != ERR_OK) {
+		printf("shmif_init failed\r\n");
+		exit(1);
+	}
+}
+
+static void __bench_peer(void)
+{
+	/* what it inherited is side 0's */
+	shmif_host_close(&__bench.host, NULL);
+	__bench_open(1);
+	__bench_run(&__bench.done);
+	shmif_host_close(&__bench.host, NULL);
+	exit(0);
+}
+
+static double __bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void __bench_row(u8_t spin, u16_t len)
+{
+	double t, bulk, rtt;
+	u32_t i;
+	pid_t pid;
+
+	memset(&__bench, 0, sizeof(__bench));
+	__bench.spin = spin;
+	__bench_open(0);
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("shmif_bench: fork");
+		exit(1);
+	}
+	if (pid == 0)
+		__bench_peer();
+
+	t = __bench_now();
+	for (i = 0; i < SHMIF_BENCH_PACKETS; i++)
+		__bench_send(i, __BENCH_BULK, len);
+	__bench_run(&__bench.done);
+	bulk = __bench_now() - t;
+
+	t = __bench_now();
+	for (i = 0; i < SHMIF_BENCH_PINGS; i++) {
+		__bench.done = 0;
+		__bench_send(i, __BENCH_PING, len);
+		__bench_run(&__bench.done);
+	}
+	rtt = (__bench_now() - t) / SHMIF_BENCH_PINGS;
+
+	__bench_send(0, __BENCH_QUIT, 8);
+	waitpid(pid, NULL, 0);
+
+	printf("%-8s %5u %9.0f %8.1f %8.2f %6.1f %5lu\r\n",
+			spin ? "poll" : "doorbell", len,
+			SHMIF_BENCH_PACKETS / bulk,
+			SHMIF_BENCH_PACKETS * (double)len / bulk / 1e6,
+			(double)__bench.host.shmif.tx_full /
+			SHMIF_BENCH_PACKETS, rtt * 1e6,
+			(unsigned long)(SHMIF_BENCH_PACKETS - __bench.rx));
+	shmif_host_close(&__bench.host, SHMIF_BENCH_PATH);
+}
+
+void shmif_bench(void)
+{
+	static const u16_t len[] = { 64, 576, SHMIF_MTU };
+	u8_t spin, i;
+
+	printf("shmif: %u packets a row one way, %u echoed, SHMIF_RING_SIZE "
+			"%u, two processes\r\n", SHMIF_BENCH_PACKETS,
+			SHMIF_BENCH_PINGS, SHMIF_RING_SIZE);
+	printf("                           bulk             echo\r\n");
+	printf("mode     bytes     pkt/s     MB/s full/pkt rtt us  lost\r\n");
+	for (spin = 0; spin < 2; spin++)
+		for (i = 0; i < sizeof(len) / sizeof(len[0]); i++)
+			__bench_row(spin, len[i]);
+}
+
+int main(void)
+{
+	shmif_bench();
+	return 0;
+}
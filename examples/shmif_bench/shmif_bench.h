@@ -0,0 +1,24 @@
+#ifndef __SHMIF_BENCH_H__
+#define __SHMIF_BENCH_H__
+
+#include "lwip/opt.h"
+
+/** Packets of each size sent one way, as fast as the ring takes them */
+#ifndef SHMIF_BENCH_PACKETS
+# define SHMIF_BENCH_PACKETS 200000
+#endif
+
+/** Packets of each size echoed by the peer, one at a time */
+#ifndef SHMIF_BENCH_PINGS
+# define SHMIF_BENCH_PINGS 20000
+#endif
+
+/** The region shared by the two processes, and its doorbells next to it */
+#ifndef SHMIF_BENCH_PATH
+# define SHMIF_BENCH_PATH "/tmp/shmif_bench"
+#endif
+
+/** Run the benchmark and print the results, forking the peer */
+void shmif_bench(void);
+
+#endif /* __SHMIF_BENCH_H__ */
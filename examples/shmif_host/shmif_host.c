@@ -0,0 +1,151 @@
+#include "shmif_host.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static void __shmif_host_bell(char *name, const char *path, u8_t side)
+{
+	snprintf(name, PATH_MAX, "%s.%u", path, side);
+}
+
+/* The driver rings after each packet and again when the ring is full; a
+ * FIFO already full holds rings the peer hasn't read, one more adds nothing */
+static void __shmif_host_kick(struct shmif *shmif)
+{
+	struct shmif_host *h = (struct shmif_host *)shmif;
+	char c = 0;
+
+	if (write(h->peer, &c, 1) < 0 && errno != EAGAIN)
+		perror("shmif_host: doorbell");
+}
+
+static void __shmif_host_sleep(void)
+{
+	struct timespec ts = { 0, 1000000 };
+
+	nanosleep(&ts, NULL);
+}
+
+int shmif_host_open(struct shmif_host *h, const char *path, u8_t side)
+{
+	char name[PATH_MAX];
+	struct shmif_shm *shm;
+	struct stat st;
+	int ms, i;
+
+	memset(h, 0, sizeof(*h));
+	h->fd = h->bell = h->peer = -1;
+	if (side == 0) {
+		unlink(path);
+		for (i = 0; i < 2; i++) {
+			__shmif_host_bell(name, path, i);
+			unlink(name);
+			if (mkfifo(name, 0600) < 0)
+				return -1;
+		}
+		h->fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (h->fd < 0 || ftruncate(h->fd, sizeof(*shm)) < 0)
+			goto fail;
+	} else {
+		/* side 0 made the FIFOs before the file */
+		for (ms = 0; ; ms++) {
+			h->fd = open(path, O_RDWR);
+			if (h->fd >= 0 && fstat(h->fd, &st) == 0 &&
+					st.st_size >= (off_t)sizeof(*shm))
+				break;
+			if (h->fd >= 0)
+				close(h->fd);
+			h->fd = -1;
+			if (ms == SHMIF_HOST_OPEN_MS) {
+				errno = ETIMEDOUT;
+				return -1;
+			}
+			__shmif_host_sleep();
+		}
+	}
+
+	shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED,
+			h->fd, 0);
+	if (shm == MAP_FAILED)
+		goto fail;
+	h->shmif.shm = shm;
+	h->shmif.side = side;
+	h->shmif.kick = __shmif_host_kick;
+
+	/* Linux opens a FIFO for reading and writing without waiting for the
+	 * other end, which the peer may not have opened yet */
+	__shmif_host_bell(name, path, side);
+	h->bell = open(name, O_RDWR | O_NONBLOCK);
+	__shmif_host_bell(name, path, 1 - side);
+	h->peer = open(name, O_RDWR | O_NONBLOCK);
+	if (h->bell < 0 || h->peer < 0)
+		goto fail;
+
+	if (side == 0) {
+		shmif_shm_init(shm);
+		return 0;
+	}
+	for (ms = 0; shm->magic != SHMIF_MAGIC; ms++) {
+		if (ms == SHMIF_HOST_OPEN_MS) {
+			errno = ETIMEDOUT;
+			goto fail;
+		}
+		__shmif_host_sleep();
+	}
+	SHMIF_MB();
+	return 0;
+
+fail:
+	i = errno;
+	shmif_host_close(h, NULL);
+	errno = i;
+	return -1;
+}
+
+int shmif_host_wait(struct shmif_host *h, int ms)
+{
+	struct pollfd pfd = { h->bell, POLLIN, 0 };
+	char buf[64];
+	int n;
+
+	n = poll(&pfd, 1, ms);
+	if (n <= 0)
+		return n;
+	while ((n = read(h->bell, buf, sizeof(buf))) == sizeof(buf))
+		;
+	if (n < 0 && errno != EAGAIN)
+		return -1;
+	return 1;
+}
+
+void shmif_host_close(struct shmif_host *h, const char *path)
+{
+	char name[PATH_MAX];
+	int i;
+
+	if (h->shmif.shm)
+		munmap(h->shmif.shm, sizeof(*h->shmif.shm));
+	h->shmif.shm = NULL;
+	if (h->bell >= 0)
+		close(h->bell);
+	if (h->peer >= 0)
+		close(h->peer);
+	if (h->fd >= 0)
+		close(h->fd);
+	h->fd = h->bell = h->peer = -1;
+	if (path && h->shmif.side == 0) {
+		unlink(path);
+		for (i = 0; i < 2; i++) {
+			__shmif_host_bell(name, path, i);
+			unlink(name);
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#ifndef __SHMIF_HOST_H__
+#define __SHMIF_HOST_H__
+
+#include "netif/shmif.h"
+
+/** One end of a shmif link between two processes of a Linux host: the
+ * region is a file both map with mmap(), the doorbells two FIFOs next to it,
+ * <path>.0 rung for side 0 and <path>.1 for side 1 */
+struct shmif_host {
+	struct shmif	shmif;	/* first, the state of the netif */
+	int		fd;
+	int		bell;	/* this side's doorbell */
+	int		peer;	/* the peer's */
+};
+
+/** Map the region at 'path' and open the doorbells, filling h->shmif for
+ * netif_add(..., &h->shmif, shmif_init, ...). Side 0 creates the file and
+ * the FIFOs afresh and clears the region, so start it first; side 1 waits
+ * up to SHMIF_HOST_OPEN_MS for it.
+ * @return 0, or -1 with errno set */
+int shmif_host_open(struct shmif_host *h, const char *path, u8_t side);
+
+#ifndef SHMIF_HOST_OPEN_MS
+# define SHMIF_HOST_OPEN_MS 5000
+#endif
+
+/** Wait up to 'ms' for the doorbell, -1 for ever, and clear it; the caller
+ * then receives with shmif_poll(), or shmif_irq() from a thread of its own.
+ * @return 1 if it rang, 0 if the time ran out, -1 with errno set */
+int shmif_host_wait(struct shmif_host *h, int ms);
+
+/** Unmap the region and close the doorbells, side 0 removing the files */
+void shmif_host_close(struct shmif_host *h, const char *path);
+
+#endif /* __SHMIF_HOST_H__ */
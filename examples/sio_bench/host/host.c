@@ -0,0 +1,115 @@
+#include "sio_bench.h"
+
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "ucos_ii.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* The kernel sio.c calls into, on a host. sio_bench reads only when the
+ * driver would wake the reader, so a pend which would block is a bug of the
+ * benchmark. */
+volatile INT32U OSTime;
+INT8U OSPrioCur = PPP_THREAD_PRIO;
+INT8U OSIntNesting;
+
+#define __HOST_SEMS	(4 * SIO_NUM_DEVS)
+
+static OS_EVENT __host_sem[__HOST_SEMS];
+static u8_t __host_sems;
+
+OS_CPU_SR OS_CPU_SR_Save(void)
+{
+	return 0;
+}
+
+void OS_CPU_SR_Restore(OS_CPU_SR cpu_sr)
+{
+	LWIP_UNUSED_ARG(cpu_sr);
+}
+
+OS_EVENT *OSSemCreate(INT16U cnt)
+{
+	OS_EVENT *e;
+
+	if (__host_sems == __HOST_SEMS)
+		return NULL;
+	e = &__host_sem[__host_sems++];
+	e->OSEventCnt = cnt;
+	return e;
+}
+
+INT16U OSSemAccept(OS_EVENT *e)
+{
+	INT16U cnt = e->OSEventCnt;
+
+	if (cnt > 0)
+		e->OSEventCnt--;
+	return cnt;
+}
+
+void OSSemPend(OS_EVENT *e, INT32U timeout, INT8U *err)
+{
+	LWIP_UNUSED_ARG(timeout);
+	if (e->OSEventCnt == 0) {
+		fprintf(stderr, "host: a pend would block\n");
+		abort();
+	}
+	e->OSEventCnt--;
+	*err = OS_ERR_NONE;
+}
+
+INT8U OSSemPendAbort(OS_EVENT *e, INT8U opt, INT8U *err)
+{
+	LWIP_UNUSED_ARG(e);
+	LWIP_UNUSED_ARG(opt);
+	*err = OS_ERR_NONE;
+	return 0;
+}
+
+INT8U OSSemPost(OS_EVENT *e)
+{
+	e->OSEventCnt++;
+	return OS_ERR_NONE;
+}
+
+void OSSemSet(OS_EVENT *e, INT16U cnt, INT8U *err)
+{
+	e->OSEventCnt = cnt;
+	*err = OS_ERR_NONE;
+}
+
+void OSSchedLock(void)
+{
+}
+
+void OSSchedUnlock(void)
+{
+}
+
+INT32U OSTimeGet(void)
+{
+	return OSTime;
+}
+
+/* Never called, as nothing aborts a pend */
+void sys_thread_free(INT8U prio)
+{
+	LWIP_UNUSED_ARG(prio);
+}
+
+unsigned int host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned int)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+int main(void)
+{
+	sio_bench();
+	return 0;
+}
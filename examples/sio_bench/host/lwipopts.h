@@ -0,0 +1,26 @@
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/* The serial options of examples/lwipopts.h, for sio_bench on a host with
+ * host.c. Build with this directory first on the include path. */
+
+#define NO_SYS			0
+
+#define PPP_SUPPORT		1
+#define PPPOS_SUPPORT		1
+#define PPP_THREAD_PRIO		10
+#define PPP_THREAD_STACKSIZE	128
+#define NUM_PPP			2
+
+#define SIO_NUM_DEVS		2
+#define SIO_LOCKFREE		1
+#define SIO_STATS		1
+#define SIO_FRAME_READ		1
+
+#define MEM_ALIGNMENT		4
+
+unsigned int host_ns(void);
+#define SIO_BENCH_CYCLES()	host_ns()
+#define SIO_BENCH_HZ		1000000000UL
+
+#endif /* __LWIPOPTS_H__ */
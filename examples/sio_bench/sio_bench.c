@@ -0,0 +1,569 @@
+#include "sio_bench.h"
+
+#include "lwip/opt.h"
+#include "lwip/sio.h"
+#include "arch/sio_arch.h"
+#include "sio_cpu.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if SIO_NUM_DEVS < 2
+# error "The benchmark joins serial devices 0 and 1, SIO_NUM_DEVS must be 2"
+#endif
+
+#define __BENCH_FLAG	0x7e
+#define __BENCH_ESC	0x7d
+#define __BENCH_TRANS	0x20
+#define __BENCH_FCS_GOOD 0xf0b8
+
+#define __BENCH_IP	0x21
+
+#define __BENCH_END	0xc0
+#define __BENCH_SLIP_ESC 0xdb
+#define __BENCH_ESC_END	0xdc
+#define __BENCH_ESC_ESC	0xdd
+#define __BENCH_MAX	1000	/* largest UDP payload */
+#define __BENCH_IP_MAX	(20 + 8 + __BENCH_MAX)
+
+/* One end: a reader and a writer on its own serial device, framing the
+ * datagrams as PPP or SLIP puts them on the wire, in place of the stack */
+struct __bench_end {
+	sio_fd_t		fd;
+	struct sio_bench_uart	*uart;
+	u8_t			echo;	/* send back what comes */
+	/* the frame being sent */
+	u8_t			out[2 * (1 + __BENCH_IP_MAX + 2) + 2];
+	u16_t			out_len, out_pos;
+	u8_t			idle;	/* the next frame starts with a flag */
+	u32_t			written;/* bytes given to sio_write() */
+	/* the frame being received */
+	u8_t			frame[1 + __BENCH_IP_MAX + 2];
+	u16_t			n;
+	u8_t			esc;
+	u32_t			read;	/* bytes sio_read() returned */
+	u32_t			ends;	/* frame ends among them */
+	u8_t			last;
+	/* this run */
+	u32_t			reads, ok, bad;
+	u32_t			lat_sum, lat_max;	/* in byte times */
+};
+
+struct sio_bench_uart sio_bench_uart[2];
+
+static struct __bench_end __bench_a, __bench_b;
+static const u16_t __bench_sizes[] = { 20, 200, __BENCH_MAX };
+
+/* the run */
+static u32_t __bench_now;	/* in byte times */
+static u32_t __bench_sent_at[SIO_BENCH_PACKETS];
+static u16_t __bench_len;	/* UDP payload */
+static u8_t __bench_frames;	/* sio_read() in frame mode */
+static u8_t __bench_slip;	/* SLIP rather than PPP */
+static u8_t __bench_delim;	/* the byte ending a frame */
+static u8_t __bench_errors;	/* flip bits on the wire */
+static u32_t __bench_seed;
+
+static u8_t __bench_buf[sizeof(__bench_a.out)];
+static u8_t __bench_pkt[__BENCH_IP_MAX];
+
+/* xorshift32 */
+static u32_t __bench_random(void)
+{
+	__bench_seed ^= __bench_seed << 13;
+	__bench_seed ^= __bench_seed >> 17;
+	__bench_seed ^= __bench_seed << 5;
+
+	return __bench_seed;
+}
+
+/* The FCS as lwIP computes it, a byte at a time from a table */
+static u16_t __bench_fcstab[256];
+
+#define __bench_fcs(fcs, c) \
+	(((fcs) >> 8) ^ __bench_fcstab[((fcs) ^ (c)) & 0xff])
+
+static void __bench_fcs_init(void)
+{
+	u16_t b, fcs;
+	u8_t i;
+
+	for (b = 0; b < 256; b++) {
+		fcs = b;
+		for (i = 0; i < 8; i++)
+			fcs = fcs & 1 ? (fcs >> 1) ^ 0x8408 : fcs >> 1;
+		__bench_fcstab[b] = fcs;
+	}
+}
+
+static u32_t __bench_sum(u32_t sum, const u8_t *b, u16_t len)
+{
+	u16_t i;
+
+	for (i = 0; i + 1 < len; i += 2)
+		sum += (u32_t)b[i] << 8 | b[i + 1];
+	if (len & 1)
+		sum += (u32_t)b[len - 1] << 8;
+
+	return sum;
+}
+
+static u16_t __bench_fold(u32_t sum)
+{
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return (u16_t)~sum;
+}
+
+/* The IPv4/UDP datagram k of the run, its sequence number first in the
+ * payload */
+static u16_t __bench_packet(u8_t *p, u16_t k)
+{
+	u16_t ulen = 8 + __bench_len;
+	u16_t len = 20 + ulen, sum, i;
+
+	memset(p, 0, 20 + 8);
+	p[0] = 0x45;
+	p[2] = (u8_t)(len >> 8);
+	p[3] = (u8_t)len;
+	p[4] = (u8_t)(k >> 8);
+	p[5] = (u8_t)k;
+	p[8] = 64;
+	p[9] = 17;
+	p[12] = 10; p[13] = 64; p[14] = 64; p[15] = 1;
+	p[16] = 10; p[17] = 64; p[18] = 64; p[19] = 2;
+	p[20] = 0xc0;
+	p[22] = 0x1f;
+	p[23] = 0x90;
+	p[24] = (u8_t)(ulen >> 8);
+	p[25] = (u8_t)ulen;
+	p[28] = (u8_t)(k >> 8);
+	p[29] = (u8_t)k;
+	for (i = 2; i < __bench_len; i++)
+		p[28 + i] = (u8_t)(k * 7 + i * 13);
+	sum = __bench_fold(__bench_sum(0, p, 20));
+	p[10] = (u8_t)(sum >> 8);
+	p[11] = (u8_t)sum;
+	/* pseudo header */
+	sum = __bench_fold(__bench_sum(__bench_sum(17 + ulen, p + 12, 8),
+				p + 20, ulen));
+	if (sum == 0)
+		sum = 0xffff;
+	p[26] = (u8_t)(sum >> 8);
+	p[27] = (u8_t)sum;
+
+	return len;
+}
+
+u8_t sio_bench_rx(struct sio_bench_uart *u)
+{
+	u8_t c = u->rdr;
+
+	u->rxne = 0;
+	u->taken++;
+	if (c == __bench_delim && u->last != __bench_delim)
+		u->ends++;
+	u->last = c;
+
+	return c;
+}
+
+void sio_bench_tx(struct sio_bench_uart *u, u8_t c)
+{
+	u->tdr = c;
+	u->tc = 0;
+}
+
+/* One byte time of the link in one direction: the byte being sent lands in
+ * the receive register of the other end. While that still holds the previous
+ * byte, RTS is off and the byte waits, as with RTS/CTS flow control. */
+static void __bench_wire(struct sio_bench_uart *tx,
+		struct sio_bench_uart *rx)
+{
+	u8_t c;
+
+	if (tx->tc || rx->rxne)
+		return;
+	c = tx->tdr;
+	if (__bench_errors && __bench_random() % SIO_BENCH_ERRORS == 0)
+		c ^= 1 << (__bench_random() % 8);
+	rx->rdr = c;
+	rx->rxne = 1;
+	tx->tc = 1;
+	tx->sent++;
+}
+
+/* Run the interrupts which are enabled and pending, as the NVIC would */
+static void __bench_irq(void)
+{
+	struct __bench_end *e[2] = { &__bench_a, &__bench_b };
+	struct sio_bench_uart *u;
+	u8_t i, more;
+
+	do {
+		more = 0;
+		for (i = 0; i < 2; i++) {
+			u = e[i]->uart;
+			if (u->rxie && u->rxne) {
+				sio_rx_complete(e[i]->fd);
+				more = 1;
+			}
+			if (u->txie && u->tc) {
+				sio_tx_complete(e[i]->fd);
+				more = 1;
+			}
+		}
+	} while (more);
+}
+
+static void __bench_put(struct __bench_end *e, u8_t c)
+{
+	if (__bench_slip) {
+		if (c == __BENCH_END) {
+			e->out[e->out_len++] = __BENCH_SLIP_ESC;
+			c = __BENCH_ESC_END;
+		} else if (c == __BENCH_SLIP_ESC) {
+			e->out[e->out_len++] = __BENCH_SLIP_ESC;
+			c = __BENCH_ESC_ESC;
+		}
+	} else if (c == __BENCH_FLAG || c == __BENCH_ESC) {
+		e->out[e->out_len++] = __BENCH_ESC;
+		c ^= __BENCH_TRANS;
+	}
+	e->out[e->out_len++] = c;
+}
+
+/* Queue an IP packet as it crosses the wire once LCP settled on an ACCM of
+ * 0 and address, control and protocol field compression, or framed by SLIP
+ * between two ENDs */
+static void __bench_send(struct __bench_end *e, const u8_t *ip, u16_t len)
+{
+	u16_t fcs = 0xffff, i;
+
+	LWIP_ASSERT("sending", e->out_pos == e->out_len);
+	e->out_len = 0;
+	e->out_pos = 0;
+	if (__bench_slip) {
+		e->out[e->out_len++] = __BENCH_END;
+		for (i = 0; i < len; i++)
+			__bench_put(e, ip[i]);
+		e->out[e->out_len++] = __BENCH_END;
+		return;
+	}
+	if (e->idle)
+		e->out[e->out_len++] = __BENCH_FLAG;
+	e->idle = 0;
+	fcs = __bench_fcs(fcs, __BENCH_IP);
+	__bench_put(e, __BENCH_IP);
+	for (i = 0; i < len; i++) {
+		fcs = __bench_fcs(fcs, ip[i]);
+		__bench_put(e, ip[i]);
+	}
+	fcs ^= 0xffff;
+	__bench_put(e, (u8_t)fcs);
+	__bench_put(e, (u8_t)(fcs >> 8));
+	e->out[e->out_len++] = __BENCH_FLAG;
+}
+
+/* A frame came. SLIP has no FCS, the comparison with what was sent drops
+ * what the IP and UDP checksums would. */
+static void __bench_input(struct __bench_end *e)
+{
+	u8_t *ip = e->frame;
+	u16_t fcs = 0xffff, i, k, len = e->n;
+	u32_t lat;
+
+	if (e->n == 0)
+		return;
+	if (!__bench_slip) {
+		for (i = 0; i < e->n; i++)
+			fcs = __bench_fcs(fcs, e->frame[i]);
+		if (e->n < 1 + 2 || fcs != __BENCH_FCS_GOOD ||
+		    e->frame[0] != __BENCH_IP) {
+			e->bad++;
+			return;
+		}
+		ip++;
+		len -= 1 + 2;
+	}
+	if (len < 30) {
+		e->bad++;
+		return;
+	}
+	k = (u16_t)ip[28] << 8 | ip[29];
+	if (k >= SIO_BENCH_PACKETS || len != __bench_packet(__bench_pkt, k) ||
+	    memcmp(ip, __bench_pkt, len) != 0) {
+		e->bad++;
+		return;
+	}
+	if (e->echo) {
+		__bench_send(e, ip, len);
+		return;
+	}
+	e->ok++;
+	lat = __bench_now - __bench_sent_at[k];
+	e->lat_sum += lat;
+	if (lat > e->lat_max)
+		e->lat_max = lat;
+}
+
+/* Whether the reader, blocked in sio_read(), would be woken: by any byte,
+ * or in frame mode by the end of a frame or a full ring */
+static u8_t __bench_woken(struct __bench_end *e)
+{
+	u32_t held = e->uart->taken - e->read;
+
+	if (!__bench_frames)
+		return held > 0;
+
+	return e->uart->ends != e->ends || held == SIO_BUF_SIZE;
+}
+
+/* The reader of an end, running as soon as an interrupt wakes it */
+static void __bench_read(struct __bench_end *e)
+{
+	u32_t n, i;
+	u8_t c;
+
+	while (__bench_woken(e)) {
+		n = sio_read(e->fd, __bench_buf, sizeof(__bench_buf));
+		e->reads++;
+		e->read += n;
+		for (i = 0; i < n; i++) {
+			c = __bench_buf[i];
+			if (c == __bench_delim && e->last != __bench_delim)
+				e->ends++;
+			e->last = c;
+			if (c == __bench_delim) {
+				__bench_input(e);
+				e->n = 0;
+				e->esc = 0;
+			} else if (c == (__bench_slip ? __BENCH_SLIP_ESC :
+						__BENCH_ESC)) {
+				e->esc = 1;
+			} else if (e->n < sizeof(e->frame)) {
+				if (e->esc && __bench_slip)
+					c = c == __BENCH_ESC_END ? __BENCH_END :
+						c == __BENCH_ESC_ESC ?
+						__BENCH_SLIP_ESC : c;
+				else if (e->esc)
+					c ^= __BENCH_TRANS;
+				e->frame[e->n++] = c;
+				e->esc = 0;
+			}
+		}
+		/* the RX interrupt is back on if the ring was full */
+		__bench_irq();
+	}
+}
+
+/* The sending thread of an end, which sio_write() would block while the TX
+ * ring is full: it writes what fits */
+static void __bench_write(struct __bench_end *e)
+{
+	u32_t space = SIO_BUF_SIZE - (e->written - e->uart->sent);
+	u32_t n = e->out_len - e->out_pos;
+
+	if (n > space)
+		n = space;
+	if (n == 0)
+		return;
+	sio_write(e->fd, e->out + e->out_pos, n);
+	e->out_pos += n;
+	e->written += n;
+	/* an idle UART takes the first byte at once */
+	__bench_irq();
+}
+
+static void __bench_step(void)
+{
+	__bench_wire(__bench_a.uart, __bench_b.uart);
+	__bench_wire(__bench_b.uart, __bench_a.uart);
+	__bench_irq();
+	__bench_read(&__bench_a);
+	__bench_read(&__bench_b);
+	__bench_write(&__bench_a);
+	__bench_write(&__bench_b);
+	__bench_now++;
+}
+
+/* Nothing left to send, on the wire or to read */
+static u8_t __bench_idle(void)
+{
+	return __bench_a.out_pos == __bench_a.out_len &&
+		__bench_b.out_pos == __bench_b.out_len &&
+		__bench_a.written == __bench_a.uart->sent &&
+		__bench_b.written == __bench_b.uart->sent &&
+		!__bench_woken(&__bench_a) && !__bench_woken(&__bench_b);
+}
+
+static void __bench_end_init(struct __bench_end *e, u8_t echo)
+{
+	u32_t n;
+
+	/* a partial frame a lost flag left in frame mode */
+	while ((n = sio_tryread(e->fd, __bench_buf, sizeof(__bench_buf))) > 0)
+		e->read += n;
+	e->uart->ends = 0;
+	e->uart->last = __bench_delim;
+	e->ends = 0;
+	e->last = __bench_delim;
+	e->echo = echo;
+	e->out_len = 0;
+	e->out_pos = 0;
+	e->idle = 1;
+	e->n = 0;
+	e->esc = 0;
+	e->reads = 0;
+	e->ok = 0;
+	e->bad = 0;
+	e->lat_sum = 0;
+	e->lat_max = 0;
+#if SIO_FRAME_READ
+	sio_frame_mode(e->fd, __bench_frames, __bench_delim);
+#endif
+}
+
+static void __bench_start(u8_t echo)
+{
+	__bench_end_init(&__bench_a, 0);
+	__bench_end_init(&__bench_b, echo);
+	__bench_now = 0;
+	__bench_seed = 1;
+}
+
+/* A sends the datagrams back to back, the next one as soon as the last is
+ * in the TX ring */
+static void __bench_bulk(void)
+{
+	u16_t k = 0;
+
+	__bench_start(0);
+	while (k < SIO_BENCH_PACKETS || !__bench_idle()) {
+		if (k < SIO_BENCH_PACKETS &&
+		    __bench_a.out_pos == __bench_a.out_len) {
+			__bench_sent_at[k] = __bench_now;
+			__bench_send(&__bench_a, __bench_pkt,
+					__bench_packet(__bench_pkt, k));
+			k++;
+		}
+		__bench_step();
+	}
+}
+
+/* A sends a datagram at a time, which B echoes, the next one once the link
+ * is idle, the echo having come back or been lost */
+static void __bench_echo(void)
+{
+	u16_t k = 0;
+
+	__bench_start(1);
+	while (k < SIO_BENCH_PACKETS || !__bench_idle()) {
+		if (k < SIO_BENCH_PACKETS && __bench_idle()) {
+			__bench_sent_at[k] = __bench_now;
+			__bench_send(&__bench_a, __bench_pkt,
+					__bench_packet(__bench_pkt, k));
+			k++;
+		}
+		__bench_step();
+	}
+}
+
+/* Microseconds of a number of byte times */
+static unsigned long __bench_us(u32_t t)
+{
+	return (unsigned long)((unsigned long long)t * 10 * 1000000UL /
+			SIO_BENCH_BPS);
+}
+
+static void __bench_row(void)
+{
+	u32_t sent = 0, cycles = 0, t;
+	unsigned long long ns;
+	struct __bench_end *b = &__bench_b;
+	u8_t r;
+
+	/* the runs differ only in the time they take, the fastest being the
+	 * least disturbed by interrupts */
+	for (r = 0; r < SIO_BENCH_REPEAT; r++) {
+		sent = __bench_a.uart->sent;
+		t = SIO_BENCH_CYCLES();
+		__bench_bulk();
+		t = SIO_BENCH_CYCLES() - t;
+		sent = __bench_a.uart->sent - sent;
+		if (r == 0 || t < cycles)
+			cycles = t;
+	}
+	t = __bench_now;
+
+	printf("%5u  %-4s %-5s %-3s", __bench_len, __bench_slip ? "slip" : "ppp",
+			__bench_frames ? "frame" : "byte",
+			__bench_errors ? "yes" : "no");
+	/* goodput over the run, frames and latency of those which came */
+	printf(" %6lu %5lu %6lu %4lu",
+			(unsigned long)((unsigned long long)b->ok * __bench_len *
+				8 * SIO_BENCH_BPS / 10 / t / 1000),
+			(unsigned long)((unsigned long long)b->ok *
+				SIO_BENCH_BPS / 10 / t),
+			(unsigned long)(sent / SIO_BENCH_PACKETS),
+			(unsigned long)(SIO_BENCH_PACKETS - b->ok));
+	if (b->ok > 0)
+		printf(" %7lu %7lu %4lu.%lu", __bench_us(b->lat_sum / b->ok),
+				__bench_us(b->lat_max),
+				(unsigned long)(b->reads / b->ok),
+				(unsigned long)(b->reads * 10 / b->ok % 10));
+	else
+		printf(" %7s %7s %6s", "-", "-", "-");
+	ns = (unsigned long long)cycles * 1000000000UL / SIO_BENCH_HZ;
+	printf(" %5lu", (unsigned long)(ns / sent));
+
+	__bench_echo();
+	if (__bench_a.ok > 0)
+		printf(" %7lu\r\n", __bench_us(__bench_a.lat_sum /
+					__bench_a.ok));
+	else
+		printf(" %7s\r\n", "-");
+}
+
+void sio_bench(void)
+{
+	u8_t i;
+
+	__bench_fcs_init();
+	__bench_a.fd = sio_open(0);
+	__bench_b.fd = sio_open(1);
+	LWIP_ASSERT("sio_open", __bench_a.fd != NULL && __bench_b.fd != NULL);
+	__bench_a.uart = &sio_bench_uart[0];
+	__bench_b.uart = &sio_bench_uart[1];
+	memset(sio_bench_uart, 0, sizeof(sio_bench_uart));
+	for (i = 0; i < 2; i++) {
+		sio_bench_uart[i].tc = 1;
+		sio_bench_uart[i].rxie = 1;
+	}
+
+	printf("sio: %u datagrams a run, %lu bit/s 8N1, rings of %u bytes,"
+			" 1 bit error in %lu bytes\r\n", SIO_BENCH_PACKETS,
+			(unsigned long)SIO_BENCH_BPS, SIO_BUF_SIZE,
+			(unsigned long)SIO_BENCH_ERRORS);
+	printf("                            bulk                     latency us"
+			"  reads        echo\r\n");
+	printf("bytes  link read  err kbit/s pkt/s  B/pkt lost    mean     max"
+			"   /pkt  ns/B  rtt us\r\n");
+	for (i = 0; i < sizeof(__bench_sizes) / sizeof(__bench_sizes[0]);
+			i++) {
+		__bench_len = __bench_sizes[i];
+		for (__bench_slip = 0; __bench_slip < 2; __bench_slip++) {
+			__bench_delim = __bench_slip ? __BENCH_END : __BENCH_FLAG;
+			for (__bench_errors = 0; __bench_errors < 2;
+					__bench_errors++) {
+				__bench_frames = 0;
+				__bench_row();
+#if SIO_FRAME_READ
+				__bench_frames = 1;
+				__bench_row();
+#endif
+			}
+		}
+	}
+}
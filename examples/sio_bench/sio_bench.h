@@ -0,0 +1,41 @@
+#ifndef __SIO_BENCH_H__
+#define __SIO_BENCH_H__
+
+#include "lwip/opt.h"
+
+/** Datagrams sent per run */
+#ifndef SIO_BENCH_PACKETS
+# define SIO_BENCH_PACKETS 256
+#endif
+
+/** Bulk runs per row, the CPU time being that of the fastest */
+#ifndef SIO_BENCH_REPEAT
+# define SIO_BENCH_REPEAT 3
+#endif
+
+/** Bit rate of the simulated link, 8N1 taking 10 bits a byte */
+#ifndef SIO_BENCH_BPS
+# define SIO_BENCH_BPS 115200
+#endif
+
+/** In the runs with errors, one bit in this many bytes on average is
+ * flipped on the wire */
+#ifndef SIO_BENCH_ERRORS
+# define SIO_BENCH_ERRORS 10000
+#endif
+
+/** Read a free running 32-bit cycle counter, to time the CPU */
+#ifndef SIO_BENCH_CYCLES
+# define SIO_BENCH_CYCLES() TASK_PROF_CYCLES()
+#endif
+
+/** Rate of SIO_BENCH_CYCLES() */
+#ifndef SIO_BENCH_HZ
+# define SIO_BENCH_HZ 72000000UL
+#endif
+
+/** Run the benchmark and print the results, from a task, on serial devices
+ * 0 and 1 which nothing else opened */
+void sio_bench(void);
+
+#endif /* __SIO_BENCH_H__ */
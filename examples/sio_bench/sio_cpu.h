@@ -0,0 +1,35 @@
+#ifndef __SIO_CPU_H__
+#define __SIO_CPU_H__
+
+/* The UARTs of sio_bench.c in place of the board's: devices 0 and 1 are
+ * joined by a simulated link, which the benchmark clocks and runs the
+ * interrupts of. Put this directory ahead of examples/ on the include path. */
+struct sio_bench_uart {
+	INT8U	rdr;	/* receive register */
+	INT8U	rxne;	/* rdr holds a byte */
+	INT8U	tdr;	/* byte being sent */
+	INT8U	tc;	/* the transmitter is idle */
+	INT8U	rxie, txie;
+	INT32U	taken;	/* bytes read from rdr */
+	INT32U	ends;	/* frame ends among them */
+	INT8U	last;	/* last byte taken */
+	INT32U	sent;	/* bytes which left the transmitter */
+};
+
+extern struct sio_bench_uart sio_bench_uart[2];
+
+INT8U sio_bench_rx(struct sio_bench_uart *u);
+void sio_bench_tx(struct sio_bench_uart *u, INT8U c);
+
+#define sio_bench_dev(fd) (&sio_bench_uart[sio_devnum(fd)])
+
+#define sio_rx_ok(fd) (sio_bench_dev(fd)->rxne)
+#define sio_rx(fd) sio_bench_rx(sio_bench_dev(fd))
+#define sio_tx_ok(fd) (sio_bench_dev(fd)->tc)
+#define sio_tx(fd, c) sio_bench_tx(sio_bench_dev(fd), c)
+#define sio_enable_tx_irq(fd) (sio_bench_dev(fd)->txie = 1)
+#define sio_disable_tx_irq(fd) (sio_bench_dev(fd)->txie = 0)
+#define sio_enable_rx_irq(fd) (sio_bench_dev(fd)->rxie = 1)
+#define sio_disable_rx_irq(fd) (sio_bench_dev(fd)->rxie = 0)
+
+#endif /* __SIO_CPU_H__ */
@@ -3,13 +3,27 @@
 
 #include "stm32f10x_usart.h"
 
-#define sio_rx_ok(fd) (USART_GetFlagStatus(USART2, USART_FLAG_RXNE) == SET)
-#define sio_rx(fd) USART_ReceiveData(USART2)
-#define sio_tx_ok(fd) (USART_GetFlagStatus(USART2, USART_FLAG_TC) == SET)
-#define sio_tx(fd, c) USART_SendData(USART2, c)
-#define sio_enable_tx_irq(fd) USART_ITConfig(USART2, USART_IT_TC, ENABLE)
-#define sio_disable_tx_irq(fd) USART_ITConfig(USART2, USART_IT_TC, DISABLE)
-#define sio_enable_rx_irq(fd) USART_ITConfig(USART2, USART_IT_RXNE, ENABLE)
-#define sio_disable_rx_irq(fd) USART_ITConfig(USART2, USART_IT_RXNE, DISABLE)
+/* Device 0 is USART2, device 1 USART3, sio_devnum() is in arch/sio_arch.h */
+#define sio_usart(fd) (sio_devnum(fd) == 0 ? USART2 : USART3)
+
+#define sio_rx_ok(fd) (USART_GetFlagStatus(sio_usart(fd), USART_FLAG_RXNE) == SET)
+#define sio_rx(fd) USART_ReceiveData(sio_usart(fd))
+#define sio_tx_ok(fd) (USART_GetFlagStatus(sio_usart(fd), USART_FLAG_TC) == SET)
+#define sio_tx(fd, c) USART_SendData(sio_usart(fd), c)
+#if SIO_LOCKFREE
+/* With no lock around them, the enable bits of CR1 are written one at a time
+ * through the bit-band alias rather than read, modified and written back */
+#define __sio_cr1_bit(fd, bit) (*(volatile uint32_t *)(0x42000000 + \
+	(((uint32_t)&sio_usart(fd)->CR1 - 0x40000000) << 5) + ((bit) << 2)))
+#define sio_enable_tx_irq(fd) (__sio_cr1_bit(fd, 6) = 1)	/* TCIE */
+#define sio_disable_tx_irq(fd) (__sio_cr1_bit(fd, 6) = 0)
+#define sio_enable_rx_irq(fd) (__sio_cr1_bit(fd, 5) = 1)	/* RXNEIE */
+#define sio_disable_rx_irq(fd) (__sio_cr1_bit(fd, 5) = 0)
+#else
+#define sio_enable_tx_irq(fd) USART_ITConfig(sio_usart(fd), USART_IT_TC, ENABLE)
+#define sio_disable_tx_irq(fd) USART_ITConfig(sio_usart(fd), USART_IT_TC, DISABLE)
+#define sio_enable_rx_irq(fd) USART_ITConfig(sio_usart(fd), USART_IT_RXNE, ENABLE)
+#define sio_disable_rx_irq(fd) USART_ITConfig(sio_usart(fd), USART_IT_RXNE, DISABLE)
+#endif
 
 #endif /* __SIO_CPU_H__ */
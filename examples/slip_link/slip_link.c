@@ -0,0 +1,33 @@
+#include "slip_link.h"
+
+#include "lwip/tcpip.h"
+#include "netif/sioslip.h"
+
+static struct sioslip __slip = { SLIP_LINK_DEVNUM };
+static struct netif __slip_netif;
+
+/* Called in the tcpip thread */
+static void slip_link_start(void *arg)
+{
+	ip_addr_t addr, mask, peer;
+
+	addr.addr = ipaddr_addr(SLIP_LINK_ADDR);
+	peer.addr = ipaddr_addr(SLIP_LINK_PEER);
+	IP4_ADDR(&mask, 255, 255, 255, 252);
+	if (netif_add(&__slip_netif, &addr, &mask, &peer, &__slip,
+				sioslip_init, tcpip_input) == NULL) {
+		printf("slip: no serial device %u\r\n", SLIP_LINK_DEVNUM);
+		return;
+	}
+	netif_set_up(&__slip_netif);
+	printf("slip: %s", SLIP_LINK_ADDR);
+	printf(" <-> %s\r\n", SLIP_LINK_PEER);
+}
+
+void slip_link_init(void)
+{
+	err_t err;
+
+	err = tcpip_callback(slip_link_start, NULL);
+	LWIP_ASSERT("tcpip_callback", err == ERR_OK);
+}
@@ -0,0 +1,21 @@
+#ifndef __SLIP_LINK_H__
+#define __SLIP_LINK_H__
+
+/** Serial device of the link, the USART of the second modem by default */
+#ifndef SLIP_LINK_DEVNUM
+# define SLIP_LINK_DEVNUM 1
+#endif
+
+/** Addresses of this end and of the peer */
+#ifndef SLIP_LINK_ADDR
+# define SLIP_LINK_ADDR "192.168.5.2"
+#endif
+
+#ifndef SLIP_LINK_PEER
+# define SLIP_LINK_PEER "192.168.5.1"
+#endif
+
+/** Bring the link up, once tcpip_init() is done */
+void slip_link_init(void);
+
+#endif /* __SLIP_LINK_H__ */
@@ -4,6 +4,10 @@
 #include "lwip/netdb.h"
 #include "lwip/err.h"
 #include "lwip/dns.h"
+#include "lwip/udp.h"
+#include "lwip/tcpip.h"
+#include "arch/resolv.h"
+#include "stun.h"
 
 struct stun_header {
 	uint16_t	type;
@@ -25,9 +29,9 @@ struct stun_attr_header {
 	}		value;
 };
 
-void stun_task(void *p_arg)
+/* One Binding Request, blocking for up to 3 s */
+static void stun_query(void *arg)
 {
-	struct hostent *ent;
 	struct sockaddr_in addr;
 	int sock;
 	uint32_t buf[50];
@@ -35,57 +39,167 @@ void stun_task(void *p_arg)
 	struct stun_attr_header *attr_hdr;
 	int timeo = 3000;
 	ip_addr_t ip;
+	err_t err;
+
+	printf("resolving\r\n");
+	err = resolv_query("stun.stunprotocol.org", &ip, NULL, NULL);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	if (err == ERR_OK) {
+		printf("resolved\r\n");
+		addr.sin_addr.s_addr = ip.addr;
+	} else {
+		printf("failed to resolve\r\n");
+		addr.sin_addr.s_addr = inet_addr("107.23.150.92");
+	}
+	addr.sin_port = htons(3478);
+
+	sock = socket(PF_INET, SOCK_DGRAM, 0);
+	LWIP_ASSERT("socket", sock >= 0);
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeo,
+			sizeof(timeo));
+	connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+
+	stun_hdr = (void *)buf;
+	stun_hdr->type = htons(1);
+	stun_hdr->length = htons(0);
+	stun_hdr->transaction_id[0] = rand();
+
+	printf("sending\r\n");
+	send(sock, buf, 20, 0);
+	printf("sent\r\n");
+	if (recv(sock, buf, 100, 0) < 0) {
+		close(sock);
+		return;
+	}
+	printf("received\r\n");
+
+	LWIP_ASSERT("recv", ntohs(stun_hdr->type) == 0x101);
+	for (attr_hdr = (void *)(stun_hdr + 1); ((uint8_t *)attr_hdr) < ((uint8_t *)(stun_hdr + 1) + ntohs(stun_hdr->length)); attr_hdr = (struct stun_attr_header *)(((uint8_t *)attr_hdr) + 4 + ntohs(attr_hdr->length))) {
+		if (ntohs(attr_hdr->type) == 1) {
+			LWIP_ASSERT("type", ntohs(attr_hdr->length) == 8);
+			LWIP_ASSERT("family", attr_hdr->value.addr.family == 1);
+			printf("%s:%hu\n", inet_ntoa(attr_hdr->value.addr.addr),
+					ntohs(attr_hdr->value.addr.port));
+		}
+	}
+
+	close(sock);
+}
+
+static void stun_init(void)
+{
+	ip_addr_t ip;
 
 	ip.addr = inet_addr("8.8.8.8");
 	dns_setserver(0, &ip);
 
 	srand(OSTimeGet());
-	while (1) {
-		OSTimeDly(10 * OS_TICKS_PER_SEC);
-		printf("resolving\r\n");
-		ent = gethostbyname("stun.stunprotocol.org");
-
-		memset(&addr, 0, sizeof(addr));
-		addr.sin_family = AF_INET;
-		if (ent) {
-			printf("resolved\r\n");
-			memcpy(&addr.sin_addr.s_addr, ent->h_addr, 4);
-		} else {
-			printf("failed to resolve\r\n");
-			addr.sin_addr.s_addr = inet_addr("107.23.150.92");
-		}
-		addr.sin_port = htons(3478);
-
-		sock = socket(PF_INET, SOCK_DGRAM, 0);
-		LWIP_ASSERT("socket", sock >= 0);
-		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeo,
-				sizeof(timeo));
-		connect(sock, (struct sockaddr *)&addr, sizeof(addr));
-
-		stun_hdr = (void *)buf;
-		stun_hdr->type = htons(1);
-		stun_hdr->length = htons(0);
-		stun_hdr->transaction_id[0] = rand();
-
-		printf("sending\r\n");
-		send(sock, buf, 20, 0);
-		printf("sent\r\n");
-		if (recv(sock, buf, 100, 0) < 0) {
-			close(sock);
+}
+
+#if TIMER_WHEEL
+/* The same query with the raw API, in the tcpip thread, where nothing may
+ * block */
+static struct udp_pcb *__stun_pcb;
+static struct timer_wheel_entry __stun_timer;
+
+/* Print the MAPPED-ADDRESS of a Binding Response */
+static void stun_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+		ip_addr_t *addr, u16_t port)
+{
+	u8_t buf[100], *a;
+	u16_t len, off, type, alen;
+
+	len = pbuf_copy_partial(p, buf, sizeof(buf), 0);
+	pbuf_free(p);
+	if (len < 20 || buf[0] != 0x01 || buf[1] != 0x01)
+		return;
+	printf("received\r\n");
+	for (off = 20; off + 4 <= len; off += 4 + alen) {
+		type = buf[off] << 8 | buf[off + 1];
+		alen = buf[off + 2] << 8 | buf[off + 3];
+		if (type != 1 || alen != 8 || off + 12 > len)
 			continue;
-		}
-		printf("received\r\n");
-
-		LWIP_ASSERT("recv", ntohs(stun_hdr->type) == 0x101);
-		for (attr_hdr = (void *)(stun_hdr + 1); ((uint8_t *)attr_hdr) < ((uint8_t *)(stun_hdr + 1) + ntohs(stun_hdr->length)); attr_hdr = (struct stun_attr_header *)(((uint8_t *)attr_hdr) + 4 + ntohs(attr_hdr->length))) {
-			if (ntohs(attr_hdr->type) == 1) {
-				LWIP_ASSERT("type", ntohs(attr_hdr->length) == 8);
-				LWIP_ASSERT("family", attr_hdr->value.addr.family == 1);
-				printf("%s:%hu\n", inet_ntoa(attr_hdr->value.addr.addr),
-						ntohs(attr_hdr->value.addr.port));
-			}
-		}
+		a = &buf[off + 4];
+		if (a[1] == 1)
+			printf("%u.%u.%u.%u:%u\n", a[4], a[5], a[6], a[7],
+					a[2] << 8 | a[3]);
+	}
+}
 
-		close(sock);
+/* Called by resolv_query(), ip is NULL if the name didn't resolve */
+static void stun_send(const char *name, const ip_addr_t *ip, void *arg)
+{
+	ip_addr_t to;
+	struct pbuf *p;
+	u8_t *hdr;
+	u8_t i;
+
+	if (ip == NULL) {
+		printf("failed to resolve\r\n");
+		to.addr = inet_addr("107.23.150.92");
+	} else {
+		ip_addr_copy(to, *ip);
+	}
+	p = pbuf_alloc(PBUF_TRANSPORT, 20, PBUF_RAM);
+	if (p == NULL)
+		return;
+	hdr = p->payload;
+	hdr[0] = 0x00;	/* Binding Request */
+	hdr[1] = 0x01;
+	hdr[2] = 0x00;	/* no attributes */
+	hdr[3] = 0x00;
+	for (i = 4; i < 20; i++)
+		hdr[i] = rand();
+	printf("sending\r\n");
+	udp_sendto(__stun_pcb, p, &to, 3478);
+	pbuf_free(p);
+}
+
+/* The timer, an answer arriving after the next query is still printed. The
+ * cache of resolv_query() answers most ticks without a lookup. */
+static void stun_tick(void *arg)
+{
+	ip_addr_t ip;
+
+	switch (resolv_query("stun.stunprotocol.org", &ip, stun_send, NULL)) {
+	case ERR_OK:
+		stun_send(NULL, &ip, NULL);
+		break;
+	case ERR_INPROGRESS:
+		break;
+	default:
+		stun_send(NULL, NULL, NULL);
+		break;
+	}
+}
+
+/* Called in the tcpip thread */
+static void stun_open(void *arg)
+{
+	stun_init();
+	__stun_pcb = udp_new();
+	LWIP_ASSERT("udp_new", __stun_pcb);
+	udp_recv(__stun_pcb, stun_recv, NULL);
+	timer_wheel_setup(&__stun_timer, stun_tick, NULL, TIMER_WHEEL_TCPIP);
+	timer_wheel_start(&__stun_timer, 10000, 10000);
+}
+
+void stun_start(void)
+{
+	err_t err;
+
+	err = tcpip_callback(stun_open, NULL);
+	LWIP_ASSERT("tcpip_callback", err == ERR_OK);
+}
+#endif
+
+void stun_task(void *p_arg)
+{
+	stun_init();
+	while (1) {
+		OSTimeDly(10 * OS_TICKS_PER_SEC);
+		stun_query(NULL);
 	}
 }
@@ -1,6 +1,14 @@
 #ifndef __STUN_H__
 #define __STUN_H__
 
+#include "arch/timer_wheel.h"
+
 void stun_task(void *p_arg);
 
+#if TIMER_WHEEL
+/** Query every 10 s from a timer in the tcpip thread, with the raw API,
+ * instead of stun_task() */
+void stun_start(void);
+#endif
+
 #endif /* __STUN_H__ */
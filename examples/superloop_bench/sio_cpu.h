@@ -0,0 +1,28 @@
+#ifndef __SIO_CPU_H__
+#define __SIO_CPU_H__
+
+/* The USART of superloop_bench.c in place of the board's: device 0 is the
+ * link to a simulated peer, which the benchmark clocks and runs the
+ * interrupts of. Put this directory ahead of examples/ on the include path. */
+struct superloop_bench_uart {
+	INT8U	rdr;	/* receive register */
+	INT8U	rxne;	/* rdr holds a byte */
+	INT8U	tc;	/* the transmitter is idle */
+	INT8U	rxie, txie;
+};
+
+extern struct superloop_bench_uart superloop_bench_uart;
+
+INT8U superloop_bench_rx(void);
+void superloop_bench_tx(INT8U c);
+
+#define sio_rx_ok(fd) (superloop_bench_uart.rxne)
+#define sio_rx(fd) superloop_bench_rx()
+#define sio_tx_ok(fd) (superloop_bench_uart.tc)
+#define sio_tx(fd, c) superloop_bench_tx(c)
+#define sio_enable_tx_irq(fd) (superloop_bench_uart.txie = 1)
+#define sio_disable_tx_irq(fd) (superloop_bench_uart.txie = 0)
+#define sio_enable_rx_irq(fd) (superloop_bench_uart.rxie = 1)
+#define sio_disable_rx_irq(fd) (superloop_bench_uart.rxie = 0)
+
+#endif /* __SIO_CPU_H__ */
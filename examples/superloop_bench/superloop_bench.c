@@ -0,0 +1,399 @@
+#include "superloop_bench.h"
+
+#include "lwip/opt.h"
+#include "lwip/sio.h"
+#include "arch/sio_arch.h"
+#include "ucos_ii.h"
+#include "sio_cpu.h"
+
+#if NO_SYS
+# include "lwip/init.h"
+# include "lwip/timers.h"
+# include "arch/superloop.h"
+# include "ppp.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#define __BENCH_FLAG	0x7e
+#define __BENCH_NEVER	(~0ULL)
+#define __BENCH_TICK	(1000000000ULL / OS_TICKS_PER_SEC)	/* ns */
+#define __BENCH_BYTE	(10 * 1000000000ULL / SUPERLOOP_BENCH_BPS)
+#define __BENCH_MAX	1000	/* largest UDP payload */
+/* A post readying a task and the switch to it, in the threaded build */
+#define __BENCH_HANDOFF	((SUPERLOOP_BENCH_POST_CYCLES + \
+	SUPERLOOP_BENCH_SWITCH_CYCLES) * 1000000000ULL / SUPERLOOP_BENCH_CPU_HZ)
+/* Flags, protocol field, IP and UDP headers, payload and FCS: a PPP frame
+ * with the address and control fields compressed, without escapes */
+#define __BENCH_FRAME(len) (1 + 1 + 20 + 8 + (len) + 2 + 1)
+
+struct superloop_bench_uart superloop_bench_uart;
+
+/* The kernel, as much of it as sio.c and superloop.c use, for the one task
+ * which runs lwIP's input: a pend or a delay runs the link until it ends */
+volatile INT32U OSTime;
+INT8U OSPrioCur;
+static OS_EVENT __bench_sem[4];
+static u8_t __bench_sems;
+
+static struct {
+	sio_fd_t		fd;
+	unsigned long long	now;		/* ns */
+	unsigned long long	tick;		/* next tick interrupt */
+	unsigned long long	rx;		/* next byte of the peer lands */
+	unsigned long long	tx;		/* the transmitter is done */
+	unsigned long long	cpu;		/* the task is done working */
+	unsigned long long	start;		/* the peer's datagram started */
+	unsigned long long	end;		/* and landed whole */
+	u8_t			req[__BENCH_FRAME(__BENCH_MAX)];
+	u8_t			reply[__BENCH_FRAME(__BENCH_MAX)];
+	u32_t			len, pos;	/* of the frame the peer sends */
+	u32_t			in;		/* bytes of the frame being read */
+	u32_t			sent, replied;
+	u32_t			wakeups;	/* of the reader */
+	u32_t			writes;		/* of the writer */
+	u8_t			writing;
+	unsigned long long	lat_sum, lat_max;
+	u32_t			random;
+	volatile u8_t		stop;
+} __bench;
+
+static const u32_t __bench_sizes[] = { 5, 200, 1000 };
+static u32_t __bench_payload;
+
+/* xorshift32 */
+static u32_t __bench_random(void)
+{
+	u32_t x = __bench.random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return __bench.random = x;
+}
+
+/* The peer's next datagram, from 'start' plus up to a tick */
+static void __bench_request(unsigned long long start)
+{
+	u32_t i;
+
+	__bench.len = __BENCH_FRAME(__bench_payload);
+	__bench.req[0] = __BENCH_FLAG;
+	for (i = 1; i < __bench.len - 1; i++)
+		__bench.req[i] = (__bench.sent + i) & 0x3f;
+	__bench.req[__bench.len - 1] = __BENCH_FLAG;
+	__bench.pos = 0;
+	__bench.start = start + __bench_random() % __BENCH_TICK;
+	__bench.rx = __bench.start + __BENCH_BYTE;
+}
+
+INT8U superloop_bench_rx(void)
+{
+	superloop_bench_uart.rxne = 0;
+	return superloop_bench_uart.rdr;
+}
+
+void superloop_bench_tx(INT8U c)
+{
+	superloop_bench_uart.tc = 0;
+	__bench.tx = __bench.now + __BENCH_BYTE;
+}
+
+/* On to the next tick or byte on the link, whose interrupts run as the
+ * NVIC would. While the receive register is full, RTS is off and the
+ * peer's byte waits, as with RTS/CTS flow control. */
+static void __bench_step(void)
+{
+	struct superloop_bench_uart *u = &superloop_bench_uart;
+	unsigned long long t;
+
+	t = LWIP_MIN(LWIP_MIN(__bench.tick, __bench.cpu),
+			LWIP_MIN(__bench.rx, __bench.tx));
+	LWIP_ASSERT("the task blocks for good", t != __BENCH_NEVER);
+	__bench.now = t;
+	if (__bench.tick == t) {
+		OSTime++;
+		__bench.tick += __BENCH_TICK;
+	}
+	if (__bench.rx == t && u->rxne) {
+		__bench.rx += __BENCH_BYTE;
+	} else if (__bench.rx == t) {
+		u->rdr = __bench.req[__bench.pos++];
+		u->rxne = 1;
+		if (__bench.pos < __bench.len) {
+			__bench.rx += __BENCH_BYTE;
+		} else {
+			__bench.end = t;
+			if (++__bench.sent < SUPERLOOP_BENCH_PACKETS)
+				__bench_request(__bench.start +
+					SUPERLOOP_BENCH_PERIOD * 1000000ULL);
+			else
+				__bench.rx = __BENCH_NEVER;
+		}
+	}
+	if (__bench.tx == t) {
+		u->tc = 1;
+		__bench.tx = __BENCH_NEVER;
+	}
+	if (u->rxie && u->rxne)
+		sio_rx_complete(__bench.fd);
+	if (u->txie && u->tc)
+		sio_tx_complete(__bench.fd);
+}
+
+#if !NO_SYS
+/* The task works for 'ns', while the link and the tick go on */
+static void __bench_work(unsigned long long ns)
+{
+	__bench.cpu = __bench.now + ns;
+	while (__bench.now < __bench.cpu)
+		__bench_step();
+	__bench.cpu = __BENCH_NEVER;
+}
+#endif
+
+OS_CPU_SR OS_CPU_SR_Save(void)
+{
+	return 0;
+}
+
+void OS_CPU_SR_Restore(OS_CPU_SR sr)
+{
+}
+
+void OSSchedLock(void)
+{
+}
+
+void OSSchedUnlock(void)
+{
+}
+
+INT32U OSTimeGet(void)
+{
+	return OSTime;
+}
+
+void OSTimeDly(INT32U ticks)
+{
+	INT32U end = OSTime + ticks;
+
+	while (OSTime != end)
+		__bench_step();
+	__bench.wakeups++;
+}
+
+OS_EVENT *OSSemCreate(INT16U cnt)
+{
+	OS_EVENT *e;
+
+	if (__bench_sems == sizeof(__bench_sem) / sizeof(__bench_sem[0]))
+		return NULL;
+	e = &__bench_sem[__bench_sems++];
+	e->OSEventCnt = cnt;
+	return e;
+}
+
+void OSSemSet(OS_EVENT *e, INT16U cnt, INT8U *err)
+{
+	e->OSEventCnt = cnt;
+	*err = OS_ERR_NONE;
+}
+
+INT16U OSSemAccept(OS_EVENT *e)
+{
+	INT16U cnt = e->OSEventCnt;
+
+	if (cnt > 0)
+		e->OSEventCnt--;
+	return cnt;
+}
+
+INT8U OSSemPost(OS_EVENT *e)
+{
+	e->OSEventCnt++;
+	return OS_ERR_NONE;
+}
+
+void OSSemPend(OS_EVENT *e, INT32U timeout, INT8U *err)
+{
+	INT32U end = OSTime + timeout;
+
+	*err = OS_ERR_NONE;
+	if (e->OSEventCnt > 0) {
+		e->OSEventCnt--;
+		return;
+	}
+	while (e->OSEventCnt == 0) {
+		if (timeout && OSTime == end) {
+			*err = OS_ERR_TIMEOUT;
+			break;
+		}
+		__bench_step();
+	}
+	if (*err == OS_ERR_NONE)
+		e->OSEventCnt--;
+	if (__bench.writing)
+		__bench.writes++;
+	else
+		__bench.wakeups++;
+}
+
+INT8U OSSemPendAbort(OS_EVENT *e, INT8U opt, INT8U *err)
+{
+	*err = OS_ERR_NONE;
+	return 0;
+}
+
+/* lwIP's input, as much as the benchmark needs: each frame is a datagram,
+ * echoed as soon as its closing flag is read */
+static void __bench_input(const u8_t *data, u32_t len)
+{
+	unsigned long long lat;
+	u32_t i;
+
+	for (i = 0; i < len; i++) {
+		if (data[i] != __BENCH_FLAG) {
+			__bench.in++;
+			continue;
+		}
+		if (__bench.in == 0)
+			continue;
+#if !NO_SYS
+		/* to the tcpip thread, the echo task and the tcpip thread */
+		__bench_work(3 * __BENCH_HANDOFF);
+#endif
+		lat = __bench.now - __bench.end;
+		__bench.lat_sum += lat;
+		if (lat > __bench.lat_max)
+			__bench.lat_max = lat;
+		__bench.in = 0;
+		if (++__bench.replied == SUPERLOOP_BENCH_PACKETS)
+			__bench.stop = 1;
+		/* the writer waits for room in the TX ring, the tcpip
+		 * thread in the threaded build */
+		__bench.writing = 1;
+		sio_write(__bench.fd, __bench.reply,
+				__BENCH_FRAME(__bench_payload));
+		__bench.writing = 0;
+	}
+}
+
+#if NO_SYS
+void lwip_init(void)
+{
+}
+
+void sys_check_timeouts(void)
+{
+}
+
+void pppos_input(int pd, u_char *data, int len)
+{
+	__bench_input(data, len);
+}
+#else
+/* Never called, as nothing aborts a pend */
+void sys_thread_free(INT8U prio)
+{
+}
+
+/* lwIP's PPP thread, which reads until the frames it passes to the tcpip
+ * thread, and on to the echo task, come back as replies */
+static void __bench_thread(void)
+{
+	static u8_t buf[SUPERLOOP_BENCH_READ_SIZE];
+	u32_t n;
+
+	while (!__bench.stop) {
+		n = sio_read(__bench.fd, buf, sizeof(buf));
+		__bench_input(buf, n);
+	}
+}
+#endif
+
+static unsigned long __bench_us(unsigned long long ns)
+{
+	return (unsigned long)(ns / 1000);
+}
+
+static void __bench_row(void)
+{
+	unsigned long long begin = __bench.now, ns;
+	u32_t wakeups = __bench.wakeups, writes = __bench.writes;
+
+	__bench.sent = __bench.replied = 0;
+	__bench.in = 0;
+	__bench.lat_sum = __bench.lat_max = 0;
+	__bench.stop = 0;
+	__bench_request(__bench.now);
+#if NO_SYS
+	superloop_run(&__bench.stop);
+#else
+	__bench_thread();
+#endif
+	ns = __bench.now - begin;
+	wakeups = __bench.wakeups - wakeups;
+	writes = __bench.writes - writes;
+
+#define __BENCH_PER_PKT(n) (unsigned long)((n) / SUPERLOOP_BENCH_PACKETS), \
+	(unsigned long)((n) * 10 / SUPERLOOP_BENCH_PACKETS % 10)
+	printf("%5lu %7lu %6lu.%lu %6lu.%lu %7lu %7lu\r\n",
+			(unsigned long)__bench_payload,
+			(unsigned long)(wakeups * 1000000000ULL / ns),
+			__BENCH_PER_PKT(wakeups), __BENCH_PER_PKT(writes),
+			__bench_us(__bench.lat_sum / SUPERLOOP_BENCH_PACKETS),
+			__bench_us(__bench.lat_max));
+}
+
+void superloop_bench(void)
+{
+	u8_t i;
+
+	__bench.random = 1;
+	__bench.tick = __BENCH_TICK;
+	__bench.rx = __bench.tx = __bench.cpu = __BENCH_NEVER;
+	memset(__bench.reply, 0x55, sizeof(__bench.reply));
+	__bench.reply[0] = __BENCH_FLAG;
+	memset(&superloop_bench_uart, 0, sizeof(superloop_bench_uart));
+	superloop_bench_uart.tc = 1;
+	superloop_bench_uart.rxie = 1;
+#if NO_SYS
+	superloop_init();
+	__bench.fd = sio_open(0);
+	LWIP_ASSERT("sio_open", __bench.fd != NULL);
+	superloop_add_ppp(__bench.fd, 0);
+	printf("superloop: NO_SYS, polls every %u tick, reads of %u bytes",
+			SUPERLOOP_IDLE_TICKS, SUPERLOOP_READ_SIZE);
+#else
+	__bench.fd = sio_open(0);
+	LWIP_ASSERT("sio_open", __bench.fd != NULL);
+# if SIO_FRAME_READ
+	sio_frame_mode(__bench.fd, 1, __BENCH_FLAG);
+	printf("superloop: threaded, frame reads of %u bytes",
+			SUPERLOOP_BENCH_READ_SIZE);
+# else
+	printf("superloop: threaded, byte reads of %u bytes",
+			SUPERLOOP_BENCH_READ_SIZE);
+# endif
+#endif
+#if !NO_SYS
+	printf(", handoffs of %u+%u cycles at %lu MHz",
+			SUPERLOOP_BENCH_POST_CYCLES,
+			SUPERLOOP_BENCH_SWITCH_CYCLES,
+			(unsigned long)(SUPERLOOP_BENCH_CPU_HZ / 1000000));
+#endif
+	printf(", %u ticks/s, a datagram every %u ms, %lu bit/s 8N1\r\n",
+			OS_TICKS_PER_SEC, SUPERLOOP_BENCH_PERIOD,
+			(unsigned long)SUPERLOOP_BENCH_BPS);
+	printf("         reader wakeups  writer  turnaround us\r\n");
+	printf("bytes      /s   /pkt    /pkt    mean     max\r\n");
+	for (i = 0; i < sizeof(__bench_sizes) / sizeof(__bench_sizes[0]);
+			i++) {
+		__bench_payload = __bench_sizes[i];
+		__bench.reply[__BENCH_FRAME(__bench_payload) - 1] =
+			__BENCH_FLAG;
+		__bench_row();
+	}
+}
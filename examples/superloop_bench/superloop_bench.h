@@ -0,0 +1,49 @@
+#ifndef __SUPERLOOP_BENCH_H__
+#define __SUPERLOOP_BENCH_H__
+
+#include "lwip/opt.h"
+
+/** Datagrams echoed per run */
+#ifndef SUPERLOOP_BENCH_PACKETS
+# define SUPERLOOP_BENCH_PACKETS 500
+#endif
+
+/** Milliseconds between the datagrams of the peer, each coming up to a tick
+ * later so that they fall at every phase of the tick */
+#ifndef SUPERLOOP_BENCH_PERIOD
+# define SUPERLOOP_BENCH_PERIOD 200
+#endif
+
+/** Bit rate of the simulated link, 8N1 taking 10 bits a byte */
+#ifndef SUPERLOOP_BENCH_BPS
+# define SUPERLOOP_BENCH_BPS 115200
+#endif
+
+/** Bytes the threaded build's PPP thread reads at a time, as superloop.c
+ * does */
+#ifndef SUPERLOOP_BENCH_READ_SIZE
+# define SUPERLOOP_BENCH_READ_SIZE 64
+#endif
+
+/** The threaded build hands each datagram from the PPP thread to the tcpip
+ * thread, on to the echo task and back to the tcpip thread before the reply
+ * is written: three mbox posts, each readying a task, and the context
+ * switch to it. The host doesn't schedule them, so each costs these cycles
+ * of a SUPERLOOP_BENCH_CPU_HZ clock. The defaults are estimates for
+ * uC/OS-II on a Cortex-M3; on the board, TASK_PROF measures a post and its
+ * switch as the ready-to-run latency of the task readied. */
+#ifndef SUPERLOOP_BENCH_CPU_HZ
+# define SUPERLOOP_BENCH_CPU_HZ 72000000
+#endif
+#ifndef SUPERLOOP_BENCH_POST_CYCLES
+# define SUPERLOOP_BENCH_POST_CYCLES 300
+#endif
+#ifndef SUPERLOOP_BENCH_SWITCH_CYCLES
+# define SUPERLOOP_BENCH_SWITCH_CYCLES 250
+#endif
+
+/** Run the benchmark and print the results, on a host in place of the
+ * kernel */
+void superloop_bench(void);
+
+#endif /* __SUPERLOOP_BENCH_H__ */
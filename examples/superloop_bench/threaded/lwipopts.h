@@ -0,0 +1,48 @@
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/* The options of examples/superloop_node with the tcpip and PPP threads and
+ * the socket API, for superloop_bench to compare the two builds. Build with
+ * this directory before examples/superloop_bench in the include path. */
+
+#define NO_SYS			0
+#define LWIP_NETCONN		1
+#define LWIP_SOCKET		1
+
+#define TCPIP_THREAD_PRIO	12
+#define TCPIP_THREAD_STACKSIZE	128
+#define TCPIP_MBOX_SIZE		8
+#define DEFAULT_UDP_RECVMBOX_SIZE 4
+#define MEMP_NUM_NETCONN	3
+
+#define PPP_SUPPORT		1
+#define PPPOS_SUPPORT		1
+#define PPP_INPROC_OWNTHREAD	1
+#define PAP_SUPPORT		1
+#define CHAP_SUPPORT		1
+#define PPP_THREAD_PRIO		10
+#define PPP_THREAD_STACKSIZE	128
+#define NUM_PPP			1
+#define SIO_FRAME_READ		1
+
+#define MEM_ALIGNMENT		4
+#define MEM_SIZE		3072
+#define MEMP_NUM_PBUF		8
+#define PBUF_POOL_SIZE		16
+#define PBUF_POOL_BUFSIZE	128
+
+#define LWIP_IPV6	0
+#define LWIP_TCP	0
+#define LWIP_ICMP	1
+#define LWIP_DHCP	0
+
+#define LWIP_UDP		1
+#define UDP_TTL			255
+#define MEMP_NUM_UDP_PCB	3
+
+#define LWIP_DNS	1
+
+#define LWIP_STATS	0
+#define RAM_REPORT	1
+
+#endif /* __LWIPOPTS_H__ */
@@ -0,0 +1,40 @@
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/* The options of a small node without the tcpip thread, see
+ * arch/superloop.h. Build with this directory before examples/ in the
+ * include path. */
+
+#define NO_SYS			1
+#define LWIP_NETCONN		0
+#define LWIP_SOCKET		0
+
+#define PPP_SUPPORT		1
+#define PPPOS_SUPPORT		1
+#define PPP_INPROC_OWNTHREAD	0
+#define PPP_INPROC_MULTITHREADED 0
+#define PAP_SUPPORT		1
+#define CHAP_SUPPORT		1
+#define NUM_PPP			1
+
+#define MEM_ALIGNMENT		4
+#define MEM_SIZE		3072
+#define MEMP_NUM_PBUF		8
+#define PBUF_POOL_SIZE		16
+#define PBUF_POOL_BUFSIZE	128
+
+#define LWIP_IPV6	0
+#define LWIP_TCP	0
+#define LWIP_ICMP	1
+#define LWIP_DHCP	0
+
+#define LWIP_UDP		1
+#define UDP_TTL			255
+#define MEMP_NUM_UDP_PCB	3
+
+#define LWIP_DNS	1
+
+#define LWIP_STATS	0
+#define RAM_REPORT	1
+
+#endif /* __LWIPOPTS_H__ */
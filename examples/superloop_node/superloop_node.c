@@ -0,0 +1,204 @@
+#include "superloop_node.h"
+#include "ucos_ii.h"
+#include "ppp.h"
+
+#include "lwip/udp.h"
+#include "lwip/dns.h"
+#include "lwip/timers.h"
+#include "arch/superloop.h"
+
+#if !NO_SYS
+# error "The node is built with its own lwipopts.h"
+#endif
+
+static struct {
+	sio_fd_t		fd;
+	int			pd;
+	volatile u8_t		down;	/* ends superloop_run() */
+	struct udp_pcb		*echo;
+	struct udp_pcb		*stun;
+	INT8U			buf[80];
+} __node;
+
+static INT32U read_line(INT8U *buf, INT32U size)
+{
+	INT8U c;
+	INT32U len = 0;
+
+	while (size-- > 0) {
+		c = sio_recv(__node.fd);
+		*buf++ = c;
+		len++;
+		if (c == '\n')
+			break;
+	}
+
+	return len;
+}
+
+static void write_str(const char *str)
+{
+	sio_write(__node.fd, (u8_t *)str, strlen(str));
+}
+
+/* Nothing else runs before the link is up, so the chat simply blocks */
+static INT8U at_cmd(const char *cmd)
+{
+	INT32U len;
+
+	write_str("AT");
+	write_str(cmd);
+	write_str("\r\n");
+	while (1) {
+		len = read_line(__node.buf, sizeof(__node.buf));
+		if (len > 2 && memcmp(__node.buf, "OK", 2) == 0)
+			return 0;
+		else if (len > 5 && memcmp(__node.buf, "ERROR", 5) == 0)
+			return 1;
+	}
+}
+
+static INT8U dial(void)
+{
+	INT32U len;
+
+	if (at_cmd("E0") || at_cmd("+CGDCONT=1,\"IP\",\"CMNET\""))
+		return 1;
+	write_str("ATD*99***1#\r\n");
+	while (1) {
+		len = read_line(__node.buf, sizeof(__node.buf));
+		if (len > 7 && memcmp(__node.buf, "CONNECT", 7) == 0)
+			return 0;
+		if ((len > 10 && memcmp(__node.buf, "NO CARRIER", 10) == 0) ||
+		    (len > 5 && memcmp(__node.buf, "ERROR", 5) == 0) ||
+		    (len > 4 && memcmp(__node.buf, "BUSY", 4) == 0))
+			return 1;
+	}
+}
+
+static void echo_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+		ip_addr_t *addr, u16_t port)
+{
+	udp_sendto(pcb, p, addr, port);
+	pbuf_free(p);
+}
+
+/* Print the MAPPED-ADDRESS of a Binding Response, see RFC 3489 */
+static void stun_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+		ip_addr_t *addr, u16_t port)
+{
+	u8_t buf[100], *a;
+	u16_t len, off, type, alen;
+
+	len = pbuf_copy_partial(p, buf, sizeof(buf), 0);
+	pbuf_free(p);
+	if (len < 20 || buf[0] != 0x01 || buf[1] != 0x01)
+		return;
+	for (off = 20; off + 4 <= len; off += 4 + alen) {
+		type = buf[off] << 8 | buf[off + 1];
+		alen = buf[off + 2] << 8 | buf[off + 3];
+		if (type != 1 || alen != 8 || off + 12 > len)
+			continue;
+		a = &buf[off + 4];
+		if (a[1] == 1)
+			printf("%u.%u.%u.%u:%u\r\n", a[4], a[5], a[6], a[7],
+					a[2] << 8 | a[3]);
+	}
+}
+
+static void stun_send(const char *name, ip_addr_t *ip, void *arg)
+{
+	ip_addr_t fallback;
+	struct pbuf *p;
+	u8_t *hdr;
+	u8_t i;
+
+	if (ip == NULL) {
+		fallback.addr = ipaddr_addr("107.23.150.92");
+		ip = &fallback;
+	}
+	p = pbuf_alloc(PBUF_TRANSPORT, 20, PBUF_RAM);
+	if (p == NULL)
+		return;
+	hdr = p->payload;
+	hdr[0] = 0x00;	/* Binding Request */
+	hdr[1] = 0x01;
+	hdr[2] = 0x00;	/* no attributes */
+	hdr[3] = 0x00;
+	for (i = 4; i < 20; i++)
+		hdr[i] = rand();
+	udp_sendto(__node.stun, p, ip, 3478);
+	pbuf_free(p);
+}
+
+static void stun_query(void *arg)
+{
+	ip_addr_t ip;
+
+	switch (dns_gethostbyname("stun.stunprotocol.org", &ip, stun_send,
+				NULL)) {
+	case ERR_OK:
+		stun_send(NULL, &ip, NULL);
+		break;
+	case ERR_INPROGRESS:
+		break;
+	default:
+		stun_send(NULL, NULL, NULL);
+		break;
+	}
+	sys_timeout(SUPERLOOP_NODE_STUN_PERIOD * 1000, stun_query, NULL);
+}
+
+/* Called from superloop_poll(), as everything else */
+static void link_status_cb(void *ctx, int errCode, void *arg)
+{
+	struct ppp_addrs *addrs = arg;
+
+	if (errCode == PPPERR_NONE) {
+		if (addrs->dns1.addr)
+			dns_setserver(0, &addrs->dns1);
+		if (addrs->dns2.addr)
+			dns_setserver(1, &addrs->dns2);
+		sys_timeout(1000, stun_query, NULL);
+	} else {
+		sys_untimeout(stun_query, NULL);
+		__node.down = 1;
+	}
+}
+
+void superloop_node_task(void *p_arg)
+{
+	err_t err;
+
+	superloop_init();
+	pppInit();
+	pppSetAuth(PPPAUTHTYPE_ANY, "cmnet", "cmnet");
+	srand(OSTimeGet());
+
+	__node.echo = udp_new();
+	LWIP_ASSERT("udp_new", __node.echo);
+	udp_bind(__node.echo, IP_ADDR_ANY, 7);
+	udp_recv(__node.echo, echo_recv, NULL);
+	__node.stun = udp_new();
+	LWIP_ASSERT("udp_new", __node.stun);
+	udp_recv(__node.stun, stun_recv, NULL);
+
+	__node.fd = sio_open(0);
+	LWIP_ASSERT("sio_open", __node.fd);
+	while (1) {
+		if (dial()) {
+			OSTimeDly(OS_TICKS_PER_SEC * 3);
+			continue;
+		}
+		__node.down = 0;
+		__node.pd = pppOverSerialOpen(__node.fd, link_status_cb, NULL);
+		LWIP_ASSERT("pppOverSerialOpen", __node.pd >= 0);
+		err = superloop_add_ppp(__node.fd, __node.pd);
+		LWIP_ASSERT("superloop_add_ppp", err == ERR_OK);
+
+		superloop_run(&__node.down);
+
+		superloop_remove_ppp(__node.pd);
+		pppClose(__node.pd);
+	}
+}
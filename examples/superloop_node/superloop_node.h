@@ -0,0 +1,12 @@
+#ifndef __SUPERLOOP_NODE_H__
+#define __SUPERLOOP_NODE_H__
+
+/** Seconds between STUN queries */
+#ifndef SUPERLOOP_NODE_STUN_PERIOD
+# define SUPERLOOP_NODE_STUN_PERIOD 60
+#endif
+
+/** The one task running lwIP, the modem and the applications */
+void superloop_node_task(void *p_arg);
+
+#endif /* __SUPERLOOP_NODE_H__ */
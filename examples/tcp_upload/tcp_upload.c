@@ -0,0 +1,248 @@
+#include "tcp_upload.h"
+#include "ucos_ii.h"
+
+#include "lwip/tcp.h"
+#include "lwip/tcpip.h"
+#include "lwip/sys.h"
+
+/* Segments which may wait for their ACK, as the send buffer allows */
+#define __TCP_UPLOAD_CHUNKS (TCP_SND_BUF / TCP_MSS + 1)
+
+static struct {
+	struct tcp_pcb		*pcb;
+	ip_addr_t		addr;
+	u16_t			port;
+	u32_t			len;
+	u32_t			written;	/* bytes given to tcp_write() */
+	u32_t			acked;
+	u32_t			start;
+	struct {
+		u32_t		end;	/* offset of the byte after the chunk */
+		u32_t		t;	/* when it was written */
+	}			chunk[__TCP_UPLOAD_CHUNKS];
+	u8_t			rd;
+	u8_t			count;
+	u32_t			rtt_sum;
+	struct tcp_upload_result *res;
+	sys_sem_t		done;
+} __tcp_upload;
+
+static u8_t __tcp_upload_buf[TCP_MSS];
+
+/* Report the result once, whichever callback ends the upload first */
+static void __tcp_upload_done(err_t err)
+{
+	struct tcp_upload_result *res = __tcp_upload.res;
+
+	if (res == NULL)
+		return;
+	__tcp_upload.res = NULL;
+	__tcp_upload.pcb = NULL;
+	res->err = err;
+	res->bytes = __tcp_upload.acked;
+	res->ms = sys_now() - __tcp_upload.start;
+	if (res->samples > 0)
+		res->rtt_avg = __tcp_upload.rtt_sum / res->samples;
+	sys_sem_signal(&__tcp_upload.done);
+}
+
+/* Take the callbacks off the pcb before closing or aborting it, so that
+ * nothing of the upload runs for data or ACKs arriving afterwards */
+static void __tcp_upload_detach(struct tcp_pcb *pcb)
+{
+	tcp_arg(pcb, NULL);
+	tcp_err(pcb, NULL);
+	tcp_recv(pcb, NULL);
+	tcp_sent(pcb, NULL);
+}
+
+/* Write as much as the send buffer takes, one segment per write */
+static err_t __tcp_upload_fill(struct tcp_pcb *pcb)
+{
+	u16_t n;
+	u8_t i;
+	err_t err;
+
+	while (__tcp_upload.written < __tcp_upload.len &&
+	       __tcp_upload.count < __TCP_UPLOAD_CHUNKS) {
+		n = LWIP_MIN(__tcp_upload.len - __tcp_upload.written, TCP_MSS);
+		if (tcp_sndbuf(pcb) < n)
+			break;
+		err = tcp_write(pcb, __tcp_upload_buf, n, TCP_WRITE_FLAG_COPY);
+		if (err == ERR_MEM)
+			break; /* until ACKs free some */
+		if (err != ERR_OK)
+			return err;
+		__tcp_upload.written += n;
+		i = (__tcp_upload.rd + __tcp_upload.count) % __TCP_UPLOAD_CHUNKS;
+		__tcp_upload.chunk[i].end = __tcp_upload.written;
+		__tcp_upload.chunk[i].t = sys_now();
+		__tcp_upload.count++;
+	}
+
+	return tcp_output(pcb);
+}
+
+static err_t __tcp_upload_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+	struct tcp_upload_result *res = __tcp_upload.res;
+	u32_t rtt, now = sys_now();
+
+	if (res == NULL)
+		return ERR_OK;
+	err_t err;
+
+	__tcp_upload.acked += len;
+	while (__tcp_upload.count > 0 &&
+	       __tcp_upload.chunk[__tcp_upload.rd].end <= __tcp_upload.acked) {
+		rtt = now - __tcp_upload.chunk[__tcp_upload.rd].t;
+		if (res->samples == 0 || rtt < res->rtt_min)
+			res->rtt_min = rtt;
+		if (rtt > res->rtt_max)
+			res->rtt_max = rtt;
+		__tcp_upload.rtt_sum += rtt;
+		res->samples++;
+		__tcp_upload.rd = (__tcp_upload.rd + 1) % __TCP_UPLOAD_CHUNKS;
+		__tcp_upload.count--;
+	}
+
+	if (__tcp_upload.acked == __tcp_upload.len) {
+		__tcp_upload_detach(pcb);
+		if (tcp_close(pcb) != ERR_OK) {
+			tcp_abort(pcb);
+			__tcp_upload_done(ERR_OK);
+			return ERR_ABRT;
+		}
+		__tcp_upload_done(ERR_OK);
+		return ERR_OK;
+	}
+
+	err = __tcp_upload_fill(pcb);
+	if (err != ERR_OK) {
+		__tcp_upload_detach(pcb);
+		tcp_abort(pcb);
+		__tcp_upload_done(err);
+		return ERR_ABRT;
+	}
+
+	return ERR_OK;
+}
+
+static err_t __tcp_upload_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p,
+		err_t err)
+{
+	if (p == NULL) {
+		/* the sink closed before taking everything */
+		__tcp_upload_detach(pcb);
+		tcp_abort(pcb);
+		__tcp_upload_done(ERR_CLSD);
+		return ERR_ABRT;
+	}
+	tcp_recved(pcb, p->tot_len);
+	pbuf_free(p);
+
+	return ERR_OK;
+}
+
+/* The pcb is already freed */
+static void __tcp_upload_err(void *arg, err_t err)
+{
+	__tcp_upload_done(err);
+}
+
+static err_t __tcp_upload_connected(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+	__tcp_upload.start = sys_now();
+	err = __tcp_upload_fill(pcb);
+	if (err != ERR_OK) {
+		__tcp_upload_detach(pcb);
+		tcp_abort(pcb);
+		__tcp_upload_done(err);
+		return ERR_ABRT;
+	}
+
+	return ERR_OK;
+}
+
+/* Called in the tcpip thread */
+static void __tcp_upload_start(void *arg)
+{
+	struct tcp_pcb *pcb;
+	err_t err;
+
+	__tcp_upload.start = sys_now();
+	pcb = tcp_new();
+	if (pcb == NULL) {
+		__tcp_upload_done(ERR_MEM);
+		return;
+	}
+	__tcp_upload.pcb = pcb;
+	tcp_arg(pcb, &__tcp_upload);
+	tcp_err(pcb, __tcp_upload_err);
+	tcp_recv(pcb, __tcp_upload_recv);
+	tcp_sent(pcb, __tcp_upload_sent);
+	err = tcp_connect(pcb, &__tcp_upload.addr, __tcp_upload.port,
+			__tcp_upload_connected);
+	if (err != ERR_OK) {
+		__tcp_upload_detach(pcb);
+		tcp_close(pcb);
+		__tcp_upload_done(err);
+	}
+}
+
+err_t tcp_upload(ip_addr_t *addr, u16_t port, u32_t len,
+		struct tcp_upload_result *res)
+{
+	u16_t i;
+
+	if (!sys_sem_valid(&__tcp_upload.done)) {
+		if (sys_sem_new(&__tcp_upload.done, 0) != ERR_OK)
+			return ERR_MEM;
+		for (i = 0; i < sizeof(__tcp_upload_buf); i++)
+			__tcp_upload_buf[i] = 'a' + i % 26;
+	}
+
+	memset(res, 0, sizeof(*res));
+	ip_addr_copy(__tcp_upload.addr, *addr);
+	__tcp_upload.port = port;
+	__tcp_upload.len = len;
+	__tcp_upload.written = 0;
+	__tcp_upload.acked = 0;
+	__tcp_upload.rd = 0;
+	__tcp_upload.count = 0;
+	__tcp_upload.rtt_sum = 0;
+	__tcp_upload.res = res;
+	if (tcpip_callback(__tcp_upload_start, NULL) != ERR_OK)
+		return ERR_MEM;
+	sys_arch_sem_wait(&__tcp_upload.done, 0);
+
+	return res->err;
+}
+
+void tcp_upload_task(void *p_arg)
+{
+	struct tcp_upload_result res;
+	ip_addr_t addr;
+
+	addr.addr = ipaddr_addr(TCP_UPLOAD_HOST);
+	while (1) {
+		OSTimeDly(30 * OS_TICKS_PER_SEC);
+		if (tcp_upload(&addr, TCP_UPLOAD_PORT, TCP_UPLOAD_SIZE,
+					&res) != ERR_OK) {
+			printf("upload failed (%d) after %lu bytes\r\n",
+					res.err, (unsigned long)res.bytes);
+			continue;
+		}
+		printf("%lu bytes in %lu ms, %lu bytes/s, "
+				"rtt %lu/%lu/%lu ms (%lu)\r\n",
+				(unsigned long)res.bytes,
+				(unsigned long)res.ms,
+				(unsigned long)(res.ms ?
+					(unsigned long long)res.bytes *
+					1000 / res.ms : 0),
+				(unsigned long)res.rtt_min,
+				(unsigned long)res.rtt_avg,
+				(unsigned long)res.rtt_max,
+				(unsigned long)res.samples);
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef __TCP_UPLOAD_H__
+#define __TCP_UPLOAD_H__
+
+#include "lwip/ip_addr.h"
+#include "lwip/err.h"
+
+#ifndef TCP_UPLOAD_HOST
+# define TCP_UPLOAD_HOST "192.0.2.1"
+#endif
+
+#ifndef TCP_UPLOAD_PORT
+# define TCP_UPLOAD_PORT 5001
+#endif
+
+/** Bytes sent by every upload of tcp_upload_task() */
+#ifndef TCP_UPLOAD_SIZE
+# define TCP_UPLOAD_SIZE 65536
+#endif
+
+struct tcp_upload_result {
+	err_t	err;		/* ERR_OK if every byte was acknowledged */
+	u32_t	bytes;		/* bytes acknowledged */
+	u32_t	ms;		/* from the connection to the last ACK */
+	u32_t	samples;	/* round trips measured */
+	u32_t	rtt_min;	/* ms from tcp_write() to the ACK, queueing in */
+	u32_t	rtt_avg;	/* the modem included */
+	u32_t	rtt_max;
+};
+
+/** Send 'len' bytes to a TCP sink and measure the goodput and the RTT under
+ * load, blocking the calling task. One upload runs at a time.
+ * @return res->err */
+err_t tcp_upload(ip_addr_t *addr, u16_t port, u32_t len,
+		struct tcp_upload_result *res);
+
+void tcp_upload_task(void *p_arg);
+
+#endif /* __TCP_UPLOAD_H__ */
@@ -0,0 +1,445 @@
+#include "tickless_bench.h"
+
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "lwip/ip_frag.h"
+#include "lwip/dns.h"
+#include "netif/etharp.h"
+#include "arch/tickless.h"
+#include "arch/timer_wheel.h"
+#include "ucos_ii.h"
+#include "tickless_cpu.h"
+#include "tickless_monitor.h"
+
+#include <stdio.h>
+
+#if !TICKLESS
+# error "The benchmark measures port/tickless.c, TICKLESS must be 1"
+#endif
+
+#define __BENCH_NEVER	(~0ULL)
+#define __BENCH_TICK	(1000000000ULL / OS_TICKS_PER_SEC)	/* ns */
+#define __BENCH_BYTE	(10 * 1000000000ULL / TICKLESS_BENCH_BPS)
+/* Flags, protocol field, IP and UDP headers, payload and FCS: a PPP frame
+ * with the address and control fields compressed, without escapes */
+#define __BENCH_FRAME	(1 + 1 + 20 + 8 + TICKLESS_BENCH_PAYLOAD + 2 + 1)
+/* Ticks the board's 24-bit SysTick counts at most */
+#define __BENCH_SYSTICK	((1UL << 24) / (TICKLESS_BENCH_HZ / OS_TICKS_PER_SEC))
+
+/* The tasks of a node running udp_echo_server and tickless_monitor, by
+ * priority */
+enum {
+	__BENCH_PPP,		/* PPP input thread, blocked in sio_read() */
+	__BENCH_TCPIP,		/* waits on its mbox for the next lwIP timer */
+	__BENCH_ECHO,		/* blocked in recvfrom() */
+	__BENCH_MONITOR,	/* in OSTimeDly() */
+	__BENCH_IDLE,
+	__BENCH_TASKS
+};
+
+static const INT8U __bench_prio[__BENCH_TASKS] = {
+	PPP_THREAD_PRIO, TCPIP_THREAD_PRIO, TCPIP_THREAD_PRIO + 1,
+	TCPIP_THREAD_PRIO + 2, OS_TASK_IDLE_PRIO
+};
+
+/* The kernel, as much of it as tickless.c and the tasks use */
+volatile INT32U OSTime;
+OS_TCB *OSTCBList;
+static OS_TCB __bench_tcb[__BENCH_TASKS];
+
+/* lwIP 1.4's timers.c: the timeouts in ms, each after the one before it,
+ * which the tcpip thread waits for on its mbox. The cyclic timers of
+ * sys_timeouts_init() in this build, with no TCP connection open. */
+struct __bench_timeout {
+	struct __bench_timeout	*next;
+	u32_t			time;
+	u32_t			period;
+};
+
+static struct __bench_timeout __bench_cyclic[] = {
+#if IP_REASSEMBLY
+	{ NULL, 0, IP_TMR_INTERVAL },
+#endif
+#if LWIP_ARP
+	{ NULL, 0, ARP_TMR_INTERVAL },
+#endif
+#if LWIP_DNS
+	{ NULL, 0, DNS_TMR_INTERVAL },
+#endif
+};
+
+static struct __bench_timeout *__bench_timeouts;
+
+/* The CPU, its tick timer and the USART of the link, in simulated time */
+static struct {
+	unsigned long long	now;		/* ns */
+	unsigned long long	tick;		/* last tick interrupt */
+	unsigned long long	fire;		/* next one */
+	unsigned long long	rx, tx;		/* next USART interrupts */
+	unsigned long long	arrive;		/* next datagram from the peer */
+	unsigned long long	period;		/* between them, 0 for none */
+	u32_t			max;		/* ticks, 0 for the periodic tick */
+	u32_t			rx_left, tx_left;
+	u8_t			masked;
+	u8_t			pend_tick, pend_rx, pend_tx;
+	u8_t			msg;		/* a datagram for the tcpip thread */
+	INT32U			begin;		/* OSTime when it pended */
+	u32_t			wakeups, by_timer;
+} __bench;
+
+/* As sys_arch_mbox_fetch() converts its timeout */
+static INT32U __bench_ms_to_ticks(u32_t ms)
+{
+	INT32U ticks = ms * OS_TICKS_PER_SEC / 1000;
+
+	if (ticks == 0)
+		return 1;
+	return ticks > 65535 ? 65535 : ticks;
+}
+
+/* sys_timeout() */
+static void __bench_timeout(struct __bench_timeout *to, u32_t ms)
+{
+	struct __bench_timeout *t;
+
+	to->time = ms;
+	if (__bench_timeouts == NULL || __bench_timeouts->time > ms) {
+		if (__bench_timeouts != NULL)
+			__bench_timeouts->time -= ms;
+		to->next = __bench_timeouts;
+		__bench_timeouts = to;
+		return;
+	}
+	for (t = __bench_timeouts; ; t = t->next) {
+		to->time -= t->time;
+		if (t->next == NULL || t->next->time > to->time) {
+			if (t->next != NULL)
+				t->next->time -= to->time;
+			to->next = t->next;
+			t->next = to;
+			return;
+		}
+	}
+}
+
+/* The first timeout expires and, being cyclic, is set again */
+static void __bench_expire(void)
+{
+	struct __bench_timeout *to = __bench_timeouts;
+
+	__bench_timeouts = to->next;
+	__bench_timeout(to, to->period);
+}
+
+/* OSSemPost() or OSQPost() to a task which waits */
+static void __bench_post(u8_t task)
+{
+	__bench_tcb[task].OSTCBStat = OS_STAT_RDY;
+	__bench_tcb[task].OSTCBDly = 0;
+}
+
+/* sys_arch_mbox_fetch() of the tcpip thread, with the timeout of the first
+ * lwIP timer */
+static void __bench_fetch(void)
+{
+	OS_TCB *ptcb = &__bench_tcb[__BENCH_TCPIP];
+
+	while (__bench_timeouts != NULL && __bench_timeouts->time == 0)
+		__bench_expire();
+	ptcb->OSTCBStat = OS_STAT_Q;
+	ptcb->OSTCBDly = __bench_timeouts != NULL ?
+		__bench_ms_to_ticks(__bench_timeouts->time) : 0;
+	__bench.begin = OSTime;
+}
+
+/* The tcpip thread, from the return of the fetch to the next one, as
+ * sys_timeouts_mbox_fetch() goes */
+static void __bench_tcpip(void)
+{
+	u32_t waited;
+
+	if (!__bench.msg) {
+		/* the first timeout expires, whatever it has left */
+		__bench_expire();
+	} else {
+		__bench.msg = 0;
+		waited = (OSTime - __bench.begin) * 1000 / OS_TICKS_PER_SEC;
+		if (__bench_timeouts != NULL)
+			__bench_timeouts->time -= LWIP_MIN(waited,
+					__bench_timeouts->time);
+		/* up to the echo task, whose reply the tcpip thread sends
+		 * at once */
+		__bench_post(__BENCH_ECHO);
+	}
+	__bench_fetch();
+}
+
+/* The reply goes to the TX ring, which the TX interrupt empties a byte at
+ * a time */
+static void __bench_echo(void)
+{
+	if (__bench.tx_left == 0)
+		__bench.tx = __bench.now + __BENCH_BYTE;
+	__bench.tx_left += __BENCH_FRAME;
+	__bench_tcb[__BENCH_ECHO].OSTCBStat = OS_STAT_Q;
+}
+
+/* Run the ready tasks by priority until they all block again. They take no
+ * time: what wakes the CPU is the same however long they run. */
+static void __bench_tasks(void)
+{
+	OS_TCB *ptcb;
+
+	while (1) {
+		for (ptcb = OSTCBList; ptcb != NULL; ptcb = ptcb->OSTCBNext)
+			if (ptcb->OSTCBPrio != OS_TASK_IDLE_PRIO &&
+			    ptcb->OSTCBStat == OS_STAT_RDY &&
+			    ptcb->OSTCBDly == 0)
+				break;
+		if (ptcb == NULL)
+			return;
+		switch (ptcb - __bench_tcb) {
+		case __BENCH_PPP:
+			/* the frame goes to the tcpip thread */
+			__bench.msg = 1;
+			__bench_post(__BENCH_TCPIP);
+			ptcb->OSTCBStat = OS_STAT_SEM;
+			break;
+		case __BENCH_TCPIP:
+			__bench_tcpip();
+			break;
+		case __BENCH_ECHO:
+			__bench_echo();
+			break;
+		case __BENCH_MONITOR:
+			ptcb->OSTCBDly = TICKLESS_MONITOR_PERIOD *
+				OS_TICKS_PER_SEC;
+			break;
+		}
+	}
+}
+
+/* OSTimeTick() */
+static void __bench_time_tick(void)
+{
+	OS_TCB *ptcb;
+
+	OSTime++;
+	for (ptcb = OSTCBList; ptcb != NULL; ptcb = ptcb->OSTCBNext)
+		if (ptcb->OSTCBDly != 0 && --ptcb->OSTCBDly == 0)
+			ptcb->OSTCBStat = OS_STAT_RDY;	/* timed out */
+}
+
+/* A byte came in; the flag at the end of a frame wakes the PPP thread, in
+ * frame mode and, reading no further, in byte mode */
+static void __bench_rx(void)
+{
+	if (__bench.rx_left == 0) {
+		__bench.rx_left = __BENCH_FRAME;
+		__bench.arrive += __bench.period;
+	}
+	if (--__bench.rx_left > 0) {
+		__bench.rx = __bench.now + __BENCH_BYTE;
+		return;
+	}
+	__bench.rx = __bench.arrive + __BENCH_BYTE;
+	__bench_post(__BENCH_PPP);
+}
+
+static void __bench_tx(void)
+{
+	if (--__bench.tx_left > 0)
+		__bench.tx = __bench.now + __BENCH_BYTE;
+	else
+		__bench.tx = __BENCH_NEVER;
+}
+
+/* The pending interrupts, once unmasked */
+static void __bench_isr(void)
+{
+	if (__bench.pend_tick) {
+		__bench.pend_tick = 0;
+		__bench.tick = __bench.fire;
+		__bench.fire = __bench.tick + __BENCH_TICK;
+		__bench_time_tick();
+	}
+	if (__bench.pend_rx) {
+		__bench.pend_rx = 0;
+		__bench_rx();
+	}
+	if (__bench.pend_tx) {
+		__bench.pend_tx = 0;
+		__bench_tx();
+	}
+}
+
+OS_CPU_SR OS_CPU_SR_Save(void)
+{
+	OS_CPU_SR sr = __bench.masked;
+
+	__bench.masked = 1;
+	return sr;
+}
+
+void OS_CPU_SR_Restore(OS_CPU_SR sr)
+{
+	__bench.masked = sr;
+	if (!sr)
+		__bench_isr();
+}
+
+u32_t tickless_cpu_max(void)
+{
+	return __bench.max;
+}
+
+void tickless_cpu_start(u32_t ticks)
+{
+	__bench.fire = __bench.tick + ticks * __BENCH_TICK;
+}
+
+/* WFI: on to the next interrupt */
+void tickless_cpu_sleep(void)
+{
+	unsigned long long t;
+
+	if (__bench.pend_tick || __bench.pend_rx || __bench.pend_tx)
+		return;
+	t = LWIP_MIN(__bench.fire, LWIP_MIN(__bench.rx, __bench.tx));
+	__bench.now = t;
+	__bench.pend_tick = __bench.fire == t;
+	__bench.pend_rx = __bench.rx == t;
+	__bench.pend_tx = __bench.tx == t;
+	__bench.wakeups++;
+	if (__bench.pend_tick)
+		__bench.by_timer++;
+}
+
+u32_t tickless_cpu_stop(u32_t ticks)
+{
+	u32_t elapsed;
+
+	if (__bench.pend_tick)
+		return ticks - 1;	/* the interrupt delivers the last */
+	elapsed = (u32_t)((__bench.now - __bench.tick) / __BENCH_TICK);
+	__bench.tick += elapsed * __BENCH_TICK;
+	__bench.fire = __bench.tick + __BENCH_TICK;
+	return elapsed;
+}
+
+#if TIMER_WHEEL
+/* In place of port/timer_wheel.c: nothing of the node is on the wheel */
+u32_t timer_wheel_next(u32_t max)
+{
+	return max;
+}
+#endif
+
+/* The idle task, with the tick stopped or, with no maximum, running */
+static void __bench_idle(void)
+{
+	OS_CPU_SR sr;
+
+	if (__bench.max) {
+		tickless_idle();
+		return;
+	}
+	sr = OS_CPU_SR_Save();
+	tickless_cpu_sleep();
+	OS_CPU_SR_Restore(sr);
+}
+
+/* Every task blocked as after startup, and the timers just started */
+static void __bench_start(void)
+{
+	u8_t i;
+
+	OSTCBList = NULL;
+	for (i = __BENCH_TASKS; i-- > 0; ) {
+		__bench_tcb[i].OSTCBPrio = __bench_prio[i];
+		__bench_tcb[i].OSTCBStat = OS_STAT_RDY;
+		__bench_tcb[i].OSTCBDly = 0;
+		__bench_tcb[i].OSTCBNext = OSTCBList;
+		OSTCBList = &__bench_tcb[i];
+	}
+	__bench_tcb[__BENCH_PPP].OSTCBStat = OS_STAT_SEM;
+	__bench_tcb[__BENCH_ECHO].OSTCBStat = OS_STAT_Q;
+	__bench_tcb[__BENCH_MONITOR].OSTCBDly = TICKLESS_MONITOR_PERIOD *
+		OS_TICKS_PER_SEC;
+	__bench_timeouts = NULL;
+	for (i = 0; i < sizeof(__bench_cyclic) / sizeof(__bench_cyclic[0]);
+			i++)
+		__bench_timeout(&__bench_cyclic[i], __bench_cyclic[i].period);
+	__bench.msg = 0;
+	__bench_fetch();
+
+	__bench.rx_left = 0;
+	__bench.arrive = __bench.now + __bench.period;
+	__bench.rx = __bench.period ? __bench.arrive + __BENCH_BYTE :
+		__BENCH_NEVER;
+}
+
+static void __bench_row(u32_t max, u32_t period_ms)
+{
+	struct tickless_stats st, last;
+	u32_t wakeups, by_timer, ticks;
+
+	__bench.max = max;
+	__bench.period = period_ms * 1000000ULL;
+	__bench_start();
+	tickless_get_stats(&last);
+	wakeups = __bench.wakeups;
+	by_timer = __bench.by_timer;
+	while (OSTime - last.ticks <
+			TICKLESS_BENCH_SECONDS * OS_TICKS_PER_SEC) {
+		__bench_tasks();
+		__bench_idle();
+	}
+	tickless_get_stats(&st);
+	ticks = st.ticks - last.ticks;
+	wakeups = __bench.wakeups - wakeups;
+	by_timer = __bench.by_timer - by_timer;
+
+	if (max)
+		printf("tickless %6lu", (unsigned long)max);
+	else
+		printf("periodic %6s", "-");
+	if (period_ms)
+		printf(" %6lu", (unsigned long)(1000 / period_ms));
+	else
+		printf(" %6s", "idle");
+#define __BENCH_PER_S(n) ((unsigned long)((n) * 10ULL * \
+		OS_TICKS_PER_SEC / ticks))
+	printf(" %7lu.%lu %5lu.%lu %5lu.%lu",
+			__BENCH_PER_S(wakeups) / 10,
+			__BENCH_PER_S(wakeups) % 10,
+			__BENCH_PER_S(by_timer) / 10,
+			__BENCH_PER_S(by_timer) % 10,
+			__BENCH_PER_S(wakeups - by_timer) / 10,
+			__BENCH_PER_S(wakeups - by_timer) % 10);
+	if (max)
+		printf(" %7lu%%\r\n", (unsigned long)((st.ticks_slept -
+				last.ticks_slept) * 100ULL / ticks));
+	else
+		printf(" %8s\r\n", "-");
+}
+
+void tickless_bench(void)
+{
+	static const u32_t max[] = { 0, __BENCH_SYSTICK, TICKLESS_MAX_TICKS };
+	static const u32_t period[] = { 0, 1000, 100 };
+	u8_t i, j;
+
+	__bench.tx = __BENCH_NEVER;
+	__bench.fire = __bench.tick + __BENCH_TICK;
+
+	printf("tickless: %u ticks/s, %u s a run, %u-byte datagrams echoed,"
+			" %lu bit/s 8N1\r\n", OS_TICKS_PER_SEC,
+			TICKLESS_BENCH_SECONDS, TICKLESS_BENCH_PAYLOAD,
+			(unsigned long)TICKLESS_BENCH_BPS);
+	printf("tick        max  pkt/s  wakeups/s   timer    uart tickless"
+			"\r\n");
+	for (i = 0; i < sizeof(max) / sizeof(max[0]); i++)
+		for (j = 0; j < sizeof(period) / sizeof(period[0]); j++)
+			__bench_row(max[i], period[j]);
+}
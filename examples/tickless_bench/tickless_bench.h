@@ -0,0 +1,30 @@
+#ifndef __TICKLESS_BENCH_H__
+#define __TICKLESS_BENCH_H__
+
+#include "lwip/opt.h"
+
+/** Simulated seconds per run */
+#ifndef TICKLESS_BENCH_SECONDS
+# define TICKLESS_BENCH_SECONDS 600
+#endif
+
+/** Bit rate of the link, 8N1 taking 10 bits a byte */
+#ifndef TICKLESS_BENCH_BPS
+# define TICKLESS_BENCH_BPS 115200
+#endif
+
+/** UDP payload of the datagrams the peer sends and the node echoes */
+#ifndef TICKLESS_BENCH_PAYLOAD
+# define TICKLESS_BENCH_PAYLOAD 5
+#endif
+
+/** Core clock of the board, which limits how far its 24-bit SysTick counts */
+#ifndef TICKLESS_BENCH_HZ
+# define TICKLESS_BENCH_HZ 72000000UL
+#endif
+
+/** Run the benchmark and print the results, on a host in place of the
+ * kernel */
+void tickless_bench(void);
+
+#endif /* __TICKLESS_BENCH_H__ */
@@ -0,0 +1,12 @@
+#ifndef __TICKLESS_CPU_H__
+#define __TICKLESS_CPU_H__
+
+/* The tick timer of tickless_bench.c in place of the board's SysTick, in
+ * simulated time. Put this directory ahead of examples/ on the include
+ * path. */
+u32_t tickless_cpu_max(void);
+void tickless_cpu_start(u32_t ticks);
+void tickless_cpu_sleep(void);
+u32_t tickless_cpu_stop(u32_t ticks);
+
+#endif /* __TICKLESS_CPU_H__ */
@@ -0,0 +1,67 @@
+#ifndef __TICKLESS_CPU_H__
+#define __TICKLESS_CPU_H__
+
+#include "stm32f10x.h"
+
+/* The tick is the SysTick timer, counting down from LOAD at the core clock.
+ * Its 24 bits last 233 ms at 72 MHz. */
+#define __TICKLESS_CPU_PERIOD (SystemCoreClock / OS_TICKS_PER_SEC)
+
+static inline u32_t tickless_cpu_max(void)
+{
+	return (SysTick_LOAD_RELOAD_Msk + 1) / __TICKLESS_CPU_PERIOD;
+}
+
+/* Stretch the current period so that it ends 'ticks' ticks after the last
+ * one */
+static inline void tickless_cpu_start(u32_t ticks)
+{
+	u32_t left;
+
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	left = SysTick->VAL;
+	SysTick->LOAD = left + (ticks - 1) * __TICKLESS_CPU_PERIOD - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+}
+
+static inline void tickless_cpu_sleep(void)
+{
+	__WFI();
+}
+
+static inline u32_t tickless_cpu_stop(u32_t ticks)
+{
+	u32_t ctrl, load, done, first, elapsed, left;
+
+	/* reading CTRL clears COUNTFLAG: read it once */
+	ctrl = SysTick->CTRL;
+	SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+	load = SysTick->LOAD;
+	if (ctrl & SysTick_CTRL_COUNTFLAG_Msk) {
+		/* SysTick_Handler delivers the last tick */
+		elapsed = ticks - 1;
+		left = __TICKLESS_CPU_PERIOD;
+	} else {
+		done = load - SysTick->VAL;
+		first = load + 1 - (ticks - 1) * __TICKLESS_CPU_PERIOD;
+		if (done < first) {
+			elapsed = 0;
+			left = first - done;
+		} else {
+			elapsed = (done - first) / __TICKLESS_CPU_PERIOD + 1;
+			left = __TICKLESS_CPU_PERIOD -
+				(done - first) % __TICKLESS_CPU_PERIOD;
+		}
+	}
+
+	/* finish the current period, then go on with whole ones */
+	SysTick->LOAD = left - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	SysTick->LOAD = __TICKLESS_CPU_PERIOD - 1;
+
+	return elapsed;
+}
+
+#endif /* __TICKLESS_CPU_H__ */
@@ -0,0 +1,18 @@
+#include "tickless_monitor.h"
+#include "ucos_ii.h"
+
+#include "lwip/sys.h"
+#include "arch/tickless.h"
+
+#if !TICKLESS
+# error "The monitor needs TICKLESS"
+#endif
+
+void tickless_monitor_task(void *p_arg)
+{
+	tickless_report();
+	while (1) {
+		OSTimeDly(TICKLESS_MONITOR_PERIOD * OS_TICKS_PER_SEC);
+		tickless_report();
+	}
+}
@@ -0,0 +1,11 @@
+#ifndef __TICKLESS_MONITOR_H__
+#define __TICKLESS_MONITOR_H__
+
+/** Seconds between the reports */
+#ifndef TICKLESS_MONITOR_PERIOD
+# define TICKLESS_MONITOR_PERIOD 60
+#endif
+
+void tickless_monitor_task(void *p_arg);
+
+#endif /* __TICKLESS_MONITOR_H__ */
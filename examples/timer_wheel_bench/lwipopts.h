@@ -0,0 +1,16 @@
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/* The timer options of examples/lwipopts.h, for timer_wheel_bench on a host,
+ * with a worker to compare. Build with this directory first on the include
+ * path. */
+
+#define NO_SYS			0
+
+#define TCPIP_THREAD_PRIO	12
+#define TCPIP_MBOX_SIZE		64
+
+#define TIMER_WHEEL			1
+#define TIMER_WHEEL_WORKER_PRIO		8
+
+#endif /* __LWIPOPTS_H__ */
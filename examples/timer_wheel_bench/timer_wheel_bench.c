@@ -0,0 +1,453 @@
+#include "timer_wheel_bench.h"
+
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "lwip/tcpip.h"
+#include "arch/tcpip_defer.h"
+#include "arch/timer_wheel.h"
+#include "ucos_ii.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define __BENCH_TICK		(1000000 / OS_TICKS_PER_SEC)	/* us */
+#define __BENCH_PERIOD		(TIMER_WHEEL_BENCH_PERIOD_MS * 1000UL)
+#define __BENCH_PERIOD_TICKS	(TIMER_WHEEL_BENCH_PERIOD_MS * \
+		OS_TICKS_PER_SEC / 1000)
+#define __BENCH_ROW		(TIMER_WHEEL_BENCH_SECONDS * 1000000ULL)
+#define __BENCH_REPEAT		1000
+
+enum {
+	__BENCH_TASK,	/* a task in OSTimeDly() */
+	__BENCH_LWIP,	/* lwIP 1.4's sys_timeout() */
+	__BENCH_TCPIP,	/* the wheel, TIMER_WHEEL_TCPIP */
+	__BENCH_WORKER,	/* the wheel, TIMER_WHEEL_WORKER */
+	__BENCH_JOBS
+};
+
+/* The periodic work of a timer, in the thread it runs in */
+struct __bench_job {
+	const char			*name;
+	u32_t				stack;	/* bytes it takes */
+	u32_t				*busy;	/* us of its thread */
+	struct timer_wheel_entry	t;
+	unsigned long long		ideal;	/* us of the next run */
+	unsigned long long		last;
+	u32_t				fired;
+	long long			late_sum;	/* early < 0 */
+	s32_t				late_max;
+	u32_t				period_err;
+};
+
+struct tcpip_callback_msg {
+	tcpip_callback_fn	fn;
+	void			*ctx;
+};
+
+/* The packets are all the same message, told apart from the callbacks */
+static u8_t __bench_packet;
+
+static struct {
+	unsigned long long	now;		/* us */
+	u8_t			load;		/* % of the tcpip thread */
+	unsigned long long	rx_at;		/* next packet lands */
+	u32_t			packets, dropped;
+
+	/* the tcpip mbox */
+	void			*mbox[TCPIP_MBOX_SIZE];
+	u16_t			out, n;
+
+	/* the threads, from the highest priority */
+	u32_t			worker_busy;
+	u32_t			tcpip_busy;
+	u8_t			tcpip_pending;	/* in OSQPend() */
+	INT32U			tcpip_begin;
+	INT32U			tcpip_timeout;	/* ticks */
+	INT32U			tcpip_fetched;	/* returned */
+	u32_t			lwip_time;	/* ms left, lwIP's delta */
+	u32_t			task_busy;
+	u8_t			task_ready;
+	INT32U			task_wake;	/* OSTimeDly() ends */
+
+	struct __bench_job	job[__BENCH_JOBS];
+	u32_t			random;
+
+	/* the worker of the wheel, run until it pends */
+	void			(*worker)(void *arg);
+	jmp_buf			worker_pend;
+	OS_EVENT		sem;
+} __bench;
+
+/* xorshift32 */
+static u32_t __bench_random(void)
+{
+	u32_t x = __bench.random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return __bench.random = x;
+}
+
+/* The kernel, as much of it as timer_wheel.c uses. The one semaphore is the
+ * worker's, which OSSemPend() leaves for the benchmark to run it again once
+ * it is posted. */
+volatile INT32U OSTime;
+INT8U OSPrioCur = TIMER_WHEEL_BENCH_TASK_PRIO;
+
+OS_CPU_SR OS_CPU_SR_Save(void)
+{
+	return 0;
+}
+
+void OS_CPU_SR_Restore(OS_CPU_SR cpu_sr)
+{
+	LWIP_UNUSED_ARG(cpu_sr);
+}
+
+INT32U OSTimeGet(void)
+{
+	return OSTime;
+}
+
+OS_EVENT *OSSemCreate(INT16U cnt)
+{
+	__bench.sem.OSEventCnt = cnt;
+	return &__bench.sem;
+}
+
+void OSSemPend(OS_EVENT *e, INT32U timeout, INT8U *perr)
+{
+	LWIP_UNUSED_ARG(timeout);
+	*perr = OS_ERR_NONE;
+	if (!e->OSEventCnt)
+		longjmp(__bench.worker_pend, 1);
+	e->OSEventCnt--;
+}
+
+INT8U OSSemPost(OS_EVENT *e)
+{
+	e->OSEventCnt++;
+	return OS_ERR_NONE;
+}
+
+INT8U OSTaskCreate(void (*task)(void *p_arg), void *p_arg, OS_STK *ptos,
+		INT8U prio)
+{
+	LWIP_UNUSED_ARG(p_arg);
+	LWIP_UNUSED_ARG(ptos);
+	LWIP_UNUSED_ARG(prio);
+	__bench.worker = task;
+	return OS_ERR_NONE;
+}
+
+/* lwIP's tcpip.c, as much of it as tcpip_defer.c uses */
+struct tcpip_callback_msg *tcpip_callbackmsg_new(tcpip_callback_fn fn,
+		void *ctx)
+{
+	struct tcpip_callback_msg *msg = malloc(sizeof(*msg));
+
+	if (msg) {
+		msg->fn = fn;
+		msg->ctx = ctx;
+	}
+	return msg;
+}
+
+static err_t __bench_post(void *msg)
+{
+	if (__bench.n == TCPIP_MBOX_SIZE)
+		return ERR_MEM;
+	__bench.mbox[(__bench.out + __bench.n++) % TCPIP_MBOX_SIZE] = msg;
+	return ERR_OK;
+}
+
+err_t tcpip_trycallback(struct tcpip_callback_msg *msg)
+{
+	return __bench_post(msg);
+}
+
+/* A timer runs: late from the time it was due, its thread busy with it */
+static void __bench_fire(void *arg)
+{
+	struct __bench_job *j = arg;
+	s32_t late = (s32_t)(__bench.now - j->ideal);
+	u32_t err;
+
+	if (j->fired > 0) {
+		err = __bench.now - j->last;
+		err = err > __BENCH_PERIOD ? err - __BENCH_PERIOD :
+			__BENCH_PERIOD - err;
+		if (err > j->period_err)
+			j->period_err = err;
+	}
+	j->fired++;
+	j->late_sum += late;
+	if (late > j->late_max)
+		j->late_max = late;
+	j->last = __bench.now;
+	/* due again a period later, or after the periods it missed, as the
+	 * wheel keeps its phase */
+	do {
+		j->ideal += __BENCH_PERIOD;
+	} while (j->ideal <= __bench.now);
+	*j->busy += TIMER_WHEEL_BENCH_WORK_US;
+}
+
+/* Run the worker until it pends again */
+static void __bench_worker(void)
+{
+	OSPrioCur = TIMER_WHEEL_WORKER_PRIO;
+	if (setjmp(__bench.worker_pend) == 0)
+		__bench.worker(NULL);
+	OSPrioCur = TIMER_WHEEL_BENCH_TASK_PRIO;
+}
+
+/* The tcpip thread, once done with the last message: lwIP 1.4's
+ * sys_timeouts_mbox_fetch() over the port's sys_arch_mbox_fetch(). The time
+ * to the first timeout runs down by the time sys_arch_mbox_fetch() returns,
+ * that since it last returned. */
+static void __bench_tcpip(void)
+{
+	struct tcpip_callback_msg *cb;
+	u32_t waited;
+	void *msg;
+
+	if (__bench.lwip_time == 0) {
+		/* the cyclic timer runs, and calls sys_timeout() again */
+		__bench.lwip_time = TIMER_WHEEL_BENCH_PERIOD_MS;
+		__bench_fire(&__bench.job[__BENCH_LWIP]);
+		return;
+	}
+	if (!__bench.n) {
+		if (!__bench.tcpip_pending) {
+			__bench.tcpip_pending = 1;
+			__bench.tcpip_begin = OSTime;
+			__bench.tcpip_timeout = __bench.lwip_time *
+				OS_TICKS_PER_SEC / 1000;
+			if (!__bench.tcpip_timeout)
+				__bench.tcpip_timeout = 1;
+		}
+		return;
+	}
+	__bench.tcpip_pending = 0;
+	waited = (OSTime - __bench.tcpip_fetched) * 1000 / OS_TICKS_PER_SEC;
+	__bench.tcpip_fetched = OSTime;
+	__bench.lwip_time -= LWIP_MIN(waited, __bench.lwip_time);
+
+	OSPrioCur = TCPIP_THREAD_PRIO;
+	tcpip_defer_poll();
+	msg = __bench.mbox[__bench.out];
+	__bench.out = (__bench.out + 1) % TCPIP_MBOX_SIZE;
+	__bench.n--;
+	if (msg == &__bench_packet) {
+		__bench.tcpip_busy = TIMER_WHEEL_BENCH_PACKET_US;
+	} else {
+		cb = msg;
+		cb->fn(cb->ctx);
+	}
+	OSPrioCur = TIMER_WHEEL_BENCH_TASK_PRIO;
+}
+
+/* A microsecond of the node: the tick, a packet landing, and the thread of
+ * highest priority with something to do */
+static void __bench_step(void)
+{
+	u32_t mean;
+
+	__bench.now++;
+	if (__bench.now % __BENCH_TICK == 0) {
+		OSTime++;
+		timer_wheel_tick();
+		if (__bench.tcpip_pending && OSTime - __bench.tcpip_begin >=
+				__bench.tcpip_timeout) {
+			__bench.tcpip_pending = 0;
+			__bench.tcpip_fetched = OSTime;
+			__bench.lwip_time = 0;
+		}
+		if (!__bench.task_ready && OSTime == __bench.task_wake)
+			__bench.task_ready = 1;
+	}
+	if (__bench.load && __bench.now >= __bench.rx_at) {
+		mean = TIMER_WHEEL_BENCH_PACKET_US * 100 / __bench.load;
+		__bench.rx_at += 1 + __bench_random() % (2 * mean - 1);
+		__bench.packets++;
+		if (__bench_post(&__bench_packet) != ERR_OK)
+			__bench.dropped++;
+	}
+
+	if (!__bench.worker_busy && __bench.sem.OSEventCnt)
+		__bench_worker();
+	if (__bench.worker_busy) {
+		__bench.worker_busy--;
+		return;
+	}
+	if (!__bench.tcpip_busy)
+		__bench_tcpip();
+	if (__bench.tcpip_busy) {
+		__bench.tcpip_busy--;
+		return;
+	}
+	if (__bench.task_ready) {
+		/* stun_task(): OSTimeDly(), then the query */
+		if (!__bench.task_busy)
+			__bench_fire(&__bench.job[__BENCH_TASK]);
+		if (--__bench.task_busy == 0) {
+			__bench.task_ready = 0;
+			__bench.task_wake = OSTime + __BENCH_PERIOD_TICKS;
+		}
+	}
+}
+
+/* Start a job a share of the period after the others, so that they don't
+ * fall due together */
+static void __bench_start(struct __bench_job *j, u8_t i)
+{
+	u32_t first = TIMER_WHEEL_BENCH_PERIOD_MS + i *
+		TIMER_WHEEL_BENCH_PERIOD_MS / __BENCH_JOBS;
+
+	j->ideal = (unsigned long long)(OSTime + first * OS_TICKS_PER_SEC /
+			1000) * __BENCH_TICK;
+	j->fired = 0;
+	j->late_sum = 0;
+	j->late_max = 0;
+	j->period_err = 0;
+	switch (i) {
+	case __BENCH_TASK:
+		__bench.task_ready = 0;
+		__bench.task_busy = 0;
+		__bench.task_wake = OSTime + first * OS_TICKS_PER_SEC / 1000;
+		break;
+	case __BENCH_LWIP:
+		__bench.lwip_time = first;
+		__bench.tcpip_pending = 0;
+		__bench.tcpip_fetched = OSTime;
+		break;
+	default:
+		timer_wheel_start(&j->t, first, TIMER_WHEEL_BENCH_PERIOD_MS);
+		break;
+	}
+}
+
+static void __bench_row(u8_t load)
+{
+	struct __bench_job *j;
+	unsigned long long end;
+	u8_t i;
+
+	__bench.load = load;
+	__bench.rx_at = __bench.now;
+	__bench.packets = __bench.dropped = 0;
+	for (i = 0; i < __BENCH_JOBS; i++)
+		__bench_start(&__bench.job[i], i);
+	end = __bench.now + __BENCH_ROW;
+	while (__bench.now < end)
+		__bench_step();
+	timer_wheel_stop(&__bench.job[__BENCH_TCPIP].t);
+	timer_wheel_stop(&__bench.job[__BENCH_WORKER].t);
+
+	for (i = 0; i < __BENCH_JOBS; i++) {
+		j = &__bench.job[i];
+		printf("%3u%% %3lu%% %-9s %5lu %6lu %8ld %8ld %8lu\r\n",
+				load, (unsigned long)(__bench.packets ?
+					__bench.dropped * 100 /
+					__bench.packets : 0),
+				j->name, (unsigned long)j->stack,
+				(unsigned long)j->fired,
+				(long)(j->fired ? j->late_sum / j->fired : 0),
+				(long)j->late_max,
+				(unsigned long)j->period_err);
+	}
+}
+
+static void __bench_nop(void *arg)
+{
+	LWIP_UNUSED_ARG(arg);
+}
+
+/* The time timer_wheel_tick() takes, masking interrupts, to catch up with
+ * the ticks tickless_idle() skipped, the timers of the rows and a timer on
+ * each level waiting */
+static void __bench_catchup(void)
+{
+	static struct timer_wheel_entry t[3];
+	static const u32_t ms[3] = { 200, 5000, 60000 };
+	struct timespec a, b;
+	unsigned long long ns = 0;
+	u32_t i;
+
+	for (i = 0; i < 3; i++) {
+		timer_wheel_setup(&t[i], __bench_nop, NULL,
+				TIMER_WHEEL_WORKER);
+		timer_wheel_start(&t[i], ms[i], ms[i]);
+	}
+	for (i = 0; i < __BENCH_REPEAT; i++) {
+		OSTime += TIMER_WHEEL_BENCH_IDLE_TICKS - 1;
+		clock_gettime(CLOCK_MONOTONIC, &a);
+		OSTime++;
+		timer_wheel_tick();
+		clock_gettime(CLOCK_MONOTONIC, &b);
+		ns += (b.tv_sec - a.tv_sec) * 1000000000ULL + b.tv_nsec -
+			a.tv_nsec;
+		/* the timers due run without taking time */
+		while (__bench.sem.OSEventCnt)
+			__bench_worker();
+	}
+	for (i = 0; i < 3; i++)
+		timer_wheel_stop(&t[i]);
+	printf("timer_wheel_tick() after %u ticks idle: %lu ns\r\n",
+			TIMER_WHEEL_BENCH_IDLE_TICKS,
+			(unsigned long)(ns / __BENCH_REPEAT));
+}
+
+void timer_wheel_bench(void)
+{
+	static const u8_t load[] = { 0, 50, 80, 95 };
+	struct __bench_job *j;
+	u8_t i;
+
+	__bench.random = 0x12345678;
+	__bench.job[__BENCH_TASK].name = "OSTimeDly";
+	__bench.job[__BENCH_TASK].stack = TIMER_WHEEL_BENCH_TASK_STACKSIZE *
+		sizeof(OS_STK);
+	__bench.job[__BENCH_TASK].busy = &__bench.task_busy;
+	__bench.job[__BENCH_LWIP].name = "timeout";
+	__bench.job[__BENCH_LWIP].busy = &__bench.tcpip_busy;
+	__bench.job[__BENCH_TCPIP].name = "tcpip";
+	__bench.job[__BENCH_TCPIP].busy = &__bench.tcpip_busy;
+	__bench.job[__BENCH_WORKER].name = "worker";
+	__bench.job[__BENCH_WORKER].stack = TIMER_WHEEL_WORKER_STACKSIZE *
+		sizeof(OS_STK);
+	__bench.job[__BENCH_WORKER].busy = &__bench.worker_busy;
+
+	if (timer_wheel_init() != ERR_OK) {
+		printf("timer_wheel_init failed\r\n");
+		exit(1);
+	}
+	for (i = __BENCH_TCPIP; i < __BENCH_JOBS; i++) {
+		j = &__bench.job[i];
+		timer_wheel_setup(&j->t, __bench_fire, j, i == __BENCH_TCPIP ?
+				TIMER_WHEEL_TCPIP : TIMER_WHEEL_WORKER);
+	}
+	/* the worker pends on its semaphore */
+	__bench_worker();
+
+	printf("timer_wheel: %u s a row, work of %u us every %u ms, packets "
+			"of %u us, %u ticks/s\r\n", TIMER_WHEEL_BENCH_SECONDS,
+			TIMER_WHEEL_BENCH_WORK_US, TIMER_WHEEL_BENCH_PERIOD_MS,
+			TIMER_WHEEL_BENCH_PACKET_US, OS_TICKS_PER_SEC);
+	printf("     pkts                           late us   period\r\n");
+	printf("load drop timer     stack  fired     mean      max  err "
+			"us\r\n");
+	for (i = 0; i < sizeof(load); i++)
+		__bench_row(load[i]);
+	__bench_catchup();
+}
+
+int main(void)
+{
+	timer_wheel_bench();
+	return 0;
+}
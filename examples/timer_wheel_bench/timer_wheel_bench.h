@@ -0,0 +1,44 @@
+#ifndef __TIMER_WHEEL_BENCH_H__
+#define __TIMER_WHEEL_BENCH_H__
+
+#include "lwip/opt.h"
+
+/** Simulated seconds of a row */
+#ifndef TIMER_WHEEL_BENCH_SECONDS
+# define TIMER_WHEEL_BENCH_SECONDS 300
+#endif
+
+/** Each timer runs work of TIMER_WHEEL_BENCH_WORK_US every
+ * TIMER_WHEEL_BENCH_PERIOD_MS, as the STUN query does every 10 s */
+#ifndef TIMER_WHEEL_BENCH_PERIOD_MS
+# define TIMER_WHEEL_BENCH_PERIOD_MS 1000
+#endif
+#ifndef TIMER_WHEEL_BENCH_WORK_US
+# define TIMER_WHEEL_BENCH_WORK_US 200
+#endif
+
+/** The tcpip thread takes this long to handle a packet, posted at random to
+ * load it to the share of each row */
+#ifndef TIMER_WHEEL_BENCH_PACKET_US
+# define TIMER_WHEEL_BENCH_PACKET_US 150
+#endif
+
+/** Priority of the task sleeping in OSTimeDly(), below the tcpip thread as
+ * the application's are, and its stack */
+#ifndef TIMER_WHEEL_BENCH_TASK_PRIO
+# define TIMER_WHEEL_BENCH_TASK_PRIO 20
+#endif
+#ifndef TIMER_WHEEL_BENCH_TASK_STACKSIZE
+# define TIMER_WHEEL_BENCH_TASK_STACKSIZE 128
+#endif
+
+/** Ticks skipped by tickless_idle() before the timer_wheel_tick() timed */
+#ifndef TIMER_WHEEL_BENCH_IDLE_TICKS
+# define TIMER_WHEEL_BENCH_IDLE_TICKS 1000
+#endif
+
+/** Run the benchmark and print the results, on a host in place of the
+ * kernel */
+void timer_wheel_bench(void);
+
+#endif /* __TIMER_WHEEL_BENCH_H__ */
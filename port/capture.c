@@ -0,0 +1,232 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "arch/capture.h"
+#include "arch/ram_report.h"
+
+#if CAPTURE
+
+#include "ucos_ii.h"
+#if LWIP_SOCKET
+#include "lwip/sockets.h"
+#endif
+
+#include <stddef.h>
+#include <string.h>
+
+#define __CAPTURE_FLAG		0x7e
+#define __CAPTURE_ESC		0x7d
+#define __CAPTURE_FCS_LEN	2
+
+#define __CAPTURE_LINKTYPE_PPP_WITH_DIR 204
+
+struct __capture_rec {
+	INT32U	ticks;
+	u16_t	len;
+	u16_t	caplen;
+	u8_t	dir;
+	u8_t	data[CAPTURE_SNAPLEN];
+};
+
+/* The frame being deframed in each direction */
+static struct {
+	struct __capture_rec	rec;
+	u8_t			sync;	/* a flag was seen */
+	u8_t			esc;
+} __capture_in[2];
+
+static struct __capture_rec __capture_ring[CAPTURE_RECORDS];
+static u16_t __capture_next;	/* where the next frame is stored */
+static u16_t __capture_count;	/* frames in the ring */
+#if RAM_REPORT
+static u16_t __capture_peak;	/* most frames it ever held */
+#endif
+static u16_t __capture_snaplen;
+
+volatile u8_t capture_on;
+
+static void __capture_commit(struct __capture_rec *rec)
+{
+	/* drop the FCS, from the kept bytes too if they reach it */
+	if (rec->len <= __CAPTURE_FCS_LEN)
+		return;
+	rec->len -= __CAPTURE_FCS_LEN;
+	if (rec->caplen > rec->len)
+		rec->caplen = rec->len;
+
+	memcpy(&__capture_ring[__capture_next], rec,
+			offsetof(struct __capture_rec, data) + rec->caplen);
+	if (++__capture_next == CAPTURE_RECORDS)
+		__capture_next = 0;
+	if (__capture_count < CAPTURE_RECORDS)
+		__capture_count++;
+#if RAM_REPORT
+	if (__capture_count > __capture_peak)
+		__capture_peak = __capture_count;
+#endif
+}
+
+void capture_bytes(u8_t dir, const u8_t *data, u32_t len)
+{
+	struct __capture_rec *rec = &__capture_in[dir].rec;
+	u8_t c;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	if (!capture_on) {
+		SYS_ARCH_UNPROTECT(sr);
+		return;
+	}
+	while (len-- > 0) {
+		c = *data++;
+		if (c == __CAPTURE_FLAG) {
+			if (__capture_in[dir].sync && rec->len > 0)
+				__capture_commit(rec);
+			__capture_in[dir].sync = 1;
+			__capture_in[dir].esc = 0;
+			rec->len = 0;
+			rec->caplen = 0;
+			continue;
+		}
+		/* bytes before the first flag aren't PPP, e.g. AT commands */
+		if (!__capture_in[dir].sync)
+			continue;
+		if (c == __CAPTURE_ESC) {
+			__capture_in[dir].esc = 1;
+			continue;
+		}
+		if (__capture_in[dir].esc) {
+			c ^= 0x20;
+			__capture_in[dir].esc = 0;
+		}
+		if (rec->len == 0)
+			rec->ticks = OSTimeGet();
+		if (rec->caplen < __capture_snaplen)
+			rec->data[rec->caplen++] = c;
+		if (rec->len < 0xffff)
+			rec->len++;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+void capture_start(u16_t snaplen)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	memset(__capture_in, 0, sizeof(__capture_in));
+	__capture_in[CAPTURE_RX].rec.dir = CAPTURE_RX;
+	__capture_in[CAPTURE_TX].rec.dir = CAPTURE_TX;
+	__capture_next = 0;
+	__capture_count = 0;
+	__capture_snaplen = LWIP_MIN(snaplen, CAPTURE_SNAPLEN);
+	capture_on = 1;
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+void capture_stop(void)
+{
+	capture_on = 0;
+}
+
+#if RAM_REPORT
+u8_t capture_ram_regions(struct ram_region *r, u8_t max)
+{
+	if (max == 0)
+		return 0;
+	r->name = "capture";
+	r->size = sizeof(__capture_ring);
+	r->peak = __capture_peak * sizeof(__capture_ring[0]);
+
+	return 1;
+}
+#endif
+
+/* pcap is read in the byte order of its magic, so it is written natively */
+static void __capture_put16(u8_t *p, u16_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static void __capture_put32(u8_t *p, u32_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+int capture_dump(capture_write_fn write, void *arg)
+{
+	u8_t buf[24 + CAPTURE_SNAPLEN];
+	struct __capture_rec *rec;
+	u16_t i, idx, count;
+	u8_t on = capture_on;
+	INT32U ticks;
+
+	capture_on = 0;
+	count = __capture_count;
+
+	__capture_put32(buf, 0xa1b2c3d4);	/* magic, microseconds */
+	__capture_put16(buf + 4, 2);		/* version 2.4 */
+	__capture_put16(buf + 6, 4);
+	__capture_put32(buf + 8, 0);		/* thiszone */
+	__capture_put32(buf + 12, 0);		/* sigfigs */
+	__capture_put32(buf + 16, CAPTURE_SNAPLEN + 1);
+	__capture_put32(buf + 20, __CAPTURE_LINKTYPE_PPP_WITH_DIR);
+	if (write(arg, buf, 24) != 0) {
+		capture_on = on;
+		return -1;
+	}
+
+	idx = (__capture_next + CAPTURE_RECORDS - count) % CAPTURE_RECORDS;
+	for (i = 0; i < count; i++) {
+		rec = &__capture_ring[idx];
+		ticks = rec->ticks;
+		__capture_put32(buf, ticks / OS_TICKS_PER_SEC);
+		__capture_put32(buf + 4, ticks % OS_TICKS_PER_SEC *
+				(1000000 / OS_TICKS_PER_SEC));
+		__capture_put32(buf + 8, rec->caplen + 1);
+		__capture_put32(buf + 12, rec->len + 1);
+		buf[16] = rec->dir;
+		memcpy(buf + 17, rec->data, rec->caplen);
+		if (write(arg, buf, 17 + rec->caplen) != 0) {
+			capture_on = on;
+			return -1;
+		}
+		if (++idx == CAPTURE_RECORDS)
+			idx = 0;
+	}
+	capture_on = on;
+
+	return count;
+}
+
+#if LWIP_SOCKET
+static int __capture_sendto(void *arg, const void *data, u16_t len)
+{
+	int sock = *(int *)arg;
+
+	return send(sock, data, len, 0) == len ? 0 : -1;
+}
+
+int capture_sendto(const ip_addr_t *addr, u16_t port)
+{
+	struct sockaddr_in sin;
+	int sock, n;
+
+	sock = socket(PF_INET, SOCK_DGRAM, 0);
+	if (sock < 0)
+		return -1;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = ip4_addr_get_u32(addr);
+	sin.sin_port = htons(port);
+	if (connect(sock, (struct sockaddr *)&sin, sizeof(sin)) != 0) {
+		close(sock);
+		return -1;
+	}
+	n = capture_dump(__capture_sendto, &sock);
+	close(sock);
+
+	return n;
+}
+#endif /* LWIP_SOCKET */
+
+#endif /* CAPTURE */
@@ -0,0 +1,80 @@
+#ifndef __ARCH_CAPTURE_H__
+#define __ARCH_CAPTURE_H__
+
+#include "lwip/opt.h"
+#include "lwip/ip_addr.h"
+
+/*****************************************************************************
+ * Capture of the PPP frames crossing the serial port
+ *
+ * The serial driver passes every span of bytes it reads or writes. Each
+ * direction is deframed on the fly: flags delimit frames, escapes are
+ * undone and the FCS is dropped, so a frame split over several spans is still
+ * one record. The last CAPTURE_RECORDS frames are kept, truncated to the snap
+ * length, and are exported as a pcap file with LINKTYPE_PPP_WITH_DIR (PPP in
+ * HDLC-like framing behind one direction byte, so both directions can share
+ * one ring).
+ *
+ * While capture is stopped each span costs one test of capture_on.
+ *****************************************************************************/
+
+#ifndef CAPTURE
+# define CAPTURE 0
+#endif
+
+#if CAPTURE
+
+/** Number of frames kept */
+#ifndef CAPTURE_RECORDS
+# define CAPTURE_RECORDS 16
+#endif
+
+/** Largest snap length, the bytes kept of each frame */
+#ifndef CAPTURE_SNAPLEN
+# define CAPTURE_SNAPLEN 64
+#endif
+
+#define CAPTURE_RX 0
+#define CAPTURE_TX 1
+
+extern volatile u8_t capture_on;
+
+/** Record a span of raw serial bytes, if capture is running */
+#define CAPTURE_BYTES(dir, data, len) \
+do { \
+	if (capture_on) \
+		capture_bytes((dir), (data), (len)); \
+} while (0)
+
+void capture_bytes(u8_t dir, const u8_t *data, u32_t len);
+
+/** Clear the ring and start capturing
+ * @param snaplen bytes kept of each frame, at most CAPTURE_SNAPLEN */
+void capture_start(u16_t snaplen);
+
+void capture_stop(void);
+
+/** Output sink of capture_dump(), returns 0 if successful */
+typedef int (*capture_write_fn)(void *arg, const void *data, u16_t len);
+
+/** Write the captured frames as a pcap file, the file header first and then
+ * one call per frame. Capture pauses while dumping.
+ * @param write the sink, fwrite() on a host build
+ * @param arg argument passed to 'write'
+ * @return number of frames written, -1 if 'write' failed */
+int capture_dump(capture_write_fn write, void *arg);
+
+#if LWIP_SOCKET
+/** Send the pcap file over UDP, one datagram per capture_dump() call, which
+ * a host can append to a file as they come, e.g. "nc -lu 5555 > ppp.pcap"
+ * @return number of frames sent, -1 on error */
+int capture_sendto(const ip_addr_t *addr, u16_t port);
+#endif
+
+#else /* CAPTURE */
+
+#define CAPTURE_BYTES(dir, data, len)
+
+#endif /* CAPTURE */
+
+#endif /* __ARCH_CAPTURE_H__ */
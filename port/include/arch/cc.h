@@ -64,13 +64,7 @@ do { \
 #define X32_F	"x"
 #define SZT_F	"lu"
 
-#if OS_CRITICAL_METHOD == 3
-# define SYS_ARCH_DECL_PROTECT(x)	OS_CPU_SR x
-# define SYS_ARCH_PROTECT(x)		x = OS_CPU_SR_Save()
-# define SYS_ARCH_UNPROTECT(x)		OS_CPU_SR_Restore(x)
-#else
-# error "not supported"
-#endif
+#include "arch/sys_crit.h"
 
 #ifndef BYTE_ORDER
 # define BYTE_ORDER LITTLE_ENDIAN
@@ -118,4 +112,6 @@ void sio_disable_rx_irq(sio_fd_t fd);
 void sio_rx_complete(sio_fd_t fd);
 void sio_tx_complete(sio_fd_t fd);
 
+#include "arch/mem_arch.h"
+
 #endif /* __ARCH_CC_H__ */
@@ -0,0 +1,66 @@
+#ifndef __ARCH_MEM_ARCH_H__
+#define __ARCH_MEM_ARCH_H__
+
+#include <stddef.h>
+
+/*****************************************************************************
+ * mem_malloc() on top of OSMem size-class partitions
+ *****************************************************************************/
+
+#ifndef MEM_ARCH
+# define MEM_ARCH 0
+#endif
+
+#if MEM_ARCH
+
+#if defined(MEM_LIBC_MALLOC) && MEM_LIBC_MALLOC <= 0
+# error "MEM_ARCH needs MEM_LIBC_MALLOC"
+#endif
+#ifndef MEM_LIBC_MALLOC
+# define MEM_LIBC_MALLOC 1
+#endif
+
+/** The size classes as MEM_ARCH_CLASS(size, number of blocks) in ascending
+ * order of size. tools/mem_classes.py derives them from a trace recorded with
+ * MEM_ARCH_TRACE. */
+#ifndef MEM_ARCH_CLASSES
+# define MEM_ARCH_CLASSES \
+	MEM_ARCH_CLASS(64, 32) \
+	MEM_ARCH_CLASS(128, 16) \
+	MEM_ARCH_CLASS(256, 8) \
+	MEM_ARCH_CLASS(512, 4) \
+	MEM_ARCH_CLASS(1536, 4)
+#endif
+
+/** Log every allocation and free with LWIP_PLATFORM_DIAG */
+#ifndef MEM_ARCH_TRACE
+# define MEM_ARCH_TRACE 0
+#endif
+
+struct mem_arch_stats {
+	u16_t	size;	/* block size of the class */
+	u16_t	nblks;	/* number of blocks of the class */
+	u16_t	used;	/* blocks in use */
+	u16_t	peak;	/* most blocks ever in use */
+	u32_t	fails;	/* requests which found the class empty */
+	u32_t	spills;	/* requests served by a larger class instead */
+};
+
+void mem_arch_init(void);
+void *mem_arch_malloc(size_t size);
+void *mem_arch_calloc(size_t count, size_t size);
+void mem_arch_free(void *mem);
+
+/** Read the counters of a size class
+ * @param cls index of the class, 0 being the smallest
+ * @param st where the counters are stored
+ * @return 0 if successful, -1 if there is no such class */
+int mem_arch_get_stats(u8_t cls, struct mem_arch_stats *st);
+
+#define mem_malloc	mem_arch_malloc
+#define mem_calloc	mem_arch_calloc
+#define mem_free	mem_arch_free
+
+#endif /* MEM_ARCH */
+
+#endif /* __ARCH_MEM_ARCH_H__ */
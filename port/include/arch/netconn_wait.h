@@ -0,0 +1,86 @@
+#ifndef __ARCH_NETCONN_WAIT_H__
+#define __ARCH_NETCONN_WAIT_H__
+
+#include "lwip/opt.h"
+#include "lwip/api.h"
+
+/*****************************************************************************
+ * Waiting on several netconns with an event flag group
+ *
+ * A netconn_wait set belongs to one task. Each netconn added to it owns two
+ * bits of its OSFlag group, readable and writable, which the netconn callback
+ * keeps set while data (or an error) is pending and while the send buffer has
+ * room. netconn_wait() pends on the group, so an event wakes only the owner
+ * of the netconn, and adding, removing or waiting costs the same whatever
+ * the number of netconns.
+ *
+ * The netconns are created with netconn_wait_callback, e.g.
+ *
+ *	conn = netconn_new_with_callback(NETCONN_UDP, netconn_wait_callback);
+ *	idx = netconn_wait_add(&set, conn);
+ *
+ * and the ones accepted from a listening netconn inherit it. lwip_select()
+ * can't wait on them: the sockets keep their own callback.
+ *****************************************************************************/
+
+#ifndef NETCONN_WAIT
+# define NETCONN_WAIT 0
+#endif
+
+#if NETCONN_WAIT
+
+/* The index of a netconn in its set is kept in conn->socket, which lwIP 1.4
+ * only has with LWIP_SOCKET */
+#if !LWIP_NETCONN || !LWIP_SOCKET || !OS_FLAG_EN
+# error "NETCONN_WAIT needs LWIP_NETCONN, LWIP_SOCKET and OS_FLAG_EN"
+#endif
+
+/** Number of sets which may exist at once */
+#ifndef NETCONN_WAIT_SETS
+# define NETCONN_WAIT_SETS 2
+#endif
+
+/** Netconns per set, OS_FLAGS holds two bits for each */
+#define NETCONN_WAIT_CONNS (OS_FLAGS_NBITS / 2)
+
+#define NETCONN_WAIT_RD(idx) ((OS_FLAGS)1 << (idx))
+#define NETCONN_WAIT_WR(idx) ((OS_FLAGS)1 << ((idx) + NETCONN_WAIT_CONNS))
+
+struct netconn_wait {
+	OS_FLAG_GRP	*grp;
+	OS_FLAGS	flags;	/* the bits set in 'grp' */
+	struct netconn	*conn[NETCONN_WAIT_CONNS];
+	s16_t		rcvevent[NETCONN_WAIT_CONNS];	/* pending receives */
+	u8_t		sendevent[NETCONN_WAIT_CONNS];
+	u8_t		errevent[NETCONN_WAIT_CONNS];
+	u8_t		id;	/* index among the sets */
+};
+
+/** Prepare a set for the calling task
+ * @return ERR_OK if successful, ERR_MEM if NETCONN_WAIT_SETS exist or no
+ * flag group is left */
+err_t netconn_wait_init(struct netconn_wait *w);
+
+/** Release a set, its netconns are left alone */
+void netconn_wait_deinit(struct netconn_wait *w);
+
+/** The callback of the netconns added to sets */
+void netconn_wait_callback(struct netconn *conn, enum netconn_evt evt,
+		u16_t len);
+
+/** Add a netconn, counting the receives which arrived before
+ * @return index of its bits, -1 if the set is full */
+s8_t netconn_wait_add(struct netconn_wait *w, struct netconn *conn);
+
+/** Remove a netconn, before netconn_delete() */
+void netconn_wait_remove(struct netconn_wait *w, struct netconn *conn);
+
+/** Wait until any of 'mask' is set, the bits stay set until the condition
+ * is gone, as with select()
+ * @param timeout in milliseconds, 0 to wait forever
+ * @return the bits of 'mask' which are set, 0 on timeout */
+OS_FLAGS netconn_wait(struct netconn_wait *w, OS_FLAGS mask, u32_t timeout);
+
+#endif /* NETCONN_WAIT */
+
+#endif /* __ARCH_NETCONN_WAIT_H__ */
@@ -0,0 +1,237 @@
+#ifndef __ARCH_PPP_IPHC_H__
+#define __ARCH_PPP_IPHC_H__
+
+#include "lwip/opt.h"
+#include "lwip/pbuf.h"
+
+/*****************************************************************************
+ * IP header compression of UDP flows on a PPP link (RFC 2507, RFC 2509)
+ *
+ * lwIP 1.4's PPP only knows Van Jacobson compression, which is for TCP. This
+ * filter sits between PPP and the serial device instead, on the HDLC frames
+ * (see sio_iphc() in sio_arch.h), so PPP itself is unchanged:
+ *
+ * - It adds the IP-Compression-Protocol option for IPHC to the IPCP
+ *   Configure-Requests lwIP sends, and takes it out of the answers before
+ *   lwIP sees them. The option of the peer's Configure-Request is likewise
+ *   hidden from lwIP and put back into lwIP's Configure-Ack.
+ * - Once the peer has acked the option, the FULL_HEADER and
+ *   COMPRESSED_NON_TCP frames it sends are turned back into IP frames.
+ * - Once lwIP has acked the peer's option, the IPv4/UDP packets of up to
+ *   PPP_IPHC_MAX_PACKET bytes are sent with their 28 bytes of headers
+ *   replaced by 4, or 6 with a UDP checksum. A flow gets a full header when
+ *   it starts or changes, then again after 1, 2, 4... compressed packets up to
+ *   F_MAX_PERIOD of them, and at least every F_MAX_TIME seconds.
+ *
+ * If either side doesn't take the option, or rejects it, that direction stays
+ * uncompressed. The option is only added when lwIP's request has no other
+ * IP-Compression-Protocol, so VJ_SUPPORT must be 0.
+ *
+ * TCP is never compressed by this end, nor decompressed: COMPRESSED_TCP
+ * frames and TCP full headers are dropped. The option can't keep the peer
+ * from compressing TCP, its TCP_SPACE of 0 still grants one context, so this
+ * end only offers it, and lets the peer compress, with PPP_IPHC_RX, which
+ * needs LWIP_TCP 0. With TCP, only what this end sends is compressed. The
+ * compressed packets of a flow whose IPv4 header has options are dropped as
+ * well, its full headers still get through. The filter also reads the ACCM
+ * lwIP acks in LCP, so the frames it sends escape only what the peer asked
+ * for.
+ *****************************************************************************/
+
+#ifndef PPP_IPHC
+# define PPP_IPHC 0
+#endif
+
+#if PPP_IPHC
+
+/** Offer the option, so that the peer compresses what it sends */
+#ifndef PPP_IPHC_RX
+# define PPP_IPHC_RX (!LWIP_TCP)
+#endif
+
+#if PPP_IPHC_RX && LWIP_TCP
+# error "PPP_IPHC_RX lets the peer compress TCP, which is dropped"
+#endif
+
+/** UDP flows compressed at once in each direction, NON_TCP_SPACE + 1 */
+#ifndef PPP_IPHC_CONTEXTS
+# define PPP_IPHC_CONTEXTS 4
+#endif
+
+#if PPP_IPHC_CONTEXTS < 1 || PPP_IPHC_CONTEXTS > 255
+# error "PPP_IPHC_CONTEXTS must be 1 to 255"
+#endif
+
+/** Most compressed packets between two full headers, F_MAX_PERIOD */
+#ifndef PPP_IPHC_MAX_PERIOD
+# define PPP_IPHC_MAX_PERIOD 64
+#endif
+
+/** Most seconds between two full headers, F_MAX_TIME */
+#ifndef PPP_IPHC_MAX_TIME
+# define PPP_IPHC_MAX_TIME 5
+#endif
+
+/** Largest IP packet compressed, each link buffers one outgoing frame of that
+ * size. Larger ones, and the IPCP and LCP frames which don't fit, pass
+ * unchanged. */
+#ifndef PPP_IPHC_MAX_PACKET
+# define PPP_IPHC_MAX_PACKET 128
+#endif
+
+/** Largest frame taken in, the MRU; received frames to rewrite are gathered
+ * into pool pbufs */
+#ifndef PPP_IPHC_MRU
+# define PPP_IPHC_MRU 1500
+#endif
+
+/** Bytes read from the serial device at once */
+#ifndef PPP_IPHC_READ_SIZE
+# define PPP_IPHC_READ_SIZE 32
+#endif
+
+#if PPP_IPHC_READ_SIZE > 255
+# error "PPP_IPHC_READ_SIZE must be at most 255"
+#endif
+
+/* FF 03, two bytes of protocol, the packet and the FCS */
+#define __PPP_IPHC_FRAME	(4 + PPP_IPHC_MAX_PACKET + 2)
+/* Longest IPHC option kept, and room for it in an IPCP frame */
+#define __PPP_IPHC_OPT_MAX	32
+
+struct ppp_iphc_stats {
+	u8_t	tx_on;		/* the peer decompresses */
+	u8_t	rx_on;		/* we decompress */
+	u32_t	tx_full;	/* full headers sent */
+	u32_t	tx_compressed;	/* compressed headers sent */
+	u32_t	tx_saved;	/* bytes saved before escaping */
+	u32_t	rx_full;	/* full headers received */
+	u32_t	rx_compressed;	/* compressed headers expanded */
+	u32_t	rx_dropped;	/* unknown context, old generation, TCP... */
+	u32_t	rx_errors;	/* bad FCS, too long, out of pbufs */
+};
+
+/* One direction of the HDLC stream */
+struct __ppp_iphc_dir {
+	u8_t	state;
+	u8_t	esc;	/* the previous byte was an escape */
+	u8_t	hlen;	/* FF 03 and protocol */
+	u16_t	proto;
+	u16_t	n;	/* bytes of the frame so far, unescaped */
+	u16_t	fcs;
+};
+
+/* A frame escaped for PPP, over as many ppp_iphc_read() as it takes */
+struct __ppp_iphc_esc {
+	struct pbuf	*p;	/* NULL if none */
+	struct pbuf	*q;
+	u16_t		off;
+	u16_t		fcs;
+	u8_t		phase;
+	u8_t		next;	/* byte after an escape, 0 if none */
+};
+
+struct __ppp_iphc_tx_ctx {
+	u8_t	key[12];	/* addresses and ports */
+	u8_t	used;
+	u8_t	gen;
+	u8_t	tos, ttl, flags;
+	u8_t	csum;		/* the UDP checksum is set */
+	u16_t	count;		/* compressed since the last full header */
+	u16_t	period;		/* compressed before the next full header */
+	u32_t	full_time;	/* sys_now() of the last full header */
+	u32_t	last;		/* sys_now() of the last packet */
+};
+
+struct __ppp_iphc_rx_ctx {
+	u8_t	hdr[28];	/* IPv4 and UDP headers */
+	u8_t	len;		/* 20, 28 with UDP, 0 if unused */
+	u8_t	gen;
+};
+
+/* Parameters of an IPHC option */
+struct __ppp_iphc_params {
+	u8_t	contexts;	/* NON_TCP_SPACE + 1 up to PPP_IPHC_CONTEXTS,
+				   0 if unusable */
+	u16_t	max_period;
+	u16_t	max_time;
+};
+
+struct ppp_iphc {
+	/* private */
+	u8_t				tx_on;
+	u8_t				rx_on;
+
+	/* sending, under the writer lock of the device */
+	struct __ppp_iphc_dir		tx;
+	u8_t				frame[__PPP_IPHC_FRAME +
+						__PPP_IPHC_OPT_MAX];
+	u32_t				tx_accm;	/* acked in LCP */
+	struct __ppp_iphc_params	tx_params;
+	struct __ppp_iphc_tx_ctx	tx_ctx[PPP_IPHC_CONTEXTS];
+
+	/* receiving, by the reader */
+	struct __ppp_iphc_dir		rx;
+	u8_t				head[4];
+	struct pbuf			*p;	/* frame gathered */
+	struct pbuf			*q;
+	u16_t				off;
+	u8_t				pend[12];	/* bytes for PPP */
+	u8_t				pend_pos, pend_len;
+	struct __ppp_iphc_esc		out;	/* then this frame */
+	u8_t				raw[PPP_IPHC_READ_SIZE];
+	u8_t				raw_pos, raw_len;
+	struct __ppp_iphc_params	rx_params;
+	struct __ppp_iphc_rx_ctx	rx_ctx[PPP_IPHC_CONTEXTS];
+
+	/* IPCP, seen by both */
+	u8_t				req_id;		/* of our request */
+	u8_t				req_iphc;	/* it has the option */
+	u8_t				refused;	/* the peer rejected it */
+	u8_t				peer_id;	/* of the peer's request */
+	u8_t				peer_opt[__PPP_IPHC_OPT_MAX];
+	u8_t				peer_opt_len;	/* 0 if it had none */
+	u8_t				peer_opt_off;
+	struct __ppp_iphc_params	peer_params;
+
+	struct ppp_iphc_stats		stats;
+};
+
+/** Source of the received bytes, returns how many were read, 0 if none */
+typedef u32_t (*ppp_iphc_read_fn)(void *arg, u8_t *data, u32_t len);
+
+/** Sink of the bytes to send */
+typedef void (*ppp_iphc_write_fn)(void *arg, const u8_t *data, u32_t len);
+
+/** Clear the state, before PPP starts on the link */
+void ppp_iphc_init(struct ppp_iphc *h);
+
+/** Read the stream PPP receives
+ * Reads the link through 'read' until some bytes are ready for PPP.
+ * @param h the link
+ * @param data where the bytes for PPP are stored
+ * @param len most bytes stored
+ * @param read reads the link, e.g. blocking for sio_read()
+ * @param arg passed to 'read'
+ * @return number of bytes stored, 0 once 'read' returns 0 */
+u32_t ppp_iphc_read(struct ppp_iphc *h, u8_t *data, u32_t len,
+		ppp_iphc_read_fn read, void *arg);
+
+/** Write the stream PPP sends, the frames it compresses are held until
+ * their closing flag
+ * @param h the link
+ * @param data the bytes PPP writes
+ * @param len number of bytes
+ * @param write writes to the link
+ * @param arg passed to 'write' */
+void ppp_iphc_write(struct ppp_iphc *h, const u8_t *data, u32_t len,
+		ppp_iphc_write_fn write, void *arg);
+
+/** Copy the counters
+ * @param h the link
+ * @param st where the counters are stored */
+void ppp_iphc_get_stats(struct ppp_iphc *h, struct ppp_iphc_stats *st);
+
+#endif /* PPP_IPHC */
+
+#endif /* __ARCH_PPP_IPHC_H__ */
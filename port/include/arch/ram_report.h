@@ -0,0 +1,65 @@
+#ifndef __ARCH_RAM_REPORT_H__
+#define __ARCH_RAM_REPORT_H__
+
+#include "lwip/opt.h"
+
+/*****************************************************************************
+ * Peak use of the RAM the port reserves
+ *
+ * Each module with a static reservation (mboxes, thread stacks, serial rings,
+ * the capture ring, the RX trace, the resolver's table, MEM_ARCH classes, the
+ * lwIP heap and memp pools) tracks the most of it ever used. ram_report()
+ * prints one line per region:
+ *
+ *	ram <region> <bytes reserved> <peak bytes used>
+ *
+ * which tools/ram_map.py reads together with the link map to tell how much
+ * each option could shrink while keeping some headroom.
+ *****************************************************************************/
+
+#ifndef RAM_REPORT
+# define RAM_REPORT 0
+#endif
+
+#if RAM_REPORT
+
+struct ram_region {
+	const char	*name;	/* no spaces */
+	u32_t		size;	/* bytes reserved */
+	u32_t		peak;	/* most bytes used */
+};
+
+#if !NO_SYS
+/** The regions of sys_arch.c: the mboxes and the lwIP thread stacks
+ * @return number of regions stored, at most 'max' */
+u8_t sys_arch_ram_regions(struct ram_region *r, u8_t max);
+#endif
+
+/** The rings of each serial device
+ * @return number of regions stored, at most 'max' */
+u8_t sio_ram_regions(struct ram_region *r, u8_t max);
+
+#if CAPTURE
+/** The ring of frames of arch/capture.h
+ * @return number of regions stored, at most 'max' */
+u8_t capture_ram_regions(struct ram_region *r, u8_t max);
+#endif
+
+#if SIO_TRACE
+/** The recording of arch/sio_trace.h
+ * @return number of regions stored, at most 'max' */
+u8_t sio_trace_ram_regions(struct ram_region *r, u8_t max);
+#endif
+
+#if LWIP_DNS && !NO_SYS
+/** The cache and the waiters of arch/resolv.h
+ * @return number of regions stored, at most 'max' */
+u8_t resolv_ram_regions(struct ram_region *r, u8_t max);
+#endif
+
+/** Print the peak use of every region with LWIP_PLATFORM_DIAG */
+void ram_report(void);
+
+#endif /* RAM_REPORT */
+
+#endif /* __ARCH_RAM_REPORT_H__ */
@@ -0,0 +1,80 @@
+#ifndef __ARCH_RESOLV_H__
+#define __ARCH_RESOLV_H__
+
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+
+/*****************************************************************************
+ * Asynchronous resolver with a shared cache on top of dns_gethostbyname()
+ *
+ * The lookups run in the tcpip thread, so NO_SYS builds, with one task only,
+ * call dns_gethostbyname() themselves instead.
+ *****************************************************************************/
+
+/** Number of names kept in the cache */
+#ifndef RESOLV_TABLE_SIZE
+# define RESOLV_TABLE_SIZE		4
+#endif
+
+/** Number of callbacks which may wait for outstanding lookups */
+#ifndef RESOLV_MAX_WAITERS
+# define RESOLV_MAX_WAITERS		4
+#endif
+
+/** Longest name (including the terminating NUL) which can be cached */
+#ifndef RESOLV_MAX_NAME_LENGTH
+# define RESOLV_MAX_NAME_LENGTH		64
+#endif
+
+/** Lifetime (in seconds) of a positive answer */
+#ifndef RESOLV_TTL
+# define RESOLV_TTL			300
+#endif
+
+/** Lifetime (in seconds) of a negative answer */
+#ifndef RESOLV_NEG_TTL
+# define RESOLV_NEG_TTL			30
+#endif
+
+/** An entry used at least RESOLV_REFRESH_HITS times is refreshed in the
+ * background once it is closer than RESOLV_REFRESH_AHEAD seconds to its
+ * expiry, so its users never see it expire. */
+#ifndef RESOLV_REFRESH_AHEAD
+# define RESOLV_REFRESH_AHEAD		30
+#endif
+
+#ifndef RESOLV_REFRESH_HITS
+# define RESOLV_REFRESH_HITS		2
+#endif
+
+/** Milliseconds between the attempts to start a lookup while the DNS table
+ * of lwIP is full, on the timer wheel with TIMER_WHEEL, whose
+ * timer_wheel_init() must have been called */
+#ifndef RESOLV_RETRY_INTERVAL
+# define RESOLV_RETRY_INTERVAL		1000
+#endif
+
+/** Callback invoked in the tcpip thread when a lookup finishes
+ * @param name the name looked up
+ * @param addr the address found or NULL if the name can't be resolved
+ * @param arg the argument passed to resolv_query() */
+typedef void (*resolv_found_fn)(const char *name, const ip_addr_t *addr,
+		void *arg);
+
+/** Look up a name, never blocks
+ * @param name the name to look up
+ * @param addr where the address is stored if it is in the cache
+ * @param found callback invoked when a lookup is needed (may be NULL)
+ * @param arg argument passed to 'found'
+ * @return ERR_OK if 'addr' was filled from the cache,
+ *         ERR_VAL if the cache knows the name can't be resolved,
+ *         ERR_INPROGRESS if a lookup is outstanding and 'found' will be
+ *         called once it finishes,
+ *         ERR_MEM if the cache, the waiters or the tcpip mbox are full,
+ *         'found' won't be called then,
+ *         ERR_ARG if the name is too long */
+err_t resolv_query(const char *name, ip_addr_t *addr, resolv_found_fn found,
+		void *arg);
+
+#endif /* __ARCH_RESOLV_H__ */
@@ -0,0 +1,114 @@
+#ifndef __ARCH_SIO_ARCH_H__
+#define __ARCH_SIO_ARCH_H__
+
+#include "lwip/opt.h"
+#include "lwip/sio.h"
+#include "arch/ppp_iphc.h"
+
+/*****************************************************************************
+ * Extensions of port/netif/sio.c beyond lwip/sio.h
+ *****************************************************************************/
+
+/** Number of serial devices, sio_open() takes 0 to SIO_NUM_DEVS - 1 */
+#ifndef SIO_NUM_DEVS
+# define SIO_NUM_DEVS 1
+#endif
+
+/** Bytes of each RX and TX ring, the indexes are 8 bits */
+#ifndef SIO_BUF_SIZE
+# define SIO_BUF_SIZE 64
+#endif
+
+#if SIO_BUF_SIZE > 255
+# error "SIO_BUF_SIZE must be at most 255"
+#endif
+
+/** Hand bytes between the ISRs and the tasks without SYS_ARCH_PROTECT()
+ * Each ring then has one producer and one consumer which write only their own
+ * index: the RX ISR and a single reader task, and the writing task and the TX
+ * ISR, writers taking turns on a semaphore. The sio_cpu.h macros enabling and
+ * disabling the interrupts must change their bit atomically, as the ISR and a
+ * task may do so at once. sio_rx_throttle(), sio_frame_mode() and the
+ * counters still lock. */
+#ifndef SIO_LOCKFREE
+# define SIO_LOCKFREE 0
+#endif
+
+/** Get the devnum a device was opened with, NULL being device 0. The
+ * sio_cpu.h macros use it to find the UART of a device. */
+u8_t sio_devnum(sio_fd_t fd);
+
+/** Count the traffic of the serial device */
+#ifndef SIO_STATS
+# define SIO_STATS 0
+#endif
+
+#if SIO_STATS
+/** Tiers of the PPP frames read: those taking 1, 2, 3-4, 5-8 and more of the
+ * PBUF_POOL buffers lwIP's PPPoS chains for a frame */
+#define SIO_RX_TIERS	5
+
+struct sio_stats {
+	u32_t	rx_bytes;	/* bytes taken from the UART */
+	u32_t	tx_bytes;	/* bytes given to the UART */
+	u32_t	rx_full;	/* RX paused because the ring was full */
+	u32_t	rx_wakeups;	/* blocking reads which returned data */
+	u32_t	rx_reads;	/* sio_read() and sio_tryread() calls */
+	u32_t	tx_writes;	/* sio_write() calls */
+	u32_t	rx_throttles;	/* RX paused by sio_rx_throttle() */
+	u32_t	rx_stall_ticks;	/* OS ticks spent paused by sio_rx_throttle() */
+	/* PPP frames read by tier, counting their escaped bytes, and those of
+	 * each which needed a buffer while the pool was empty, as lwIP's
+	 * MEMP_STATS tell it: the frames PPPoS dropped for want of one */
+	u32_t	rx_frames[SIO_RX_TIERS];
+	u32_t	rx_pool_empty[SIO_RX_TIERS];
+};
+
+/** Copy the counters of a serial device
+ * @param fd serial device handle
+ * @param st where the counters are stored */
+void sio_get_stats(sio_fd_t fd, struct sio_stats *st);
+#endif /* SIO_STATS */
+
+/** Let sio_read() return whole frames, see sio_frame_mode() */
+#ifndef SIO_FRAME_READ
+# define SIO_FRAME_READ 0
+#endif
+
+/** Ticks sio_read() waits for the rest of a partial frame in frame mode */
+#ifndef SIO_FRAME_TIMEOUT
+# define SIO_FRAME_TIMEOUT (OS_TICKS_PER_SEC / 50 > 0 ? OS_TICKS_PER_SEC / 50 : 1)
+#endif
+
+#if SIO_FRAME_READ
+/** Switch between byte and frame mode, while nobody is reading
+ * In frame mode the RX ISR looks for the delimiter (0x7E for PPP) and wakes
+ * the reader only when a frame is complete or the ring is full, and
+ * sio_read() returns at most one frame, ending with its delimiter. A partial
+ * frame is returned once SIO_FRAME_TIMEOUT ticks pass without it completing;
+ * to time it, the ISR also wakes the reader when a frame starts while none is
+ * pending. An idle link never wakes the reader.
+ * @param fd serial device handle
+ * @param on 1 for frame mode, 0 for byte mode
+ * @param delim the byte which ends a frame */
+void sio_frame_mode(sio_fd_t fd, u8_t on, u8_t delim);
+#endif
+
+/** Pause (on = 1) or resume (on = 0) reception, ISR safe
+ * While paused, RX interrupts stay disabled, so the UART holds RTS under
+ * hardware flow control and the modem buffers the data. Matches the callback
+ * of sys_backpressure_set().
+ * @param fd serial device handle
+ * @param on whether to pause */
+void sio_rx_throttle(void *fd, u8_t on);
+
+#if PPP_IPHC
+/** Compress the UDP/IP headers of the PPP link on a device, see ppp_iphc.h
+ * Reads and writes then go through the filter, which 'h' keeps the state of.
+ * Call before PPP opens the device, or while nobody reads or writes it.
+ * @param fd serial device handle
+ * @param h state of the link, cleared, NULL to stop filtering */
+void sio_iphc(sio_fd_t fd, struct ppp_iphc *h);
+#endif
+
+#endif /* __ARCH_SIO_ARCH_H__ */
@@ -0,0 +1,105 @@
+#ifndef __ARCH_SIO_TRACE_H__
+#define __ARCH_SIO_TRACE_H__
+
+#include "lwip/opt.h"
+#include "lwip/sio.h"
+#include "lwip/netif.h"
+
+/*****************************************************************************
+ * Recording and replaying the bytes received by the serial driver
+ *
+ * While recording, the RX ISR appends every byte with the clock ticks since
+ * the previous one, and the attached netif appends a digest of every packet
+ * it is given. sio_trace_replay() feeds a recording back through the RX ring,
+ * as fast as the reader takes it or at the recorded pace, and checks the
+ * packets against the recorded digests.
+ *
+ * A trace is a header, "SIOT", a version byte, three zero bytes and the
+ * clock rate (32 bits, little endian), followed by records. A record is a
+ * varint (7 bits per byte, least significant first) of the ticks since the
+ * previous record shifted left by one, then one received byte if bit 0 is 0,
+ * or a 32-bit FNV-1a digest (little endian) of a packet if bit 0 is 1.
+ * tools/sio_trace.py summarizes a trace.
+ *****************************************************************************/
+
+#ifndef SIO_TRACE
+# define SIO_TRACE 0
+#endif
+
+#if SIO_TRACE
+
+/** Free running 32-bit clock, fine enough to tell bytes apart */
+#ifndef SIO_TRACE_CLOCK
+# define SIO_TRACE_CLOCK() OSTimeGet()
+# define SIO_TRACE_CLOCK_HZ OS_TICKS_PER_SEC
+#endif
+
+/** Bytes of RAM for a recording */
+#ifndef SIO_TRACE_SIZE
+# define SIO_TRACE_SIZE 4096
+#endif
+
+extern volatile u8_t sio_trace_on;
+
+/** Called by the RX ISR with every byte taken from the UART */
+#define SIO_TRACE_BYTE(c) \
+do { \
+	if (sio_trace_on) \
+		sio_trace_byte(c); \
+} while (0)
+
+void sio_trace_byte(u8_t c);
+
+/** Hook the input function of the netif PPP delivers packets to, called
+ * whenever the link comes up */
+void sio_trace_attach(struct netif *netif);
+
+/** Clear the recording and start recording */
+void sio_trace_start(void);
+
+void sio_trace_stop(void);
+
+/** Get the recording, which stays valid until sio_trace_start()
+ * @param len where its length in bytes is stored
+ * @return the trace, truncated if it outgrew SIO_TRACE_SIZE */
+const u8_t *sio_trace_get(u32_t *len);
+
+struct sio_trace_result {
+	u32_t	bytes;		/* bytes replayed */
+	u32_t	packets;	/* packets in the trace */
+	u32_t	decoded;	/* packets received during the replay */
+	u32_t	mismatches;	/* differing, missing or extra packets */
+	u32_t	elapsed;	/* clock ticks from the first byte to the last
+				   packet */
+	u32_t	clock_hz;
+};
+
+/** Replay a trace into the RX ring of the serial device, from a task with a
+ * lower priority than the reader. The reader must be running and the netif
+ * attached, e.g. PPP up with the options negotiated when recording. With
+ * TASK_PROF, task_prof_reset() before and task_prof_report() after tell the
+ * CPU time each thread spent on the packets.
+ * @param fd serial device handle
+ * @param trace the trace
+ * @param len its length in bytes
+ * @param timed 1 to keep the recorded gaps, 0 to go as fast as possible
+ * @param res where the result is stored
+ * @return 0 if successful, -1 if the trace is malformed */
+int sio_trace_replay(sio_fd_t fd, const u8_t *trace, u32_t len, u8_t timed,
+		struct sio_trace_result *res);
+
+/** Print a result with LWIP_PLATFORM_DIAG */
+void sio_trace_report(const struct sio_trace_result *res);
+
+/** Push bytes into the RX ring as if the UART received them
+ * @return number of bytes taken, less than 'len' if the ring is full or
+ * reception is paused */
+u32_t sio_inject(sio_fd_t fd, const u8_t *data, u32_t len);
+
+#else /* SIO_TRACE */
+
+#define SIO_TRACE_BYTE(c)
+
+#endif /* SIO_TRACE */
+
+#endif /* __ARCH_SIO_TRACE_H__ */
@@ -0,0 +1,79 @@
+#ifndef __ARCH_SUPERLOOP_H__
+#define __ARCH_SUPERLOOP_H__
+
+#include "lwip/opt.h"
+#include "lwip/sio.h"
+
+/*****************************************************************************
+ * NO_SYS superloop
+ *
+ * With NO_SYS 1 there is no tcpip thread, no mbox and no lwIP thread: one
+ * task runs the whole stack. superloop_poll() takes what the serial devices
+ * received with sio_tryread() and gives it to pppos_input(), which runs PPP
+ * and IP right there, then runs the lwIP timers which are due. Applications
+ * use the raw API from their callbacks and from sys_timeout().
+ *
+ * Nothing else may call lwIP, neither another task nor an ISR. lwipopts.h
+ * needs
+ *
+ *	#define NO_SYS			1
+ *	#define LWIP_NETCONN		0
+ *	#define LWIP_SOCKET		0
+ *	#define PPP_INPROC_OWNTHREAD	0
+ *	#define PPP_INPROC_MULTITHREADED 0
+ *
+ * sys_arch.c then only provides sys_now(), and arch/resolv.h and
+ * arch/tcpip_defer.h are left out. See examples/superloop_node.
+ *****************************************************************************/
+
+#if NO_SYS
+
+#if LWIP_NETCONN || LWIP_SOCKET
+# error "NO_SYS has no netconn nor socket API"
+#endif
+
+#if PPP_SUPPORT && PPPOS_SUPPORT && \
+    (PPP_INPROC_OWNTHREAD || PPP_INPROC_MULTITHREADED)
+# error "NO_SYS needs PPP_INPROC_OWNTHREAD and PPP_INPROC_MULTITHREADED 0"
+#endif
+
+/** Number of PPP links polled */
+#ifndef SUPERLOOP_LINKS
+# define SUPERLOOP_LINKS 1
+#endif
+
+/** Bytes read from a serial device at a time */
+#ifndef SUPERLOOP_READ_SIZE
+# define SUPERLOOP_READ_SIZE 64
+#endif
+
+/** Ticks the loop sleeps when a poll found nothing to do, which is also the
+ * most a received byte waits */
+#ifndef SUPERLOOP_IDLE_TICKS
+# define SUPERLOOP_IDLE_TICKS 1
+#endif
+
+/** Initialize the port and lwIP, instead of tcpip_init() */
+void superloop_init(void);
+
+/** Poll the serial device of a PPP link
+ * @param fd serial device handle given to pppOverSerialOpen()
+ * @param pd PPP descriptor pppOverSerialOpen() returned
+ * @return ERR_OK if successful, ERR_MEM if SUPERLOOP_LINKS are polled */
+err_t superloop_add_ppp(sio_fd_t fd, int pd);
+
+/** Stop polling a PPP link, before pppClose() */
+void superloop_remove_ppp(int pd);
+
+/** Feed each link what it received, then run the lwIP timers which are due
+ * @return number of bytes fed */
+u32_t superloop_poll(void);
+
+/** Poll until *stop is set, sleeping SUPERLOOP_IDLE_TICKS whenever a poll
+ * found nothing
+ * @param stop set by a callback, e.g. the PPP link status one */
+void superloop_run(const volatile u8_t *stop);
+
+#endif /* NO_SYS */
+
+#endif /* __ARCH_SUPERLOOP_H__ */
@@ -38,6 +38,27 @@ do { \
 		*(sem) = NULL; \
 } while (0)
 
+/** Keep up to SYS_SEM_CACHE freed semaphores for reuse, so that the
+ * semaphore every netconn and every blocking socket call of lwIP 1.4 opens
+ * isn't created and deleted in the kernel each time */
+#ifndef SYS_SEM_CACHE
+# define SYS_SEM_CACHE 0
+#endif
+
+#if SYS_SEM_CACHE > 0
+# if OS_SEM_SET_EN <= 0
+#  error "SYS_SEM_CACHE needs OS_SEM_SET_EN"
+# endif
+
+struct sys_sem_cache_stats {
+	u32_t	hits;	/* sys_sem_new() served from the cache */
+	u32_t	misses;	/* sys_sem_new() which had to create a semaphore */
+	u16_t	cached;	/* semaphores in the cache now */
+};
+
+void sys_sem_cache_get_stats(struct sys_sem_cache_stats *st);
+#endif /* SYS_SEM_CACHE > 0 */
+
 /*****************************************************************************
  * sys_mbox
  *****************************************************************************/
@@ -66,6 +87,60 @@ do { \
 		*(mbox) = NULL; \
 } while (0)
 
+/** Keep up to SYS_MBOX_CACHE freed mboxes with their OS queue and
+ * semaphore for reuse, SYS_MBOX_CACHE_WARM of which are built by sys_init() */
+#ifndef SYS_MBOX_CACHE
+# define SYS_MBOX_CACHE 0
+#endif
+
+#if SYS_MBOX_CACHE > 0
+# ifndef SYS_MBOX_CACHE_WARM
+#  define SYS_MBOX_CACHE_WARM 0
+# endif
+# if SYS_MBOX_CACHE_WARM > SYS_MBOX_CACHE
+#  error "SYS_MBOX_CACHE_WARM is bigger than SYS_MBOX_CACHE"
+# endif
+
+struct sys_mbox_cache_stats {
+	u32_t	hits;	/* sys_mbox_new() served from the cache */
+	u32_t	misses;	/* sys_mbox_new() which had to build an mbox */
+	u16_t	cached;	/* mboxes in the cache now */
+};
+
+void sys_mbox_cache_get_stats(struct sys_mbox_cache_stats *st);
+#endif /* SYS_MBOX_CACHE > 0 */
+
+/** Throttle the link when the tcpip thread falls behind: once the tcpip mbox
+ * holds SYS_BACKPRESSURE_HIGH messages (or the pbuf pool is
+ * SYS_BACKPRESSURE_POOL_HIGH percent used, with SYS_BACKPRESSURE_POOL), the
+ * function given to sys_backpressure_set() is asked to stop input, and it is
+ * asked to resume once the backlog is down to SYS_BACKPRESSURE_LOW (and the
+ * pool to SYS_BACKPRESSURE_POOL_LOW). The message watermarks default to 3/4
+ * and 1/4 of the slots of an mbox, which hold the largest of the mbox sizes
+ * of lwipopts.h. */
+#ifndef SYS_BACKPRESSURE
+# define SYS_BACKPRESSURE 0
+#endif
+
+#if SYS_BACKPRESSURE
+/** Watch the pbuf pool as well, which reads lwIP's memp counters */
+# ifndef SYS_BACKPRESSURE_POOL
+#  define SYS_BACKPRESSURE_POOL (LWIP_STATS && MEMP_STATS)
+# endif
+# if SYS_BACKPRESSURE_POOL && !(LWIP_STATS && MEMP_STATS)
+#  error "SYS_BACKPRESSURE_POOL needs LWIP_STATS and MEMP_STATS"
+# endif
+# ifndef SYS_BACKPRESSURE_POOL_HIGH
+#  define SYS_BACKPRESSURE_POOL_HIGH 75
+# endif
+# ifndef SYS_BACKPRESSURE_POOL_LOW
+#  define SYS_BACKPRESSURE_POOL_LOW 50
+# endif
+
+void sys_backpressure_set(void (*fn)(void *arg, u8_t on), void *arg);
+u32_t sys_backpressure_drops(void);
+#endif /* SYS_BACKPRESSURE */
+
 /*****************************************************************************
  * sys_thread
  *****************************************************************************/
@@ -74,6 +149,15 @@ typedef INT8U		sys_thread_t;
 
 void sys_thread_free(sys_thread_t id);
 
+#if PPP_THREAD_STACKSIZE > 0
+/** Get the PPP thread which the calling task started with
+ * pppOverSerialOpen(). lwIP 1.4 lets that thread return once the link is
+ * dead, which a uC/OS-II task mustn't do, so the link status callback frees
+ * it. A task opens one PPP session at a time.
+ * @return its priority, OS_PRIO_SELF if none of its PPP threads runs */
+sys_thread_t sys_thread_ppp(void);
+#endif
+
 /*****************************************************************************
  * time
  *****************************************************************************/
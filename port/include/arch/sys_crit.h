@@ -0,0 +1,122 @@
+#ifndef __ARCH_SYS_CRIT_H__
+#define __ARCH_SYS_CRIT_H__
+
+/*****************************************************************************
+ * Critical sections of SYS_ARCH_PROTECT()
+ *
+ * Included by cc.h, after lwipopts.h. SYS_CRIT picks how the port and lwIP
+ * keep interrupts out of their critical sections:
+ *
+ * - SYS_CRIT_MASK_ALL: OS_CPU_SR_Save() masks every interrupt, as uC/OS-II
+ *   itself does.
+ * - SYS_CRIT_THRESHOLD: only the interrupts at or below a priority threshold
+ *   are masked (BASEPRI on Cortex-M3), so the ones above it, e.g. motor
+ *   control, keep their latency. Those must not call uC/OS-II or lwIP. The
+ *   application supplies crit_cpu.h:
+ *
+ *	crit_cpu_t			type of the saved mask
+ *	crit_cpu_t crit_cpu_raise(void)	mask up to the threshold, return the
+ *					previous mask
+ *	void crit_cpu_restore(crit_cpu_t)
+ *
+ * The kernel's own critical sections still mask every interrupt. Setting
+ * SIO_LOCKFREE takes the sio.c rings out of these sections altogether.
+ *
+ * With SYS_CRIT_MEASURE, a debug build, every section records the cycles
+ * from SYS_ARCH_PROTECT() to SYS_ARCH_UNPROTECT(), and the longest and the
+ * count are kept for each SYS_ARCH_PROTECT() call site, lwIP's included.
+ * Bookkeeping on exit lengthens each section by a table lookup.
+ *****************************************************************************/
+
+#define SYS_CRIT_MASK_ALL	0
+#define SYS_CRIT_THRESHOLD	1
+
+#ifndef SYS_CRIT
+# define SYS_CRIT SYS_CRIT_MASK_ALL
+#endif
+
+#ifndef SYS_CRIT_MEASURE
+# define SYS_CRIT_MEASURE 0
+#endif
+
+#if SYS_CRIT == SYS_CRIT_MASK_ALL
+# if OS_CRITICAL_METHOD != 3
+#  error "not supported"
+# endif
+typedef OS_CPU_SR sys_crit_t;
+# define __SYS_CRIT_ENTER()	OS_CPU_SR_Save()
+# define __SYS_CRIT_EXIT(x)	OS_CPU_SR_Restore(x)
+#elif SYS_CRIT == SYS_CRIT_THRESHOLD
+# include "crit_cpu.h"
+typedef crit_cpu_t sys_crit_t;
+# define __SYS_CRIT_ENTER()	crit_cpu_raise()
+# define __SYS_CRIT_EXIT(x)	crit_cpu_restore(x)
+#else
+# error "SYS_CRIT must be SYS_CRIT_MASK_ALL or SYS_CRIT_THRESHOLD"
+#endif
+
+#if SYS_CRIT_MEASURE
+
+/** Read a free running 32-bit cycle counter, TASK_PROF_CYCLES() by default */
+#ifndef SYS_CRIT_CYCLES
+# if defined(TASK_PROF_CYCLES)
+#  define SYS_CRIT_CYCLES() TASK_PROF_CYCLES()
+# else
+#  error "SYS_CRIT_MEASURE needs SYS_CRIT_CYCLES()"
+# endif
+#endif
+
+/** Number of call sites recorded, the others are only counted */
+#ifndef SYS_CRIT_SITES
+# define SYS_CRIT_SITES 32
+#endif
+
+struct sys_crit {
+	sys_crit_t	sr;
+	u32_t		t0;
+	const char	*file;
+	u16_t		line;
+};
+
+struct sys_crit_site {
+	const char	*file;	/* NULL for a free entry */
+	u16_t		line;
+	u32_t		count;
+	u32_t		max;	/* longest section in cycles */
+};
+
+# define SYS_ARCH_DECL_PROTECT(x)	struct sys_crit x
+# define SYS_ARCH_PROTECT(x) \
+do { \
+	(x).sr = __SYS_CRIT_ENTER(); \
+	(x).file = __FILE__; \
+	(x).line = __LINE__; \
+	(x).t0 = SYS_CRIT_CYCLES(); \
+} while (0)
+# define SYS_ARCH_UNPROTECT(x)		sys_crit_exit(&(x))
+
+/** Record a section and leave it, for SYS_ARCH_UNPROTECT() */
+void sys_crit_exit(struct sys_crit *c);
+
+/** Copy a call site
+ * @param i index of the site, from 0
+ * @param site where the site is stored
+ * @return 0 once 'i' is past the last site */
+u8_t sys_crit_get_site(u8_t i, struct sys_crit_site *site);
+
+/** Print every call site with LWIP_PLATFORM_DIAG, as
+ * "crit <file>:<line> <max cycles> <count>" */
+void sys_crit_report(void);
+
+/** Clear the call sites */
+void sys_crit_reset(void);
+
+#else /* SYS_CRIT_MEASURE */
+
+# define SYS_ARCH_DECL_PROTECT(x)	sys_crit_t x
+# define SYS_ARCH_PROTECT(x)		x = __SYS_CRIT_ENTER()
+# define SYS_ARCH_UNPROTECT(x)		__SYS_CRIT_EXIT(x)
+
+#endif /* SYS_CRIT_MEASURE */
+
+#endif /* __ARCH_SYS_CRIT_H__ */
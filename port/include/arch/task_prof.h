@@ -0,0 +1,74 @@
+#ifndef __ARCH_TASK_PROF_H__
+#define __ARCH_TASK_PROF_H__
+
+#include "lwip/opt.h"
+
+/*****************************************************************************
+ * Per-task CPU time and scheduling latency
+ *
+ * The context switch hook reads a free running cycle counter and charges the
+ * cycles since the previous switch to the task being switched out. A task
+ * switched out while still ready was preempted; it is timestamped as ready,
+ * as is any task the hooks find ready but not running, and the time until it
+ * is switched in is its ready-to-run latency. A task which runs right after
+ * it was made ready counts a latency of 0.
+ *
+ * The port must call task_prof_switch() from OSTaskSwHook() (App_TaskSwHook()
+ * with OS_APP_HOOKS_EN), and should call task_prof_tick() from
+ * OSTimeTickHook(), which catches tasks waiting behind a higher priority one
+ * that runs without switching.
+ *****************************************************************************/
+
+#ifndef TASK_PROF
+# define TASK_PROF 0
+#endif
+
+#if TASK_PROF
+
+/** Read a free running 32-bit cycle counter, such as DWT_CYCCNT */
+#ifndef TASK_PROF_CYCLES
+# error "TASK_PROF_CYCLES isn't defined"
+#endif
+
+/** Start the cycle counter, if it needs to be */
+#ifndef TASK_PROF_CYCLES_INIT
+# define TASK_PROF_CYCLES_INIT()
+#endif
+
+/** Number of tasks profiled separately, the others are added up together */
+#ifndef TASK_PROF_SLOTS
+# define TASK_PROF_SLOTS 8
+#endif
+
+struct task_prof_stats {
+	u8_t			prio;	/* OS_PRIO_SELF for the other tasks */
+	u32_t			switches;	/* times switched in */
+	u32_t			preemptions;	/* switched out while ready */
+	unsigned long long	run;	/* cycles spent running */
+	unsigned long long	latency;	/* sum of the latencies */
+	u32_t			max_latency;	/* in cycles */
+};
+
+void task_prof_init(void);
+
+/** Called from the context switch hook, with interrupts disabled */
+void task_prof_switch(void);
+
+/** Called from the tick hook */
+void task_prof_tick(void);
+
+/** Clear the counters */
+void task_prof_reset(void);
+
+/** Read the counters of a task, in the order the tasks first ran
+ * @param idx index of the task, 0 being the first, TASK_PROF_SLOTS the others
+ * @param st where the counters are stored
+ * @return 0 if successful, -1 if there is no such task */
+int task_prof_get_stats(u8_t idx, struct task_prof_stats *st);
+
+/** Print the share of CPU time and the latencies with LWIP_PLATFORM_DIAG */
+void task_prof_report(void);
+
+#endif /* TASK_PROF */
+
+#endif /* __ARCH_TASK_PROF_H__ */
@@ -0,0 +1,110 @@
+#ifndef __ARCH_TCP_PPP_H__
+#define __ARCH_TCP_PPP_H__
+
+/*****************************************************************************
+ * TCP options sized for a PPP link over a serial port
+ *
+ * Included at the end of lwipopts.h, after LWIP_TCP, the pbuf pool and the
+ * link parameters below, so it only uses the preprocessor. Anything defined
+ * before it is kept.
+ *
+ * A segment is kept short enough to cross the link in TCP_PPP_SEG_MS, which
+ * bounds the delay it adds to the packets behind it. The send buffer holds
+ * one bandwidth-delay product: less leaves the link idle while waiting for
+ * ACKs, more only queues in the modem and inflates the RTT. The receive
+ * window is what half the pbuf pool holds, as PPPoS receives into the pool.
+ *
+ * The ACK of a segment leaves the peer TCP_PPP_RTT_MS after the segment's
+ * last byte left the node, or one segment later if the peer acks every
+ * second segment, and while it is on its way the link must stay busy. So
+ * the buffer holds what the link carries in TCP_PPP_RTT_MS, plus the
+ * segment being acked and the one the peer waited for. The link carries
+ * TCP_MSS bytes of data in every TCP_MSS + 48 bytes it sends: 40 of IP and
+ * TCP headers, 8 of PPP framing. Escapes, under 1% of random data, are
+ * left out.
+ *
+ * With MEM_ARCH, every queued segment is one block of the smallest class of
+ * at least TCP_PPP_SEG_BLOCK bytes, so that class needs TCP_PPP_SEGS blocks
+ * plus the ones used by other traffic.
+ *****************************************************************************/
+
+#if LWIP_TCP
+
+/** Bits per second of the slower of the serial port and the radio uplink */
+#ifndef TCP_PPP_LINK_BPS
+# define TCP_PPP_LINK_BPS 115200
+#endif
+
+/** Round trip time of the idle link in milliseconds */
+#ifndef TCP_PPP_RTT_MS
+# define TCP_PPP_RTT_MS 400
+#endif
+
+/** Longest time a segment may hold the link in milliseconds */
+#ifndef TCP_PPP_SEG_MS
+# define TCP_PPP_SEG_MS 40
+#endif
+
+/** MRU negotiated by PPP, PPP_MRU of lwIP */
+#ifndef TCP_PPP_MRU
+# define TCP_PPP_MRU 1500
+#endif
+
+/* 10 bits a byte, 8N1 */
+#define TCP_PPP_BYTES_PER_SEC	(TCP_PPP_LINK_BPS / 10)
+#define TCP_PPP_PKT_LEN \
+	(TCP_PPP_BYTES_PER_SEC * TCP_PPP_SEG_MS / 1000 < TCP_PPP_MRU ? \
+	 TCP_PPP_BYTES_PER_SEC * TCP_PPP_SEG_MS / 1000 : TCP_PPP_MRU)
+
+/* IP and TCP headers without options */
+#ifndef TCP_MSS
+# define TCP_MSS (TCP_PPP_PKT_LEN - 40)
+#endif
+
+/** Bytes of data in flight for the link never to wait for an ACK */
+#define TCP_PPP_BDP \
+	(TCP_PPP_BYTES_PER_SEC * TCP_PPP_RTT_MS / 1000 * TCP_MSS / \
+	 (TCP_MSS + 48) + 2 * TCP_MSS)
+
+/** Segments in flight, one bandwidth-delay product */
+#define TCP_PPP_SEGS ((TCP_PPP_BDP + TCP_MSS - 1) / TCP_MSS)
+
+/** Bytes of a queued segment: its data, the headers reserved in front of it
+ * (PBUF_LINK_HLEN, IP and TCP) and struct pbuf */
+#define TCP_PPP_SEG_BLOCK (TCP_MSS + 14 + 40 + 16)
+
+#ifndef TCP_SND_BUF
+# define TCP_SND_BUF (TCP_PPP_SEGS * TCP_MSS)
+#endif
+
+/* lwIP wants two pbufs per segment */
+#ifndef TCP_SND_QUEUELEN
+# define TCP_SND_QUEUELEN (2 * TCP_PPP_SEGS)
+#endif
+
+#ifndef MEMP_NUM_TCP_SEG
+# define MEMP_NUM_TCP_SEG TCP_SND_QUEUELEN
+#endif
+
+#ifndef TCP_WND
+# define TCP_WND \
+	(PBUF_POOL_SIZE * PBUF_POOL_BUFSIZE / 2 / TCP_MSS * TCP_MSS < TCP_SND_BUF ? \
+	 PBUF_POOL_SIZE * PBUF_POOL_BUFSIZE / 2 / TCP_MSS * TCP_MSS : TCP_SND_BUF)
+#endif
+
+/* PPP delivers in order, a segment out of order was preceded by a loss and
+ * buffering it would pin pool pbufs for a retransmission timeout */
+#ifndef TCP_QUEUE_OOSEQ
+# define TCP_QUEUE_OOSEQ 0
+#endif
+
+#if TCP_MSS < 64
+# error "TCP_PPP_SEG_MS leaves no room for data"
+#endif
+#if TCP_WND < TCP_MSS
+# error "The pbuf pool can't hold a TCP window"
+#endif
+
+#endif /* LWIP_TCP */
+
+#endif /* __ARCH_TCP_PPP_H__ */
@@ -0,0 +1,65 @@
+#ifndef __ARCH_TCPIP_DEFER_H__
+#define __ARCH_TCPIP_DEFER_H__
+
+#include "lwip/opt.h"
+#include "lwip/tcpip.h"
+
+/*****************************************************************************
+ * Deferring work from an interrupt into the tcpip thread
+ *
+ * A tcpip_defer queue is a fixed ring of (function, argument) pairs with one
+ * producer, normally an ISR, and the tcpip thread as its consumer. Queueing
+ * neither allocates nor masks interrupts. The first entry queued after the
+ * ring was drained posts one preallocated message to the tcpip thread, which
+ * then runs every queued entry in a batch. Should the tcpip mbox be full, the
+ * tcpip thread drains the queue itself the next time it fetches its mbox.
+ *
+ * The ISR must be wrapped in OSIntEnter()/OSIntExit(). Each interrupt source
+ * needs its own queue.
+ *****************************************************************************/
+
+/** Number of entries of a queue, must be a power of 2 */
+#ifndef TCPIP_DEFER_SIZE
+# define TCPIP_DEFER_SIZE 16
+#endif
+
+#if (TCPIP_DEFER_SIZE & (TCPIP_DEFER_SIZE - 1)) != 0
+# error "TCPIP_DEFER_SIZE isn't a power of 2"
+#endif
+
+struct tcpip_defer {
+	volatile struct {
+		tcpip_callback_fn	fn;
+		void			*arg;
+	}				slot[TCPIP_DEFER_SIZE];
+	volatile u16_t			head;	/* written by the producer */
+	volatile u16_t			tail;	/* written by the consumer */
+	volatile u8_t			pending;/* the message is posted */
+	volatile u8_t			lost;	/* its post failed */
+	struct tcpip_callback_msg	*msg;
+	struct tcpip_defer		*next;	/* list of the queues */
+
+	/* statistics */
+	u32_t				drops;	/* queue full */
+	u32_t				wakeup_fails;
+	u32_t				batches;
+	u16_t				max_batch;
+};
+
+/** Prepare a queue, called from a task after tcpip_init()
+ * @param q the queue
+ * @return ERR_OK if successful, ERR_MEM if no message could be allocated */
+err_t tcpip_defer_init(struct tcpip_defer *q);
+
+/** Queue fn(arg) to run in the tcpip thread, callable from an ISR
+ * @param q the queue owned by the caller
+ * @param fn the function
+ * @param arg argument passed to 'fn'
+ * @return ERR_OK if queued, ERR_MEM if the queue is full */
+err_t tcpip_defer(struct tcpip_defer *q, tcpip_callback_fn fn, void *arg);
+
+/** Drain the queues whose wakeup could not be posted, called by
+ * sys_arch_mbox_fetch() in the tcpip thread */
+void tcpip_defer_poll(void);
+
+#endif /* __ARCH_TCPIP_DEFER_H__ */
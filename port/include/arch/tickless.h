@@ -0,0 +1,77 @@
+#ifndef __ARCH_TICKLESS_H__
+#define __ARCH_TICKLESS_H__
+
+#include "lwip/opt.h"
+
+/*****************************************************************************
+ * Tickless idle
+ *
+ * Every timeout of the port, lwIP's timers included, ends up as the delay of
+ * a task blocked in uC/OS-II: the tcpip thread waits on its mbox until the
+ * next lwIP timer, and sys_arch_sem_wait() and sys_arch_mbox_fetch() pend
+ * with a timeout. When every task is blocked, tickless_idle() finds the
+ * shortest of these delays, stops the periodic tick and programs the tick
+ * timer to fire once when it expires, then sleeps. On wakeup, by that timer
+ * or by any other interrupt, it adds the ticks which passed to OSTime and to
+ * the delays, so sys_now() and the timeouts carry on as if the tick had
+ * kept running. With TIMER_WHEEL, it doesn't sleep past the next timer
+ * either.
+ *
+ * The port must call tickless_idle() from OSTaskIdleHook() (App_TaskIdleHook()
+ * with OS_APP_HOOKS_EN). The application supplies tickless_cpu.h, which
+ * drives the tick timer:
+ *
+ *	u32_t tickless_cpu_max(void)	most ticks the timer can count at once
+ *	void tickless_cpu_start(u32_t ticks)
+ *				stop the periodic tick, interrupt once 'ticks'
+ *				ticks after the last one
+ *	void tickless_cpu_sleep(void)	sleep until an interrupt is pending,
+ *				called with every interrupt masked by
+ *				OS_CPU_SR_Save() whatever SYS_CRIT is (WFI)
+ *	u32_t tickless_cpu_stop(u32_t ticks)
+ *				restart the periodic tick in phase and return
+ *				the whole ticks which passed, less the one the
+ *				tick interrupt delivers if it fired
+ *
+ * The CPU usage of OSTaskStat() doesn't count the time asleep.
+ *****************************************************************************/
+
+#ifndef TICKLESS
+# define TICKLESS 0
+#endif
+
+#if TICKLESS
+
+/** Shortest sleep worth stopping the tick for, shorter ones sleep until the
+ * next tick */
+#ifndef TICKLESS_MIN_TICKS
+# define TICKLESS_MIN_TICKS 2
+#endif
+
+/** Longest sleep, also when no task waits with a timeout */
+#ifndef TICKLESS_MAX_TICKS
+# define TICKLESS_MAX_TICKS (10 * OS_TICKS_PER_SEC)
+#endif
+
+struct tickless_stats {
+	u32_t	sleeps;		/* times the CPU slept, each ends with a wakeup */
+	u32_t	tickless;	/* sleeps with the tick stopped */
+	u32_t	early;		/* of them, woken before the timer */
+	u32_t	ticks_slept;	/* ticks skipped while the tick was stopped */
+	u32_t	ticks;		/* OSTime when the counters were read */
+};
+
+/** Called from the idle task hook */
+void tickless_idle(void);
+
+/** Copy the counters
+ * @param st where the counters are stored */
+void tickless_get_stats(struct tickless_stats *st);
+
+/** Print the wakeups per second since the previous call with
+ * LWIP_PLATFORM_DIAG */
+void tickless_report(void);
+
+#endif /* TICKLESS */
+
+#endif /* __ARCH_TICKLESS_H__ */
@@ -0,0 +1,118 @@
+#ifndef __ARCH_TIMER_WHEEL_H__
+#define __ARCH_TIMER_WHEEL_H__
+
+#include "lwip/opt.h"
+
+/*****************************************************************************
+ * Timers on a hierarchical timer wheel
+ *
+ * Periodic or one-shot work without a task of its own sleeping in
+ * OSTimeDly(). The caller owns each struct timer_wheel_entry, so starting
+ * and stopping a timer only links or unlinks it in a slot: O(1), with
+ * interrupts masked for a few instructions.
+ *
+ * The wheel has 256 slots of one tick and 64 slots of 256 ticks. Later
+ * timers wait in an overflow list, and each level is cascaded into the one
+ * below when it wraps. timer_wheel_tick(), called from OSTimeTickHook(),
+ * moves the timers of the slot due to the list of their target. The first
+ * one moved wakes that target, which then runs the whole batch:
+ *
+ * - TIMER_WHEEL_TCPIP: the tcpip thread, through a tcpip_defer queue. The
+ *   callbacks may use the raw API but must not block.
+ * - TIMER_WHEEL_WORKER: a task at TIMER_WHEEL_WORKER_PRIO, shared by all the
+ *   timers. Its callbacks may block, delaying the timers behind them.
+ *
+ * With TICKLESS, tickless_idle() doesn't sleep past the next slot in use,
+ * and the ticks it skipped are run by the next timer_wheel_tick().
+ *
+ * lwIP's own timers stay on the sys_timeout() list of lwIP 1.4's timers.c:
+ * its timers.h turns LWIP_TIMERS on whenever NO_SYS is 0, so sys_timeout()
+ * can't be taken over without patching lwIP. The tcpip thread runs that list
+ * while it waits on its mbox, which takes no task of its own. The timeouts
+ * of the port, the retries of resolv.c, and of the application are on the
+ * wheel. examples/timer_wheel_bench compares their jitter with a task in
+ * OSTimeDly().
+ *****************************************************************************/
+
+#ifndef TIMER_WHEEL
+# define TIMER_WHEEL 0
+#endif
+
+#if TIMER_WHEEL
+
+#if NO_SYS
+# error "TIMER_WHEEL delivers to the tcpip thread, use sys_timeout() with NO_SYS"
+#endif
+
+/** Priority of the worker task, 0 for no worker */
+#ifndef TIMER_WHEEL_WORKER_PRIO
+# define TIMER_WHEEL_WORKER_PRIO 0
+#endif
+
+#ifndef TIMER_WHEEL_WORKER_STACKSIZE
+# define TIMER_WHEEL_WORKER_STACKSIZE 256
+#endif
+
+#define TIMER_WHEEL_TCPIP	0
+#define TIMER_WHEEL_WORKER	1
+
+typedef void (*timer_wheel_fn)(void *arg);
+
+struct timer_wheel_entry {
+	/* private */
+	struct timer_wheel_entry	*next;
+	struct timer_wheel_entry	**pprev;
+	u32_t				expires;	/* in ticks */
+	u32_t				period;		/* 0 for one-shot */
+	timer_wheel_fn			fn;
+	void				*arg;
+	u8_t				target;
+	u8_t				state;
+};
+
+struct timer_wheel_stats {
+	u32_t	fired;
+	u32_t	batches;
+	u32_t	max_batch;
+	u32_t	late_max;	/* ticks from expiry to the callback */
+	u32_t	late_sum;
+	u32_t	cascaded;	/* timers moved down a level */
+};
+
+/** Start the service, called from a task after tcpip_init()
+ * @return ERR_OK if successful, ERR_MEM if no tcpip message could be
+ * allocated */
+err_t timer_wheel_init(void);
+
+/** Called from OSTimeTickHook() */
+void timer_wheel_tick(void);
+
+/** Prepare a timer, which must be stopped
+ * @param t the timer
+ * @param fn called when it expires
+ * @param arg passed to 'fn'
+ * @param target TIMER_WHEEL_TCPIP or TIMER_WHEEL_WORKER */
+void timer_wheel_setup(struct timer_wheel_entry *t, timer_wheel_fn fn,
+		void *arg, u8_t target);
+
+/** (Re)start a timer, callable from an ISR and from its own callback
+ * @param t the timer
+ * @param ms time until it expires
+ * @param period_ms time between the expiries after that, 0 for one-shot */
+void timer_wheel_start(struct timer_wheel_entry *t, u32_t ms, u32_t period_ms);
+
+/** Stop a timer, its callback won't be called unless it is already running
+ * @param t the timer */
+void timer_wheel_stop(struct timer_wheel_entry *t);
+
+/** Ticks until the next slot in use, for tickless_idle()
+ * @param max the most worth knowing */
+u32_t timer_wheel_next(u32_t max);
+
+/** Copy the counters
+ * @param st where the counters are stored */
+void timer_wheel_get_stats(struct timer_wheel_stats *st);
+
+#endif /* TIMER_WHEEL */
+
+#endif /* __ARCH_TIMER_WHEEL_H__ */
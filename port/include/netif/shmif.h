@@ -0,0 +1,105 @@
+#ifndef __NETIF_SHMIF_H__
+#define __NETIF_SHMIF_H__
+
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "arch/tcpip_defer.h"
+
+/*****************************************************************************
+ * IP over a pair of descriptor rings in shared memory
+ *
+ * Each direction is a single-producer/single-consumer ring of fixed slots.
+ * Received packets are handed to the stack in place, as custom pbufs which
+ * release their slot when freed. Sent packets are copied into a slot once,
+ * or dropped when the ring is full, as an Ethernet MAC would.
+ * The peer is notified through a doorbell callback; the doorbell interrupt of
+ * this side calls shmif_irq(), or the owner polls with shmif_poll().
+ *
+ * Both sides must be built with the same SHMIF_RING_SIZE and SHMIF_MTU.
+ *****************************************************************************/
+
+#ifndef SHMIF_RING_SIZE
+# define SHMIF_RING_SIZE 8
+#endif
+
+#if (SHMIF_RING_SIZE & (SHMIF_RING_SIZE - 1)) != 0
+# error "SHMIF_RING_SIZE isn't a power of 2"
+#endif
+
+#ifndef SHMIF_MTU
+# define SHMIF_MTU 1500
+#endif
+
+/** Full memory barrier between the producer and the consumer cores */
+#ifndef SHMIF_MB
+# ifdef __GNUC__
+#  define SHMIF_MB() __sync_synchronize()
+# else
+#  error "SHMIF_MB isn't defined"
+# endif
+#endif
+
+#define SHMIF_MAGIC 0x73686d31UL /* "shm1" */
+
+struct shmif_ring {
+	volatile u32_t	head;	/* next slot the producer fills */
+	volatile u32_t	tail;	/* next slot the consumer releases */
+	volatile u16_t	len[SHMIF_RING_SIZE];
+	u32_t		data[SHMIF_RING_SIZE][(SHMIF_MTU + 3) / 4];
+};
+
+/** The shared memory region */
+struct shmif_shm {
+	volatile u32_t		magic;
+	struct shmif_ring	ring[2];
+};
+
+struct shmif;
+
+/** Notify the peer of new packets */
+typedef void (*shmif_kick_fn)(struct shmif *shmif);
+
+/** One end of the link, passed to netif_add() as the state */
+struct shmif {
+	struct shmif_shm	*shm;
+	u8_t			side;	/* 0 or 1, the peer uses the other */
+	shmif_kick_fn		kick;
+
+	/* private */
+	struct netif		*netif;
+	u32_t			next;	/* next slot to receive */
+	u8_t			released[SHMIF_RING_SIZE];
+	struct shmif_pbuf {
+		struct pbuf_custom	pc;
+		struct shmif		*shmif;
+		u32_t			seq;
+	}			rx[SHMIF_RING_SIZE];
+#if !NO_SYS
+	struct tcpip_defer	defer;
+#endif
+
+	/* statistics */
+	u32_t			rx_packets;
+	u32_t			tx_packets;
+	u32_t			tx_full;	/* dropped, the ring was full */
+	u32_t			tx_toobig;
+};
+
+/** Clear the shared region, done by exactly one side before either side
+ * calls shmif_init() */
+void shmif_shm_init(struct shmif_shm *shm);
+
+/** netif init function, netif->state must point to a struct shmif */
+err_t shmif_init(struct netif *netif);
+
+/** Receive all pending packets, called in the tcpip thread (or the main loop
+ * if NO_SYS) */
+void shmif_poll(struct shmif *shmif);
+
+#if !NO_SYS
+/** Called from the doorbell ISR of this side */
+void shmif_irq(struct shmif *shmif);
+#endif
+
+#endif /* __NETIF_SHMIF_H__ */
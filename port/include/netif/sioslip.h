@@ -0,0 +1,69 @@
+#ifndef __NETIF_SIOSLIP_H__
+#define __NETIF_SIOSLIP_H__
+
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/sio.h"
+
+/*****************************************************************************
+ * IP over SLIP (RFC 1055) on a serial device of port/netif/sio.c
+ *
+ * Unlike lwIP's slipif, which moves one byte per sio_recv()/sio_send() call,
+ * the receive thread takes what the ring holds with sio_read() (a whole frame
+ * with SIO_FRAME_READ) and decodes it straight into a PBUF_POOL chain, grown
+ * a pbuf at a time as the frame comes in, and a packet is encoded into a
+ * small buffer written with sio_write(). There is no negotiation and no
+ * checksum: the link is up as soon as the netif is.
+ *
+ * The receive thread runs at SLIPIF_THREAD_PRIO on the stack sys_arch.c keeps
+ * for it, so there is one link per build. With NO_SYS, the main loop calls
+ * sioslip_poll() instead.
+ *****************************************************************************/
+
+/** Largest packet, both sides must agree */
+#ifndef SIOSLIP_MTU
+# define SIOSLIP_MTU 1006
+#endif
+
+/** Bytes taken from the serial ring at a time */
+#ifndef SIOSLIP_READ_SIZE
+# define SIOSLIP_READ_SIZE 64
+#endif
+
+/** Bytes encoded before each sio_write() */
+#ifndef SIOSLIP_WRITE_SIZE
+# define SIOSLIP_WRITE_SIZE 64
+#endif
+
+/** One end of the link, passed to netif_add() as the state */
+struct sioslip {
+	u8_t		devnum;	/* for sio_open() */
+
+	/* private */
+	struct netif	*netif;
+	sio_fd_t	fd;
+	struct pbuf	*rx;	/* the frame being received */
+	struct pbuf	*q;	/* the pbuf of 'rx' being filled */
+	u16_t		off;	/* in 'q' */
+	u16_t		len;	/* of the frame so far */
+	u8_t		esc;	/* the previous byte was ESC */
+	u8_t		drop;	/* discard until the next END */
+	u8_t		rbuf[SIOSLIP_READ_SIZE];
+	u8_t		wbuf[SIOSLIP_WRITE_SIZE];
+
+	/* statistics */
+	u32_t		rx_packets;
+	u32_t		rx_drops;	/* too long or out of pbufs */
+	u32_t		tx_packets;
+};
+
+/** netif init function, netif->state must point to a struct sioslip */
+err_t sioslip_init(struct netif *netif);
+
+#if NO_SYS
+/** Decode what the serial device received, called from the main loop */
+void sioslip_poll(struct sioslip *s);
+#endif
+
+#endif /* __NETIF_SIOSLIP_H__ */
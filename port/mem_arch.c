@@ -0,0 +1,161 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "arch/mem_arch.h"
+
+#if MEM_ARCH
+
+#include "ucos_ii.h"
+
+#include <string.h>
+
+/* Every block starts with the class it belongs to */
+#define __MEM_ARCH_HDR_SIZE LWIP_MEM_ALIGN_SIZE(sizeof(void *))
+
+#define __MEM_ARCH_BLK_WORDS(size) \
+	((LWIP_MEM_ALIGN_SIZE(size) + __MEM_ARCH_HDR_SIZE + sizeof(u32_t) - 1) / \
+	 sizeof(u32_t))
+
+#define MEM_ARCH_CLASS(size, nblks) \
+	static u32_t __mem_arch_pool_##size[nblks][__MEM_ARCH_BLK_WORDS(size)];
+MEM_ARCH_CLASSES
+#undef MEM_ARCH_CLASS
+
+static struct __mem_arch_class {
+	void		*pool;
+	OS_MEM		*mem;
+	u16_t		size;
+	u16_t		nblks;
+	u16_t		blk_size;	/* in bytes, header included */
+	u16_t		used;
+	u16_t		peak;
+	u32_t		fails;
+	u32_t		spills;
+} __mem_arch_class[] = {
+#define MEM_ARCH_CLASS(size, nblks) \
+	{ __mem_arch_pool_##size, NULL, size, nblks, \
+	  __MEM_ARCH_BLK_WORDS(size) * sizeof(u32_t) },
+	MEM_ARCH_CLASSES
+#undef MEM_ARCH_CLASS
+};
+
+#define __MEM_ARCH_NCLASSES \
+	(sizeof(__mem_arch_class) / sizeof(__mem_arch_class[0]))
+
+/* Called by sys_init() */
+void mem_arch_init(void)
+{
+	struct __mem_arch_class *c;
+	INT8U err;
+	u8_t i;
+
+	for (i = 0; i < __MEM_ARCH_NCLASSES; i++) {
+		c = &__mem_arch_class[i];
+		LWIP_ASSERT("MEM_ARCH_CLASSES isn't in ascending order",
+				i == 0 || c[-1].size < c->size);
+		c->mem = OSMemCreate(c->pool, c->nblks, c->blk_size, &err);
+		LWIP_ASSERT("OSMemCreate", err == OS_ERR_NONE);
+	}
+}
+
+/** Allocate a block of the smallest class which fits 'size', or of the next
+ * larger class if that one is exhausted. The number of classes is fixed, so
+ * this is constant time. */
+void *mem_arch_malloc(size_t size)
+{
+	struct __mem_arch_class *c;
+	u8_t *blk = NULL;
+	u8_t i, first;
+	INT8U err;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	for (i = 0; i < __MEM_ARCH_NCLASSES; i++) {
+		if (__mem_arch_class[i].size >= size)
+			break;
+	}
+	if (i == __MEM_ARCH_NCLASSES) {
+		SYS_ARCH_PROTECT(sr);
+		__mem_arch_class[__MEM_ARCH_NCLASSES - 1].fails++;
+		SYS_ARCH_UNPROTECT(sr);
+		return NULL;
+	}
+
+	first = i;
+	for (c = &__mem_arch_class[i]; i < __MEM_ARCH_NCLASSES; i++, c++) {
+		blk = OSMemGet(c->mem, &err);
+		SYS_ARCH_PROTECT(sr);
+		if (blk) {
+			if (++c->used > c->peak)
+				c->peak = c->used;
+			if (i != first)
+				__mem_arch_class[first].spills++;
+		} else {
+			c->fails++;
+		}
+		SYS_ARCH_UNPROTECT(sr);
+		if (blk)
+			break;
+	}
+	if (!blk)
+		return NULL;
+
+	*(struct __mem_arch_class **)blk = c;
+#if MEM_ARCH_TRACE
+	LWIP_PLATFORM_DIAG(("mem + %p %u\n", blk + __MEM_ARCH_HDR_SIZE,
+				(unsigned)size));
+#endif
+
+	return blk + __MEM_ARCH_HDR_SIZE;
+}
+
+void *mem_arch_calloc(size_t count, size_t size)
+{
+	void *mem = mem_arch_malloc(count * size);
+
+	if (mem)
+		memset(mem, 0, count * size);
+
+	return mem;
+}
+
+void mem_arch_free(void *mem)
+{
+	struct __mem_arch_class *c;
+	u8_t *blk;
+	INT8U err;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (!mem)
+		return;
+#if MEM_ARCH_TRACE
+	LWIP_PLATFORM_DIAG(("mem - %p\n", mem));
+#endif
+	blk = (u8_t *)mem - __MEM_ARCH_HDR_SIZE;
+	c = *(struct __mem_arch_class **)blk;
+	err = OSMemPut(c->mem, blk);
+	LWIP_ASSERT("OSMemPut", err == OS_ERR_NONE);
+	SYS_ARCH_PROTECT(sr);
+	c->used--;
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+int mem_arch_get_stats(u8_t cls, struct mem_arch_stats *st)
+{
+	struct __mem_arch_class *c;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (cls >= __MEM_ARCH_NCLASSES)
+		return -1;
+	c = &__mem_arch_class[cls];
+	SYS_ARCH_PROTECT(sr);
+	st->size = c->size;
+	st->nblks = c->nblks;
+	st->used = c->used;
+	st->peak = c->peak;
+	st->fails = c->fails;
+	st->spills = c->spills;
+	SYS_ARCH_UNPROTECT(sr);
+
+	return 0;
+}
+
+#endif /* MEM_ARCH */
@@ -0,0 +1,203 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "arch/netconn_wait.h"
+
+#if NETCONN_WAIT
+
+#include "lwip/tcp.h"
+#include "ucos_ii.h"
+
+#include <string.h>
+
+static struct netconn_wait *__netconn_wait[NETCONN_WAIT_SETS];
+
+/* Update the bits of a netconn, with the scheduler locked so that the
+ * tcpip thread and the owner, which both report events, keep the counts and
+ * the bits in step */
+static void __netconn_wait_update(struct netconn_wait *w, u8_t i)
+{
+	OS_FLAGS set = 0, clr = 0;
+	INT8U err;
+
+	if (w->rcvevent[i] > 0 || w->errevent[i])
+		set |= NETCONN_WAIT_RD(i);
+	else
+		clr |= NETCONN_WAIT_RD(i);
+	if (w->sendevent[i] || w->errevent[i])
+		set |= NETCONN_WAIT_WR(i);
+	else
+		clr |= NETCONN_WAIT_WR(i);
+	/* only the changes are posted, a receive on a readable netconn costs
+	 * no kernel call */
+	set &= ~w->flags;
+	clr &= w->flags;
+	if (set) {
+		OSFlagPost(w->grp, set, OS_FLAG_SET, &err);
+		LWIP_ASSERT("OSFlagPost", err == OS_ERR_NONE);
+	}
+	if (clr) {
+		OSFlagPost(w->grp, clr, OS_FLAG_CLR, &err);
+		LWIP_ASSERT("OSFlagPost", err == OS_ERR_NONE);
+	}
+	w->flags = (w->flags | set) & ~clr;
+}
+
+err_t netconn_wait_init(struct netconn_wait *w)
+{
+	INT8U err;
+	u8_t i;
+
+	memset(w, 0, sizeof(*w));
+	w->grp = OSFlagCreate(0, &err);
+	if (w->grp == NULL)
+		return ERR_MEM;
+
+	OSSchedLock();
+	for (i = 0; i < NETCONN_WAIT_SETS; i++) {
+		if (__netconn_wait[i] == NULL) {
+			__netconn_wait[i] = w;
+			w->id = i;
+			break;
+		}
+	}
+	OSSchedUnlock();
+	if (i == NETCONN_WAIT_SETS) {
+		OSFlagDel(w->grp, OS_DEL_ALWAYS, &err);
+		return ERR_MEM;
+	}
+
+	return ERR_OK;
+}
+
+void netconn_wait_deinit(struct netconn_wait *w)
+{
+	INT8U err;
+	u8_t i;
+
+	OSSchedLock();
+	for (i = 0; i < NETCONN_WAIT_CONNS; i++) {
+		if (w->conn[i])
+			w->conn[i]->socket = -1;
+	}
+	__netconn_wait[w->id] = NULL;
+	OSSchedUnlock();
+	OSFlagDel(w->grp, OS_DEL_ALWAYS, &err);
+	LWIP_ASSERT("OSFlagDel", err == OS_ERR_NONE);
+}
+
+/** Called by lwIP in the tcpip thread and in the thread receiving. A netconn
+ * not in a set yet counts its receives in 'socket' as the sockets do:
+ * -1 - n for n receives. */
+void netconn_wait_callback(struct netconn *conn, enum netconn_evt evt,
+		u16_t len)
+{
+	struct netconn_wait *w;
+	u8_t i;
+
+	OSSchedLock();
+	if (conn->socket < 0) {
+		if (evt == NETCONN_EVT_RCVPLUS)
+			conn->socket--;
+		OSSchedUnlock();
+		return;
+	}
+	w = __netconn_wait[conn->socket / NETCONN_WAIT_CONNS];
+	i = conn->socket % NETCONN_WAIT_CONNS;
+	switch (evt) {
+	case NETCONN_EVT_RCVPLUS:
+		w->rcvevent[i]++;
+		break;
+	case NETCONN_EVT_RCVMINUS:
+		w->rcvevent[i]--;
+		break;
+	case NETCONN_EVT_SENDPLUS:
+		w->sendevent[i] = 1;
+		break;
+	case NETCONN_EVT_SENDMINUS:
+		w->sendevent[i] = 0;
+		break;
+	case NETCONN_EVT_ERROR:
+		w->errevent[i] = 1;
+		break;
+	default:
+		LWIP_ASSERT("Invalid event", 0);
+		break;
+	}
+	__netconn_wait_update(w, i);
+	OSSchedUnlock();
+}
+
+s8_t netconn_wait_add(struct netconn_wait *w, struct netconn *conn)
+{
+	u8_t i;
+
+	LWIP_ASSERT("Not created with netconn_wait_callback",
+			conn->callback == netconn_wait_callback);
+	OSSchedLock();
+	for (i = 0; i < NETCONN_WAIT_CONNS; i++) {
+		if (w->conn[i] == NULL)
+			break;
+	}
+	if (i == NETCONN_WAIT_CONNS) {
+		OSSchedUnlock();
+		return -1;
+	}
+	w->conn[i] = conn;
+	w->rcvevent[i] = -1 - conn->socket;
+	/* as lwip_socket() and lwip_accept(): a TCP netconn becomes writable
+	 * once connected */
+	if (NETCONNTYPE_GROUP(netconn_type(conn)) == NETCONN_TCP)
+		w->sendevent[i] = conn->pcb.tcp != NULL &&
+			conn->pcb.tcp->state == ESTABLISHED;
+	else
+		w->sendevent[i] = 1;
+	w->errevent[i] = 0;
+	conn->socket = w->id * NETCONN_WAIT_CONNS + i;
+	__netconn_wait_update(w, i);
+	OSSchedUnlock();
+
+	return i;
+}
+
+void netconn_wait_remove(struct netconn_wait *w, struct netconn *conn)
+{
+	u8_t i;
+
+	OSSchedLock();
+	i = conn->socket % NETCONN_WAIT_CONNS;
+	LWIP_ASSERT("Not in the set", conn->socket >= 0 && w->conn[i] == conn);
+	w->conn[i] = NULL;
+	conn->socket = -1;
+	w->rcvevent[i] = 0;
+	w->sendevent[i] = 0;
+	w->errevent[i] = 0;
+	__netconn_wait_update(w, i);
+	OSSchedUnlock();
+}
+
+OS_FLAGS netconn_wait(struct netconn_wait *w, OS_FLAGS mask, u32_t timeout)
+{
+	OS_FLAGS ready;
+	INT8U err;
+
+	if (timeout) {
+		timeout = (timeout * OS_TICKS_PER_SEC + 999) / 1000;
+		if (timeout > 65535)
+			timeout = 65535;
+	}
+
+	ready = OSFlagPend(w->grp, mask, OS_FLAG_WAIT_SET_ANY, timeout, &err);
+	switch (err) {
+	case OS_ERR_NONE:
+		return ready;
+	case OS_ERR_TIMEOUT:
+		break;
+	default:
+		LWIP_ASSERT("OSFlagPend", 0);
+		break;
+	}
+
+	return 0;
+}
+
+#endif /* NETCONN_WAIT */
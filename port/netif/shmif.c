@@ -0,0 +1,146 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "lwip/ip.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "netif/shmif.h"
+
+#include <string.h>
+
+#define __SHMIF_MASK (SHMIF_RING_SIZE - 1)
+
+#define __shmif_tx_ring(s) (&(s)->shm->ring[(s)->side])
+#define __shmif_rx_ring(s) (&(s)->shm->ring[1 - (s)->side])
+
+void shmif_shm_init(struct shmif_shm *shm)
+{
+	memset(shm, 0, sizeof(*shm));
+	SHMIF_MB();
+	shm->magic = SHMIF_MAGIC;
+}
+
+/* Release a receive slot, called from whichever thread frees the pbuf */
+static void __shmif_free(struct pbuf *p)
+{
+	struct shmif_pbuf *sp = (struct shmif_pbuf *)p;
+	struct shmif *s = sp->shmif;
+	struct shmif_ring *rx = __shmif_rx_ring(s);
+	u32_t tail;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	s->released[sp->seq & __SHMIF_MASK] = 1;
+	tail = rx->tail;
+	while (tail != s->next && s->released[tail & __SHMIF_MASK]) {
+		s->released[tail & __SHMIF_MASK] = 0;
+		tail++;
+	}
+	/* the peer drops what finds its ring full and doesn't wait for the
+	 * space, so there is no one to ring */
+	if (tail != rx->tail) {
+		SHMIF_MB();
+		rx->tail = tail;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+void shmif_poll(struct shmif *s)
+{
+	struct shmif_ring *rx = __shmif_rx_ring(s);
+	struct shmif_pbuf *sp;
+	struct pbuf *p;
+	u32_t idx;
+
+	while (s->next != rx->head) {
+		SHMIF_MB();
+		idx = s->next & __SHMIF_MASK;
+		sp = &s->rx[idx];
+		sp->shmif = s;
+		sp->seq = s->next;
+		sp->pc.custom_free_function = __shmif_free;
+		p = pbuf_alloced_custom(PBUF_RAW, rx->len[idx], PBUF_REF,
+				&sp->pc, rx->data[idx], SHMIF_MTU);
+		LWIP_ASSERT("pbuf_alloced_custom", p);
+		s->next++;
+		s->rx_packets++;
+		/* already in the tcpip thread, ip_input() frees 'p' on error */
+		ip_input(p, s->netif);
+	}
+}
+
+#if !NO_SYS
+static void __shmif_poll(void *arg)
+{
+	shmif_poll(arg);
+}
+
+void shmif_irq(struct shmif *s)
+{
+	/* a full queue already holds a poll, which receives everything; a
+	 * failed wakeup is retried by the tcpip thread, see tcpip_defer.h */
+	tcpip_defer(&s->defer, __shmif_poll, s);
+}
+#endif
+
+static err_t __shmif_output(struct netif *netif, struct pbuf *p,
+		ip_addr_t *ipaddr)
+{
+	struct shmif *s = netif->state;
+	struct shmif_ring *tx = __shmif_tx_ring(s);
+	u32_t head = tx->head, idx;
+
+	LWIP_UNUSED_ARG(ipaddr);
+	if (p->tot_len > SHMIF_MTU) {
+		s->tx_toobig++;
+		return ERR_BUF;
+	}
+	if (head - tx->tail >= SHMIF_RING_SIZE) {
+		/* the packet is dropped, ring the doorbell again in case the
+		 * peer missed the one which filled the ring */
+		s->tx_full++;
+		LINK_STATS_INC(link.drop);
+		s->kick(s);
+		return ERR_MEM;
+	}
+	/* the slot must not be written before the peer released it */
+	SHMIF_MB();
+	idx = head & __SHMIF_MASK;
+	pbuf_copy_partial(p, tx->data[idx], p->tot_len, 0);
+	tx->len[idx] = p->tot_len;
+	SHMIF_MB();
+	tx->head = head + 1;
+	s->tx_packets++;
+	s->kick(s);
+
+	return ERR_OK;
+}
+
+err_t shmif_init(struct netif *netif)
+{
+	struct shmif *s = netif->state;
+
+	LWIP_ASSERT("shmif: no state", s && s->shm && s->kick);
+	LWIP_ASSERT("shmif: invalid side", s->side <= 1);
+	LWIP_ASSERT("shmif: shared memory isn't initialized",
+			s->shm->magic == SHMIF_MAGIC);
+
+	s->netif = netif;
+	s->next = __shmif_rx_ring(s)->tail;
+	memset(s->released, 0, sizeof(s->released));
+	s->rx_packets = 0;
+	s->tx_packets = 0;
+	s->tx_full = 0;
+	s->tx_toobig = 0;
+#if !NO_SYS
+	if (tcpip_defer_init(&s->defer) != ERR_OK)
+		return ERR_MEM;
+#endif
+
+	netif->name[0] = 's';
+	netif->name[1] = 'h';
+	netif->output = __shmif_output;
+	netif->mtu = SHMIF_MTU;
+	netif->flags = NETIF_FLAG_POINTTOPOINT | NETIF_FLAG_LINK_UP;
+
+	return ERR_OK;
+}
@@ -1,52 +1,195 @@
+#include "lwip/opt.h"
 #include "ucos_ii.h"
 #include "sio_cpu.h"
 
 #include "lwip/sys.h"
 #include "lwip/sio.h"
-
-#define __SIO_BUF_SIZE 64
+#include "arch/sio_arch.h"
+#include "arch/capture.h"
+#include "arch/ppp_iphc.h"
+#include "arch/sio_trace.h"
+#include "arch/ram_report.h"
+
+#if SIO_STATS && MEMP_STATS
+# include "lwip/stats.h"
+# include "lwip/memp.h"
+# define __sio_pool_empty() \
+	(lwip_stats.memp[MEMP_PBUF_POOL].used >= \
+	 lwip_stats.memp[MEMP_PBUF_POOL].avail)
+#else
+# define __sio_pool_empty() 0
+#endif
+
+#include <string.h>
+
+/* Writers take turns on a semaphore */
+#define __SIO_WLOCK	(SIO_LOCKFREE || PPP_IPHC)
+
+#if SIO_LOCKFREE
+/* One spare slot tells a full ring from an empty one, so that the ISR and the
+ * task each write only their own index. volatile keeps every access in
+ * program order, which is enough on a single core. */
+# define __SIO_RING	(SIO_BUF_SIZE + 1)
+# define __sio_shared	volatile
+#else
+# define __SIO_RING	SIO_BUF_SIZE
+# define __sio_shared
+#endif
 
 struct __sio_buf {
-	INT8U	buf[__SIO_BUF_SIZE];
-	INT8U	rd;
-	INT8U	wr;
+	__sio_shared INT8U	buf[__SIO_RING];
+	__sio_shared INT8U	rd;	/* written by the consumer only */
+	__sio_shared INT8U	wr;	/* written by the producer only */
+#if !SIO_LOCKFREE
 	INT8U	len;
+#endif
+#if RAM_REPORT
+	INT8U	peak;	/* most bytes held */
+#endif
 };
 
-struct {
+static struct __sio_dev {
+	u8_t			devnum;
 	struct {
 		struct __sio_buf	buf;
 		OS_EVENT		*sem;
 	} rx, tx;
-} __sio;
-
-#define __sio_buf_empty(buf) ((buf)->len == 0)
-#define __sio_buf_full(buf) ((buf)->len == __SIO_BUF_SIZE)
+#if __SIO_WLOCK
+	/* keeps one producer on the TX ring and one writer in 'iphc' */
+	OS_EVENT		*wlock;
+#endif
+#if PPP_IPHC
+	struct ppp_iphc		*iphc;	/* NULL if none */
+#endif
+	__sio_shared u8_t	throttled;
+#if SIO_FRAME_READ
+	u8_t			frame_mode;
+	u8_t			delim;
+	u8_t			last;	/* last byte received */
+	u8_t			taken;	/* last byte taken by the reader */
+	/* frame ends (delimiters after another byte) queued by the ISR and
+	 * taken by the reader, their difference is the number of whole
+	 * frames in the RX ring */
+	__sio_shared u8_t	frames_in;
+	__sio_shared u8_t	frames_out;
+	__sio_shared u8_t	waiting;/* __SIO_WAIT_*, what wakes the reader */
+#endif
+#if SIO_STATS
+	INT32U			stall_begin;
+	u16_t			rx_frame_len;	/* bytes of the frame read */
+	u8_t			rx_frame_empty;	/* it found the pool empty */
+	struct sio_stats	stats;
+#endif
+} __sio[SIO_NUM_DEVS];
+
+/* A NULL handle is the first device, as before there were several */
+#define __sio_dev(fd) ((fd) ? (struct __sio_dev *)(fd) : &__sio[0])
+
+#if SIO_STATS
+# define __SIO_STATS_INC(x) ++s->stats.x
+/* for the counters which several tasks update outside the ring lock */
+# define __SIO_STATS_INC_LOCKED(x) \
+do { \
+	SYS_ARCH_DECL_PROTECT(__sr); \
+	SYS_ARCH_PROTECT(__sr); \
+	++s->stats.x; \
+	SYS_ARCH_UNPROTECT(__sr); \
+} while (0)
+#else
+# define __SIO_STATS_INC(x)
+# define __SIO_STATS_INC_LOCKED(x)
+#endif
+
+/* Only the first device is captured and traced */
+#if CAPTURE
+# define __SIO_CAPTURE(s, dir, data, len) \
+do { \
+	if (capture_on && (s)->devnum == 0) \
+		capture_bytes((dir), (data), (len)); \
+} while (0)
+#else
+# define __SIO_CAPTURE(s, dir, data, len)
+#endif
+
+#if SIO_TRACE
+# define __SIO_TRACE_BYTE(s, c) \
+do { \
+	if (sio_trace_on && (s)->devnum == 0) \
+		sio_trace_byte(c); \
+} while (0)
+#else
+# define __SIO_TRACE_BYTE(s, c)
+#endif
+
+/* The hot paths between an ISR and a task only lock without SIO_LOCKFREE */
+#if SIO_LOCKFREE
+# define __SIO_DECL_LOCK(sr)
+# define __SIO_LOCK(sr)
+# define __SIO_UNLOCK(sr)
+# define __sio_buf_len(buf) \
+	((INT8U)(((buf)->wr + __SIO_RING - (buf)->rd) % __SIO_RING))
+#else
+# define __SIO_DECL_LOCK(sr)	SYS_ARCH_DECL_PROTECT(sr)
+# define __SIO_LOCK(sr)		SYS_ARCH_PROTECT(sr)
+# define __SIO_UNLOCK(sr)	SYS_ARCH_UNPROTECT(sr)
+# define __sio_buf_len(buf) ((buf)->len)
+#endif
+
+#define __sio_buf_empty(buf) (__sio_buf_len(buf) == 0)
+#define __sio_buf_full(buf) (__sio_buf_len(buf) == SIO_BUF_SIZE)
+
+#if SIO_FRAME_READ
+# define __sio_frames(s) ((u8_t)((s)->frames_in - (s)->frames_out))
+
+/* What the reader of a device in frame mode waits for, besides a full ring:
+ * the end of a frame, or the start of one while the ring holds none, so that
+ * an idle link never wakes it */
+# define __SIO_WAIT_NONE	0
+# define __SIO_WAIT_END		1
+# define __SIO_WAIT_START	2
+#endif
 
 static void __sio_init_buf(struct __sio_buf *buf)
 {
 	buf->rd = 0;
 	buf->wr = 0;
+#if !SIO_LOCKFREE
 	buf->len = 0;
+#endif
 }
 
+/* The byte is read before the slot is given back */
 static INT8U __sio_read_buf(struct __sio_buf *buf)
 {
-	INT8U c = buf->buf[buf->rd++];
+	INT8U rd = buf->rd;
+	INT8U c = buf->buf[rd++];
 
-	if (buf->rd == __SIO_BUF_SIZE)
-		buf->rd = 0;
+	if (rd == __SIO_RING)
+		rd = 0;
+	buf->rd = rd;
+#if !SIO_LOCKFREE
 	buf->len--;
+#endif
 
 	return c;
 }
 
+/* The byte is written before it is published */
 static void __sio_write_buf(struct __sio_buf *buf, INT8U c)
 {
-	buf->buf[buf->wr++] = c;
-	if (buf->wr == __SIO_BUF_SIZE)
-		buf->wr = 0;
+	INT8U wr = buf->wr;
+
+	buf->buf[wr++] = c;
+	if (wr == __SIO_RING)
+		wr = 0;
+	buf->wr = wr;
+#if !SIO_LOCKFREE
 	buf->len++;
+#endif
+#if RAM_REPORT
+	if (__sio_buf_len(buf) > buf->peak)
+		buf->peak = __sio_buf_len(buf);
+#endif
 }
 
 /**
@@ -57,104 +200,290 @@ static void __sio_write_buf(struct __sio_buf *buf, INT8U c)
  */
 sio_fd_t sio_open(u8_t devnum)
 {
-	__sio.rx.sem = OSSemCreate(0); /* number of bytes */
-	LWIP_ASSERT("OSSemCreate", __sio.rx.sem);
-	__sio.tx.sem = OSSemCreate(__SIO_BUF_SIZE + 1); /* number of spaces */
-	LWIP_ASSERT("OSSemCreate", __sio.tx.sem);
-	__sio_init_buf(&__sio.rx.buf);
-	__sio_init_buf(&__sio.tx.buf);
+	struct __sio_dev *s;
+
+	if (devnum >= SIO_NUM_DEVS)
+		return NULL;
+	s = &__sio[devnum];
+	s->devnum = devnum;
+	s->rx.sem = OSSemCreate(0); /* number of bytes */
+	LWIP_ASSERT("OSSemCreate", s->rx.sem);
+#if SIO_LOCKFREE
+	s->tx.sem = OSSemCreate(SIO_BUF_SIZE); /* number of spaces */
+	LWIP_ASSERT("OSSemCreate", s->tx.sem);
+#else
+	/* number of spaces, and the UART when idle */
+	s->tx.sem = OSSemCreate(SIO_BUF_SIZE + 1);
+	LWIP_ASSERT("OSSemCreate", s->tx.sem);
+#endif
+#if __SIO_WLOCK
+	s->wlock = OSSemCreate(1);
+	LWIP_ASSERT("OSSemCreate", s->wlock);
+#endif
+#if PPP_IPHC
+	s->iphc = NULL;
+#endif
+	__sio_init_buf(&s->rx.buf);
+	__sio_init_buf(&s->tx.buf);
+	s->throttled = 0;
+#if SIO_FRAME_READ
+	s->frame_mode = 0;
+#endif
+#if SIO_STATS
+	s->rx_frame_len = 0;
+	s->rx_frame_empty = 0;
+	memset(&s->stats, 0, sizeof(s->stats));
+#endif
+
+	return s;
+}
 
-	return &__sio;
+/**
+ * Gets the number of a serial device, for sio_cpu.h to find its UART.
+ * 
+ * @param fd serial device handle, NULL for device 0
+ * @return the devnum passed to sio_open()
+ */
+u8_t sio_devnum(sio_fd_t fd)
+{
+	return __sio_dev(fd)->devnum;
 }
 
+#if PPP_IPHC
 /**
- * Sends a single character to the serial device.
+ * Filters the PPP frames of a serial device through IP header compression.
  * 
- * @param c character to send
  * @param fd serial device handle
- * 
- * @note This function will block until the character can be sent.
+ * @param h state of the link, NULL to stop
  */
-void sio_send(u8_t c, sio_fd_t fd)
+void sio_iphc(sio_fd_t fd, struct ppp_iphc *h)
 {
+	if (h != NULL)
+		ppp_iphc_init(h);
+	__sio_dev(fd)->iphc = h;
+}
+#endif
+
+static void __sio_send(u8_t c, sio_fd_t fd)
+{
+	struct __sio_dev *s = __sio_dev(fd);
 	INT8U err;
-	SYS_ARCH_DECL_PROTECT(sr);
+	__SIO_DECL_LOCK(sr);
 
-	OSSemPend(__sio.tx.sem, 0, &err);
+	OSSemPend(s->tx.sem, 0, &err);
 	LWIP_ASSERT("OSSemPend", err == OS_ERR_NONE);
-	SYS_ARCH_PROTECT(sr);
-	if (__sio_buf_empty(&__sio.tx.buf) && sio_tx_ok(fd)) {
+	__SIO_LOCK(sr);
+	__SIO_STATS_INC(tx_bytes);
+#if SIO_LOCKFREE
+	/* the TX interrupt of an idle UART fires at once and sends it */
+	__sio_write_buf(&s->tx.buf, c);
+	sio_enable_tx_irq(fd);
+#else
+	if (__sio_buf_empty(&s->tx.buf) && sio_tx_ok(fd)) {
 		sio_tx(fd, c);
 		sio_enable_tx_irq(fd);
 	} else {
-		__sio_write_buf(&__sio.tx.buf, c);
+		__sio_write_buf(&s->tx.buf, c);
 	}
-	SYS_ARCH_UNPROTECT(sr);
+#endif
+	__SIO_UNLOCK(sr);
+}
+
+#if __SIO_WLOCK
+# define __sio_wlock(s) \
+do { \
+	INT8U __err; \
+	OSSemPend((s)->wlock, 0, &__err); \
+	LWIP_ASSERT("OSSemPend", __err == OS_ERR_NONE); \
+} while (0)
+# define __sio_wunlock(s) OSSemPost((s)->wlock)
+#else
+# define __sio_wlock(s)
+# define __sio_wunlock(s)
+#endif
+
+/* Called with the writer lock held, the bytes as they go on the wire */
+static void __sio_write_raw(void *fd, const u8_t *data, u32_t len)
+{
+	struct __sio_dev *s = __sio_dev(fd);
+
+	__SIO_CAPTURE(s, CAPTURE_TX, data, len);
+	while (len-- > 0)
+		__sio_send(*data++, fd);
+}
+
+/**
+ * Sends a single character to the serial device.
+ * 
+ * @param c character to send
+ * @param fd serial device handle
+ * 
+ * @note This function will block until the character can be sent.
+ */
+void sio_send(u8_t c, sio_fd_t fd)
+{
+	struct __sio_dev *s = __sio_dev(fd);
+
+	__sio_wlock(s);
+#if PPP_IPHC
+	if (s->iphc != NULL)
+		ppp_iphc_write(s->iphc, &c, 1, __sio_write_raw, fd);
+	else
+#endif
+		__sio_write_raw(fd, &c, 1);
+	__sio_wunlock(s);
 }
 
 /* Called in TX completion ISR */
 void sio_tx_complete(sio_fd_t fd)
 {
+	struct __sio_dev *s = __sio_dev(fd);
 	INT8U err, c;
-	SYS_ARCH_DECL_PROTECT(sr);
+	__SIO_DECL_LOCK(sr);
 
-	SYS_ARCH_PROTECT(sr);
+	__SIO_LOCK(sr);
 	if (sio_tx_ok(fd)) {
-		err = OSSemPost(__sio.tx.sem);
+#if SIO_LOCKFREE
+		if (!__sio_buf_empty(&s->tx.buf)) {
+			c = __sio_read_buf(&s->tx.buf);
+			sio_tx(fd, c);
+			err = OSSemPost(s->tx.sem);
+			LWIP_ASSERT("OSSemPost", err == OS_ERR_NONE);
+		} else {
+			/* a byte written after this enables it again */
+			sio_disable_tx_irq(fd);
+		}
+#else
+		err = OSSemPost(s->tx.sem);
 		LWIP_ASSERT("OSSemPost", err == OS_ERR_NONE);
-		if (!__sio_buf_empty(&__sio.tx.buf)) {
-			c = __sio_read_buf(&__sio.tx.buf);
+		if (!__sio_buf_empty(&s->tx.buf)) {
+			c = __sio_read_buf(&s->tx.buf);
 			sio_tx(fd, c);
 		} else {
 			sio_disable_tx_irq(fd);
 		}
+#endif
 	}
-	SYS_ARCH_UNPROTECT(sr);
+	__SIO_UNLOCK(sr);
+}
+
+#if SIO_FRAME_READ
+/* Called in RX ISR with the byte just queued: wake the reader only at the
+ * start or the end of a frame, as it asked, or when the ring is full */
+static void __sio_rx_frame(struct __sio_dev *s, INT8U c)
+{
+	INT8U err;
+	u8_t end = 0;
+
+	if (c == s->delim && s->last != s->delim) {
+		s->frames_in++;
+		end = 1;
+	}
+	s->last = c;
+	if (s->waiting && (end || __sio_buf_full(&s->rx.buf) ||
+	    (s->waiting == __SIO_WAIT_START && c != s->delim))) {
+		s->waiting = __SIO_WAIT_NONE;
+		err = OSSemPost(s->rx.sem);
+		LWIP_ASSERT("OSSemPost", err == OS_ERR_NONE);
+	}
+}
+#endif
+
+/* Queue a received byte and wake the reader, called with the ring locked */
+static void __sio_rx_push(struct __sio_dev *s, INT8U c)
+{
+	INT8U err;
+
+	__SIO_STATS_INC(rx_bytes);
+	__sio_write_buf(&s->rx.buf, c);
+#if SIO_FRAME_READ
+	if (s->frame_mode) {
+		__sio_rx_frame(s, c);
+		return;
+	}
+#endif
+	err = OSSemPost(s->rx.sem);
+	LWIP_ASSERT("OSSemPost", err == OS_ERR_NONE);
 }
 
 /* Called in RX ISR to push one byte */
 void sio_rx_complete(sio_fd_t fd)
 {
-	INT8U err, c;
-	SYS_ARCH_DECL_PROTECT(sr);
+	struct __sio_dev *s = __sio_dev(fd);
+	INT8U c;
+	__SIO_DECL_LOCK(sr);
 
-	SYS_ARCH_PROTECT(sr);
+	__SIO_LOCK(sr);
 	if (sio_rx_ok(fd)) {
-		if (__sio_buf_full(&__sio.rx.buf)) {
+		/* the reader enables it again once it takes a byte from a full
+		 * ring, or sio_rx_throttle() when it resumes */
+		if (s->throttled) {
 			sio_disable_rx_irq(fd);
+		} else if (__sio_buf_full(&s->rx.buf)) {
+			sio_disable_rx_irq(fd);
+			__SIO_STATS_INC(rx_full);
 		} else {
 			c = sio_rx(fd);
-			__sio_write_buf(&__sio.rx.buf, c);
-			err = OSSemPost(__sio.rx.sem);
-			LWIP_ASSERT("OSSemPost", err == OS_ERR_NONE);
+			__SIO_TRACE_BYTE(s, c);
+			__sio_rx_push(s, c);
 		}
 	}
+	__SIO_UNLOCK(sr);
+}
+
+#if SIO_TRACE
+u32_t sio_inject(sio_fd_t fd, const u8_t *data, u32_t len)
+{
+	struct __sio_dev *s = __sio_dev(fd);
+	u32_t n;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	/* the reader runs once the whole span is queued, as after an ISR */
+	OSSchedLock();
+	SYS_ARCH_PROTECT(sr);
+	for (n = 0; n < len; n++) {
+		if (s->throttled || __sio_buf_full(&s->rx.buf))
+			break;
+		__sio_rx_push(s, data[n]);
+	}
 	SYS_ARCH_UNPROTECT(sr);
+	OSSchedUnlock();
+
+	return n;
 }
+#endif
 
-/**
- * Receives a single character from the serial device.
- * 
- * @param fd serial device handle
- * 
- * @note This function will block until a character is received.
- */
-u8_t sio_recv(sio_fd_t fd)
+#if SIO_FRAME_READ
+static u32_t __sio_read_frame(sio_fd_t fd, u8_t *data, u32_t len);
+#endif
+static u32_t __sio_read_raw(void *fd, u8_t *data, u32_t len);
+
+static u8_t __sio_recv(sio_fd_t fd)
 {
+	struct __sio_dev *s = __sio_dev(fd);
 	INT8U err, c = 0;
-	SYS_ARCH_DECL_PROTECT(sr);
+	__SIO_DECL_LOCK(sr);
 
-	OSSemPend(__sio.rx.sem, 0, &err);
+#if SIO_FRAME_READ
+	if (s->frame_mode) {
+		__sio_read_frame(fd, &c, 1);
+		return c;
+	}
+#endif
+	OSSemPend(s->rx.sem, 0, &err);
 	switch (err) {
 	case OS_ERR_NONE:
-		SYS_ARCH_PROTECT(sr);
-		c = __sio_read_buf(&__sio.rx.buf);
-		if (__sio.rx.buf.len == __SIO_BUF_SIZE - 1)
+		__SIO_LOCK(sr);
+		c = __sio_read_buf(&s->rx.buf);
+		if (__sio_buf_len(&s->rx.buf) == SIO_BUF_SIZE - 1 &&
+		    !s->throttled)
 			sio_enable_rx_irq(fd);
-		SYS_ARCH_UNPROTECT(sr);
+		__SIO_UNLOCK(sr);
 		break;
 	case OS_ERR_PEND_ABORT:
-		sys_thread_free(PPP_THREAD_PRIO);
+#if !NO_SYS
+		sys_thread_free(OSPrioCur);
+#endif
 	default:
 		LWIP_ASSERT("OSQPend", 0);
 		break;
@@ -164,29 +493,196 @@ u8_t sio_recv(sio_fd_t fd)
 }
 
 /**
- * Reads from the serial device.
+ * Receives a single character from the serial device.
  * 
  * @param fd serial device handle
- * @param data pointer to data buffer for receiving
- * @param len maximum length (in bytes) of data to receive
- * @return number of bytes actually received - may be 0 if aborted by sio_read_abort
  * 
- * @note This function will block until data can be received. The blocking
- * can be cancelled by calling sio_read_abort().
+ * @note This function will block until a character is received.
  */
-u32_t sio_read(sio_fd_t fd, u8_t *data, u32_t len)
+u8_t sio_recv(sio_fd_t fd)
 {
+	struct __sio_dev *s = __sio_dev(fd);
+	u8_t c = 0;
+
+#if PPP_IPHC
+	if (s->iphc != NULL) {
+		ppp_iphc_read(s->iphc, &c, 1, __sio_read_raw, fd);
+		return c;
+	}
+#endif
+	c = __sio_recv(fd);
+	__SIO_CAPTURE(s, CAPTURE_RX, &c, 1);
+
+	return c;
+}
+
+#if SIO_FRAME_READ
+/* Frame mode: move bytes out of the RX ring, stopping after the delimiter
+ * which ends a frame if 'frame' is set. Called with the ring locked.
+ * Without the lock, the length is checked once the slot is given back: a
+ * ring the ISR found full has then room for one byte, and no more bytes. */
+static u32_t __sio_take(sio_fd_t fd, u8_t *data, u32_t len, u8_t frame)
+{
+	struct __sio_dev *s = __sio_dev(fd);
 	u32_t n = 0;
+	INT8U c;
+	u8_t end;
 
-	if (len-- > 0) {
-		*data++ = sio_recv(fd);
-		++n;
-		n += sio_tryread(fd, data, len);
+	while (n < len && !__sio_buf_empty(&s->rx.buf)) {
+		c = __sio_read_buf(&s->rx.buf);
+		if (__sio_buf_len(&s->rx.buf) == SIO_BUF_SIZE - 1 &&
+		    !s->throttled)
+			sio_enable_rx_irq(fd);
+		data[n++] = c;
+		/* the same test as __sio_rx_frame() on the same bytes */
+		end = c == s->delim && s->taken != s->delim;
+		s->taken = c;
+		if (end) {
+			s->frames_out++;
+			if (frame)
+				break;
+		}
 	}
 
 	return n;
 }
 
+/* Frame mode: block until a whole frame is in the ring, the ring is full or
+ * SIO_FRAME_TIMEOUT passes with a partial frame pending. Without a partial
+ * frame, it blocks without a timeout. */
+static u32_t __sio_read_frame(sio_fd_t fd, u8_t *data, u32_t len)
+{
+	struct __sio_dev *s = __sio_dev(fd);
+	INT8U err = OS_ERR_NONE;
+	u32_t n;
+	u8_t partial;
+	__SIO_DECL_LOCK(sr);
+
+	if (len == 0)
+		return 0;
+	while (1) {
+		__SIO_LOCK(sr);
+		/* set first, so that a frame starting or ending after the
+		 * check posts */
+		s->waiting = __SIO_WAIT_START;
+		if (__sio_frames(s) > 0 || __sio_buf_full(&s->rx.buf) ||
+		    (err == OS_ERR_TIMEOUT &&
+		     !__sio_buf_empty(&s->rx.buf))) {
+			s->waiting = __SIO_WAIT_NONE;
+			n = __sio_take(fd, data, len, 1);
+			__SIO_UNLOCK(sr);
+			__SIO_STATS_INC_LOCKED(rx_reads);
+			__SIO_STATS_INC_LOCKED(rx_wakeups);
+			return n;
+		}
+		/* unless a frame started, the ring holds only delimiters */
+		partial = !__sio_buf_empty(&s->rx.buf) &&
+			s->last != s->delim;
+		if (partial && s->waiting == __SIO_WAIT_START)
+			s->waiting = __SIO_WAIT_END;
+		__SIO_UNLOCK(sr);
+
+		OSSemPend(s->rx.sem, partial ? SIO_FRAME_TIMEOUT : 0, &err);
+		switch (err) {
+		case OS_ERR_NONE:
+			break;
+		case OS_ERR_TIMEOUT:
+			/* the ISR may have posted since the timeout, the count
+			 * would wake the next wait at once */
+			__SIO_LOCK(sr);
+			s->waiting = __SIO_WAIT_NONE;
+			__SIO_UNLOCK(sr);
+			OSSemAccept(s->rx.sem);
+			break;
+		case OS_ERR_PEND_ABORT:
+#if !NO_SYS
+			sys_thread_free(OSPrioCur);
+#endif
+		default:
+			LWIP_ASSERT("OSSemPend", 0);
+			return 0;
+		}
+	}
+}
+
+void sio_frame_mode(sio_fd_t fd, u8_t on, u8_t delim)
+{
+	struct __sio_dev *s = __sio_dev(fd);
+	INT8U err;
+	u8_t i, c, n = 0;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	OSSchedLock();
+	SYS_ARCH_PROTECT(sr);
+	if (on) {
+		s->last = delim;
+		for (i = 0; i < __sio_buf_len(&s->rx.buf); i++) {
+			c = s->rx.buf.buf[(s->rx.buf.rd + i) % __SIO_RING];
+			if (c == delim && s->last != delim)
+				n++;
+			s->last = c;
+		}
+		s->frames_in = n;
+		s->frames_out = 0;
+		s->delim = delim;
+		s->taken = delim;
+		s->waiting = __SIO_WAIT_NONE;
+	}
+	s->frame_mode = on;
+	n = on ? 0 : __sio_buf_len(&s->rx.buf);
+	SYS_ARCH_UNPROTECT(sr);
+	/* the semaphore counts bytes in byte mode and wakeups in frame mode */
+	OSSemSet(s->rx.sem, n, &err);
+	LWIP_ASSERT("OSSemSet", err == OS_ERR_NONE);
+	OSSchedUnlock();
+}
+#endif /* SIO_FRAME_READ */
+
+static u32_t __sio_tryread(sio_fd_t fd, u8_t *data, u32_t len)
+{
+	struct __sio_dev *s = __sio_dev(fd);
+	u32_t n = 0;
+	INT8U c;
+	__SIO_DECL_LOCK(sr);
+
+	__SIO_STATS_INC_LOCKED(rx_reads);
+#if SIO_FRAME_READ
+	if (s->frame_mode) {
+		__SIO_LOCK(sr);
+		n = __sio_take(fd, data, len, 0);
+		__SIO_UNLOCK(sr);
+		return n;
+	}
+#endif
+	while (len-- > 0) {
+		if (OSSemAccept(s->rx.sem) > 0) {
+			__SIO_LOCK(sr);
+			c = __sio_read_buf(&s->rx.buf);
+			if (__sio_buf_len(&s->rx.buf) == SIO_BUF_SIZE - 1 &&
+			    !s->throttled)
+				sio_enable_rx_irq(fd);
+			__SIO_UNLOCK(sr);
+			*data++ = c;
+			++n;
+		} else {
+			break;
+		}
+	}
+
+	return n;
+}
+
+/* The bytes as they come from the wire */
+static u32_t __sio_tryread_raw(void *fd, u8_t *data, u32_t len)
+{
+	struct __sio_dev *s = __sio_dev(fd);
+	u32_t n = __sio_tryread(fd, data, len);
+
+	__SIO_CAPTURE(s, CAPTURE_RX, data, n);
+
+	return n;
+}
+
 /**
  * Tries to read from the serial device. Same as sio_read but returns
  * immediately if no data is available and never blocks.
@@ -198,26 +694,104 @@ u32_t sio_read(sio_fd_t fd, u8_t *data, u32_t len)
  */
 u32_t sio_tryread(sio_fd_t fd, u8_t *data, u32_t len)
 {
+	struct __sio_dev *s = __sio_dev(fd);
+	u32_t n;
+
+#if PPP_IPHC
+	if (s->iphc != NULL)
+		n = ppp_iphc_read(s->iphc, data, len, __sio_tryread_raw, fd);
+	else
+#endif
+		n = __sio_tryread_raw(fd, data, len);
+
+	return __sio_rx_tier(s, data, n);
+}
+
+/* The bytes as they come from the wire, blocking for the first one */
+static u32_t __sio_read_raw(void *fd, u8_t *data, u32_t len)
+{
+	struct __sio_dev *s = __sio_dev(fd);
 	u32_t n = 0;
-	INT8U c;
-	SYS_ARCH_DECL_PROTECT(sr);
 
-	while (len-- > 0) {
-		if (OSSemAccept(__sio.rx.sem) > 0) {
-			SYS_ARCH_PROTECT(sr);
-			c = __sio_read_buf(&__sio.rx.buf);
-			if (__sio.rx.buf.len == __SIO_BUF_SIZE - 1)
-				sio_enable_rx_irq(fd);
-			SYS_ARCH_UNPROTECT(sr);
-			*data++ = c;
-			++n;
-		} else {
-			break;
+#if SIO_FRAME_READ
+	if (s->frame_mode) {
+		n = __sio_read_frame(fd, data, len);
+		__SIO_CAPTURE(s, CAPTURE_RX, data, n);
+		return n;
+	}
+#endif
+	if (len > 0) {
+		data[0] = __sio_recv(fd);
+		__SIO_STATS_INC_LOCKED(rx_wakeups);
+		n = 1 + __sio_tryread(fd, data + 1, len - 1);
+		__SIO_CAPTURE(s, CAPTURE_RX, data, n);
+	}
+
+	return n;
+}
+
+#if SIO_STATS
+/* Sort the PPP frames the reader takes into the tiers of sio_stats, by the
+ * pool buffers PPPoS fills with them, each needed as a frame goes past the
+ * end of the last */
+static u32_t __sio_rx_tier(struct __sio_dev *s, const u8_t *data, u32_t n)
+{
+	u16_t bufs;
+	u8_t tier;
+	u32_t i;
+
+	for (i = 0; i < n; i++) {
+		if (data[i] != 0x7e) {
+			if (s->rx_frame_len++ % PBUF_POOL_BUFSIZE == 0 &&
+			    __sio_pool_empty())
+				s->rx_frame_empty = 1;
+			continue;
 		}
+		if (s->rx_frame_len == 0)
+			continue;
+		bufs = (s->rx_frame_len + PBUF_POOL_BUFSIZE - 1) /
+			PBUF_POOL_BUFSIZE;
+		for (tier = 0; tier < SIO_RX_TIERS - 1 && bufs > 1 << tier;
+				tier++)
+			;
+		s->stats.rx_frames[tier]++;
+		if (s->rx_frame_empty)
+			s->stats.rx_pool_empty[tier]++;
+		s->rx_frame_len = 0;
+		s->rx_frame_empty = 0;
 	}
 
 	return n;
 }
+#else
+# define __sio_rx_tier(s, data, n) ((void)(s), (n))
+#endif
+
+/**
+ * Reads from the serial device.
+ * 
+ * @param fd serial device handle
+ * @param data pointer to data buffer for receiving
+ * @param len maximum length (in bytes) of data to receive
+ * @return number of bytes actually received - may be 0 if aborted by sio_read_abort
+ * 
+ * @note This function will block until data can be received. The blocking
+ * can be cancelled by calling sio_read_abort().
+ */
+u32_t sio_read(sio_fd_t fd, u8_t *data, u32_t len)
+{
+	struct __sio_dev *s = __sio_dev(fd);
+	u32_t n;
+
+#if PPP_IPHC
+	if (s->iphc != NULL)
+		n = ppp_iphc_read(s->iphc, data, len, __sio_read_raw, fd);
+	else
+#endif
+		n = __sio_read_raw(fd, data, len);
+
+	return __sio_rx_tier(s, data, n);
+}
 
 /**
  * Writes to the serial device.
@@ -231,14 +805,19 @@ u32_t sio_tryread(sio_fd_t fd, u8_t *data, u32_t len)
  */
 u32_t sio_write(sio_fd_t fd, u8_t *data, u32_t len)
 {
-	u32_t n = 0;
-
-	while (len-- > 0) {
-		sio_send(*data++, fd);
-		n++;
-	}
-
-	return n;
+	struct __sio_dev *s = __sio_dev(fd);
+
+	__SIO_STATS_INC_LOCKED(tx_writes);
+	__sio_wlock(s);
+#if PPP_IPHC
+	if (s->iphc != NULL)
+		ppp_iphc_write(s->iphc, data, len, __sio_write_raw, fd);
+	else
+#endif
+		__sio_write_raw(fd, data, len);
+	__sio_wunlock(s);
+
+	return len;
 }
 
 /**
@@ -248,7 +827,70 @@ u32_t sio_write(sio_fd_t fd, u8_t *data, u32_t len)
  */
 void sio_read_abort(sio_fd_t fd)
 {
+	struct __sio_dev *s = __sio_dev(fd);
 	INT8U err;
 
-	OSSemPendAbort(__sio.rx.sem, OS_PEND_OPT_BROADCAST, &err);
+	OSSemPendAbort(s->rx.sem, OS_PEND_OPT_BROADCAST, &err);
+}
+
+void sio_rx_throttle(void *fd, u8_t on)
+{
+	struct __sio_dev *s = __sio_dev(fd);
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	if (on && !s->throttled) {
+		s->throttled = 1;
+		sio_disable_rx_irq(fd);
+#if SIO_STATS
+		s->stall_begin = OSTimeGet();
+		s->stats.rx_throttles++;
+#endif
+	} else if (!on && s->throttled) {
+		s->throttled = 0;
+		if (!__sio_buf_full(&s->rx.buf))
+			sio_enable_rx_irq(fd);
+#if SIO_STATS
+		s->stats.rx_stall_ticks += OSTimeGet() - s->stall_begin;
+#endif
+	}
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+#if SIO_STATS
+void sio_get_stats(sio_fd_t fd, struct sio_stats *st)
+{
+	struct __sio_dev *s = __sio_dev(fd);
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	*st = s->stats;
+	SYS_ARCH_UNPROTECT(sr);
+}
+#endif
+
+#if RAM_REPORT
+u8_t sio_ram_regions(struct ram_region *r, u8_t max)
+{
+	static const char *const names[][2] = {
+		{ "sio0.rx", "sio0.tx" }, { "sio1.rx", "sio1.tx" },
+		{ "sio2.rx", "sio2.tx" }, { "sio3.rx", "sio3.tx" },
+	};
+	u8_t i, n = 0;
+
+	for (i = 0; i < SIO_NUM_DEVS && i < sizeof(names) / sizeof(names[0]); i++) {
+		if (n + 2 > max)
+			break;
+		r[n].name = names[i][0];
+		r[n].size = SIO_BUF_SIZE;
+		r[n].peak = __sio[i].rx.buf.peak;
+		n++;
+		r[n].name = names[i][1];
+		r[n].size = SIO_BUF_SIZE;
+		r[n].peak = __sio[i].tx.buf.peak;
+		n++;
+	}
+
+	return n;
 }
+#endif
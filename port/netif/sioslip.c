@@ -0,0 +1,187 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "lwip/ip.h"
+#include "lwip/pbuf.h"
+#include "netif/sioslip.h"
+#include "arch/sio_arch.h"
+
+#include <string.h>
+
+#define __SLIP_END	0xC0
+#define __SLIP_ESC	0xDB
+#define __SLIP_ESC_END	0xDC
+#define __SLIP_ESC_ESC	0xDD
+
+/* Hand the frame to the stack, runt frames (line noise between two ENDs)
+ * are dropped */
+static void __sioslip_deliver(struct sioslip *s)
+{
+	struct pbuf *p = s->rx;
+
+	s->rx = NULL;
+	if (s->len < 20) {
+		pbuf_free(p);
+		return;
+	}
+	pbuf_realloc(p, s->len);
+	s->rx_packets++;
+	if (s->netif->input(p, s->netif) != ERR_OK)
+		pbuf_free(p);
+}
+
+/* Drop the frame being received until the next END */
+static void __sioslip_drop(struct sioslip *s)
+{
+	if (s->rx) {
+		pbuf_free(s->rx);
+		s->rx = NULL;
+	}
+	s->rx_drops++;
+	s->drop = 1;
+}
+
+static void __sioslip_input(struct sioslip *s, const u8_t *data, u32_t n)
+{
+	struct pbuf *q;
+	u8_t c;
+
+	while (n-- > 0) {
+		c = *data++;
+		if (c == __SLIP_END) {
+			if (s->rx)
+				__sioslip_deliver(s);
+			s->drop = 0;
+			s->esc = 0;
+			continue;
+		}
+		if (s->drop)
+			continue;
+		if (c == __SLIP_ESC) {
+			s->esc = 1;
+			continue;
+		}
+		if (s->esc) {
+			if (c == __SLIP_ESC_END)
+				c = __SLIP_END;
+			else if (c == __SLIP_ESC_ESC)
+				c = __SLIP_ESC;
+			s->esc = 0;
+		}
+
+		if (s->rx && s->len == SIOSLIP_MTU) {
+			__sioslip_drop(s);
+			continue;
+		}
+		/* the chain grows a pool pbuf at a time, so that a small
+		 * frame takes one */
+		if (s->rx == NULL || s->off == s->q->len) {
+			q = pbuf_alloc(PBUF_RAW, PBUF_POOL_BUFSIZE, PBUF_POOL);
+			if (q == NULL) {
+				__sioslip_drop(s);
+				continue;
+			}
+			if (s->rx == NULL) {
+				s->rx = q;
+				s->len = 0;
+			} else {
+				pbuf_cat(s->rx, q);
+			}
+			s->q = q;
+			s->off = 0;
+		}
+		((u8_t *)s->q->payload)[s->off++] = c;
+		s->len++;
+	}
+}
+
+#if NO_SYS
+void sioslip_poll(struct sioslip *s)
+{
+	u32_t n;
+
+	while ((n = sio_tryread(s->fd, s->rbuf, sizeof(s->rbuf))) > 0)
+		__sioslip_input(s, s->rbuf, n);
+}
+#else
+static void __sioslip_thread(void *arg)
+{
+	struct sioslip *s = arg;
+	u32_t n;
+
+	while (1) {
+		n = sio_read(s->fd, s->rbuf, sizeof(s->rbuf));
+		__sioslip_input(s, s->rbuf, n);
+	}
+}
+#endif
+
+static err_t __sioslip_output(struct netif *netif, struct pbuf *p,
+		ip_addr_t *ipaddr)
+{
+	struct sioslip *s = netif->state;
+	struct pbuf *q;
+	u8_t *data, c;
+	u16_t i, n = 0;
+
+	LWIP_UNUSED_ARG(ipaddr);
+	/* a leading END flushes the noise the peer may have received */
+	s->wbuf[n++] = __SLIP_END;
+	for (q = p; q; q = q->next) {
+		data = q->payload;
+		for (i = 0; i < q->len; i++) {
+			/* room for an escaped byte */
+			if (n > sizeof(s->wbuf) - 2) {
+				sio_write(s->fd, s->wbuf, n);
+				n = 0;
+			}
+			c = data[i];
+			if (c == __SLIP_END) {
+				s->wbuf[n++] = __SLIP_ESC;
+				c = __SLIP_ESC_END;
+			} else if (c == __SLIP_ESC) {
+				s->wbuf[n++] = __SLIP_ESC;
+				c = __SLIP_ESC_ESC;
+			}
+			s->wbuf[n++] = c;
+		}
+	}
+	s->wbuf[n++] = __SLIP_END;
+	sio_write(s->fd, s->wbuf, n);
+	s->tx_packets++;
+
+	return ERR_OK;
+}
+
+err_t sioslip_init(struct netif *netif)
+{
+	struct sioslip *s = netif->state;
+
+	LWIP_ASSERT("sioslip: no state", s);
+	s->fd = sio_open(s->devnum);
+	if (s->fd == NULL)
+		return ERR_IF;
+	s->netif = netif;
+	s->rx = NULL;
+	s->esc = 0;
+	s->drop = 0;
+	s->rx_packets = 0;
+	s->rx_drops = 0;
+	s->tx_packets = 0;
+#if SIO_FRAME_READ
+	/* wake the thread once per frame rather than per few bytes */
+	sio_frame_mode(s->fd, 1, __SLIP_END);
+#endif
+
+	netif->name[0] = 's';
+	netif->name[1] = 'l';
+	netif->output = __sioslip_output;
+	netif->mtu = SIOSLIP_MTU;
+	netif->flags = NETIF_FLAG_POINTTOPOINT | NETIF_FLAG_LINK_UP;
+
+#if !NO_SYS
+	sys_thread_new("slipif", __sioslip_thread, s, SLIPIF_THREAD_STACKSIZE,
+			SLIPIF_THREAD_PRIO);
+#endif
+
+	return ERR_OK;
+}
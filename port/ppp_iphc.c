@@ -0,0 +1,1019 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "arch/ppp_iphc.h"
+
+#if PPP_IPHC
+
+#include "lwip/pbuf.h"
+#include "lwip/ip.h"
+#include "lwip/inet_chksum.h"
+
+#include <string.h>
+
+#define __PPP_IPHC_FLAG		0x7e
+#define __PPP_IPHC_ESC		0x7d
+#define __PPP_IPHC_TRANS	0x20
+#define __PPP_IPHC_FCS_INIT	0xffff
+#define __PPP_IPHC_FCS_GOOD	0xf0b8
+
+#define __PPP_IP		0x0021
+#define __PPP_FULL_HEADER	0x0061
+#define __PPP_COMPRESSED_TCP	0x0063
+#define __PPP_COMPRESSED_TCP_ND	0x2063
+#define __PPP_COMPRESSED_NON_TCP 0x0065
+#define __PPP_IPCP		0x8021
+#define __PPP_LCP		0xc021
+
+/* LCP and IPCP codes */
+#define __PPP_CONFREQ		1
+#define __PPP_CONFACK		2
+#define __PPP_CONFNAK		3
+#define __PPP_CONFREJ		4
+#define __PPP_TERMREQ		5
+#define __PPP_TERMACK		6
+
+#define __PPP_LCP_ACCM		2	/* option type */
+#define __PPP_IPCP_COMPRESS	2	/* option type */
+#define __PPP_IPHC_OPT_LEN	14	/* without suboptions */
+/* Largest header the peer may compress, the least RFC 2507 allows. Those
+ * with IPv4 options aren't kept as contexts, see __ppp_iphc_rx_full(). */
+#define __PPP_IPHC_MAX_HEADER	60
+
+/* Room before a received frame for the headers it expands to, IPv4 and UDP
+ * in place of the 4 bytes of the shortest compressed header */
+#define __PPP_IPHC_HEADROOM	(20 + 8 - 4)
+
+enum {
+	__PPP_IPHC_HUNT,	/* before the first flag */
+	__PPP_IPHC_START,	/* after a flag */
+	__PPP_IPHC_HEAD,	/* reading the protocol */
+	__PPP_IPHC_PASS,	/* forwarding the frame as it is */
+	__PPP_IPHC_COLLECT,	/* gathering the frame to rewrite */
+	__PPP_IPHC_DROP		/* discarding the frame */
+};
+
+enum {
+	__PPP_IPHC_BODY,
+	__PPP_IPHC_FCS_LO,
+	__PPP_IPHC_FCS_HI,
+	__PPP_IPHC_END,
+	__PPP_IPHC_DONE
+};
+
+#define __get16(b)	((u16_t)((b)[0] << 8 | (b)[1]))
+#define __put16(b, x) \
+do { \
+	(b)[0] = (u8_t)((x) >> 8); \
+	(b)[1] = (u8_t)(x); \
+} while (0)
+
+/* Bytes written a chunk at a time */
+struct __ppp_iphc_out {
+	u8_t			buf[32];
+	u8_t			n;
+	ppp_iphc_write_fn	write;
+	void			*arg;
+};
+
+/* RFC 1662 FCS-16, four bits at a time */
+static const u16_t __ppp_iphc_fcs_tab[16] = {
+	0x0000, 0x1081, 0x2102, 0x3183, 0x4204, 0x5285, 0x6306, 0x7387,
+	0x8408, 0x9489, 0xa50a, 0xb58b, 0xc60c, 0xd68d, 0xe70e, 0xf78f
+};
+
+static u16_t __ppp_iphc_fcs(u16_t fcs, u8_t c)
+{
+	fcs = (fcs >> 4) ^ __ppp_iphc_fcs_tab[(fcs ^ c) & 0xf];
+	fcs = (fcs >> 4) ^ __ppp_iphc_fcs_tab[(fcs ^ (c >> 4)) & 0xf];
+
+	return fcs;
+}
+
+static u8_t __ppp_iphc_escaped(u8_t c, u32_t accm)
+{
+	return c == __PPP_IPHC_FLAG || c == __PPP_IPHC_ESC ||
+		(c < 0x20 && (accm & (1UL << c)));
+}
+
+static void __ppp_iphc_start(struct __ppp_iphc_dir *d)
+{
+	d->state = __PPP_IPHC_START;
+	d->esc = 0;
+	d->n = 0;
+	d->fcs = __PPP_IPHC_FCS_INIT;
+}
+
+/* Parse the address, control and protocol fields, return their length or 0
+ * if more bytes are needed. 'proto' is 0 if the frame isn't PPP. */
+static u8_t __ppp_iphc_proto(const u8_t *b, u16_t n, u16_t *proto)
+{
+	u8_t i = 0;
+
+	if (b[0] == 0xff) {
+		if (n < 2)
+			return 0;
+		if (b[1] != 0x03) {
+			*proto = 0;
+			return 2;
+		}
+		i = 2;
+	}
+	if (n < i + 1)
+		return 0;
+	if (b[i] & 1) {
+		/* compressed protocol field */
+		*proto = b[i];
+		return i + 1;
+	}
+	if (n < i + 2)
+		return 0;
+	*proto = __get16(b + i);
+
+	return i + 2;
+}
+
+/* Find an option of 'type' in a list, with 'proto' in its first two bytes
+ * unless it is 0. Return its offset, or -1. */
+static int __ppp_iphc_find(const u8_t *opt, u16_t len, u8_t type, u16_t proto)
+{
+	u16_t i = 0;
+
+	while (i + 2 <= len && opt[i + 1] >= 2 && i + opt[i + 1] <= len) {
+		if (opt[i] == type && (proto == 0 ||
+		    (opt[i + 1] >= 4 && __get16(opt + i + 2) == proto)))
+			return i;
+		i += opt[i + 1];
+	}
+
+	return -1;
+}
+
+/* Remove an option from an LCP or IPCP packet, return its new length */
+static u16_t __ppp_iphc_strip(u8_t *pkt, u16_t len, u16_t off, u8_t olen)
+{
+	memmove(pkt + off, pkt + off + olen, len - off - olen);
+	len -= olen;
+	__put16(pkt + 2, len);
+
+	return len;
+}
+
+static void __ppp_iphc_params(struct __ppp_iphc_params *pr, const u8_t *opt)
+{
+	u32_t space;
+
+	pr->contexts = 0;
+	if (opt[1] < __PPP_IPHC_OPT_LEN)
+		return;
+	space = __get16(opt + 6) + 1UL;
+	pr->max_period = __get16(opt + 8);
+	pr->max_time = __get16(opt + 10);
+	if (__get16(opt + 12) < 28 || pr->max_period == 0)
+		return;
+	pr->contexts = space < PPP_IPHC_CONTEXTS ? space : PPP_IPHC_CONTEXTS;
+}
+
+static void __ppp_iphc_ip_chksum(u8_t *ip, u8_t ihl)
+{
+	u16_t sum;
+
+	ip[10] = 0;
+	ip[11] = 0;
+	/* in network order already */
+	sum = inet_chksum(ip, ihl);
+	memcpy(ip + 10, &sum, sizeof(sum));
+}
+
+/* Back to the state of a new link, after LCP starts over */
+static void __ppp_iphc_reset(struct ppp_iphc *h)
+{
+	h->tx_on = 0;
+	h->rx_on = 0;
+	h->tx_accm = 0xffffffffUL;
+	/* no contexts, no option in lwIP's requests */
+	h->rx_params.contexts = PPP_IPHC_RX ? PPP_IPHC_CONTEXTS : 0;
+	h->rx_params.max_period = PPP_IPHC_MAX_PERIOD;
+	h->rx_params.max_time = PPP_IPHC_MAX_TIME;
+	h->req_iphc = 0;
+	h->refused = 0;
+	h->peer_opt_len = 0;
+}
+
+void ppp_iphc_init(struct ppp_iphc *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->tx.state = __PPP_IPHC_HUNT;
+	h->rx.state = __PPP_IPHC_HUNT;
+	__ppp_iphc_reset(h);
+}
+
+/*
+ * Sending
+ */
+
+static void __ppp_iphc_out(struct __ppp_iphc_out *o, u8_t c)
+{
+	o->buf[o->n++] = c;
+	if (o->n == sizeof(o->buf)) {
+		o->write(o->arg, o->buf, o->n);
+		o->n = 0;
+	}
+}
+
+static void __ppp_iphc_flush(struct __ppp_iphc_out *o)
+{
+	if (o->n > 0) {
+		o->write(o->arg, o->buf, o->n);
+		o->n = 0;
+	}
+}
+
+static void __ppp_iphc_put(struct __ppp_iphc_out *o, u8_t c, u32_t accm)
+{
+	if (__ppp_iphc_escaped(c, accm)) {
+		__ppp_iphc_out(o, __PPP_IPHC_ESC);
+		c ^= __PPP_IPHC_TRANS;
+	}
+	__ppp_iphc_out(o, c);
+}
+
+/* Send the frame gathered so far as it came, escaping every control
+ * character, and forward the rest of it */
+static void __ppp_iphc_tx_pass(struct ppp_iphc *h, struct __ppp_iphc_out *o)
+{
+	u16_t i;
+
+	for (i = 0; i < h->tx.n; i++)
+		__ppp_iphc_put(o, h->frame[i], 0xffffffffUL);
+	h->tx.state = __PPP_IPHC_PASS;
+}
+
+/* Send a frame with a new FCS, up to its closing flag */
+static void __ppp_iphc_emit(struct __ppp_iphc_out *o, const u8_t *b, u16_t n,
+		u32_t accm)
+{
+	u16_t fcs = __PPP_IPHC_FCS_INIT;
+	u16_t i;
+
+	for (i = 0; i < n; i++) {
+		fcs = __ppp_iphc_fcs(fcs, b[i]);
+		__ppp_iphc_put(o, b[i], accm);
+	}
+	fcs ^= 0xffff;
+	__ppp_iphc_put(o, (u8_t)fcs, accm);
+	__ppp_iphc_put(o, (u8_t)(fcs >> 8), accm);
+	__ppp_iphc_out(o, __PPP_IPHC_FLAG);
+}
+
+/* LCP from lwIP: a new negotiation, or the ACCM it acked */
+static void __ppp_iphc_tx_lcp(struct ppp_iphc *h, const u8_t *pkt, u16_t len)
+{
+	int i;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (len < 4 || __get16(pkt + 2) > len)
+		return;
+	len = __get16(pkt + 2);
+	SYS_ARCH_PROTECT(sr);
+	switch (pkt[0]) {
+	case __PPP_CONFREQ:
+	case __PPP_TERMREQ:
+	case __PPP_TERMACK:
+		__ppp_iphc_reset(h);
+		break;
+	case __PPP_CONFACK:
+		i = __ppp_iphc_find(pkt + 4, len - 4, __PPP_LCP_ACCM, 0);
+		if (i >= 0 && pkt[4 + i + 1] == 6)
+			h->tx_accm = (u32_t)__get16(pkt + 4 + i + 2) << 16 |
+				__get16(pkt + 4 + i + 4);
+		break;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+/* IPCP from lwIP: add our option to its requests and the peer's option back
+ * to its acks. Return the new length. There is room for __PPP_IPHC_OPT_MAX
+ * more bytes. */
+static u16_t __ppp_iphc_tx_ipcp(struct ppp_iphc *h, u8_t *pkt, u16_t len)
+{
+	struct __ppp_iphc_params *pr = &h->rx_params;
+	u8_t *opt = pkt + 4;
+	u8_t flush = 0;
+	u16_t off;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (len < 4 || __get16(pkt + 2) > len)
+		return len;
+	len = __get16(pkt + 2);
+	SYS_ARCH_PROTECT(sr);
+	switch (pkt[0]) {
+	case __PPP_CONFREQ:
+		h->req_id = pkt[1];
+		h->rx_on = 0;
+		h->req_iphc = !h->refused && pr->contexts > 0 &&
+			__ppp_iphc_find(opt, len - 4, __PPP_IPCP_COMPRESS,
+					0) < 0;
+		if (h->req_iphc) {
+			opt = pkt + len;
+			opt[0] = __PPP_IPCP_COMPRESS;
+			opt[1] = __PPP_IPHC_OPT_LEN;
+			__put16(opt + 2, __PPP_FULL_HEADER);
+			__put16(opt + 4, 0);	/* TCP_SPACE */
+			__put16(opt + 6, pr->contexts - 1);
+			__put16(opt + 8, pr->max_period);
+			__put16(opt + 10, pr->max_time);
+			__put16(opt + 12, __PPP_IPHC_MAX_HEADER);
+			len += __PPP_IPHC_OPT_LEN;
+			__put16(pkt + 2, len);
+		}
+		break;
+	case __PPP_CONFACK:
+		if (pkt[1] != h->peer_id)
+			break;
+		if (h->peer_opt_len > 0) {
+			off = h->peer_opt_off < len - 4 ? h->peer_opt_off :
+				len - 4;
+			memmove(opt + off + h->peer_opt_len, opt + off,
+					len - 4 - off);
+			memcpy(opt + off, h->peer_opt, h->peer_opt_len);
+			len += h->peer_opt_len;
+			__put16(pkt + 2, len);
+			h->tx_params = h->peer_params;
+			h->tx_on = h->peer_params.contexts > 0;
+			flush = h->tx_on;
+		} else {
+			h->tx_on = 0;
+		}
+		break;
+	case __PPP_TERMREQ:
+	case __PPP_TERMACK:
+		h->tx_on = 0;
+		h->rx_on = 0;
+		break;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+	if (flush)
+		memset(h->tx_ctx, 0, sizeof(h->tx_ctx));
+
+	return len;
+}
+
+/* Whether the start of an IPv4 packet may be compressed */
+static u8_t __ppp_iphc_udp(const u8_t *ip)
+{
+	u16_t len = __get16(ip + 2);
+
+	return ip[0] == 0x45 && len >= 20 + 8 && len <= PPP_IPHC_MAX_PACKET &&
+		(__get16(ip + 6) & 0x3fff) == 0 && ip[9] == IP_PROTO_UDP;
+}
+
+/* Compress the IPv4/UDP packet of the frame in place. Return the offset of
+ * the frame to send, 'n' being updated to its length. */
+static u16_t __ppp_iphc_compress(struct ppp_iphc *h, u16_t *n)
+{
+	u8_t hlen = h->tx.hlen;
+	u8_t *ip = h->frame + hlen;
+	u8_t *c;
+	struct __ppp_iphc_tx_ctx *x, *victim = NULL;
+	u32_t now = sys_now();
+	u8_t cid, csum, full = 0;
+	u8_t id[2], sum[2];
+	u16_t start;
+
+	/* lwIP may have padded it */
+	if (h->tx_params.contexts == 0 || *n - hlen < 20 + 8 ||
+	    !__ppp_iphc_udp(ip) || *n - hlen != __get16(ip + 2))
+		return 0;
+	csum = (ip[26] | ip[27]) != 0;
+	for (cid = 0; cid < h->tx_params.contexts; cid++) {
+		x = &h->tx_ctx[cid];
+		if (x->used && memcmp(x->key, ip + 12, sizeof(x->key)) == 0)
+			break;
+		/* a free context, or else the least recently used */
+		if (victim == NULL || (victim->used && (!x->used ||
+		    now - x->last > now - victim->last)))
+			victim = x;
+	}
+	if (cid == h->tx_params.contexts) {
+		x = victim;
+		cid = (u8_t)(x - h->tx_ctx);
+		memcpy(x->key, ip + 12, sizeof(x->key));
+		x->used = 1;
+		full = 1;
+	} else if (x->tos != ip[1] || x->ttl != ip[8] ||
+	    x->flags != (ip[6] & 0xe0) || x->csum != csum) {
+		full = 1;
+	}
+	x->last = now;
+	if (full) {
+		/* a new generation, which full headers start slowly */
+		x->gen = (x->gen + 1) & 0x3f;
+		x->tos = ip[1];
+		x->ttl = ip[8];
+		x->flags = ip[6] & 0xe0;
+		x->csum = csum;
+		x->period = 1;
+	} else if (x->count >= x->period || (h->tx_params.max_time > 0 &&
+	    now - x->full_time >= h->tx_params.max_time * 1000UL)) {
+		full = 1;
+		if (x->period < h->tx_params.max_period)
+			x->period = x->period * 2 < h->tx_params.max_period ?
+				x->period * 2 : h->tx_params.max_period;
+	}
+
+	if (full) {
+		/* the IPv4 length carries the context */
+		ip[2] = 0x80 | x->gen;
+		ip[3] = cid;
+		h->frame[hlen - 1] = (u8_t)__PPP_FULL_HEADER;
+		x->count = 0;
+		x->full_time = now;
+		h->stats.tx_full++;
+		return 0;
+	}
+
+	/* CID, generation, IPv4 identification and the UDP checksum if set,
+	 * in place of the headers, after the link header moved up */
+	memcpy(id, ip + 4, sizeof(id));
+	memcpy(sum, ip + 26, sizeof(sum));
+	start = 20 + 8 - 4 - (csum ? 2 : 0);
+	c = ip + start;
+	c[0] = cid;
+	c[1] = x->gen;
+	memcpy(c + 2, id, sizeof(id));
+	if (csum)
+		memcpy(c + 4, sum, sizeof(sum));
+	memmove(h->frame + start, h->frame, hlen);
+	h->frame[start + hlen - 1] = (u8_t)__PPP_COMPRESSED_NON_TCP;
+	*n -= start;
+	x->count++;
+	h->stats.tx_compressed++;
+	h->stats.tx_saved += start;
+
+	return start;
+}
+
+/* At the closing flag of a frame from lwIP */
+static void __ppp_iphc_tx_end(struct ppp_iphc *h, struct __ppp_iphc_out *o)
+{
+	struct __ppp_iphc_dir *d = &h->tx;
+	u8_t hlen = d->hlen;
+	u16_t n, start = 0;
+	u32_t accm = 0xffffffffUL;
+
+	if (d->state != __PPP_IPHC_COLLECT || d->esc ||
+	    d->fcs != __PPP_IPHC_FCS_GOOD || d->n < hlen + 2) {
+		/* as it came, aborted or not */
+		__ppp_iphc_tx_pass(h, o);
+		if (d->esc)
+			__ppp_iphc_out(o, __PPP_IPHC_ESC);
+		__ppp_iphc_out(o, __PPP_IPHC_FLAG);
+		__ppp_iphc_start(d);
+		return;
+	}
+
+	n = d->n - 2;
+	switch (d->proto) {
+	case __PPP_LCP:
+		__ppp_iphc_tx_lcp(h, h->frame + hlen, n - hlen);
+		break;
+	case __PPP_IPCP:
+		n = hlen + __ppp_iphc_tx_ipcp(h, h->frame + hlen, n - hlen);
+		break;
+	case __PPP_IP:
+		start = __ppp_iphc_compress(h, &n);
+		accm = h->tx_accm;
+		break;
+	}
+	__ppp_iphc_emit(o, h->frame + start, n, accm);
+	__ppp_iphc_start(d);
+}
+
+static void __ppp_iphc_tx_byte(struct ppp_iphc *h, struct __ppp_iphc_out *o,
+		u8_t c)
+{
+	struct __ppp_iphc_dir *d = &h->tx;
+	u16_t max;
+
+	if (c == __PPP_IPHC_FLAG) {
+		__ppp_iphc_tx_end(h, o);
+		return;
+	}
+	if (c == __PPP_IPHC_ESC) {
+		d->esc = 1;
+		return;
+	}
+	if (d->esc) {
+		c ^= __PPP_IPHC_TRANS;
+		d->esc = 0;
+	}
+	d->fcs = __ppp_iphc_fcs(d->fcs, c);
+	h->frame[d->n++] = c;
+
+	if (d->state != __PPP_IPHC_COLLECT) {
+		d->state = __PPP_IPHC_HEAD;
+		d->hlen = __ppp_iphc_proto(h->frame, d->n, &d->proto);
+		if (d->hlen == 0)
+			return;
+		if (d->proto == __PPP_LCP || d->proto == __PPP_IPCP ||
+		    (d->proto == __PPP_IP && h->tx_on))
+			d->state = __PPP_IPHC_COLLECT;
+		else
+			__ppp_iphc_tx_pass(h, o);
+		return;
+	}
+
+	switch (d->proto) {
+	case __PPP_IP:
+		if (d->n == d->hlen + 10 && !__ppp_iphc_udp(h->frame + d->hlen))
+			__ppp_iphc_tx_pass(h, o);
+		max = d->hlen + PPP_IPHC_MAX_PACKET + 2;
+		break;
+	case __PPP_IPCP:
+		/* leaving room for an option */
+		max = __PPP_IPHC_FRAME;
+		break;
+	default:
+		max = sizeof(h->frame);
+		break;
+	}
+	if (d->state == __PPP_IPHC_COLLECT && d->n == max)
+		__ppp_iphc_tx_pass(h, o);
+}
+
+void ppp_iphc_write(struct ppp_iphc *h, const u8_t *data, u32_t len,
+		ppp_iphc_write_fn write, void *arg)
+{
+	struct __ppp_iphc_out o;
+	const u8_t *flag;
+	u32_t n;
+
+	o.n = 0;
+	o.write = write;
+	o.arg = arg;
+	while (len > 0) {
+		if (h->tx.state == __PPP_IPHC_HUNT ||
+		    h->tx.state == __PPP_IPHC_PASS) {
+			/* straight through, up to the flag */
+			flag = memchr(data, __PPP_IPHC_FLAG, len);
+			n = flag ? (u32_t)(flag - data) + 1 : len;
+			if (flag)
+				__ppp_iphc_start(&h->tx);
+			__ppp_iphc_flush(&o);
+			write(arg, data, n);
+			data += n;
+			len -= n;
+		} else {
+			__ppp_iphc_tx_byte(h, &o, *data++);
+			len--;
+		}
+	}
+	__ppp_iphc_flush(&o);
+}
+
+/*
+ * Receiving
+ */
+
+static void __ppp_iphc_pend(struct ppp_iphc *h, u8_t c)
+{
+	h->pend[h->pend_len++] = c;
+}
+
+/* Pass the head of the frame as it came and the rest of it */
+static void __ppp_iphc_rx_pass(struct ppp_iphc *h)
+{
+	u8_t i, c;
+
+	for (i = 0; i < h->rx.n; i++) {
+		c = h->head[i];
+		if (__ppp_iphc_escaped(c, 0xffffffffUL)) {
+			__ppp_iphc_pend(h, __PPP_IPHC_ESC);
+			c ^= __PPP_IPHC_TRANS;
+		}
+		__ppp_iphc_pend(h, c);
+	}
+	h->rx.state = __PPP_IPHC_PASS;
+}
+
+static void __ppp_iphc_rx_drop(struct ppp_iphc *h)
+{
+	if (h->p != NULL) {
+		pbuf_free(h->p);
+		h->p = NULL;
+	}
+	h->rx.state = __PPP_IPHC_DROP;
+}
+
+/* Store a byte of the frame gathered, in pool pbufs chained as it grows */
+static void __ppp_iphc_rx_store(struct ppp_iphc *h, u8_t c)
+{
+	struct pbuf *q;
+
+	if (h->p == NULL) {
+		h->p = pbuf_alloc(PBUF_RAW, PBUF_POOL_BUFSIZE, PBUF_POOL);
+		if (h->p == NULL || pbuf_header(h->p, -__PPP_IPHC_HEADROOM)) {
+			h->stats.rx_errors++;
+			__ppp_iphc_rx_drop(h);
+			return;
+		}
+		h->q = h->p;
+		h->off = 0;
+	} else if (h->off == h->q->len) {
+		q = pbuf_alloc(PBUF_RAW, PBUF_POOL_BUFSIZE, PBUF_POOL);
+		if (q == NULL) {
+			h->stats.rx_errors++;
+			__ppp_iphc_rx_drop(h);
+			return;
+		}
+		pbuf_cat(h->p, q);
+		h->q = q;
+		h->off = 0;
+	}
+	((u8_t *)h->q->payload)[h->off++] = c;
+}
+
+/* IPCP from the peer: take the IPHC options out, before lwIP sees them.
+ * The frame is in one pbuf, without its FCS. */
+static void __ppp_iphc_rx_ipcp(struct ppp_iphc *h, struct pbuf *p)
+{
+	u8_t hlen = h->rx.hlen;
+	u8_t *pkt = (u8_t *)p->payload + hlen;
+	u8_t *opt = pkt + 4;
+	u16_t len;
+	u8_t flush = 0;
+	int i;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (p->next != NULL || p->len < hlen + 4 ||
+	    __get16(pkt + 2) < 4 || __get16(pkt + 2) > p->len - hlen)
+		return;
+	len = __get16(pkt + 2);
+	i = __ppp_iphc_find(opt, len - 4, __PPP_IPCP_COMPRESS,
+			__PPP_FULL_HEADER);
+	SYS_ARCH_PROTECT(sr);
+	switch (pkt[0]) {
+	case __PPP_CONFREQ:
+		/* lwIP acks the rest, or not */
+		h->peer_id = pkt[1];
+		h->peer_opt_len = 0;
+		h->tx_on = 0;
+		if (i >= 0 && opt[i + 1] <= sizeof(h->peer_opt)) {
+			h->peer_opt_len = opt[i + 1];
+			h->peer_opt_off = (u8_t)i;
+			memcpy(h->peer_opt, opt + i, h->peer_opt_len);
+			__ppp_iphc_params(&h->peer_params, opt + i);
+			len = __ppp_iphc_strip(pkt, len, 4 + i, opt[i + 1]);
+		}
+		break;
+	case __PPP_CONFACK:
+		if (pkt[1] == h->req_id && h->req_iphc && i >= 0) {
+			len = __ppp_iphc_strip(pkt, len, 4 + i, opt[i + 1]);
+			h->rx_on = 1;
+			flush = 1;
+		}
+		break;
+	case __PPP_CONFNAK:
+		if (pkt[1] != h->req_id || !h->req_iphc)
+			break;
+		if (i >= 0) {
+			/* the values the peer wants, in the next request */
+			__ppp_iphc_params(&h->rx_params, opt + i);
+			if (h->rx_params.contexts == 0)
+				h->refused = 1;
+			len = __ppp_iphc_strip(pkt, len, 4 + i, opt[i + 1]);
+		} else if (__ppp_iphc_find(opt, len - 4, __PPP_IPCP_COMPRESS,
+					0) >= 0) {
+			/* another protocol, for lwIP to take or not */
+			h->refused = 1;
+		}
+		break;
+	case __PPP_CONFREJ:
+		if (pkt[1] == h->req_id && h->req_iphc && i >= 0) {
+			len = __ppp_iphc_strip(pkt, len, 4 + i, opt[i + 1]);
+			h->refused = 1;
+		}
+		break;
+	case __PPP_TERMREQ:
+	case __PPP_TERMACK:
+		h->tx_on = 0;
+		h->rx_on = 0;
+		break;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+	if (flush)
+		memset(h->rx_ctx, 0, sizeof(h->rx_ctx));
+	pbuf_realloc(p, hlen + len);
+}
+
+/* FULL_HEADER: put the IPv4 length back and keep the headers of the
+ * context. Return 0 to drop the frame. */
+static u8_t __ppp_iphc_rx_full(struct ppp_iphc *h, struct pbuf *p)
+{
+	u8_t hlen = h->rx.hlen;
+	u8_t *ip = (u8_t *)p->payload + hlen;
+	u16_t len = p->tot_len - hlen;
+	struct __ppp_iphc_rx_ctx *x;
+	u8_t ihl, frag, udp;
+
+	/* a non-TCP context with an 8-bit CID */
+	if (p->len < hlen + 20 || (ip[2] & 0xc0) != 0x80 ||
+	    ip[3] >= h->rx_params.contexts)
+		return 0;
+	ihl = (ip[0] & 0x0f) * 4;
+	if ((ip[0] >> 4) != 4 || ihl < 20 || ihl > len || p->len < hlen + ihl)
+		return 0;
+	frag = (__get16(ip + 6) & 0x3fff) != 0;
+	udp = ip[9] == IP_PROTO_UDP && !frag;
+	if (udp && (len < ihl + 8 || p->len < hlen + ihl + 8))
+		return 0;
+	x = &h->rx_ctx[ip[3]];
+	x->gen = ip[2] & 0x3f;
+	__put16(ip + 2, len);
+	if (udp)
+		__put16(ip + ihl + 4, len - ihl);
+	__ppp_iphc_ip_chksum(ip, ihl);
+	/* a header with options doesn't fit the headroom */
+	x->len = 0;
+	if (ihl == 20 && !frag) {
+		x->len = 20 + (udp ? 8 : 0);
+		memcpy(x->hdr, ip, x->len);
+	}
+	ip[-1] = (u8_t)__PPP_IP;
+	h->stats.rx_full++;
+
+	return 1;
+}
+
+/* COMPRESSED_NON_TCP: expand the headers from the context, in the headroom.
+ * Return 0 to drop the frame. */
+static u8_t __ppp_iphc_rx_compressed(struct ppp_iphc *h, struct pbuf *p)
+{
+	u8_t hlen = h->rx.hlen;
+	u8_t *c = (u8_t *)p->payload + hlen;
+	u8_t link[4], rnd[4];
+	struct __ppp_iphc_rx_ctx *x;
+	u8_t clen;
+	u16_t len;
+	u8_t *ip;
+
+	/* 8-bit CID and no delta */
+	if (p->len < hlen + 4 || (c[1] & 0xc0) != 0 ||
+	    c[0] >= h->rx_params.contexts)
+		return 0;
+	x = &h->rx_ctx[c[0]];
+	if (x->len == 0 || x->gen != c[1])
+		return 0;
+	clen = 4 + (x->len == 28 && (x->hdr[26] | x->hdr[27]) ? 2 : 0);
+	if (p->len < hlen + clen)
+		return 0;
+	memcpy(link, p->payload, hlen);
+	memcpy(rnd, c + 2, clen - 2);
+	if (pbuf_header(p, x->len - clen)) {
+		h->stats.rx_errors++;
+		return 0;
+	}
+
+	memcpy(p->payload, link, hlen);
+	ip = (u8_t *)p->payload + hlen;
+	ip[-1] = (u8_t)__PPP_IP;
+	memcpy(ip, x->hdr, x->len);
+	len = p->tot_len - hlen;
+	__put16(ip + 2, len);
+	memcpy(ip + 4, rnd, 2);
+	if (x->len == 28) {
+		__put16(ip + 24, len - 20);
+		if (clen == 6)
+			memcpy(ip + 26, rnd + 2, 2);
+	}
+	__ppp_iphc_ip_chksum(ip, 20);
+	h->stats.rx_compressed++;
+
+	return 1;
+}
+
+/* At the closing flag of a frame gathered, pass it to PPP rewritten */
+static void __ppp_iphc_rx_end(struct ppp_iphc *h)
+{
+	struct __ppp_iphc_dir *d = &h->rx;
+	struct pbuf *p = h->p;
+	u8_t ok = 1;
+
+	h->p = NULL;
+	if (d->esc || d->fcs != __PPP_IPHC_FCS_GOOD || d->n < d->hlen + 2) {
+		h->stats.rx_errors++;
+		pbuf_free(p);
+		return;
+	}
+	pbuf_realloc(p, d->n - 2);
+	switch (d->proto) {
+	case __PPP_IPCP:
+		__ppp_iphc_rx_ipcp(h, p);
+		break;
+	case __PPP_FULL_HEADER:
+		ok = __ppp_iphc_rx_full(h, p);
+		break;
+	case __PPP_COMPRESSED_NON_TCP:
+		ok = __ppp_iphc_rx_compressed(h, p);
+		break;
+	}
+	if (!ok) {
+		h->stats.rx_dropped++;
+		pbuf_free(p);
+		return;
+	}
+
+	h->out.p = p;
+	h->out.q = p;
+	h->out.off = 0;
+	h->out.fcs = __PPP_IPHC_FCS_INIT;
+	h->out.phase = __PPP_IPHC_BODY;
+	h->out.next = 0;
+}
+
+static void __ppp_iphc_rx_byte(struct ppp_iphc *h, u8_t c)
+{
+	struct __ppp_iphc_dir *d = &h->rx;
+	u8_t i;
+
+	if (c == __PPP_IPHC_FLAG) {
+		switch (d->state) {
+		case __PPP_IPHC_START:
+		case __PPP_IPHC_HEAD:
+			__ppp_iphc_rx_pass(h);
+			if (d->esc)
+				__ppp_iphc_pend(h, __PPP_IPHC_ESC);
+			__ppp_iphc_pend(h, __PPP_IPHC_FLAG);
+			break;
+		case __PPP_IPHC_COLLECT:
+			__ppp_iphc_rx_end(h);
+			break;
+		}
+		/* the previous flag opens the next frame after a drop */
+		__ppp_iphc_start(d);
+		return;
+	}
+	if (c == __PPP_IPHC_ESC) {
+		d->esc = 1;
+		return;
+	}
+	if (d->esc) {
+		c ^= __PPP_IPHC_TRANS;
+		d->esc = 0;
+	}
+	d->fcs = __ppp_iphc_fcs(d->fcs, c);
+
+	switch (d->state) {
+	case __PPP_IPHC_START:
+	case __PPP_IPHC_HEAD:
+		d->state = __PPP_IPHC_HEAD;
+		h->head[d->n++] = c;
+		d->hlen = __ppp_iphc_proto(h->head, d->n, &d->proto);
+		if (d->hlen == 0)
+			return;
+		if (d->proto == __PPP_IPCP || (h->rx_on &&
+		    (d->proto == __PPP_FULL_HEADER ||
+		     d->proto == __PPP_COMPRESSED_NON_TCP))) {
+			d->state = __PPP_IPHC_COLLECT;
+			for (i = 0; i < d->n && d->state == __PPP_IPHC_COLLECT;
+					i++)
+				__ppp_iphc_rx_store(h, h->head[i]);
+		} else if (h->rx_on && (d->proto == __PPP_COMPRESSED_TCP ||
+		    d->proto == __PPP_COMPRESSED_TCP_ND)) {
+			h->stats.rx_dropped++;
+			d->state = __PPP_IPHC_DROP;
+		} else {
+			__ppp_iphc_rx_pass(h);
+		}
+		break;
+	case __PPP_IPHC_COLLECT:
+		if (d->n == d->hlen + PPP_IPHC_MRU + 2) {
+			h->stats.rx_errors++;
+			__ppp_iphc_rx_drop(h);
+			break;
+		}
+		d->n++;
+		__ppp_iphc_rx_store(h, c);
+		break;
+	}
+}
+
+/* Next byte of the frame escaped for PPP, -1 after its closing flag */
+static int __ppp_iphc_esc_next(struct __ppp_iphc_esc *e)
+{
+	u8_t c;
+
+	if (e->next) {
+		c = e->next;
+		e->next = 0;
+		return c;
+	}
+	switch (e->phase) {
+	case __PPP_IPHC_BODY:
+		while (e->q != NULL && e->off == e->q->len) {
+			e->q = e->q->next;
+			e->off = 0;
+		}
+		if (e->q != NULL) {
+			c = ((u8_t *)e->q->payload)[e->off++];
+			e->fcs = __ppp_iphc_fcs(e->fcs, c);
+			break;
+		}
+		e->fcs ^= 0xffff;
+		e->phase = __PPP_IPHC_FCS_LO;
+		/* fall through */
+	case __PPP_IPHC_FCS_LO:
+		c = (u8_t)e->fcs;
+		e->phase = __PPP_IPHC_FCS_HI;
+		break;
+	case __PPP_IPHC_FCS_HI:
+		c = (u8_t)(e->fcs >> 8);
+		e->phase = __PPP_IPHC_END;
+		break;
+	case __PPP_IPHC_END:
+		e->phase = __PPP_IPHC_DONE;
+		return __PPP_IPHC_FLAG;
+	default:
+		return -1;
+	}
+	if (__ppp_iphc_escaped(c, 0xffffffffUL)) {
+		e->next = c ^ __PPP_IPHC_TRANS;
+		return __PPP_IPHC_ESC;
+	}
+
+	return c;
+}
+
+/* Move the bytes ready for PPP */
+static u32_t __ppp_iphc_drain(struct ppp_iphc *h, u8_t *data, u32_t len)
+{
+	u32_t n = 0;
+	int c;
+
+	while (n < len && h->pend_pos < h->pend_len)
+		data[n++] = h->pend[h->pend_pos++];
+	if (h->pend_pos == h->pend_len) {
+		h->pend_pos = 0;
+		h->pend_len = 0;
+	}
+	while (n < len && h->out.p != NULL) {
+		c = __ppp_iphc_esc_next(&h->out);
+		if (c < 0) {
+			pbuf_free(h->out.p);
+			h->out.p = NULL;
+			break;
+		}
+		data[n++] = (u8_t)c;
+	}
+
+	return n;
+}
+
+u32_t ppp_iphc_read(struct ppp_iphc *h, u8_t *data, u32_t len,
+		ppp_iphc_read_fn read, void *arg)
+{
+	u32_t n = 0;
+	u8_t c;
+
+	while (1) {
+		n += __ppp_iphc_drain(h, data + n, len - n);
+		if (n == len)
+			return n;
+		/* nothing left for PPP */
+		if (h->raw_pos == h->raw_len) {
+			if (n > 0)
+				return n;
+			h->raw_pos = 0;
+			h->raw_len = (u8_t)read(arg, h->raw, sizeof(h->raw));
+			if (h->raw_len == 0)
+				return 0;
+		}
+		if (h->rx.state == __PPP_IPHC_HUNT ||
+		    h->rx.state == __PPP_IPHC_PASS) {
+			/* straight through, up to the flag */
+			while (n < len && h->raw_pos < h->raw_len) {
+				c = h->raw[h->raw_pos++];
+				data[n++] = c;
+				if (c == __PPP_IPHC_FLAG) {
+					__ppp_iphc_start(&h->rx);
+					break;
+				}
+			}
+		} else {
+			__ppp_iphc_rx_byte(h, h->raw[h->raw_pos++]);
+		}
+	}
+}
+
+void ppp_iphc_get_stats(struct ppp_iphc *h, struct ppp_iphc_stats *st)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	*st = h->stats;
+	st->tx_on = h->tx_on;
+	st->rx_on = h->rx_on;
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+#endif /* PPP_IPHC */
@@ -0,0 +1,100 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "arch/ram_report.h"
+
+#if RAM_REPORT
+
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+#include "arch/mem_arch.h"
+#include "arch/capture.h"
+#include "arch/sio_trace.h"
+
+/* What the pools of memp_std.h need, as memp.c includes it */
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/raw.h"
+#include "lwip/tcp_impl.h"
+#include "lwip/igmp.h"
+#include "lwip/api.h"
+#include "lwip/api_msg.h"
+#include "lwip/tcpip.h"
+#include "lwip/timers.h"
+#include "netif/etharp.h"
+#include "lwip/ip_frag.h"
+#include "lwip/snmp_structs.h"
+#include "lwip/snmp_msg.h"
+#include "lwip/dns.h"
+#include "netif/ppp_oe.h"
+
+#include <stdio.h>
+
+#define __RAM_REPORT_REGIONS 20
+
+#if MEMP_STATS
+/* The name and element size of each pool, in the order of memp_t */
+static const struct {
+	const char	*name;
+	u16_t		size;
+} __ram_report_memp[MEMP_MAX] = {
+#define LWIP_MEMPOOL(name, num, size, desc) \
+	{ "memp." #name, LWIP_MEM_ALIGN_SIZE(size) },
+#include "lwip/memp_std.h"
+};
+#endif
+
+static void __ram_report_line(const char *name, u32_t size, u32_t peak)
+{
+	LWIP_PLATFORM_DIAG(("ram %s %lu %lu\n", name, (unsigned long)size,
+				(unsigned long)peak));
+}
+
+void ram_report(void)
+{
+	struct ram_region r[__RAM_REPORT_REGIONS];
+#if MEM_ARCH
+	struct mem_arch_stats ms;
+#endif
+#if MEM_ARCH
+	char name[16];
+#endif
+	u8_t i, n;
+
+#if !NO_SYS
+	n = sys_arch_ram_regions(r, __RAM_REPORT_REGIONS);
+#else
+	n = 0;
+#endif
+	n += sio_ram_regions(&r[n], __RAM_REPORT_REGIONS - n);
+#if CAPTURE
+	n += capture_ram_regions(&r[n], __RAM_REPORT_REGIONS - n);
+#endif
+#if SIO_TRACE
+	n += sio_trace_ram_regions(&r[n], __RAM_REPORT_REGIONS - n);
+#endif
+#if LWIP_DNS && !NO_SYS
+	n += resolv_ram_regions(&r[n], __RAM_REPORT_REGIONS - n);
+#endif
+	for (i = 0; i < n; i++)
+		__ram_report_line(r[i].name, r[i].size, r[i].peak);
+
+#if MEM_ARCH
+	for (i = 0; mem_arch_get_stats(i, &ms) == 0; i++) {
+		snprintf(name, sizeof(name), "mem.%u", (unsigned)ms.size);
+		__ram_report_line(name, (u32_t)ms.size * ms.nblks,
+				(u32_t)ms.size * ms.peak);
+	}
+#elif MEM_STATS
+	__ram_report_line("heap", lwip_stats.mem.avail, lwip_stats.mem.max);
+#endif
+#if MEMP_STATS
+	for (i = 0; i < MEMP_MAX; i++)
+		__ram_report_line(__ram_report_memp[i].name,
+				(u32_t)__ram_report_memp[i].size *
+				lwip_stats.memp[i].avail,
+				(u32_t)__ram_report_memp[i].size *
+				lwip_stats.memp[i].max);
+#endif
+}
+
+#endif /* RAM_REPORT */
@@ -0,0 +1,349 @@
+#include "lwip/opt.h"
+
+#if LWIP_DNS && !NO_SYS
+
+#include "lwip/sys.h"
+#include "lwip/dns.h"
+#include "lwip/tcpip.h"
+#include "lwip/timers.h"
+#include "arch/resolv.h"
+#include "arch/ram_report.h"
+#include "arch/timer_wheel.h"
+
+#include <string.h>
+
+enum {
+	__RESOLV_FREE,
+	__RESOLV_PENDING,	/* no answer yet */
+	__RESOLV_VALID,
+	__RESOLV_NEGATIVE
+};
+
+struct __resolv_waiter {
+	struct __resolv_waiter	*next;
+	resolv_found_fn		found;
+	void			*arg;
+};
+
+static struct __resolv_entry {
+	char			name[RESOLV_MAX_NAME_LENGTH];
+	u32_t			hash;
+	ip_addr_t		addr;
+	u32_t			expires;	/* sys_now() based */
+	u16_t			hits;
+	u8_t			state;
+	u8_t			busy;		/* a query is outstanding */
+	struct __resolv_waiter	*waiters;
+#if TIMER_WHEEL
+	struct timer_wheel_entry retry;
+#endif
+} __resolv[RESOLV_TABLE_SIZE];
+
+static struct __resolv_waiter __resolv_waiter[RESOLV_MAX_WAITERS];
+
+#if RAM_REPORT
+static u8_t __resolv_peak, __resolv_waiter_peak;	/* most ever in use */
+#endif
+
+#define __resolv_expired(e, now) ((s32_t)((e)->expires - (now)) <= 0)
+
+static u32_t __resolv_hash(const char *name)
+{
+	u32_t hash = 2166136261UL;
+
+	while (*name)
+		hash = (hash ^ (u8_t)*name++) * 16777619UL;
+
+	return hash;
+}
+
+/* Called with the cache locked */
+static struct __resolv_entry *__resolv_find(const char *name, u32_t hash)
+{
+	int i;
+
+	for (i = 0; i < RESOLV_TABLE_SIZE; i++) {
+		if (__resolv[i].state != __RESOLV_FREE &&
+		    __resolv[i].hash == hash &&
+		    strcmp(__resolv[i].name, name) == 0)
+			return &__resolv[i];
+	}
+
+	return NULL;
+}
+
+/* Called with the cache locked: pick a free entry or evict the idle one
+ * closest to its expiry */
+static struct __resolv_entry *__resolv_alloc(void)
+{
+	struct __resolv_entry *e, *victim = NULL;
+	int i;
+
+	for (i = 0; i < RESOLV_TABLE_SIZE; i++) {
+		e = &__resolv[i];
+		if (e->state == __RESOLV_FREE)
+			return e;
+		if (e->busy || e->waiters)
+			continue;
+		if (!victim || (s32_t)(e->expires - victim->expires) < 0)
+			victim = e;
+	}
+
+	return victim;
+}
+
+/* Called with the cache locked */
+static struct __resolv_waiter *__resolv_waiter_alloc(void)
+{
+	int i;
+
+	for (i = 0; i < RESOLV_MAX_WAITERS; i++) {
+		if (!__resolv_waiter[i].found)
+			return &__resolv_waiter[i];
+	}
+
+	return NULL;
+}
+
+#if RAM_REPORT
+/* Called with the cache locked, once a query took an entry and a waiter */
+static void __resolv_ram_used(void)
+{
+	u8_t i, n = 0, w = 0;
+
+	for (i = 0; i < RESOLV_TABLE_SIZE; i++) {
+		if (__resolv[i].state != __RESOLV_FREE)
+			n++;
+	}
+	for (i = 0; i < RESOLV_MAX_WAITERS; i++) {
+		if (__resolv_waiter[i].found)
+			w++;
+	}
+	if (n > __resolv_peak)
+		__resolv_peak = n;
+	if (w > __resolv_waiter_peak)
+		__resolv_waiter_peak = w;
+}
+#endif
+
+static void __resolv_start(void *arg);
+
+/* Runs in the tcpip thread: record the outcome of a lookup and hand it to the
+ * waiters. A failure is cached as a negative answer only when 'cache' is set,
+ * that is when it came from the DNS server rather than from a lack of local
+ * resources. */
+static void __resolv_done(struct __resolv_entry *e, ip_addr_t *ipaddr,
+		u8_t cache)
+{
+	struct __resolv_waiter *w, *next;
+	char name[RESOLV_MAX_NAME_LENGTH];
+	ip_addr_t addr;
+	u8_t valid;
+	u32_t now = sys_now();
+	int i;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	if (ipaddr) {
+		ip_addr_copy(e->addr, *ipaddr);
+		e->expires = now + RESOLV_TTL * 1000UL;
+		e->state = __RESOLV_VALID;
+	} else if (e->state != __RESOLV_VALID) {
+		/* a failed refresh keeps the old answer until it expires */
+		e->expires = now + RESOLV_NEG_TTL * 1000UL;
+		e->state = cache ? __RESOLV_NEGATIVE : __RESOLV_FREE;
+	}
+	/* the entry may be evicted as soon as it is unlocked */
+	valid = e->state == __RESOLV_VALID;
+	ip_addr_copy(addr, e->addr);
+	strcpy(name, e->name);
+	e->hits = 0;
+	e->busy = 0;
+	w = e->waiters;
+	e->waiters = NULL;
+	SYS_ARCH_UNPROTECT(sr);
+
+	for (; w; w = next) {
+		next = w->next;
+		w->found(name, valid ? &addr : NULL, w->arg);
+		SYS_ARCH_PROTECT(sr);
+		w->found = NULL;
+		SYS_ARCH_UNPROTECT(sr);
+	}
+
+	/* start the lookups whose waiters were left behind when resolv_query()
+	 * could not reach the tcpip thread */
+	for (i = 0; i < RESOLV_TABLE_SIZE; i++) {
+		e = &__resolv[i];
+		SYS_ARCH_PROTECT(sr);
+		valid = e->state == __RESOLV_PENDING && !e->busy && e->waiters;
+		if (valid)
+			e->busy = 1;
+		SYS_ARCH_UNPROTECT(sr);
+		if (valid)
+			__resolv_start(e);
+	}
+}
+
+/* Runs in the tcpip thread when dns_gethostbyname() finishes */
+static void __resolv_found(const char *name, ip_addr_t *ipaddr, void *arg)
+{
+	LWIP_UNUSED_ARG(name);
+	__resolv_done(arg, ipaddr, 1);
+}
+
+/* Runs in the tcpip thread */
+static void __resolv_start(void *arg)
+{
+	struct __resolv_entry *e = arg;
+	ip_addr_t addr;
+
+	switch (dns_gethostbyname(e->name, &addr, __resolv_found, e)) {
+	case ERR_OK:
+		__resolv_done(e, &addr, 1);
+		break;
+	case ERR_INPROGRESS:
+		break;
+	case ERR_MEM:
+		/* every entry of the DNS table is busy, one frees up once its
+		 * query is answered or times out */
+#if TIMER_WHEEL
+		timer_wheel_setup(&e->retry, __resolv_start, e,
+				TIMER_WHEEL_TCPIP);
+		timer_wheel_start(&e->retry, RESOLV_RETRY_INTERVAL, 0);
+#else
+		sys_timeout(RESOLV_RETRY_INTERVAL, __resolv_start, e);
+#endif
+		break;
+	default:
+		__resolv_done(e, NULL, 0);
+		break;
+	}
+}
+
+static err_t __resolv_kick(struct __resolv_entry *e)
+{
+	return tcpip_callback_with_block(__resolv_start, e, 0);
+}
+
+err_t resolv_query(const char *name, ip_addr_t *addr, resolv_found_fn found,
+		void *arg)
+{
+	struct __resolv_entry *e;
+	struct __resolv_waiter *w, **pw;
+	u32_t hash, now;
+	u8_t start = 0, prev;
+	err_t err = ERR_INPROGRESS;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (!name || strlen(name) >= RESOLV_MAX_NAME_LENGTH)
+		return ERR_ARG;
+	hash = __resolv_hash(name);
+	now = sys_now();
+
+	SYS_ARCH_PROTECT(sr);
+	e = __resolv_find(name, hash);
+	if (e && e->state == __RESOLV_VALID && !__resolv_expired(e, now)) {
+		ip_addr_copy(*addr, e->addr);
+		if (e->hits < 0xffff)
+			e->hits++;
+		if (!e->busy && e->hits >= RESOLV_REFRESH_HITS &&
+		    (s32_t)(e->expires - now) <
+		    (s32_t)(RESOLV_REFRESH_AHEAD * 1000UL)) {
+			e->busy = 1;
+			start = 1;
+		}
+		SYS_ARCH_UNPROTECT(sr);
+		if (start && __resolv_kick(e) != ERR_OK) {
+			/* try again on a later hit */
+			SYS_ARCH_PROTECT(sr);
+			e->busy = 0;
+			SYS_ARCH_UNPROTECT(sr);
+		}
+		return ERR_OK;
+	}
+	if (e && e->state == __RESOLV_NEGATIVE && !__resolv_expired(e, now)) {
+		SYS_ARCH_UNPROTECT(sr);
+		return ERR_VAL;
+	}
+
+	if (!e) {
+		e = __resolv_alloc();
+		if (!e) {
+			SYS_ARCH_UNPROTECT(sr);
+			return ERR_MEM;
+		}
+		strcpy(e->name, name);
+		e->hash = hash;
+		e->state = __RESOLV_FREE;
+		e->busy = 0;
+		e->waiters = NULL;
+	}
+	prev = e->state;
+	e->state = __RESOLV_PENDING;
+	e->hits = 0;
+	if (!e->busy) {
+		e->busy = 1;
+		start = 1;
+	}
+	w = NULL;
+	if (found) {
+		w = __resolv_waiter_alloc();
+		if (w) {
+			w->found = found;
+			w->arg = arg;
+			w->next = e->waiters;
+			e->waiters = w;
+		} else {
+			err = ERR_MEM;
+		}
+	}
+#if RAM_REPORT
+	__resolv_ram_used();
+#endif
+	SYS_ARCH_UNPROTECT(sr);
+
+	if (start && __resolv_kick(e) != ERR_OK) {
+		/* the tcpip mbox is full: nothing is cached and the caller may
+		 * try again, the waiters which joined meanwhile are started by
+		 * the next lookup to finish or the next query of the name */
+		SYS_ARCH_PROTECT(sr);
+		if (w) {
+			for (pw = &e->waiters; *pw != w; pw = &(*pw)->next)
+				;
+			*pw = w->next;
+			w->found = NULL;
+		}
+		e->busy = 0;
+		if (!e->waiters)
+			e->state = prev;
+		SYS_ARCH_UNPROTECT(sr);
+		return ERR_MEM;
+	}
+
+	return err;
+}
+
+#if RAM_REPORT
+u8_t resolv_ram_regions(struct ram_region *r, u8_t max)
+{
+	u8_t n = 0;
+
+	if (n < max) {
+		r[n].name = "resolv";
+		r[n].size = sizeof(__resolv);
+		r[n].peak = __resolv_peak * sizeof(__resolv[0]);
+		n++;
+	}
+	if (n < max) {
+		r[n].name = "resolv.waiters";
+		r[n].size = sizeof(__resolv_waiter);
+		r[n].peak = __resolv_waiter_peak * sizeof(__resolv_waiter[0]);
+		n++;
+	}
+
+	return n;
+}
+#endif
+
+#endif /* LWIP_DNS && !NO_SYS */
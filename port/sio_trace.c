@@ -0,0 +1,323 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "lwip/pbuf.h"
+#include "arch/sio_trace.h"
+#include "arch/ram_report.h"
+
+#if SIO_TRACE
+
+#include "ucos_ii.h"
+
+#include <string.h>
+
+#define __SIO_TRACE_HDR_LEN	12
+#define __SIO_TRACE_VERSION	1
+
+/* Room for the longest record, a 5-byte varint and a digest */
+#define __SIO_TRACE_REC_MAX	9
+
+/* Digests waiting to be matched during a replay */
+#define __SIO_TRACE_PENDING	8
+
+static struct {
+	u8_t		buf[SIO_TRACE_SIZE];
+	u32_t		len;
+	u32_t		last;	/* clock of the previous record */
+	u8_t		truncated;
+#if RAM_REPORT
+	u32_t		peak;	/* longest recording */
+#endif
+} __sio_trace;
+
+static struct {
+	u8_t		on;
+	u32_t		digest[__SIO_TRACE_PENDING];
+	u8_t		rd;
+	u8_t		count;
+	u8_t		decoded;	/* the pending digests are decoded ones */
+	u32_t		last;	/* clock of the last packet */
+	struct sio_trace_result *res;
+} __sio_replay;
+
+static netif_input_fn __sio_trace_input;
+
+volatile u8_t sio_trace_on;
+
+static u32_t __sio_trace_get32(const u8_t *p)
+{
+	return p[0] | (p[1] << 8) | ((u32_t)p[2] << 16) | ((u32_t)p[3] << 24);
+}
+
+static void __sio_trace_put32(u8_t *p, u32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/* Called with interrupts disabled */
+static void __sio_trace_rec(u8_t kind, const u8_t *data, u8_t len)
+{
+	u32_t now = SIO_TRACE_CLOCK(), v;
+	u8_t *p;
+
+	if (__sio_trace.len + __SIO_TRACE_REC_MAX > SIO_TRACE_SIZE) {
+		__sio_trace.truncated = 1;
+		sio_trace_on = 0;
+		return;
+	}
+	p = &__sio_trace.buf[__sio_trace.len];
+	v = now - __sio_trace.last;
+	__sio_trace.last = now;
+	/* the top bit of the delta doesn't fit, such a gap is clamped */
+	if (v > 0x7fffffff)
+		v = 0x7fffffff;
+	v = (v << 1) | kind;
+	while (v >= 0x80) {
+		*p++ = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	while (len-- > 0)
+		*p++ = *data++;
+	__sio_trace.len = p - __sio_trace.buf;
+}
+
+void sio_trace_byte(u8_t c)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	if (sio_trace_on)
+		__sio_trace_rec(0, &c, 1);
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+static u32_t __sio_trace_digest(struct pbuf *p)
+{
+	u32_t h = 2166136261UL;
+	u16_t i;
+
+	for (; p; p = p->next) {
+		for (i = 0; i < p->len; i++)
+			h = (h ^ ((u8_t *)p->payload)[i]) * 16777619UL;
+	}
+
+	return h;
+}
+
+/* Match a digest against the pending ones of the other side */
+static void __sio_replay_match(u32_t digest, u8_t decoded)
+{
+	struct sio_trace_result *res = __sio_replay.res;
+
+	if (__sio_replay.count > 0 && __sio_replay.decoded != decoded) {
+		if (__sio_replay.digest[__sio_replay.rd] != digest)
+			res->mismatches++;
+		__sio_replay.rd = (__sio_replay.rd + 1) % __SIO_TRACE_PENDING;
+		__sio_replay.count--;
+	} else if (__sio_replay.count == __SIO_TRACE_PENDING) {
+		/* too far apart to be the same packets */
+		res->mismatches++;
+	} else {
+		__sio_replay.digest[(__sio_replay.rd + __sio_replay.count) %
+			__SIO_TRACE_PENDING] = digest;
+		__sio_replay.count++;
+		__sio_replay.decoded = decoded;
+	}
+}
+
+static err_t __sio_trace_netif_input(struct pbuf *p, struct netif *inp)
+{
+	u32_t digest;
+	u8_t buf[4];
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (sio_trace_on || __sio_replay.on) {
+		digest = __sio_trace_digest(p);
+		SYS_ARCH_PROTECT(sr);
+		if (sio_trace_on) {
+			__sio_trace_put32(buf, digest);
+			__sio_trace_rec(1, buf, sizeof(buf));
+		}
+		if (__sio_replay.on) {
+			__sio_replay.res->decoded++;
+			__sio_replay.last = SIO_TRACE_CLOCK();
+			__sio_replay_match(digest, 1);
+		}
+		SYS_ARCH_UNPROTECT(sr);
+	}
+
+	return __sio_trace_input(p, inp);
+}
+
+void sio_trace_attach(struct netif *netif)
+{
+	if (netif->input != __sio_trace_netif_input) {
+		__sio_trace_input = netif->input;
+		netif->input = __sio_trace_netif_input;
+	}
+}
+
+void sio_trace_start(void)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+#if RAM_REPORT
+	if (__sio_trace.len > __sio_trace.peak)
+		__sio_trace.peak = __sio_trace.len;
+#endif
+	memcpy(__sio_trace.buf, "SIOT", 4);
+	__sio_trace.buf[4] = __SIO_TRACE_VERSION;
+	__sio_trace.buf[5] = 0;
+	__sio_trace.buf[6] = 0;
+	__sio_trace.buf[7] = 0;
+	__sio_trace_put32(&__sio_trace.buf[8], SIO_TRACE_CLOCK_HZ);
+	__sio_trace.len = __SIO_TRACE_HDR_LEN;
+	__sio_trace.last = SIO_TRACE_CLOCK();
+	__sio_trace.truncated = 0;
+	sio_trace_on = 1;
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+void sio_trace_stop(void)
+{
+	sio_trace_on = 0;
+}
+
+const u8_t *sio_trace_get(u32_t *len)
+{
+	*len = __sio_trace.len;
+
+	return __sio_trace.buf;
+}
+
+#if RAM_REPORT
+u8_t sio_trace_ram_regions(struct ram_region *r, u8_t max)
+{
+	if (max == 0)
+		return 0;
+	r->name = "sio_trace";
+	r->size = SIO_TRACE_SIZE;
+	r->peak = LWIP_MAX(__sio_trace.peak, __sio_trace.len);
+
+	return 1;
+}
+#endif
+
+/* Wait until 'delta' clock ticks passed since '*t', then advance '*t' */
+static void __sio_replay_wait(u32_t *t, u32_t delta)
+{
+	u32_t ticks;
+
+	ticks = (u32_t)((unsigned long long)delta * OS_TICKS_PER_SEC /
+			SIO_TRACE_CLOCK_HZ);
+	if (ticks > 1)
+		OSTimeDly(ticks - 1);
+	while ((u32_t)(SIO_TRACE_CLOCK() - *t) < delta)
+		;
+	*t += delta;
+}
+
+int sio_trace_replay(sio_fd_t fd, const u8_t *trace, u32_t len, u8_t timed,
+		struct sio_trace_result *res)
+{
+	u32_t off, v, t, start;
+	u8_t shift, kind, idle;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (len < __SIO_TRACE_HDR_LEN || memcmp(trace, "SIOT", 4) != 0 ||
+	    trace[4] != __SIO_TRACE_VERSION)
+		return -1;
+	memset(res, 0, sizeof(*res));
+	res->clock_hz = SIO_TRACE_CLOCK_HZ;
+	if (timed && __sio_trace_get32(&trace[8]) != SIO_TRACE_CLOCK_HZ)
+		return -1;
+
+	SYS_ARCH_PROTECT(sr);
+	__sio_replay.rd = 0;
+	__sio_replay.count = 0;
+	__sio_replay.res = res;
+	__sio_replay.on = 1;
+	SYS_ARCH_UNPROTECT(sr);
+
+	start = t = SIO_TRACE_CLOCK();
+	__sio_replay.last = start;
+	off = __SIO_TRACE_HDR_LEN;
+	while (off < len) {
+		v = 0;
+		shift = 0;
+		do {
+			if (off == len || shift > 28)
+				goto malformed;
+			v |= (u32_t)(trace[off] & 0x7f) << shift;
+			shift += 7;
+		} while (trace[off++] & 0x80);
+		kind = v & 1;
+		if (timed)
+			__sio_replay_wait(&t, v >> 1);
+
+		if (kind == 0) {
+			if (off == len)
+				goto malformed;
+			/* a reader with a higher priority empties the ring
+			 * as soon as it wakes up */
+			while (sio_inject(fd, &trace[off], 1) == 0)
+				OSTimeDly(1);
+			off++;
+			res->bytes++;
+		} else {
+			if (len - off < 4)
+				goto malformed;
+			SYS_ARCH_PROTECT(sr);
+			res->packets++;
+			__sio_replay_match(__sio_trace_get32(&trace[off]), 0);
+			SYS_ARCH_UNPROTECT(sr);
+			off += 4;
+		}
+	}
+
+	/* let the last packets through, a partial frame takes a timeout */
+	for (idle = 0; idle < 2; idle++) {
+		v = res->decoded;
+		OSTimeDly(OS_TICKS_PER_SEC / 10 + 1);
+		if (res->decoded != v)
+			idle = 0;
+	}
+
+	SYS_ARCH_PROTECT(sr);
+	__sio_replay.on = 0;
+	res->mismatches += __sio_replay.count;
+	res->elapsed = __sio_replay.last - start;
+	SYS_ARCH_UNPROTECT(sr);
+
+	return 0;
+
+malformed:
+	__sio_replay.on = 0;
+	return -1;
+}
+
+void sio_trace_report(const struct sio_trace_result *res)
+{
+	u32_t us = (u32_t)((unsigned long long)res->elapsed * 1000000 /
+			res->clock_hz);
+
+	LWIP_PLATFORM_DIAG(("replayed %lu bytes, %lu/%lu packets, "
+				"%lu mismatches\n",
+				(unsigned long)res->bytes,
+				(unsigned long)res->decoded,
+				(unsigned long)res->packets,
+				(unsigned long)res->mismatches));
+	if (res->decoded > 0 && us > 0) {
+		LWIP_PLATFORM_DIAG(("%lu us, %lu packets/s, %lu us/packet\n",
+				(unsigned long)us,
+				(unsigned long)((unsigned long long)
+					res->decoded * 1000000 / us),
+				(unsigned long)(us / res->decoded)));
+	}
+}
+
+#endif /* SIO_TRACE */
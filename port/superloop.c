@@ -0,0 +1,97 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "arch/superloop.h"
+
+#if NO_SYS
+
+#include "lwip/init.h"
+#include "lwip/timers.h"
+#include "arch/mem_arch.h"
+#include "arch/task_prof.h"
+#include "ucos_ii.h"
+
+#if PPP_SUPPORT && PPPOS_SUPPORT
+# include "ppp.h"
+#endif
+
+static struct {
+	sio_fd_t	fd;
+	int		pd;	/* -1 if unused */
+} __superloop[SUPERLOOP_LINKS];
+
+static u8_t __superloop_buf[SUPERLOOP_READ_SIZE];
+
+void superloop_init(void)
+{
+	u8_t i;
+
+	for (i = 0; i < SUPERLOOP_LINKS; i++)
+		__superloop[i].pd = -1;
+	/* what sys_init() does for the threaded build */
+#if MEM_ARCH
+	mem_arch_init();
+#endif
+#if TASK_PROF
+	task_prof_init();
+#endif
+	lwip_init();
+}
+
+err_t superloop_add_ppp(sio_fd_t fd, int pd)
+{
+	u8_t i;
+
+	for (i = 0; i < SUPERLOOP_LINKS; i++) {
+		if (__superloop[i].pd < 0) {
+			__superloop[i].fd = fd;
+			__superloop[i].pd = pd;
+			return ERR_OK;
+		}
+	}
+
+	return ERR_MEM;
+}
+
+void superloop_remove_ppp(int pd)
+{
+	u8_t i;
+
+	for (i = 0; i < SUPERLOOP_LINKS; i++) {
+		if (__superloop[i].pd == pd)
+			__superloop[i].pd = -1;
+	}
+}
+
+u32_t superloop_poll(void)
+{
+	u32_t len, total = 0;
+	u8_t i;
+
+	/* one read per link and poll, so that a busy link doesn't starve the
+	 * others nor the timers */
+	for (i = 0; i < SUPERLOOP_LINKS; i++) {
+		if (__superloop[i].pd < 0)
+			continue;
+		len = sio_tryread(__superloop[i].fd, __superloop_buf,
+				sizeof(__superloop_buf));
+		if (len == 0)
+			continue;
+#if PPP_SUPPORT && PPPOS_SUPPORT
+		pppos_input(__superloop[i].pd, __superloop_buf, len);
+#endif
+		total += len;
+	}
+	sys_check_timeouts();
+
+	return total;
+}
+
+void superloop_run(const volatile u8_t *stop)
+{
+	while (!*stop) {
+		if (superloop_poll() == 0)
+			OSTimeDly(SUPERLOOP_IDLE_TICKS);
+	}
+}
+
+#endif /* NO_SYS */
@@ -1,7 +1,19 @@
 #include "lwip/sys.h"
+#include "arch/mem_arch.h"
+#include "arch/task_prof.h"
+#include "arch/tcpip_defer.h"
+#include "arch/ram_report.h"
 
 #include "ucos_ii.h"
 
+static u32_t ticks_to_ms(u32_t ticks)
+{
+	return ticks * 1000 / OS_TICKS_PER_SEC;
+}
+
+/* With NO_SYS, only sys_now() is left, see arch/superloop.h */
+#if !NO_SYS
+
 /******************************************************************************
  * Define the size of the mbox
  ******************************************************************************/
@@ -33,41 +45,387 @@
 # define __MBOX_SIZE DEFAULT_TCP_RECVMBOX_SIZE
 #endif
 
+/******************************************************************************
+ * Urgent messages
+ *
+ * Blocking posts (API calls, callbacks and timeouts) are control traffic,
+ * while packet input is always posted with sys_mbox_trypost(). Up to
+ * SYS_MBOX_URGENT_SIZE blocking posts to the tcpip mbox are kept in a
+ * separate FIFO and announced with OSQPostFront(), so they overtake queued
+ * packets. Packets can't use these slots. Once they are all taken, control
+ * messages go to the normal slots, and keep doing so until the last of them
+ * was fetched, so that they are never overtaken by a later one.
+ *
+ * Only the tcpip mbox has them, outside the pool: it is the first mbox
+ * sys_mbox_new() makes, as tcpip_init() makes it before any other part of
+ * lwIP can. Blocking posts to the other mboxes (netconn_accept()'s, a recvmbox
+ * of a netconn) are in order with the rest.
+ ******************************************************************************/
+
+#ifndef SYS_MBOX_URGENT_SIZE
+# define SYS_MBOX_URGENT_SIZE 0
+#endif
+
 #define __ESC_NULL ((void *)0xffffffffUL)
+#define __ESC_URGENT ((void *)0xfffffffeUL)
 
-static struct sys_mbox {
+struct sys_mbox {
 	OS_EVENT	*q;
 	OS_EVENT	*sem;
+#if SYS_MBOX_CACHE > 0
+	struct sys_mbox	*next;	/* in the cache */
+#endif
+};
+
+#if SYS_MBOX_URGENT_SIZE > 0
+# define __MBOX_POOL (OS_MAX_QS - 1)
+
+static struct {
+	struct sys_mbox	mbox;
+	void		*urgent[SYS_MBOX_URGENT_SIZE];
+	u8_t		urgent_rd;
+	u8_t		urgent_len;
+	void		*urgent_last;	/* last control message in the normal
+					 * slots, until it is fetched */
+	void		*start[__MBOX_SIZE + SYS_MBOX_URGENT_SIZE];
+} __mbox_tcpip;
+
+# define __MBOX_IS_TCPIP(m) ((m) == &__mbox_tcpip.mbox)
+#else
+# define __MBOX_POOL OS_MAX_QS
+# define __MBOX_IS_TCPIP(m) 0
+#endif
+
+/* The pool of the other mboxes, each with the slots of its OS queue */
+static struct sys_mbox_slots {
+	struct sys_mbox	mbox;
 	void		*start[__MBOX_SIZE];
-} __mbox[OS_MAX_QS];
+} __mbox[__MBOX_POOL];
 static OS_MEM *__mbox_mem;
 
+#if RAM_REPORT
+static struct {
+	u16_t	used;	/* mboxes allocated, the cached ones included */
+	u16_t	peak;
+	u16_t	depth;	/* most normal slots ever taken in one mbox */
+} __mbox_ram;
+
+/* Called after a normal slot was taken */
+# define __SYS_MBOX_DEPTH(m) \
+do { \
+	u16_t __depth = __MBOX_SIZE - (m)->sem->OSEventCnt; \
+	if (__depth > __mbox_ram.depth) \
+		__mbox_ram.depth = __depth; \
+} while (0)
+#else
+# define __SYS_MBOX_DEPTH(m)
+#endif
+
+/* Create the kernel objects of an mbox, returns 0 if there are none left */
+static int __sys_mbox_init(sys_mbox_t m, void **start, u16_t size)
+{
+	INT8U err;
+#if RAM_REPORT
+	SYS_ARCH_DECL_PROTECT(sr);
+#endif
+
+	m->q = OSQCreate(start, size);
+	if (m->q) {
+		m->sem = OSSemCreate(__MBOX_SIZE);
+		if (m->sem) {
+#if RAM_REPORT
+			SYS_ARCH_PROTECT(sr);
+			if (++__mbox_ram.used > __mbox_ram.peak)
+				__mbox_ram.peak = __mbox_ram.used;
+			SYS_ARCH_UNPROTECT(sr);
+#endif
+			return 1;
+		}
+		OSQDel(m->q, OS_DEL_ALWAYS, &err);
+		LWIP_ASSERT("OSQDel", err == OS_ERR_NONE);
+		m->q = NULL;
+	}
+
+	return 0;
+}
+
+/* Allocate an mbox of the pool and its kernel objects */
+static sys_mbox_t __sys_mbox_create(void)
+{
+	struct sys_mbox_slots *s;
+	INT8U err;
+
+	s = OSMemGet(__mbox_mem, &err);
+	if (s) {
+		if (__sys_mbox_init(&s->mbox, s->start, __MBOX_SIZE))
+			return &s->mbox;
+		err = OSMemPut(__mbox_mem, s);
+		LWIP_ASSERT("OSMemPut", err == OS_ERR_NONE);
+	}
+
+	return NULL;
+}
+
+static void __sys_mbox_destroy(sys_mbox_t m)
+{
+	INT8U err;
+#if RAM_REPORT
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	__mbox_ram.used--;
+	SYS_ARCH_UNPROTECT(sr);
+#endif
+
+	OSSemDel(m->sem, OS_DEL_ALWAYS, &err);
+	LWIP_ASSERT("OSSemDel", err == OS_ERR_NONE);
+	OSQDel(m->q, OS_DEL_ALWAYS, &err);
+	LWIP_ASSERT("OSQDel", err == OS_ERR_NONE);
+	m->q = NULL;
+	if (__MBOX_IS_TCPIP(m))
+		return;
+	/* the mbox is the first member of its slots */
+	err = OSMemPut(__mbox_mem, m);
+	LWIP_ASSERT("OSMemPut", err == OS_ERR_NONE);
+}
+
+#if SYS_MBOX_CACHE > 0
+/******************************************************************************
+ * Cache of freed mboxes
+ *
+ * A freed mbox keeps its OS queue and semaphore and is handed out again by
+ * the next sys_mbox_new(), so opening and closing netconns doesn't create
+ * and delete kernel objects.
+ ******************************************************************************/
+
+static struct {
+	struct sys_mbox	*head;
+	u16_t		len;
+	struct sys_mbox_cache_stats stats;
+} __mbox_cache;
+
+/** Read the counters of the mbox cache
+ * @param st where the counters are stored */
+void sys_mbox_cache_get_stats(struct sys_mbox_cache_stats *st)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	*st = __mbox_cache.stats;
+	st->cached = __mbox_cache.len;
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+/* Empty an mbox and put it into the cache, returns 0 if the cache is full */
+static int __sys_mbox_cache_put(sys_mbox_t m)
+{
+	INT8U err;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	if (__mbox_cache.len >= SYS_MBOX_CACHE) {
+		SYS_ARCH_UNPROTECT(sr);
+		return 0;
+	}
+	__mbox_cache.len++;
+	SYS_ARCH_UNPROTECT(sr);
+
+	/* nobody may wait on an mbox being freed */
+	LWIP_ASSERT("mbox in use", m->q->OSEventGrp == 0 &&
+			m->sem->OSEventGrp == 0);
+	err = OSQFlush(m->q);
+	LWIP_ASSERT("OSQFlush", err == OS_ERR_NONE);
+	OSSemSet(m->sem, __MBOX_SIZE, &err);
+	LWIP_ASSERT("OSSemSet", err == OS_ERR_NONE);
+
+	SYS_ARCH_PROTECT(sr);
+	m->next = __mbox_cache.head;
+	__mbox_cache.head = m;
+	SYS_ARCH_UNPROTECT(sr);
+
+	return 1;
+}
+#endif /* SYS_MBOX_CACHE > 0 */
+
+#if SYS_BACKPRESSURE
+/******************************************************************************
+ * Backpressure from the tcpip mbox (and the pbuf pool) to the link
+ ******************************************************************************/
+
+#ifndef SYS_BACKPRESSURE_HIGH
+# define SYS_BACKPRESSURE_HIGH (__MBOX_SIZE * 3 / 4)
+#endif
+#ifndef SYS_BACKPRESSURE_LOW
+# define SYS_BACKPRESSURE_LOW (__MBOX_SIZE / 4)
+#endif
+
+#if SYS_BACKPRESSURE_HIGH > __MBOX_SIZE || \
+	SYS_BACKPRESSURE_LOW >= SYS_BACKPRESSURE_HIGH
+# error "SYS_BACKPRESSURE_LOW < SYS_BACKPRESSURE_HIGH <= mbox size is needed"
+#endif
+
+#if SYS_BACKPRESSURE_POOL
+# include "lwip/stats.h"
+# include "lwip/memp.h"
+# define __pool_used() \
+	(lwip_stats.memp[MEMP_PBUF_POOL].used * 100 / \
+	 lwip_stats.memp[MEMP_PBUF_POOL].avail)
+#else
+# define __pool_used() 0
+#endif
+
+static struct {
+	sys_mbox_t	mbox;	/* the tcpip mbox, learnt from its reader */
+	void		(*fn)(void *arg, u8_t on);
+	void		*arg;
+	u8_t		on;
+	u32_t		drops;
+} __bp;
+
+/** Ask for a callback when the tcpip thread falls behind
+ * @param fn called with on = 1 when the backlog reaches the high watermark
+ *        and with on = 0 when it has dropped below the low watermark again,
+ *        possibly from an ISR
+ * @param arg argument passed to 'fn' */
+void sys_backpressure_set(void (*fn)(void *arg, u8_t on), void *arg)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	__bp.fn = fn;
+	__bp.arg = arg;
+	__bp.on = 0;
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+/** Number of messages the tcpip mbox refused */
+u32_t sys_backpressure_drops(void)
+{
+	return __bp.drops;
+}
+
+static void __sys_backpressure(sys_mbox_t m, u8_t dropped)
+{
+	u16_t backlog;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (m != __bp.mbox)
+		return;
+	backlog = __MBOX_SIZE - m->sem->OSEventCnt;
+	SYS_ARCH_PROTECT(sr);
+	if (dropped)
+		__bp.drops++;
+	if (!__bp.on) {
+		if (dropped || backlog >= SYS_BACKPRESSURE_HIGH ||
+		    __pool_used() >= SYS_BACKPRESSURE_POOL_HIGH) {
+			__bp.on = 1;
+			if (__bp.fn)
+				__bp.fn(__bp.arg, 1);
+		}
+	} else {
+		if (backlog <= SYS_BACKPRESSURE_LOW &&
+		    __pool_used() <= SYS_BACKPRESSURE_POOL_LOW) {
+			__bp.on = 0;
+			if (__bp.fn)
+				__bp.fn(__bp.arg, 0);
+		}
+	}
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+/* Called after every fetch, including timeouts */
+static void __sys_backpressure_fetched(sys_mbox_t m)
+{
+	if (!__bp.mbox && OSPrioCur == TCPIP_THREAD_PRIO)
+		__bp.mbox = m;
+	__sys_backpressure(m, 0);
+}
+#endif /* SYS_BACKPRESSURE */
+
 #if TCPIP_THREAD_STACKSIZE > 0
 static OS_STK __tcpip_stk[TCPIP_THREAD_STACKSIZE];
 #endif
 
+/* Tick the tcpip thread last came back from sys_arch_mbox_fetch() */
+static INT32U __tcpip_fetched;
+static u8_t __tcpip_fetching;
+
 #if SLIPIF_THREAD_STACKSIZE > 0
 static OS_STK __slipif_stk[SLIPIF_THREAD_STACKSIZE];
 #endif
 
 #if PPP_THREAD_STACKSIZE > 0
-static OS_STK __ppp_stk[PPP_THREAD_STACKSIZE];
+/* Every PPP session reads its serial port in its own thread, which takes the
+ * first free priority from PPP_THREAD_PRIO on. */
+#if TCPIP_THREAD_PRIO >= PPP_THREAD_PRIO && \
+	TCPIP_THREAD_PRIO < PPP_THREAD_PRIO + NUM_PPP
+#error "TCPIP_THREAD_PRIO is one of the NUM_PPP priorities of the PPP threads"
+#endif
+static OS_STK __ppp_stk[NUM_PPP][PPP_THREAD_STACKSIZE];
+/* The task which started each PPP thread, OS_PRIO_SELF once it is freed */
+static u8_t __ppp_creator[NUM_PPP];
 #endif
 
 /* sys_init() must be called before anything else. */
 void sys_init(void)
 {
 	INT8U err;
+#if SYS_MBOX_CACHE > 0
+	sys_mbox_t m;
+#endif
+#if SYS_MBOX_CACHE > 0 || PPP_THREAD_STACKSIZE > 0
+	u8_t i;
+#endif
 
-	__mbox_mem = OSMemCreate(&__mbox[0], OS_MAX_QS, sizeof(struct sys_mbox),
-		       	&err);
+	__mbox_mem = OSMemCreate(&__mbox[0], __MBOX_POOL,
+			sizeof(struct sys_mbox_slots), &err);
 	LWIP_ASSERT("OSMemCreate", err == OS_ERR_NONE);
+#if PPP_THREAD_STACKSIZE > 0
+	for (i = 0; i < NUM_PPP; i++)
+		__ppp_creator[i] = OS_PRIO_SELF;
+#endif
+#if SYS_MBOX_CACHE > 0
+	for (i = 0; i < SYS_MBOX_CACHE_WARM; i++) {
+		m = __sys_mbox_create();
+		LWIP_ASSERT("SYS_MBOX_CACHE_WARM is too big", m);
+		__sys_mbox_cache_put(m);
+	}
+#endif
+#if MEM_ARCH
+	mem_arch_init();
+#endif
+#if TASK_PROF
+	task_prof_init();
+#endif
 }
 
-static u32_t ticks_to_ms(u32_t ticks)
+#if SYS_SEM_CACHE > 0
+/******************************************************************************
+ * Cache of freed semaphores
+ *
+ * lwIP 1.4 gives every netconn its own op_completed semaphore and creates one
+ * for each blocking select() and gethostbyname(); a freed semaphore is kept
+ * here and handed out again by the next sys_sem_new() with its count reset.
+ ******************************************************************************/
+
+static struct {
+	OS_EVENT	*sems[SYS_SEM_CACHE];
+	u16_t		len;
+	struct sys_sem_cache_stats stats;
+} __sem_cache;
+
+/** Read the counters of the semaphore cache
+ * @param st where the counters are stored */
+void sys_sem_cache_get_stats(struct sys_sem_cache_stats *st)
 {
-	return ticks * 1000 / OS_TICKS_PER_SEC;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	*st = __sem_cache.stats;
+	st->cached = __sem_cache.len;
+	SYS_ARCH_UNPROTECT(sr);
 }
+#endif /* SYS_SEM_CACHE > 0 */
 
 static u32_t ms_to_ticks(u32_t ms)
 {
@@ -81,6 +439,24 @@ static u32_t ms_to_ticks(u32_t ms)
 err_t sys_sem_new(sys_sem_t *sem, u8_t count)
 {
 	OS_EVENT *ev;
+#if SYS_SEM_CACHE > 0
+	INT8U err;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	if (__sem_cache.len > 0) {
+		ev = __sem_cache.sems[--__sem_cache.len];
+		__sem_cache.stats.hits++;
+		SYS_ARCH_UNPROTECT(sr);
+		/* nobody waits on a cached semaphore, so this can't fail */
+		OSSemSet(ev, count, &err);
+		LWIP_ASSERT("OSSemSet", err == OS_ERR_NONE);
+		*sem = ev;
+		return ERR_OK;
+	}
+	__sem_cache.stats.misses++;
+	SYS_ARCH_UNPROTECT(sr);
+#endif
 
 	ev = OSSemCreate(count);
 	if (ev) {
@@ -96,6 +472,19 @@ err_t sys_sem_new(sys_sem_t *sem, u8_t count)
 void sys_sem_free(sys_sem_t *sem)
 {
 	INT8U err;
+#if SYS_SEM_CACHE > 0
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	/* nobody may wait on a semaphore being freed */
+	LWIP_ASSERT("sem in use", (*sem)->OSEventGrp == 0);
+	SYS_ARCH_PROTECT(sr);
+	if (__sem_cache.len < SYS_SEM_CACHE) {
+		__sem_cache.sems[__sem_cache.len++] = *sem;
+		SYS_ARCH_UNPROTECT(sr);
+		return;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+#endif
 
 	OSSemDel(*sem, OS_DEL_ALWAYS, &err);
 	LWIP_ASSERT("OSSemDel", err == OS_ERR_NONE);
@@ -149,25 +538,46 @@ u32_t sys_arch_sem_wait(sys_sem_t *sem, u32_t timeout)
 err_t sys_mbox_new(sys_mbox_t *mbox, int size)
 {
 	sys_mbox_t m;
-	INT8U err;
+#if SYS_MBOX_CACHE > 0
+	SYS_ARCH_DECL_PROTECT(sr);
+#endif
 
 	LWIP_ASSERT("allocate a empty mbox?", size);
 	LWIP_ASSERT("__MBOX_SIZE is too small", size <= __MBOX_SIZE);
 
-	m = OSMemGet(__mbox_mem, &err);
+#if SYS_MBOX_URGENT_SIZE > 0
+	/* tcpip_init() makes the first one */
+	if (!__mbox_tcpip.mbox.q) {
+		__mbox_tcpip.urgent_rd = 0;
+		__mbox_tcpip.urgent_len = 0;
+		__mbox_tcpip.urgent_last = NULL;
+		if (!__sys_mbox_init(&__mbox_tcpip.mbox, __mbox_tcpip.start,
+				__MBOX_SIZE + SYS_MBOX_URGENT_SIZE))
+			return ERR_MEM;
+		*mbox = &__mbox_tcpip.mbox;
+		return ERR_OK;
+	}
+#endif
+#if SYS_MBOX_CACHE > 0
+	SYS_ARCH_PROTECT(sr);
+	m = __mbox_cache.head;
 	if (m) {
-		m->q = OSQCreate(m->start, __MBOX_SIZE);
-		if (m->q) {
-			m->sem = OSSemCreate(__MBOX_SIZE);
-			if (m->sem) {
-				*mbox = m;
-				return ERR_OK;
-			}
-			OSQDel(m->q, OS_DEL_ALWAYS, &err);
-			LWIP_ASSERT("OSQDel", err == OS_ERR_NONE);
-		}
-		err = OSMemPut(__mbox_mem, m);
-		LWIP_ASSERT("OSMemPut", err == OS_ERR_NONE);
+		__mbox_cache.head = m->next;
+		__mbox_cache.len--;
+		__mbox_cache.stats.hits++;
+	} else {
+		__mbox_cache.stats.misses++;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+	if (m) {
+		*mbox = m;
+		return ERR_OK;
+	}
+#endif
+	m = __sys_mbox_create();
+	if (m) {
+		*mbox = m;
+		return ERR_OK;
 	}
 
 	return ERR_MEM;
@@ -177,15 +587,82 @@ err_t sys_mbox_new(sys_mbox_t *mbox, int size)
  * @param mbox mbox to delete */
 void sys_mbox_free(sys_mbox_t *mbox)
 {
-	INT8U err;
 	sys_mbox_t m = *mbox;
 
-	OSSemDel(m->sem, OS_DEL_ALWAYS, &err);
-	LWIP_ASSERT("OSSemDel", err == OS_ERR_NONE);
-	OSQDel(m->q, OS_DEL_ALWAYS, &err);
-	LWIP_ASSERT("OSQDel", err == OS_ERR_NONE);
-	err = OSMemPut(__mbox_mem, m);
-	LWIP_ASSERT("OSMemPut", err == OS_ERR_NONE);
+#if SYS_BACKPRESSURE
+	if (m == __bp.mbox)
+		__bp.mbox = NULL;
+#endif
+#if SYS_MBOX_CACHE > 0
+	if (!__MBOX_IS_TCPIP(m) && __sys_mbox_cache_put(m))
+		return;
+#endif
+	__sys_mbox_destroy(m);
+}
+
+#if SYS_MBOX_URGENT_SIZE > 0
+/* Returns 0 if the message must go to the normal slots: the mbox isn't the
+ * tcpip mbox, the urgent slots are all taken, or an earlier control message
+ * went there and is still queued. A control message is live until it is
+ * processed, so its pointer tells it apart from any other message queued
+ * meanwhile. */
+static int __sys_mbox_post_urgent(sys_mbox_t m, void *msg)
+{
+	INT8U err;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (!__MBOX_IS_TCPIP(m))
+		return 0;
+	SYS_ARCH_PROTECT(sr);
+	if (__mbox_tcpip.urgent_len == SYS_MBOX_URGENT_SIZE ||
+			__mbox_tcpip.urgent_last) {
+		__mbox_tcpip.urgent_last = msg ? msg : __ESC_NULL;
+		SYS_ARCH_UNPROTECT(sr);
+		return 0;
+	}
+	__mbox_tcpip.urgent[(__mbox_tcpip.urgent_rd +
+			__mbox_tcpip.urgent_len) % SYS_MBOX_URGENT_SIZE] = msg;
+	__mbox_tcpip.urgent_len++;
+	SYS_ARCH_UNPROTECT(sr);
+	err = OSQPostFront(m->q, __ESC_URGENT);
+	LWIP_ASSERT("OSQPostFront", err == OS_ERR_NONE);
+
+	return 1;
+}
+#endif
+
+/* Turn what the OS queue returned into the message posted */
+static void *__sys_mbox_got(sys_mbox_t m, void *msg)
+{
+	INT8U err;
+#if SYS_MBOX_URGENT_SIZE > 0
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (msg == __ESC_URGENT) {
+		LWIP_ASSERT("urgent message out of the tcpip mbox",
+				__MBOX_IS_TCPIP(m));
+		SYS_ARCH_PROTECT(sr);
+		LWIP_ASSERT("urgent_len", __mbox_tcpip.urgent_len > 0);
+		msg = __mbox_tcpip.urgent[__mbox_tcpip.urgent_rd];
+		if (++__mbox_tcpip.urgent_rd == SYS_MBOX_URGENT_SIZE)
+			__mbox_tcpip.urgent_rd = 0;
+		__mbox_tcpip.urgent_len--;
+		SYS_ARCH_UNPROTECT(sr);
+		return msg;
+	}
+	if (__MBOX_IS_TCPIP(m)) {
+		SYS_ARCH_PROTECT(sr);
+		if (msg == __mbox_tcpip.urgent_last)
+			__mbox_tcpip.urgent_last = NULL;
+		SYS_ARCH_UNPROTECT(sr);
+	}
+#endif
+	err = OSSemPost(m->sem);
+	LWIP_ASSERT("OSSemPost", err == OS_ERR_NONE);
+	if (msg == __ESC_NULL)
+		msg = NULL;
+
+	return msg;
 }
 
 /** Post a message to an mbox - may not fail
@@ -197,10 +674,15 @@ void sys_mbox_post(sys_mbox_t *mbox, void *msg)
 	INT8U err;
 	sys_mbox_t m = *mbox;
 
+#if SYS_MBOX_URGENT_SIZE > 0
+	if (__sys_mbox_post_urgent(m, msg))
+		return;
+#endif
 	if (!msg)
 		msg = __ESC_NULL;
 	OSSemPend(m->sem, 0, &err);
 	LWIP_ASSERT("OSSemPend", err == OS_ERR_NONE);
+	__SYS_MBOX_DEPTH(m);
 	err = OSQPost(m->q, msg);
 	LWIP_ASSERT("OSQPost", err == OS_ERR_NONE);
 }
@@ -216,10 +698,17 @@ err_t sys_mbox_trypost(sys_mbox_t *mbox, void *msg)
 	if (!msg)
 		msg = __ESC_NULL;
 	if (OSSemAccept(m->sem)) {
+		__SYS_MBOX_DEPTH(m);
 		err = OSQPost(m->q, msg);
 		LWIP_ASSERT("OSQPost", err == OS_ERR_NONE);
+#if SYS_BACKPRESSURE
+		__sys_backpressure(m, 0);
+#endif
 		return ERR_OK;
 	} else {
+#if SYS_BACKPRESSURE
+		__sys_backpressure(m, 1);
+#endif
 		return ERR_MEM;
 	}
 }
@@ -229,13 +718,16 @@ err_t sys_mbox_trypost(sys_mbox_t *mbox, void *msg)
  * @param msg pointer where the message is stored
  * @param timeout maximum time (in milliseconds) to wait for a message (0 = wait forever)
  * @return time (in milliseconds) waited for a message, may be 0 if not waited
-           or SYS_ARCH_TIMEOUT on timeout
+           or SYS_ARCH_TIMEOUT on timeout, in the tcpip thread the time since
+           its last fetch
  *         The returned time has to be accurate to prevent timer jitter! */
 u32_t sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout)
 {
 	INT8U err;
 	sys_mbox_t m = *mbox;
 	INT32U begin_time;
+	u32_t waited;
+	u8_t tcpip = OSPrioCur == TCPIP_THREAD_PRIO;
 
 	if (timeout) {
 		timeout = ms_to_ticks(timeout);
@@ -245,18 +737,35 @@ u32_t sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout)
 			timeout = 65535;
 	}
 	begin_time = OSTimeGet();
+	if (tcpip) {
+		LWIP_ASSERT("the tcpip mbox wasn't the first one made",
+				!SYS_MBOX_URGENT_SIZE || __MBOX_IS_TCPIP(m));
+		tcpip_defer_poll();
+		/* lwIP 1.4's timers.c runs its first timeout down by the time
+		 * returned alone: counted from the last fetch, it includes the
+		 * time the thread took with the messages, so that the timeouts
+		 * don't stretch with the load */
+		if (__tcpip_fetching)
+			begin_time = __tcpip_fetched;
+	}
 	*msg = OSQPend(m->q, timeout, &err);
+	if (tcpip) {
+		__tcpip_fetched = OSTimeGet();
+		__tcpip_fetching = 1;
+	}
 	if (err == OS_ERR_NONE) {
 		LWIP_ASSERT("OSQPend", *msg);
-		err = OSSemPost(m->sem);
-		LWIP_ASSERT("OSSemPost", err == OS_ERR_NONE);
-		if ((*msg) == __ESC_NULL)
-			*msg = NULL;
-		return ticks_to_ms(OSTimeGet() - begin_time);
+		*msg = __sys_mbox_got(m, *msg);
+		waited = ticks_to_ms(OSTimeGet() - begin_time);
 	} else {
 		LWIP_ASSERT("OSQPend", err == OS_ERR_TIMEOUT);
-		return SYS_ARCH_TIMEOUT;
+		waited = SYS_ARCH_TIMEOUT;
 	}
+#if SYS_BACKPRESSURE
+	__sys_backpressure_fetched(m);
+#endif
+
+	return waited;
 }
 
 /** Wait for a new message to arrive in the mbox
@@ -272,15 +781,29 @@ u32_t sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg)
 	*msg = OSQAccept(m->q, &err);
 	if (*msg) {
 		LWIP_ASSERT("OSQAccept", err == OS_ERR_NONE);
-		err = OSSemPost(m->sem);
-		LWIP_ASSERT("OSSemPost", err == OS_ERR_NONE);
-		if ((*msg) == __ESC_NULL)
-			*msg = NULL;
-		return 0;
+		/* frees the slot, which the backlog no longer counts */
+		*msg = __sys_mbox_got(m, *msg);
 	} else {
 		LWIP_ASSERT("OSQAccept", err == OS_ERR_Q_EMPTY);
-		return SYS_MBOX_EMPTY;
 	}
+#if SYS_BACKPRESSURE
+	__sys_backpressure_fetched(m);
+#endif
+
+	return err == OS_ERR_NONE ? 0 : SYS_MBOX_EMPTY;
+}
+
+/* Create a task on a stack growing downwards, with the stack cleared so that
+ * OSTaskStkChk() can tell how deep it went */
+static INT8U __sys_task_create(void (*thread)(void *arg), void *arg,
+		OS_STK *stk, INT32U size, INT8U prio)
+{
+#if OS_TASK_CREATE_EXT_EN > 0
+	return OSTaskCreateExt(thread, arg, &stk[size - 1], prio, prio, stk,
+			size, NULL, OS_TASK_OPT_STK_CHK | OS_TASK_OPT_STK_CLR);
+#else
+	return OSTaskCreate(thread, arg, &stk[size - 1], prio);
+#endif
 }
 
 /** The only thread function:
@@ -294,33 +817,47 @@ sys_thread_t sys_thread_new(const char *name, void (*thread)(void *arg),
 		void *arg, int stacksize, int prio)
 {
 	INT8U err;
-	OS_STK *stk_top;
+	OS_STK *stk;
+	INT32U size;
 
 	LWIP_ASSERT("Non-positive prio", prio > 0);
 	LWIP_ASSERT("Prio is too big", prio < OS_PRIO_SELF);
+#if PPP_THREAD_STACKSIZE > 0
+	/* OSTaskCreate() claims a free priority atomically */
+	if (prio == PPP_THREAD_PRIO) {
+		do {
+			err = __sys_task_create(thread, arg,
+					__ppp_stk[prio - PPP_THREAD_PRIO],
+					PPP_THREAD_STACKSIZE, prio);
+		} while (err == OS_ERR_PRIO_EXIST &&
+			 ++prio < PPP_THREAD_PRIO + NUM_PPP);
+		LWIP_ASSERT("OSTaskCreate", err == OS_ERR_NONE);
+		__ppp_creator[prio - PPP_THREAD_PRIO] = OSPrioCur;
+		goto name;
+	}
+#endif
 	switch (prio) {
 #if TCPIP_THREAD_STACKSIZE > 0
 	case TCPIP_THREAD_PRIO:
-		stk_top = &__tcpip_stk[TCPIP_THREAD_STACKSIZE - 1];
+		stk = __tcpip_stk;
+		size = TCPIP_THREAD_STACKSIZE;
 		break;
 #endif
 #if SLIPIF_THREAD_STACKSIZE > 0
 	case SLIPIF_THREAD_PRIO:
-		stk_top = &__slipif_stk[SLIPIF_THREAD_STACKSIZE - 1];
-		break;
-#endif
-#if PPP_THREAD_STACKSIZE > 0
-	case PPP_THREAD_PRIO:
-		stk_top = &__ppp_stk[PPP_THREAD_STACKSIZE - 1];
+		stk = __slipif_stk;
+		size = SLIPIF_THREAD_STACKSIZE;
 		break;
 #endif
 	default:
 		LWIP_ASSERT("Invalid prio", 0);
 	}
 
-	/* TODO: OSTaskCreateEx */
-	err = OSTaskCreate(thread, arg, stk_top, prio);
+	err = __sys_task_create(thread, arg, stk, size, prio);
 	LWIP_ASSERT("OSTaskCreate", err == OS_ERR_NONE);
+#if PPP_THREAD_STACKSIZE > 0
+name:
+#endif
 	OSTaskNameSet(prio, (INT8U *)name, &err);
 	LWIP_ASSERT("OSTaskNameSet", err == OS_ERR_NONE);
 
@@ -335,13 +872,128 @@ void sys_thread_free(sys_thread_t id)
 	INT8U err;
 
 	LWIP_ASSERT("Invalid thread", id != OS_PRIO_SELF);
+#if PPP_THREAD_STACKSIZE > 0
+	/* before OSTaskDel(), which doesn't return to a thread freeing itself */
+	if (id >= PPP_THREAD_PRIO && id < PPP_THREAD_PRIO + NUM_PPP)
+		__ppp_creator[id - PPP_THREAD_PRIO] = OS_PRIO_SELF;
+#endif
 	err = OSTaskDel(id);
 	LWIP_ASSERT("OSTaskDel", err == OS_ERR_NONE);
 }
 
+#if PPP_THREAD_STACKSIZE > 0
+sys_thread_t sys_thread_ppp(void)
+{
+	sys_thread_t id = OS_PRIO_SELF;
+	u8_t i;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	for (i = 0; i < NUM_PPP; i++) {
+		if (__ppp_creator[i] == OSPrioCur) {
+			id = PPP_THREAD_PRIO + i;
+			break;
+		}
+	}
+	SYS_ARCH_UNPROTECT(sr);
+
+	return id;
+}
+#endif
+
+#if RAM_REPORT
+/* Deepest use of a thread stack in bytes, the whole stack if unknown */
+static u32_t __sys_stk_used(INT8U prio, u32_t size)
+{
+	OS_STK_DATA data;
+	INT8U err;
+
+	err = OSTaskStkChk(prio, &data);
+	if (err != OS_ERR_NONE)
+		return size;
+
+	return data.OSUsed;
+}
+
+u8_t sys_arch_ram_regions(struct ram_region *r, u8_t max)
+{
+	static const u32_t hdr = sizeof(struct sys_mbox_slots) -
+		__MBOX_SIZE * sizeof(void *);
+	u8_t n = 0;
+#if PPP_THREAD_STACKSIZE > 0
+	static const char *const names[] = {
+		"stack.ppp0", "stack.ppp1", "stack.ppp2", "stack.ppp3"
+	};
+	/* the PPP threads come and go with the links, keep their deepest */
+	static u32_t ppp_peak[NUM_PPP];
+	u32_t used;
+	u8_t i;
+#endif
+
+	/* the peaks count the tcpip mbox as one of the pool */
+	if (n < max) {
+		r[n].name = "mbox";
+		r[n].size = __MBOX_POOL * hdr;
+		r[n].peak = __mbox_ram.peak * hdr;
+		n++;
+	}
+	if (n < max) {
+		r[n].name = "mbox.slots";
+		r[n].size = __MBOX_POOL * __MBOX_SIZE * sizeof(void *);
+		r[n].peak = __mbox_ram.peak * __mbox_ram.depth *
+			sizeof(void *);
+		n++;
+	}
+#if SYS_MBOX_URGENT_SIZE > 0
+	if (n < max) {
+		r[n].name = "mbox.tcpip";
+		r[n].size = sizeof(__mbox_tcpip);
+		r[n].peak = __mbox_tcpip.mbox.q ? r[n].size : 0;
+		n++;
+	}
+#endif
+#if TCPIP_THREAD_STACKSIZE > 0
+	if (n < max) {
+		r[n].name = "stack.tcpip";
+		r[n].size = sizeof(__tcpip_stk);
+		r[n].peak = __sys_stk_used(TCPIP_THREAD_PRIO, r[n].size);
+		n++;
+	}
+#endif
+#if SLIPIF_THREAD_STACKSIZE > 0
+	if (n < max) {
+		r[n].name = "stack.slipif";
+		r[n].size = sizeof(__slipif_stk);
+		r[n].peak = __sys_stk_used(SLIPIF_THREAD_PRIO, r[n].size);
+		n++;
+	}
+#endif
+#if PPP_THREAD_STACKSIZE > 0
+	/* a stack per slot, as each thread runs on the stack of its priority */
+	for (i = 0; i < NUM_PPP && i < sizeof(names) / sizeof(names[0]) &&
+			n < max; i++) {
+		if (OSTCBPrioTbl[PPP_THREAD_PRIO + i] != NULL) {
+			used = __sys_stk_used(PPP_THREAD_PRIO + i,
+					sizeof(__ppp_stk[0]));
+			if (used > ppp_peak[i])
+				ppp_peak[i] = used;
+		}
+		r[n].name = names[i];
+		r[n].size = sizeof(__ppp_stk[0]);
+		r[n].peak = ppp_peak[i];
+		n++;
+	}
+#endif
+
+	return n;
+}
+#endif /* RAM_REPORT */
+
+#endif /* !NO_SYS */
+
 /** Returns the current time in milliseconds,
  * may be the same as sys_jiffies or at least based on it. */
 u32_t sys_now(void)
 {
-	return ticks_to_ms(sys_jiffies());
+	return ticks_to_ms(OSTimeGet());
 }
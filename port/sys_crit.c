@@ -0,0 +1,77 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+
+#if SYS_CRIT_MEASURE
+
+#include <string.h>
+
+static struct sys_crit_site __sys_crit_sites[SYS_CRIT_SITES];
+static u32_t __sys_crit_lost;	/* sections of the sites not recorded */
+
+/* Called with interrupts masked */
+void sys_crit_exit(struct sys_crit *c)
+{
+	u32_t t = SYS_CRIT_CYCLES() - c->t0;
+	struct sys_crit_site *site;
+
+	for (site = __sys_crit_sites;
+			site < &__sys_crit_sites[SYS_CRIT_SITES]; site++) {
+		if (site->file == NULL) {
+			site->file = c->file;
+			site->line = c->line;
+			break;
+		}
+		if (site->line == c->line && (site->file == c->file ||
+					strcmp(site->file, c->file) == 0))
+			break;
+	}
+	if (site < &__sys_crit_sites[SYS_CRIT_SITES]) {
+		site->count++;
+		if (t > site->max)
+			site->max = t;
+	} else {
+		__sys_crit_lost++;
+	}
+
+	__SYS_CRIT_EXIT(c->sr);
+}
+
+u8_t sys_crit_get_site(u8_t i, struct sys_crit_site *site)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (i >= SYS_CRIT_SITES)
+		return 0;
+	SYS_ARCH_PROTECT(sr);
+	*site = __sys_crit_sites[i];
+	SYS_ARCH_UNPROTECT(sr);
+
+	return site->file != NULL;
+}
+
+void sys_crit_report(void)
+{
+	struct sys_crit_site site;
+	u8_t i;
+
+	/* one site at a time, not to print with interrupts masked */
+	for (i = 0; sys_crit_get_site(i, &site); i++)
+		LWIP_PLATFORM_DIAG(("crit %s:%u %lu %lu\n", site.file,
+				(unsigned)site.line, (unsigned long)site.max,
+				(unsigned long)site.count));
+	if (__sys_crit_lost > 0)
+		LWIP_PLATFORM_DIAG(("crit other %lu\n",
+				(unsigned long)__sys_crit_lost));
+}
+
+void sys_crit_reset(void)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	memset(__sys_crit_sites, 0, sizeof(__sys_crit_sites));
+	__sys_crit_lost = 0;
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+#endif /* SYS_CRIT_MEASURE */
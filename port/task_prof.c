@@ -0,0 +1,165 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "arch/task_prof.h"
+
+#if TASK_PROF
+
+#include "ucos_ii.h"
+
+#include <string.h>
+
+static struct __task_prof {
+	struct task_prof_stats	st;
+	u32_t			in;	/* when it was switched in */
+	u32_t			ready;	/* when it was seen ready */
+	u8_t			is_ready;
+} __task_prof[TASK_PROF_SLOTS + 1];
+
+/* slot + 1 of every priority, 0 if it has none yet */
+static u8_t __task_prof_slot[OS_LOWEST_PRIO + 1];
+static u8_t __task_prof_nslots;
+
+static struct __task_prof *__task_prof_get(u8_t prio)
+{
+	struct __task_prof *t;
+
+	if (__task_prof_slot[prio] == 0) {
+		if (__task_prof_nslots == TASK_PROF_SLOTS)
+			return &__task_prof[TASK_PROF_SLOTS];
+		__task_prof_slot[prio] = ++__task_prof_nslots;
+		t = &__task_prof[__task_prof_nslots - 1];
+		t->st.prio = prio;
+		t->is_ready = 0;
+	}
+
+	return &__task_prof[__task_prof_slot[prio] - 1];
+}
+
+/* Timestamp the tasks which are ready but not running */
+static void __task_prof_scan(u32_t now, u8_t cur)
+{
+	OS_TCB *tcb;
+	u8_t i, prio;
+
+	for (i = 0; i < __task_prof_nslots; i++) {
+		prio = __task_prof[i].st.prio;
+		if (prio == cur || __task_prof[i].is_ready)
+			continue;
+		tcb = OSTCBPrioTbl[prio];
+		if (tcb == NULL || tcb == OS_TCB_RESERVED)
+			continue;
+		if (OSRdyTbl[tcb->OSTCBY] & tcb->OSTCBBitX) {
+			__task_prof[i].ready = now;
+			__task_prof[i].is_ready = 1;
+		}
+	}
+}
+
+void task_prof_switch(void)
+{
+	u32_t now = TASK_PROF_CYCLES(), lat;
+	struct __task_prof *t;
+
+	t = __task_prof_get(OSTCBCur->OSTCBPrio);
+	t->st.run += now - t->in;
+	if (OSRdyTbl[OSTCBCur->OSTCBY] & OSTCBCur->OSTCBBitX) {
+		t->st.preemptions++;
+		t->ready = now;
+		t->is_ready = 1;
+	}
+
+	t = __task_prof_get(OSTCBHighRdy->OSTCBPrio);
+	t->st.switches++;
+	if (t->is_ready) {
+		lat = now - t->ready;
+		t->st.latency += lat;
+		if (lat > t->st.max_latency)
+			t->st.max_latency = lat;
+		t->is_ready = 0;
+	}
+	t->in = now;
+
+	__task_prof_scan(now, OSTCBHighRdy->OSTCBPrio);
+}
+
+void task_prof_tick(void)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	__task_prof_scan(TASK_PROF_CYCLES(), OSPrioCur);
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+/* Called by sys_init() */
+void task_prof_init(void)
+{
+	TASK_PROF_CYCLES_INIT();
+	task_prof_reset();
+}
+
+void task_prof_reset(void)
+{
+	struct __task_prof *t;
+	u32_t now;
+	u8_t prio;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	now = TASK_PROF_CYCLES();
+	for (t = __task_prof; t <= &__task_prof[TASK_PROF_SLOTS]; t++) {
+		prio = t->st.prio;
+		memset(&t->st, 0, sizeof(t->st));
+		t->st.prio = prio;
+		t->in = now;
+		t->is_ready = 0;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+int task_prof_get_stats(u8_t idx, struct task_prof_stats *st)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (idx > TASK_PROF_SLOTS ||
+	    (idx < TASK_PROF_SLOTS && idx >= __task_prof_nslots))
+		return -1;
+	SYS_ARCH_PROTECT(sr);
+	*st = __task_prof[idx].st;
+	SYS_ARCH_UNPROTECT(sr);
+	if (idx == TASK_PROF_SLOTS)
+		st->prio = OS_PRIO_SELF;
+
+	return 0;
+}
+
+void task_prof_report(void)
+{
+	struct task_prof_stats st[TASK_PROF_SLOTS + 1];
+	unsigned long long total = 0;
+	u8_t i, n = 0;
+
+	for (i = 0; i <= TASK_PROF_SLOTS; i++) {
+		if (task_prof_get_stats(i, &st[n]) == 0) {
+			total += st[n].run;
+			n++;
+		}
+	}
+	if (total == 0)
+		total = 1;
+
+	LWIP_PLATFORM_DIAG(("prio  cpu%%  switches  preempts  "
+				"avg-lat  max-lat\n"));
+	for (i = 0; i < n; i++) {
+		LWIP_PLATFORM_DIAG(("%4u %5u %9lu %9lu %8lu %8lu\n",
+				(unsigned)st[i].prio,
+				(unsigned)(st[i].run * 100 / total),
+				(unsigned long)st[i].switches,
+				(unsigned long)st[i].preemptions,
+				(unsigned long)(st[i].switches ?
+					st[i].latency / st[i].switches : 0),
+				(unsigned long)st[i].max_latency));
+	}
+}
+
+#endif /* TASK_PROF */
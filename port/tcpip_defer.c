@@ -0,0 +1,106 @@
+#include "lwip/opt.h"
+
+#if !NO_SYS
+
+#include "lwip/tcpip.h"
+#include "arch/tcpip_defer.h"
+
+#define __TCPIP_DEFER_MASK (TCPIP_DEFER_SIZE - 1)
+
+static struct tcpip_defer *__tcpip_defer_list;
+static volatile u8_t __tcpip_defer_lost;	/* a queue missed its wakeup */
+
+/* Runs in the tcpip thread */
+static void __tcpip_defer_drain(void *ctx)
+{
+	struct tcpip_defer *q = ctx;
+	tcpip_callback_fn fn;
+	void *arg;
+	u16_t tail, n = 0;
+
+	/* Cleared before draining: an entry queued from now on posts the
+	 * message again, so nothing is left behind. */
+	q->pending = 0;
+	tail = q->tail;
+	while (tail != q->head) {
+		fn = q->slot[tail & __TCPIP_DEFER_MASK].fn;
+		arg = q->slot[tail & __TCPIP_DEFER_MASK].arg;
+		q->tail = ++tail;
+		fn(arg);
+		n++;
+	}
+	q->batches++;
+	if (n > q->max_batch)
+		q->max_batch = n;
+}
+
+err_t tcpip_defer_init(struct tcpip_defer *q)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	q->head = 0;
+	q->tail = 0;
+	q->pending = 0;
+	q->drops = 0;
+	q->wakeup_fails = 0;
+	q->batches = 0;
+	q->max_batch = 0;
+	q->lost = 0;
+	q->msg = tcpip_callbackmsg_new(__tcpip_defer_drain, q);
+	if (!q->msg)
+		return ERR_MEM;
+
+	SYS_ARCH_PROTECT(sr);
+	q->next = __tcpip_defer_list;
+	__tcpip_defer_list = q;
+	SYS_ARCH_UNPROTECT(sr);
+
+	return ERR_OK;
+}
+
+err_t tcpip_defer(struct tcpip_defer *q, tcpip_callback_fn fn, void *arg)
+{
+	u16_t head = q->head;
+	err_t err = ERR_OK;
+
+	if ((u16_t)(head - q->tail) < TCPIP_DEFER_SIZE) {
+		q->slot[head & __TCPIP_DEFER_MASK].fn = fn;
+		q->slot[head & __TCPIP_DEFER_MASK].arg = arg;
+		q->head = head + 1;
+	} else {
+		q->drops++;
+		err = ERR_MEM;
+	}
+
+	if (!q->pending) {
+		q->pending = 1;
+		if (tcpip_trycallback(q->msg) != ERR_OK) {
+			/* The tcpip mbox is full, so the tcpip thread is bound to
+			 * fetch it again soon: tcpip_defer_poll() drains the
+			 * queue then. 'pending' stays set until it does. */
+			q->lost = 1;
+			__tcpip_defer_lost = 1;
+			q->wakeup_fails++;
+		}
+	}
+
+	return err;
+}
+
+void tcpip_defer_poll(void)
+{
+	struct tcpip_defer *q;
+
+	if (!__tcpip_defer_lost)
+		return;
+	/* cleared first: a wakeup lost while scanning sets it again */
+	__tcpip_defer_lost = 0;
+	for (q = __tcpip_defer_list; q; q = q->next) {
+		if (q->lost) {
+			q->lost = 0;
+			__tcpip_defer_drain(q);
+		}
+	}
+}
+
+#endif /* !NO_SYS */
@@ -0,0 +1,130 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "arch/tickless.h"
+#include "arch/timer_wheel.h"
+
+#if TICKLESS
+
+#include "ucos_ii.h"
+#include "tickless_cpu.h"
+
+#if OS_TMR_EN > 0
+# error "TICKLESS doesn't wake up for the OS_TMR timers"
+#endif
+
+#if OS_CRITICAL_METHOD != 3
+# error "TICKLESS needs OS_CPU_SR_Save()"
+#endif
+
+static struct tickless_stats __tickless;
+
+/* Shortest delay of the blocked tasks, capped to 'max'; 0 if a task other
+ * than the idle one is ready */
+static INT32U __tickless_next(INT32U max)
+{
+	OS_TCB *ptcb;
+
+	for (ptcb = OSTCBList; ptcb != NULL; ptcb = ptcb->OSTCBNext) {
+		if (ptcb->OSTCBPrio == OS_TASK_IDLE_PRIO)
+			continue;
+		if (ptcb->OSTCBDly == 0) {
+			if (ptcb->OSTCBStat == OS_STAT_RDY)
+				return 0;
+			continue; /* waits forever */
+		}
+		if (ptcb->OSTCBDly < max)
+			max = ptcb->OSTCBDly;
+	}
+
+	return max;
+}
+
+/* Account for the ticks the tick interrupt didn't deliver, they are fewer
+ * than every delay */
+static void __tickless_catch_up(INT32U elapsed)
+{
+	OS_TCB *ptcb;
+
+	OSTime += elapsed;
+	for (ptcb = OSTCBList; ptcb != NULL; ptcb = ptcb->OSTCBNext) {
+		if (ptcb->OSTCBDly > elapsed)
+			ptcb->OSTCBDly -= elapsed;
+		else if (ptcb->OSTCBDly > 0)
+			ptcb->OSTCBDly = 1;
+	}
+}
+
+void tickless_idle(void)
+{
+	INT32U ticks, elapsed;
+	OS_CPU_SR sr;
+
+	/* Not SYS_ARCH_PROTECT(): with SYS_CRIT_THRESHOLD it only raises
+	 * BASEPRI, and WFI doesn't wake for an interrupt masked that way, the
+	 * tick and the USARTs included. Masked by PRIMASK, a pending interrupt
+	 * still ends WFI and runs once the mask is restored. */
+	sr = OS_CPU_SR_Save();
+	ticks = __tickless_next(LWIP_MIN(TICKLESS_MAX_TICKS,
+				tickless_cpu_max()));
+	if (ticks == 0) {
+		OS_CPU_SR_Restore(sr);
+		return;
+	}
+#if TIMER_WHEEL
+	ticks = timer_wheel_next(ticks);
+#endif
+	__tickless.sleeps++;
+	if (ticks < TICKLESS_MIN_TICKS) {
+		/* the next tick wakes us */
+		tickless_cpu_sleep();
+		OS_CPU_SR_Restore(sr);
+		return;
+	}
+
+	tickless_cpu_start(ticks);
+	tickless_cpu_sleep();
+	elapsed = tickless_cpu_stop(ticks);
+	if (elapsed > 0)
+		__tickless_catch_up(elapsed);
+	__tickless.tickless++;
+	if (elapsed + 1 < ticks)
+		__tickless.early++;
+	__tickless.ticks_slept += elapsed;
+	/* the pending interrupt runs here */
+	OS_CPU_SR_Restore(sr);
+}
+
+void tickless_get_stats(struct tickless_stats *st)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	*st = __tickless;
+	st->ticks = OSTime;
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+void tickless_report(void)
+{
+	static struct tickless_stats last;
+	struct tickless_stats st;
+	u32_t ticks, sleeps;
+
+	tickless_get_stats(&st);
+	ticks = st.ticks - last.ticks;
+	sleeps = st.sleeps - last.sleeps;
+	if (ticks == 0)
+		ticks = 1;
+
+	LWIP_PLATFORM_DIAG(("%lu s: %lu wakeups/s, %lu%% tickless, "
+				"%lu early\n",
+			(unsigned long)(ticks / OS_TICKS_PER_SEC),
+			(unsigned long)((unsigned long long)sleeps *
+				OS_TICKS_PER_SEC / ticks),
+			(unsigned long)((st.ticks_slept - last.ticks_slept) *
+				100ULL / ticks),
+			(unsigned long)(st.early - last.early)));
+	last = st;
+}
+
+#endif /* TICKLESS */
@@ -0,0 +1,329 @@
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "arch/timer_wheel.h"
+
+#if TIMER_WHEEL
+
+#include "arch/tcpip_defer.h"
+#include "ucos_ii.h"
+
+#define __TW_L0_BITS	8
+#define __TW_L1_BITS	6
+#define __TW_L0_SIZE	(1 << __TW_L0_BITS)
+#define __TW_L1_SIZE	(1 << __TW_L1_BITS)
+#define __TW_L0_MASK	(__TW_L0_SIZE - 1)
+#define __TW_L1_MASK	(__TW_L1_SIZE - 1)
+
+enum {
+	__TW_IDLE,
+	__TW_WHEEL,	/* in a slot or the overflow list */
+	__TW_DUE	/* waiting for its target */
+};
+
+static struct {
+	struct timer_wheel_entry	*l0[__TW_L0_SIZE];
+	struct timer_wheel_entry	*l1[__TW_L1_SIZE];
+	struct timer_wheel_entry	*far;
+	u32_t				base;	/* next tick to run */
+	u8_t				ready;
+	struct {
+		struct timer_wheel_entry	*head;
+		struct timer_wheel_entry	**tail;
+	}				due[2];
+	struct tcpip_defer		defer;
+#if TIMER_WHEEL_WORKER_PRIO > 0
+	OS_EVENT			*sem;
+#endif
+	struct timer_wheel_stats	stats;
+} __tw;
+
+#if TIMER_WHEEL_WORKER_PRIO > 0
+static OS_STK __tw_stk[TIMER_WHEEL_WORKER_STACKSIZE];
+#endif
+
+static void __tw_link(struct timer_wheel_entry **head,
+		struct timer_wheel_entry *t)
+{
+	t->next = *head;
+	if (t->next)
+		t->next->pprev = &t->next;
+	*head = t;
+	t->pprev = head;
+}
+
+static void __tw_unlink(struct timer_wheel_entry *t)
+{
+	if (t->state == __TW_DUE && __tw.due[t->target].tail == &t->next)
+		__tw.due[t->target].tail = t->pprev;
+	*t->pprev = t->next;
+	if (t->next)
+		t->next->pprev = t->pprev;
+	t->state = __TW_IDLE;
+}
+
+/* Put a timer in the slot of its expiry, relative to the next tick run */
+static void __tw_add(struct timer_wheel_entry *t)
+{
+	u32_t delta = t->expires - __tw.base;
+	struct timer_wheel_entry **head;
+
+	if ((s32_t)delta < 0)
+		head = &__tw.l0[__tw.base & __TW_L0_MASK];
+	else if (delta < __TW_L0_SIZE)
+		head = &__tw.l0[t->expires & __TW_L0_MASK];
+	else if (delta < __TW_L0_SIZE * __TW_L1_SIZE)
+		head = &__tw.l1[(t->expires >> __TW_L0_BITS) & __TW_L1_MASK];
+	else
+		head = &__tw.far;
+	__tw_link(head, t);
+	t->state = __TW_WHEEL;
+}
+
+/* Spread a list over the slots below */
+static void __tw_cascade(struct timer_wheel_entry **head)
+{
+	struct timer_wheel_entry *t = *head, *next;
+
+	*head = NULL;
+	for (; t; t = next) {
+		next = t->next;
+		__tw_add(t);
+		__tw.stats.cascaded++;
+	}
+}
+
+/* With interrupts disabled: the first tick from 'base' on, before 'end'
+ * and less than a turn of the first level away, whose slot holds timers or
+ * which cascades some from above */
+static u32_t __tw_scan(u32_t end)
+{
+	u32_t tick, idx;
+
+	for (tick = __tw.base; tick != end &&
+			tick - __tw.base < __TW_L0_SIZE; tick++) {
+		if (__tw.l0[tick & __TW_L0_MASK])
+			break;
+		if ((tick & __TW_L0_MASK) == 0) {
+			idx = (tick >> __TW_L0_BITS) & __TW_L1_MASK;
+			if (__tw.l1[idx] || (idx == 0 && __tw.far))
+				break;
+		}
+	}
+
+	return tick;
+}
+
+/* Run tick 'base', with interrupts disabled */
+static void __tw_run(void)
+{
+	struct timer_wheel_entry *t, *next;
+	u32_t idx;
+
+	if ((__tw.base & __TW_L0_MASK) == 0) {
+		idx = (__tw.base >> __TW_L0_BITS) & __TW_L1_MASK;
+		if (idx == 0)
+			__tw_cascade(&__tw.far);
+		__tw_cascade(&__tw.l1[idx]);
+	}
+
+	t = __tw.l0[__tw.base & __TW_L0_MASK];
+	__tw.l0[__tw.base & __TW_L0_MASK] = NULL;
+	for (; t; t = next) {
+		next = t->next;
+		t->next = NULL;
+		t->pprev = __tw.due[t->target].tail;
+		*t->pprev = t;
+		__tw.due[t->target].tail = &t->next;
+		t->state = __TW_DUE;
+	}
+}
+
+/* Run the callbacks due, in the tcpip thread or the worker */
+static void __tw_drain(u8_t target)
+{
+	struct timer_wheel_entry *t;
+	timer_wheel_fn fn;
+	void *arg;
+	u32_t late, n = 0;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	while (1) {
+		SYS_ARCH_PROTECT(sr);
+		t = __tw.due[target].head;
+		if (t == NULL) {
+			SYS_ARCH_UNPROTECT(sr);
+			break;
+		}
+		__tw_unlink(t);
+		late = OSTime - t->expires;
+		if (late > __tw.stats.late_max)
+			__tw.stats.late_max = late;
+		__tw.stats.late_sum += late;
+		__tw.stats.fired++;
+		fn = t->fn;
+		arg = t->arg;
+		if (t->period > 0) {
+			/* keep the phase, skipping the periods missed */
+			do {
+				t->expires += t->period;
+			} while ((s32_t)(t->expires - OSTime) <= 0);
+			__tw_add(t);
+		}
+		SYS_ARCH_UNPROTECT(sr);
+
+		fn(arg);
+		n++;
+	}
+
+	if (n > 0) {
+		SYS_ARCH_PROTECT(sr);
+		__tw.stats.batches++;
+		if (n > __tw.stats.max_batch)
+			__tw.stats.max_batch = n;
+		SYS_ARCH_UNPROTECT(sr);
+	}
+}
+
+static void __tw_drain_tcpip(void *arg)
+{
+	__tw_drain(TIMER_WHEEL_TCPIP);
+}
+
+#if TIMER_WHEEL_WORKER_PRIO > 0
+static void __tw_worker(void *p_arg)
+{
+	INT8U err;
+
+	while (1) {
+		OSSemPend(__tw.sem, 0, &err);
+		LWIP_ASSERT("OSSemPend", err == OS_ERR_NONE);
+		__tw_drain(TIMER_WHEEL_WORKER);
+	}
+}
+#endif
+
+err_t timer_wheel_init(void)
+{
+	u8_t i;
+#if TIMER_WHEEL_WORKER_PRIO > 0
+	INT8U err;
+#endif
+
+	for (i = 0; i < 2; i++) {
+		__tw.due[i].head = NULL;
+		__tw.due[i].tail = &__tw.due[i].head;
+	}
+	if (tcpip_defer_init(&__tw.defer) != ERR_OK)
+		return ERR_MEM;
+#if TIMER_WHEEL_WORKER_PRIO > 0
+	__tw.sem = OSSemCreate(0);
+	if (__tw.sem == NULL)
+		return ERR_MEM;
+	err = OSTaskCreate(__tw_worker, NULL,
+			&__tw_stk[TIMER_WHEEL_WORKER_STACKSIZE - 1],
+			TIMER_WHEEL_WORKER_PRIO);
+	LWIP_ASSERT("OSTaskCreate", err == OS_ERR_NONE);
+#endif
+	__tw.base = OSTimeGet();
+	__tw.ready = 1;
+
+	return ERR_OK;
+}
+
+void timer_wheel_tick(void)
+{
+	u8_t worker_idle;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	if (!__tw.ready)
+		return;
+
+	SYS_ARCH_PROTECT(sr);
+	worker_idle = __tw.due[TIMER_WHEEL_WORKER].head == NULL;
+	/* also the ticks tickless_idle() skipped, jumping over the empty ones */
+	while ((s32_t)(OSTime - __tw.base) >= 0) {
+		__tw.base = __tw_scan(OSTime + 1);
+		if (__tw.base == OSTime + 1)
+			break;
+		__tw_run();
+		__tw.base++;
+	}
+	SYS_ARCH_UNPROTECT(sr);
+
+	/* a running batch takes the new timers along, the tcpip thread is
+	 * woken again only if it may have missed them */
+	if (__tw.due[TIMER_WHEEL_TCPIP].head && !__tw.defer.pending)
+		tcpip_defer(&__tw.defer, __tw_drain_tcpip, NULL);
+#if TIMER_WHEEL_WORKER_PRIO > 0
+	if (worker_idle && __tw.due[TIMER_WHEEL_WORKER].head)
+		OSSemPost(__tw.sem);
+#else
+	LWIP_UNUSED_ARG(worker_idle);
+	LWIP_ASSERT("No TIMER_WHEEL_WORKER_PRIO",
+			__tw.due[TIMER_WHEEL_WORKER].head == NULL);
+#endif
+}
+
+void timer_wheel_setup(struct timer_wheel_entry *t, timer_wheel_fn fn,
+		void *arg, u8_t target)
+{
+	t->fn = fn;
+	t->arg = arg;
+	t->target = target;
+	t->state = __TW_IDLE;
+}
+
+void timer_wheel_start(struct timer_wheel_entry *t, u32_t ms, u32_t period_ms)
+{
+	u32_t ticks = (ms * OS_TICKS_PER_SEC + 999) / 1000;
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	if (t->state != __TW_IDLE)
+		__tw_unlink(t);
+	t->expires = OSTime + (ticks > 0 ? ticks : 1);
+	t->period = (period_ms * OS_TICKS_PER_SEC + 999) / 1000;
+	if (period_ms > 0 && t->period == 0)
+		t->period = 1;
+	__tw_add(t);
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+void timer_wheel_stop(struct timer_wheel_entry *t)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	if (t->state != __TW_IDLE)
+		__tw_unlink(t);
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+/* Called with interrupts disabled. Stops at a cascade of timers from above,
+ * which may bring one into the next slots. */
+u32_t timer_wheel_next(u32_t max)
+{
+	u32_t tick;
+
+	if (!__tw.ready)
+		return max;
+	tick = __tw_scan(__tw.base + __TW_L0_SIZE);
+	if (tick - __tw.base == __TW_L0_SIZE)
+		return max;
+	/* ticks not run yet are run by the next tick */
+	if ((s32_t)(tick - OSTime) <= 0)
+		return 1;
+
+	return LWIP_MIN(tick - OSTime, max);
+}
+
+void timer_wheel_get_stats(struct timer_wheel_stats *st)
+{
+	SYS_ARCH_DECL_PROTECT(sr);
+
+	SYS_ARCH_PROTECT(sr);
+	*st = __tw.stats;
+	SYS_ARCH_UNPROTECT(sr);
+}
+
+#endif /* TIMER_WHEEL */
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""Derive MEM_ARCH_CLASSES from an allocation trace.
+
+Build the port with MEM_ARCH_TRACE enabled and capture the console. Every
+allocation is logged as "mem + <addr> <size>" and every free as
+"mem - <addr>". This script picks the size classes which need the least RAM
+to serve the trace, prints them in lwipopts.h syntax, and replays the trace
+against both the chosen classes and a first-fit heap like lwIP's mem.c to
+compare allocation failures.
+
+usage: mem_classes.py [-k CLASSES] [--heap MEM_SIZE] [--headroom PCT] trace
+"""
+
+import argparse
+import re
+import sys
+
+ALIGN = 4
+HDR = 4			# class pointer in front of every block
+HEAP_HDR = 8		# struct mem of lwIP's heap with 16-bit mem_size_t
+HEAP_MIN = 12
+
+LINE = re.compile(r'mem ([+-]) (\S+)(?: (\d+))?')
+
+
+def align(n):
+    return (n + ALIGN - 1) & ~(ALIGN - 1)
+
+
+def parse(path):
+    events = []
+    with open(path, errors='replace') as f:
+        for line in f:
+            m = LINE.search(line)
+            if not m:
+                continue
+            if m.group(1) == '+':
+                events.append(('+', m.group(2), int(m.group(3))))
+            else:
+                events.append(('-', m.group(2), 0))
+    return events
+
+
+def sized_events(events, step):
+    """Pair frees with allocations and round the sizes up to 'step'."""
+    live = {}
+    out = []
+    for n, (op, addr, size) in enumerate(events):
+        if op == '+':
+            size = (size + step - 1) // step * step
+            live[addr] = (size, n)
+            out.append((size, 1, n))
+        elif addr in live:
+            size, key = live.pop(addr)
+            out.append((size, -1, key))
+    return out
+
+
+def choose(events, k, headroom):
+    sizes = sorted({s for s, _, _ in events})
+    index = {s: i for i, s in enumerate(sizes)}
+    n = len(sizes)
+    # peak[i][j]: most blocks live at once with sizes[i] .. sizes[j]
+    peak = [[0] * n for _ in range(n)]
+    for i in range(n):
+        cur = [0] * len(events)
+        for j in range(i, n):
+            for t, (s, d, _) in enumerate(events):
+                if index[s] == j:
+                    cur[t] += d
+            live = best = 0
+            for d in cur:
+                live += d
+                best = max(best, live)
+            peak[i][j] = best
+
+    def cost(i, j):
+        blocks = peak[i][j] + (peak[i][j] * headroom + 99) // 100
+        blocks = max(blocks, 2)     # OSMemCreate() wants two at least
+        return blocks * (align(sizes[j]) + HDR), blocks
+
+    inf = float('inf')
+    k = min(k, n)
+    dp = [[inf] * (n + 1) for _ in range(k + 1)]
+    cut = [[0] * (n + 1) for _ in range(k + 1)]
+    dp[0][0] = 0
+    for c in range(1, k + 1):
+        for j in range(1, n + 1):
+            for i in range(c - 1, j):
+                v = dp[c - 1][i] + cost(i, j - 1)[0]
+                if v < dp[c][j]:
+                    dp[c][j], cut[c][j] = v, i
+    # fewer classes may do with less, each holding two blocks at least
+    k = min(range(1, k + 1), key=lambda c: dp[c][n])
+    classes = []
+    j = n
+    for c in range(k, 0, -1):
+        i = cut[c][j]
+        classes.append((sizes[j - 1], cost(i, j - 1)[1]))
+        j = i
+    return sorted(classes), dp[k][n]
+
+
+def replay_classes(events, classes):
+    free = [n for _, n in classes]
+    fails = 0
+    owner = {}
+    for size, d, key in events:
+        if d > 0:
+            for c, (csize, _) in enumerate(classes):
+                if csize >= size and free[c]:
+                    free[c] -= 1
+                    owner[key] = c
+                    break
+            else:
+                fails += 1
+        elif key in owner:
+            free[owner.pop(key)] += 1
+    return fails
+
+
+def replay_heap(trace, heap_size):
+    """First fit over a heap of 'heap_size' bytes, like lwIP's mem.c."""
+    blocks = [(0, heap_size, False)]	# (offset, length, used)
+    where = {}
+    fails = 0
+    for op, addr, size in trace:
+        if op == '+':
+            need = max(align(size), HEAP_MIN) + HEAP_HDR
+            for n, (off, length, used) in enumerate(blocks):
+                if not used and length >= need:
+                    rest = length - need
+                    if rest >= HEAP_MIN + HEAP_HDR:
+                        blocks[n:n + 1] = [(off, need, True),
+                                           (off + need, rest, False)]
+                    else:
+                        blocks[n] = (off, length, True)
+                    where[addr] = off
+                    break
+            else:
+                fails += 1
+        elif addr in where:
+            off = where.pop(addr)
+            n = next(n for n, b in enumerate(blocks) if b[0] == off)
+            blocks[n] = (off, blocks[n][1], False)
+            merged = []
+            for b in blocks:
+                if merged and not merged[-1][2] and not b[2]:
+                    merged[-1] = (merged[-1][0], merged[-1][1] + b[1], False)
+                else:
+                    merged.append(b)
+            blocks = merged
+    return fails
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('trace')
+    ap.add_argument('-k', '--classes', type=int, default=5)
+    ap.add_argument('--step', type=int, default=16,
+                    help='round request sizes up to this (default 16)')
+    ap.add_argument('--heap', type=int, default=16 * 1024,
+                    help='MEM_SIZE of the heap to compare with')
+    ap.add_argument('--headroom', type=int, default=25,
+                    help='extra blocks per class in percent (default 25)')
+    args = ap.parse_args()
+
+    trace = parse(args.trace)
+    events = sized_events(trace, args.step)
+    if not events:
+        sys.exit('no allocations found in %s' % args.trace)
+
+    classes, ram = choose(events, args.classes, args.headroom)
+    print('#define MEM_ARCH_CLASSES \\')
+    print(' \\\n'.join('\tMEM_ARCH_CLASS(%d, %d)' % c for c in classes))
+    print()
+    print('allocations:        %d' % sum(1 for _, d, _ in events if d > 0))
+    print('class RAM:          %d bytes' % ram)
+    print('class failures:     %d' % replay_classes(events, classes))
+    print('heap RAM:           %d bytes' % args.heap)
+    print('heap failures:      %d' % replay_heap(trace, args.heap))
+
+
+if __name__ == '__main__':
+    main()
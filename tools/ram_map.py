@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+"""Attribute the RAM of a build to the subsystems of the port.
+
+Link with -Wl,-Map=app.map and -fdata-sections so that every variable has
+its own .bss.<name> or .data.<name> input section. This script sums the
+bytes of each subsystem (thread stacks, mboxes, serial rings, MEM_ARCH
+classes, lwIP's heap and pools, uC/OS-II, ...) and prints next to it the
+options of lwipopts.h and os_cfg.h which size it.
+
+With --runtime, the console of a build with RAM_REPORT, after ram_report()
+ran under a realistic load, is read as well. Its "ram <region> <size> <peak>"
+lines tell how much of each reservation was ever used, and the script prints
+what each option could give back while keeping --headroom percent spare.
+
+usage: ram_map.py [-I DIR ...] [--runtime CONSOLE] [--headroom PCT] map
+"""
+
+import argparse
+import os
+import re
+import sys
+
+# (subsystem, symbol pattern, options sizing it), first match wins
+SUBSYSTEMS = [
+    ('stacks', r'_stk$', ['TCPIP_THREAD_STACKSIZE', 'SLIPIF_THREAD_STACKSIZE',
+                          'PPP_THREAD_STACKSIZE', 'NUM_PPP']),
+    ('mbox', r'^__mbox|^__sys_mbox|^__sys_sem',
+     ['OS_MAX_QS', 'OS_MAX_EVENTS', 'TCPIP_MBOX_SIZE',
+      'DEFAULT_RAW_RECVMBOX_SIZE', 'DEFAULT_UDP_RECVMBOX_SIZE',
+      'DEFAULT_TCP_RECVMBOX_SIZE', 'DEFAULT_ACCEPTMBOX_SIZE']),
+    ('serial', r'^__sio(?!_trace|_replay)', ['SIO_BUF_SIZE', 'SIO_NUM_DEVS']),
+    ('mem_arch', r'^__mem_arch', ['MEM_ARCH_CLASSES']),
+    ('lwIP heap', r'^ram_heap$', ['MEM_SIZE']),
+    ('lwIP pools', r'^memp_memory', ['PBUF_POOL_SIZE', 'PBUF_POOL_BUFSIZE',
+                                     'MEMP_NUM_TCP_PCB', 'MEMP_NUM_UDP_PCB',
+                                     'MEMP_NUM_TCP_SEG', 'MEMP_NUM_NETCONN',
+                                     'MEMP_NUM_NETBUF', 'MEMP_NUM_PBUF']),
+    ('capture', r'^__capture', ['CAPTURE_RECORDS', 'CAPTURE_SNAPLEN']),
+    ('sio trace', r'^__sio_trace|^__sio_replay', ['SIO_TRACE_SIZE']),
+    ('task prof', r'^__task_prof', ['TASK_PROF_SLOTS']),
+    ('resolver', r'^__resolv', ['RESOLV_TABLE_SIZE', 'RESOLV_MAX_WAITERS',
+                                'RESOLV_MAX_NAME_LENGTH']),
+    ('uC/OS-II', r'^OS', ['OS_MAX_TASKS', 'OS_MAX_EVENTS', 'OS_MAX_QS',
+                          'OS_MAX_MEM_PART', 'OS_MAX_FLAGS',
+                          'OS_TASK_IDLE_STK_SIZE', 'OS_TASK_STAT_STK_SIZE']),
+]
+
+# runtime region (prefix) -> option which sizes it, first match wins; an
+# option ending in _ is completed with the rest of the region's name
+KNOBS = [
+    ('stack.tcpip', 'TCPIP_THREAD_STACKSIZE'),
+    ('stack.slipif', 'SLIPIF_THREAD_STACKSIZE'),
+    ('stack.ppp', 'PPP_THREAD_STACKSIZE'),
+    ('mbox.slots', 'TCPIP_MBOX_SIZE'),
+    ('mbox', 'OS_MAX_QS'),
+    ('sio_trace', 'SIO_TRACE_SIZE'),
+    ('sio', 'SIO_BUF_SIZE'),
+    ('capture', 'CAPTURE_RECORDS'),
+    ('resolv.waiters', 'RESOLV_MAX_WAITERS'),
+    ('resolv', 'RESOLV_TABLE_SIZE'),
+    ('mem.', 'MEM_ARCH_CLASSES'),
+    ('heap', 'MEM_SIZE'),
+    ('memp.PBUF_POOL', 'PBUF_POOL_SIZE'),
+    ('memp.', 'MEMP_NUM_'),
+]
+
+# "<section> <addr> <size> <object>", the name may be on a line of its own
+SECTION = re.compile(r'^ (\.(?:bss|data|sbss|sdata)(?:\.(\S+))?|COMMON)'
+                     r'(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+))?\s*$')
+CONT = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)\s*$')
+SYMBOL = re.compile(r'^\s+0x([0-9a-f]+)\s+(\w+)\s*$')
+DEFINE = re.compile(r'^\s*#\s*define\s+(\w+)\s+(.+?)\s*(?:/[*/].*)?$')
+RAM = re.compile(r'ram (\S+) (\d+) (\d+)')
+
+
+def parse_map(path):
+    """Return [(symbol, size, object)] of the RAM input sections."""
+    out = []
+    with open(path, errors='replace') as f:
+        lines = f.read().splitlines()
+    i = 0
+    while i < len(lines):
+        m = SECTION.match(lines[i])
+        i += 1
+        if not m:
+            continue
+        name, addr, size, obj = m.group(2), m.group(3), m.group(4), m.group(5)
+        if addr is None:
+            if i >= len(lines):
+                break
+            c = CONT.match(lines[i])
+            if not c:
+                continue
+            i += 1
+            addr, size, obj = c.groups()
+        size = int(size, 16)
+        if size == 0:
+            continue
+        # COMMON and merged .bss list their symbols below
+        syms = []
+        while i < len(lines):
+            s = SYMBOL.match(lines[i])
+            if not s:
+                break
+            syms.append((int(s.group(1), 16), s.group(2)))
+            i += 1
+        if name is None and syms:
+            end = int(addr, 16) + size
+            for n, (a, sym) in enumerate(syms):
+                nxt = syms[n + 1][0] if n + 1 < len(syms) else end
+                out.append((sym, nxt - a, obj))
+        else:
+            out.append((name or os.path.basename(obj), size, obj))
+    return out
+
+
+def subsystem(sym, obj):
+    for name, pattern, _ in SUBSYSTEMS:
+        if re.search(pattern, sym):
+            return name
+    base = os.path.basename(obj)
+    if '/lwip/' in obj.replace('\\', '/') or base.startswith(
+            ('tcp', 'udp', 'ip', 'pbuf', 'mem', 'netif', 'ppp', 'api',
+             'sockets', 'dns', 'etharp', 'raw', 'timers', 'stats')):
+        return 'lwIP other'
+    if 'examples' in obj or 'modem' in base:
+        return 'examples'
+    return 'other'
+
+
+def parse_defines(dirs):
+    defs = {}
+    for d in dirs:
+        for name in ('lwipopts.h', 'os_cfg.h'):
+            path = os.path.join(d, name)
+            if not os.path.exists(path):
+                continue
+            with open(path, errors='replace') as f:
+                text = f.read().replace('\\\n', ' ')
+            for line in text.splitlines():
+                m = DEFINE.match(line)
+                if m:
+                    defs[m.group(1)] = ' '.join(m.group(2).split())
+    return defs
+
+
+def parse_runtime(path):
+    regions = {}
+    with open(path, errors='replace') as f:
+        for line in f:
+            m = RAM.search(line)
+            if m:
+                # the last report wins, it saw the longest run
+                regions[m.group(1)] = (int(m.group(2)), int(m.group(3)))
+    return regions
+
+
+def knob(region):
+    for prefix, name in KNOBS:
+        if region.startswith(prefix):
+            if name.endswith('_'):
+                return name + region[len(prefix):]
+            return name
+    return '?'
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('map', help='GNU ld map file')
+    ap.add_argument('-I', dest='dirs', action='append', default=[],
+                    help='directory holding lwipopts.h or os_cfg.h')
+    ap.add_argument('--runtime', help='console log with the ram_report() '
+                    'lines')
+    ap.add_argument('--headroom', type=int, default=25,
+                    help='percent kept above the peak (default 25)')
+    args = ap.parse_args()
+
+    syms = parse_map(args.map)
+    if not syms:
+        sys.exit('%s: no .bss/.data input sections found' % args.map)
+    defs = parse_defines(args.dirs)
+
+    total = sum(size for _, size, _ in syms)
+    by = {}
+    for sym, size, obj in syms:
+        by.setdefault(subsystem(sym, obj), []).append((size, sym))
+    knobs = {name: opts for name, _, opts in SUBSYSTEMS}
+
+    print('%-12s %8s %6s' % ('subsystem', 'bytes', '%'))
+    for name, items in sorted(by.items(), key=lambda kv: -sum(
+            s for s, _ in kv[1])):
+        n = sum(s for s, _ in items)
+        print('%-12s %8d %5.1f%%' % (name, n, 100.0 * n / total))
+        for size, sym in sorted(items, reverse=True)[:4]:
+            print('    %-32s %8d' % (sym, size))
+        opts = ['%s=%s' % (o, defs[o]) for o in knobs.get(name, [])
+                if o in defs]
+        if opts:
+            print('    sized by ' + ', '.join(opts))
+    print('%-12s %8d' % ('total', total))
+
+    if not args.runtime:
+        return
+    regions = parse_runtime(args.runtime)
+    if not regions:
+        sys.exit('%s: no "ram" lines, was RAM_REPORT enabled?'
+                 % args.runtime)
+    print()
+    print('%-14s %8s %8s %5s %8s  %s' % ('region', 'reserved', 'peak', '%',
+                                        'spare', 'option'))
+    spare = 0
+    for region, (size, peak) in sorted(regions.items()):
+        keep = peak * (100 + args.headroom) // 100
+        free = max(size - keep, 0)
+        spare += free
+        print('%-14s %8d %8d %4d%% %8d  %s' % (
+            region, size, peak, 100 * peak // size if size else 0, free,
+            knob(region)))
+    print('%-14s %35d' % ('reclaimable', spare))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Summarize a serial RX trace recorded with SIO_TRACE.
+
+Get the recording off the target with sio_trace_get() and save it as a
+file. This script decodes the records, deframes the bytes as PPP does
+(flags, escapes) and prints what the receive path has to cope with: the
+data rate, the frame sizes, the share of escaped bytes and the bursts of
+back-to-back bytes, so traces taken in the field can be compared before
+being replayed with sio_trace_replay().
+
+usage: sio_trace.py [-v] [--gap US] trace
+"""
+
+import argparse
+import struct
+import sys
+
+FLAG = 0x7e
+ESC = 0x7d
+
+
+def parse(data):
+    if len(data) < 12 or data[:4] != b'SIOT' or data[4] != 1:
+        sys.exit('not a version 1 trace')
+    hz = struct.unpack_from('<I', data, 8)[0]
+    recs = []
+    off = 12
+    t = 0
+    while off < len(data):
+        v = shift = 0
+        while True:
+            if off == len(data):
+                sys.exit('truncated record at %d' % off)
+            b = data[off]
+            off += 1
+            v |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        t += v >> 1
+        if v & 1:
+            recs.append((t, 'packet', struct.unpack_from('<I', data, off)[0]))
+            off += 4
+        else:
+            recs.append((t, 'byte', data[off]))
+            off += 1
+    return hz, recs
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('-v', action='store_true', help='list every frame')
+    ap.add_argument('--gap', type=float, default=200,
+                    help='microseconds which end a burst (default 200)')
+    ap.add_argument('trace')
+    args = ap.parse_args()
+
+    with open(args.trace, 'rb') as f:
+        hz, recs = parse(f.read())
+    nbytes = [r for r in recs if r[1] == 'byte']
+    packets = [r for r in recs if r[1] == 'packet']
+    if not nbytes:
+        sys.exit('no bytes recorded')
+
+    us = lambda ticks: ticks * 1e6 / hz
+    duration = us(nbytes[-1][0] - nbytes[0][0])
+
+    frames = []
+    escapes = 0
+    cur = 0
+    start = None
+    for t, _, b in nbytes:
+        if b == FLAG:
+            if cur:
+                frames.append((start, cur))
+            cur = 0
+            continue
+        if b == ESC:
+            escapes += 1
+            continue
+        if not cur:
+            start = t
+        cur += 1
+
+    bursts = []
+    run = 1
+    gap = args.gap * hz / 1e6
+    for a, b in zip(nbytes, nbytes[1:]):
+        if b[0] - a[0] > gap:
+            bursts.append(run)
+            run = 1
+        else:
+            run += 1
+    bursts.append(run)
+
+    print('clock            %d Hz' % hz)
+    print('duration         %.3f s' % (duration / 1e6))
+    print('bytes            %d (%.0f bytes/s)' %
+          (len(nbytes), len(nbytes) * 1e6 / duration if duration else 0))
+    print('escaped bytes    %d (%.1f%%)' %
+          (escapes, 100.0 * escapes / len(nbytes)))
+    print('frames           %d' % len(frames))
+    if frames:
+        sizes = sorted(n for _, n in frames)
+        print('frame size       min %d, median %d, max %d' %
+              (sizes[0], sizes[len(sizes) // 2], sizes[-1]))
+    print('packets          %d' % len(packets))
+    print('bursts           %d, longest %d bytes (gap > %g us)' %
+          (len(bursts), max(bursts), args.gap))
+
+    if args.v:
+        for t, n in frames:
+            print('%12.0f us  %5d bytes' % (us(t - nbytes[0][0]), n))
+
+
+if __name__ == '__main__':
+    main()